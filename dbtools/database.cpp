@@ -22,7 +22,13 @@ using namespace std::literals::string_literals;
 bool verbose = false;
 
 database read_db_labelsv1(istream &, std::uint32_t);
+void read_db_labelsv1_header(istream &, std::uint32_t, database &);
+bool read_db_labelsv1_object(istream &, const database &, std::uint32_t,
+                             dbthing &);
 database read_db_oldstyle(istream &, std::uint32_t);
+void read_db_oldstyle_header(istream &, std::uint32_t, database &);
+bool read_db_oldstyle_object(istream &, const database &, std::uint32_t,
+                             dbthing &);
 void write_db_labelsv1(std::ostream &, const database &);
 
 std::string
@@ -264,8 +270,9 @@ dbflags_to_str(std::uint32_t bits)
   return join_words(flags);
 }
 
-istream &
-operator>>(istream &in, database &db)
+// Read the +V line at the start of a database
+static std::uint32_t
+read_dbflags(istream &in)
 {
   char c1, c2;
 
@@ -287,6 +294,13 @@ operator>>(istream &in, database &db)
       "Unable to read this database version. Minimum flags: "s +
       dbflags_to_str(minimum_flags)};
   }
+  return flags;
+}
+
+istream &
+operator>>(istream &in, database &db)
+{
+  std::uint32_t flags = read_dbflags(in);
 
   if (flags & DBF_LABELS) {
     db = read_db_labelsv1(in, flags);
@@ -300,15 +314,12 @@ operator>>(istream &in, database &db)
   return in;
 }
 
-database
-read_database(const std::string &name, COMP compress_type, bool vrbse)
+// Set up a stream to read a possibly compressed database from
+static void
+open_database(istream &dbin, const std::string &name, COMP compress_type)
 {
   namespace io = boost::iostreams;
-  database db;
 
-  verbose = vrbse;
-
-  istream dbin;
   dbin.push(io::counter{1});
 
   switch (compress_type) {
@@ -344,6 +355,17 @@ read_database(const std::string &name, COMP compress_type, bool vrbse)
   if (!dbin) {
     throw std::runtime_error{"Unable to read database."};
   }
+}
+
+database
+read_database(const std::string &name, COMP compress_type, bool vrbse)
+{
+  database db;
+
+  verbose = vrbse;
+
+  istream dbin;
+  open_database(dbin, name, compress_type);
 
   dbin >> db;
   if (dbin.good() || dbin.eof()) {
@@ -353,6 +375,36 @@ read_database(const std::string &name, COMP compress_type, bool vrbse)
   }
 }
 
+db_reader::db_reader(const std::string &name, COMP compress_type, bool vrbse)
+{
+  verbose = vrbse;
+  open_database(in, name, compress_type);
+
+  std::uint32_t flags = read_dbflags(in);
+  labels = flags & DBF_LABELS;
+  if (labels) {
+    read_db_labelsv1_header(in, flags, db);
+    if (verbose) {
+      std::cerr << "Database version " << db.version << '\n';
+    }
+  } else {
+    read_db_oldstyle_header(in, flags, db);
+  }
+  db.dbflags = flags;
+}
+
+bool
+db_reader::next(dbthing &obj)
+{
+  bool more = labels ? read_db_labelsv1_object(in, db, db.dbflags, obj)
+                     : read_db_oldstyle_object(in, db, db.dbflags, obj);
+
+  if (!more && !(in.good() || in.eof())) {
+    throw std::runtime_error{"Unable to read database."};
+  }
+  return more;
+}
+
 void
 write_database(const database &db, const std::string &name, COMP compress_type)
 {
@@ -149,5 +149,26 @@ constexpr int CURRENT_DB_VERSION = 6;
 database read_database(const std::string &, COMP = COMP::NONE, bool = false);
 void write_database(const database &, const std::string &, COMP = COMP::NONE);
 
+// Reads a database one object at a time, for tools that don't need the
+// whole thing in memory at once.
+class db_reader {
+public:
+  db_reader(const std::string &, COMP = COMP::NONE, bool = false);
+  db_reader(const db_reader &) = delete;
+  db_reader &operator=(const db_reader &) = delete;
+
+  // Everything but the objects: version, flags, and the flag, power
+  // and attribute tables.
+  const database &header() const { return db; }
+
+  // Read the next object. Returns false at the end of the database.
+  bool next(dbthing &);
+
+private:
+  istream in;
+  database db;
+  bool labels = false;
+};
+
 istream &operator>>(istream &, database &);
 std::ostream &operator<<(std::ostream &, const database &);
@@ -181,8 +181,9 @@ read_object(istream &in, dbref num, int, std::uint32_t flags)
   return obj;
 }
 
-database
-read_db_labelsv1(istream &in, std::uint32_t flags)
+// Read everything before the first object.
+void
+read_db_labelsv1_header(istream &in, std::uint32_t flags, database &db)
 {
   std::uint32_t minimum_flags = DBF_LABELS | DBF_SPIFFY_LOCKS;
 
@@ -191,59 +192,82 @@ read_db_labelsv1(istream &in, std::uint32_t flags)
     throw db_format_exception{"Invalid database format."};
   }
 
-  database db;
-
   if (flags & DBF_NEW_VERSIONS) {
     db.version = db_read_this_labeled_int(in, "dbversion");
   }
   db.saved_time = db_read_this_labeled_string(in, "savedtime");
+  if (flags & DBF_SPIFFY_AF_ANSI) {
+    db.spiffy_af_ansi = true;
+  }
 
-  char c;
   std::string line;
-  while (in.get(c)) {
-    switch (c) {
-    case '+':
-      std::getline(in, line);
-      if (line == "FLAGS LIST") {
-        db.flags = read_flags(in);
-      } else if (line == "POWER LIST") {
-        db.powers = read_flags(in);
-      } else if (line == "ATTRIBUTES LIST") {
-        db.attribs = read_db_attribs(in);
-      } else {
-        throw db_format_exception{"unknown +LIST: "s + line};
-      }
-      break;
-    case '~': {
+  for (int c = in.peek(); c == '+' || c == '~'; c = in.peek()) {
+    in.get();
+    if (c == '~') {
       long len = db_getref(in);
       db.objects.reserve(len);
-    } break;
-    case '!': {
-      dbref d = db_getref(in);
-      while (static_cast<std::size_t>(d) != db.objects.size()) {
-        if (!(flags & DBF_LESS_GARBAGE)) {
-          std::cerr << "Missing object #" << db.objects.size()
-                    << istream_line(in) << '\n';
-        }
-        dbthing garbage;
-        garbage.num = static_cast<dbref>(db.objects.size());
-        db.objects.emplace_back(std::move(garbage));
-      }
-      db.objects.emplace_back(read_object(in, d, db.version, flags));
-    } break;
-    case '*': {
-      std::string eod;
-      std::getline(in, eod);
-      if (eod != "**END OF DUMP***") {
-        throw db_format_exception{"Invalid end string: *"s + eod};
-      }
-    } break;
-    default:
-      throw db_format_exception{"Unexpected character: "s + c};
+      continue;
+    }
+    std::getline(in, line);
+    if (line == "FLAGS LIST") {
+      db.flags = read_flags(in);
+    } else if (line == "POWER LIST") {
+      db.powers = read_flags(in);
+    } else if (line == "ATTRIBUTES LIST") {
+      db.attribs = read_db_attribs(in);
+    } else {
+      throw db_format_exception{"unknown +LIST: "s + line};
     }
   }
-  if (flags & DBF_SPIFFY_AF_ANSI) {
-    db.spiffy_af_ansi = true;
+}
+
+// Read the next object. Returns false at the end of the dump.
+bool
+read_db_labelsv1_object(istream &in, const database &db, std::uint32_t flags,
+                        dbthing &obj)
+{
+  char c;
+
+  if (!in.get(c)) {
+    return false;
+  }
+  switch (c) {
+  case '!': {
+    dbref d = db_getref(in);
+    obj = read_object(in, d, db.version, flags);
+    return true;
+  }
+  case '*': {
+    std::string eod;
+    std::getline(in, eod);
+    if (eod != "**END OF DUMP***") {
+      throw db_format_exception{"Invalid end string: *"s + eod};
+    }
+    return false;
+  }
+  default:
+    throw db_format_exception{"Unexpected character: "s + c};
+  }
+}
+
+database
+read_db_labelsv1(istream &in, std::uint32_t flags)
+{
+  database db;
+  dbthing obj;
+
+  read_db_labelsv1_header(in, flags, db);
+  while (read_db_labelsv1_object(in, db, flags, obj)) {
+    while (static_cast<std::size_t>(obj.num) > db.objects.size()) {
+      if (!(flags & DBF_LESS_GARBAGE)) {
+        std::cerr << "Missing object #" << db.objects.size()
+                  << istream_line(in) << '\n';
+      }
+      dbthing garbage;
+      garbage.num = static_cast<dbref>(db.objects.size());
+      db.objects.emplace_back(std::move(garbage));
+    }
+    db.objects.emplace_back(std::move(obj));
   }
 
   return db;
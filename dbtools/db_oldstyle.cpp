@@ -197,11 +197,10 @@ read_old_object(istream &in, dbref d, std::uint32_t flags)
   return obj;
 }
 
-database
-read_db_oldstyle(istream &in, std::uint32_t flags)
+// Read everything before the first object.
+void
+read_db_oldstyle_header(istream &in, std::uint32_t flags, database &db)
 {
-  database db{};
-  char c;
   std::string line;
 
   quoted_strings = flags & DBF_NEW_STRINGS;
@@ -211,47 +210,73 @@ read_db_oldstyle(istream &in, std::uint32_t flags)
   db.powers = standard_powers();
   db.attribs = standard_attribs();
 
-  while (in.get(c)) {
-    switch (c) {
-    case '~': {
+  for (int c = in.peek(); c == '+' || c == '~'; c = in.peek()) {
+    in.get();
+    if (c == '~') {
       long len = db_getref(in);
       db.objects.reserve(len);
-    } break;
-    case '+':
-      std::getline(in, line);
-      if (line == "FLAGS LIST") { // DBF_NEW_FLAGS ?
-        db.flags = read_flags(in);
-      } else if (line == "POWER LIST") { // DBF_NEW_POWERS ?
-        db.powers = read_flags(in);
-      } else {
-        throw db_format_exception{"Unrecognized database format!"};
-      }
-      break;
-    case '#': // [[fallthrough]]
-    case '&':
-      throw db_format_exception{"Old style database."};
-    case '!': {
-      dbref d = db_getref(in);
-      while (static_cast<std::size_t>(d) != db.objects.size()) {
-        if (!(flags & DBF_LESS_GARBAGE)) {
-          std::cerr << "Missing object #" << db.objects.size()
-                    << istream_line(in) << '\n';
-        }
-        dbthing garbage;
-        garbage.num = static_cast<dbref>(db.objects.size());
-        db.objects.push_back(std::move(garbage));
-      }
-      db.objects.push_back(read_old_object(in, d, flags));
-    } break;
-    case '*':
-      std::getline(in, line);
-      if (line != "**END OF DUMP***") {
-        throw db_format_exception{"Invalid end string "s + line};
+      continue;
+    }
+    std::getline(in, line);
+    if (line == "FLAGS LIST") { // DBF_NEW_FLAGS ?
+      db.flags = read_flags(in);
+    } else if (line == "POWER LIST") { // DBF_NEW_POWERS ?
+      db.powers = read_flags(in);
+    } else {
+      throw db_format_exception{"Unrecognized database format!"};
+    }
+  }
+}
+
+// Read the next object. Returns false at the end of the dump.
+bool
+read_db_oldstyle_object(istream &in, const database &, std::uint32_t flags,
+                        dbthing &obj)
+{
+  char c;
+  std::string line;
+
+  if (!in.get(c)) {
+    return false;
+  }
+  switch (c) {
+  case '#': // [[fallthrough]]
+  case '&':
+    throw db_format_exception{"Old style database."};
+  case '!': {
+    dbref d = db_getref(in);
+    obj = read_old_object(in, d, flags);
+    return true;
+  }
+  case '*':
+    std::getline(in, line);
+    if (line != "**END OF DUMP***") {
+      throw db_format_exception{"Invalid end string "s + line};
+    }
+    return false;
+  default:
+    throw db_format_exception{"Unexpected character "s + c};
+  }
+}
+
+database
+read_db_oldstyle(istream &in, std::uint32_t flags)
+{
+  database db{};
+  dbthing obj;
+
+  read_db_oldstyle_header(in, flags, db);
+  while (read_db_oldstyle_object(in, db, flags, obj)) {
+    while (static_cast<std::size_t>(obj.num) > db.objects.size()) {
+      if (!(flags & DBF_LESS_GARBAGE)) {
+        std::cerr << "Missing object #" << db.objects.size()
+                  << istream_line(in) << '\n';
       }
-      break;
-    default:
-      throw db_format_exception{"Unexpected character "s + c};
+      dbthing garbage;
+      garbage.num = static_cast<dbref>(db.objects.size());
+      db.objects.push_back(std::move(garbage));
     }
+    db.objects.push_back(std::move(obj));
   }
 
   return db;
@@ -0,0 +1,599 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <cctype>
+
+#include <boost/program_options.hpp>
+
+#include "database.h"
+
+using namespace std::literals::string_literals;
+
+// Minimal JSON output helpers
+
+std::string
+json_string(const std::string &s)
+{
+  std::string esc;
+  esc.reserve(s.size() + 2);
+
+  esc.push_back('"');
+  for (unsigned char c : s) {
+    switch (c) {
+    case '"':
+      esc += "\\\"";
+      break;
+    case '\\':
+      esc += "\\\\";
+      break;
+    case '\n':
+      esc += "\\n";
+      break;
+    case '\r':
+      esc += "\\r";
+      break;
+    case '\t':
+      esc += "\\t";
+      break;
+    default:
+      if (c < 0x20) {
+        const char *hex = "0123456789abcdef";
+        esc += "\\u00";
+        esc.push_back(hex[c >> 4]);
+        esc.push_back(hex[c & 0xF]);
+      } else if (c < 0x80) {
+        esc.push_back(c);
+      } else {
+        // Dumps aren't guaranteed to be UTF-8; treat them as Latin-1.
+        esc.push_back(0xC0 | (c >> 6));
+        esc.push_back(0x80 | (c & 0x3F));
+      }
+    }
+  }
+  esc.push_back('"');
+  return esc;
+}
+
+const char *
+type_name(dbtype t)
+{
+  switch (t) {
+  case dbtype::ROOM:
+    return "ROOM";
+  case dbtype::EXIT:
+    return "EXIT";
+  case dbtype::THING:
+    return "THING";
+  case dbtype::PLAYER:
+    return "PLAYER";
+  case dbtype::GARBAGE:
+  default:
+    return "GARBAGE";
+  }
+}
+
+// Totals for some group of attributes.
+struct usage {
+  std::size_t objects = 0;
+  std::size_t attribs = 0;
+  std::size_t bytes = 0;
+  std::size_t largest = 0;
+
+  void add(std::size_t len)
+  {
+    attribs += 1;
+    bytes += len;
+    largest = std::max(largest, len);
+  }
+};
+
+std::ostream &
+operator<<(std::ostream &out, const usage &u)
+{
+  return out << "\"objects\": " << u.objects
+             << ", \"attributes\": " << u.attribs << ", \"bytes\": " << u.bytes
+             << ", \"largest\": " << u.largest;
+}
+
+// Attribute lengths, in power of two buckets.
+struct histogram {
+  static constexpr int nbuckets = 16;
+  std::array<std::size_t, nbuckets> count{};
+  std::array<std::size_t, nbuckets> bytes{};
+
+  static int bucket(std::size_t len)
+  {
+    int b = 0;
+    while (b < nbuckets - 1 && len > (std::size_t{1} << b)) {
+      b += 1;
+    }
+    return b;
+  }
+
+  void add(std::size_t len)
+  {
+    int b = bucket(len);
+    count[b] += 1;
+    bytes[b] += len;
+  }
+};
+
+// Estimates how well every attribute would compress with the
+// attr_compression algorithms the game offers. They're approximations:
+// the real huffman tree is tuned with a few special cases and a maximum
+// code length, and the word table is shared with anything else the game
+// compresses.
+class compression_estimate {
+public:
+  void add(const std::string &s)
+  {
+    for (unsigned char c : s) {
+      freqs[c] += 1;
+    }
+    freqs[0] += 1; // End of string
+    plain += s.size() + 1;
+    word += word_compress(s) + 1;
+  }
+
+  std::size_t none() const { return plain; }
+  std::size_t huffman() const;
+  std::size_t word_bytes() const { return word; }
+  std::size_t word_table() const { return table_bytes; }
+
+private:
+  std::array<std::size_t, 256> freqs{};
+  std::size_t plain = 0;
+  std::size_t word = 0;
+
+  // Mirror of comp_w8.c's table
+  static constexpr std::size_t maxtable = 32768;
+  static constexpr std::size_t maxwords = 100;
+  static constexpr int collision_limit = 20;
+  std::vector<std::string> words = std::vector<std::string>(maxtable);
+  std::size_t table_bytes = 0;
+
+  std::size_t word_compress(const std::string &);
+  std::size_t output_word(const std::string &);
+};
+
+std::size_t
+compression_estimate::output_word(const std::string &w)
+{
+  if (w.size() <= 3) {
+    return w.size();
+  }
+
+  unsigned hashval = 0;
+  for (char c : w) {
+    hashval = (hashval << 5) + hashval + c;
+  }
+
+  std::size_t i = hashval & (maxtable - 1);
+  int j = 0;
+  for (; i < maxtable && (!words[i].empty() || (i & 0xFF) == 0) &&
+         j < collision_limit;
+       i += 1, j += 1) {
+    if (words[i] == w) {
+      return 3;
+    }
+  }
+  if ((i & 0xFF) == 0) {
+    i += 1;
+    j += 1;
+  }
+  if (i >= maxtable || j >= collision_limit) {
+    return w.size();
+  }
+  words[i] = w;
+  table_bytes += w.size() + 1;
+  return 3;
+}
+
+std::size_t
+compression_estimate::word_compress(const std::string &s)
+{
+  std::size_t len = 0;
+  std::string w;
+
+  for (char c : s) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) ||
+        w.size() >= maxwords) {
+      if (!w.empty()) {
+        w.push_back(c);
+        len += output_word(w);
+        w.clear();
+      } else {
+        len += 1;
+      }
+    } else {
+      w.push_back(c);
+    }
+  }
+  if (!w.empty()) {
+    len += output_word(w);
+  }
+  return len;
+}
+
+std::size_t
+compression_estimate::huffman() const
+{
+  // Build the code lengths of an unrestricted huffman tree and add up
+  // how many bits every character would take. Each compressed string
+  // is rounded up to a whole byte; count that as half a byte on average.
+  struct node {
+    std::size_t freq;
+    int left, right;
+  };
+  std::vector<node> nodes;
+  using entry = std::pair<std::size_t, int>;
+  std::priority_queue<entry, std::vector<entry>, std::greater<entry>> pq;
+
+  for (int c = 0; c < 256; c += 1) {
+    if (freqs[c]) {
+      nodes.push_back({freqs[c], -1, c});
+      pq.emplace(freqs[c], nodes.size() - 1);
+    }
+  }
+  if (pq.empty()) {
+    return 0;
+  }
+  if (pq.size() == 1) {
+    return plain; // Only empty strings
+  }
+  while (pq.size() > 1) {
+    auto a = pq.top();
+    pq.pop();
+    auto b = pq.top();
+    pq.pop();
+    nodes.push_back({a.first + b.first, a.second, b.second});
+    pq.emplace(a.first + b.first, nodes.size() - 1);
+  }
+
+  std::size_t bits = 0;
+  std::vector<std::pair<int, int>> stack{{pq.top().second, 0}};
+  while (!stack.empty()) {
+    auto top = stack.back();
+    stack.pop_back();
+    const auto &n = nodes[top.first];
+    if (n.left < 0) {
+      bits += n.freq * top.second;
+    } else {
+      stack.emplace_back(n.left, top.second + 1);
+      stack.emplace_back(n.right, top.second + 1);
+    }
+  }
+  return bits / 8 + freqs[0] / 2;
+}
+
+// Identical attribute values, found by hashing.
+struct duplicate {
+  std::size_t count = 0;
+  std::size_t len = 0;
+  dbref where = NOTHING;
+  std::string attr;
+};
+
+struct object_size {
+  dbref num;
+  std::string name;
+  dbtype type;
+  usage u;
+};
+
+// Ages of objects, by last modification time.
+const std::array<long, 5> age_days{{1, 7, 30, 365, -1}};
+
+struct dbstats {
+  std::size_t top = 10;
+
+  std::size_t locks = 0;
+  std::size_t lock_bytes = 0;
+  usage all;
+  histogram sizes;
+  std::map<std::string, usage> by_type;
+  std::unordered_map<std::string, usage> by_attr;
+  std::unordered_map<dbref, usage> by_owner;
+  std::unordered_map<dbref, std::string> player_names;
+  std::unordered_map<std::size_t, duplicate> values;
+  compression_estimate comp;
+  std::vector<object_size> largest;
+  std::vector<std::pair<std::time_t, std::size_t>> modified;
+
+  void add(const dbthing &);
+  void report(std::ostream &, const database &);
+};
+
+void
+dbstats::add(const dbthing &obj)
+{
+  object_size os{obj.num, obj.name, obj.type, {}};
+  auto &type = by_type[type_name(obj.type)];
+  auto &owner = by_owner[obj.owner];
+
+  if (obj.type == dbtype::PLAYER) {
+    player_names[obj.num] = obj.name;
+  }
+  all.objects += 1;
+  type.objects += 1;
+  owner.objects += 1;
+  os.u.objects = 1;
+
+  for (const auto &l2 : obj.locks) {
+    locks += 1;
+    lock_bytes += l2.second.key.size();
+  }
+
+  std::hash<std::string> hasher;
+  for (const auto &a2 : obj.attribs) {
+    const auto &a = a2.second;
+    auto len = a.data.size();
+    all.add(len);
+    type.add(len);
+    owner.add(len);
+    os.u.add(len);
+    sizes.add(len);
+    auto &an = by_attr[a.name];
+    an.objects += 1;
+    an.add(len);
+    comp.add(a.data);
+
+    if (len > 0) {
+      auto &dup = values[hasher(a.data)];
+      if (dup.count++ == 0) {
+        dup.len = len;
+        dup.where = obj.num;
+        dup.attr = a.name;
+      }
+    }
+  }
+
+  modified.emplace_back(obj.modified, os.u.bytes);
+
+  // Keep the largest objects in a min-heap of the top N.
+  auto smaller = [](const object_size &a, const object_size &b) {
+    return a.u.bytes > b.u.bytes;
+  };
+  if (largest.size() < top) {
+    largest.push_back(std::move(os));
+    std::push_heap(largest.begin(), largest.end(), smaller);
+  } else if (top > 0 && os.u.bytes > largest.front().u.bytes) {
+    std::pop_heap(largest.begin(), largest.end(), smaller);
+    largest.back() = std::move(os);
+    std::push_heap(largest.begin(), largest.end(), smaller);
+  }
+}
+
+// Return the top N entries of a map by bytes used.
+template <typename Map>
+std::vector<typename Map::const_iterator>
+top_by_bytes(const Map &m, std::size_t n)
+{
+  std::vector<typename Map::const_iterator> v;
+  for (auto it = m.begin(); it != m.end(); ++it) {
+    v.push_back(it);
+  }
+  auto bigger = [](const auto &a, const auto &b) {
+    if (a->second.bytes != b->second.bytes) {
+      return a->second.bytes > b->second.bytes;
+    }
+    return a->first < b->first;
+  };
+  n = std::min(n, v.size());
+  std::partial_sort(v.begin(), v.begin() + n, v.end(), bigger);
+  v.resize(n);
+  return v;
+}
+
+void
+dbstats::report(std::ostream &out, const database &db)
+{
+  const char *sep;
+
+  out << "{\n  \"version\": " << db.version
+      << ",\n  \"saved\": " << json_string(db.saved_time) << ",\n";
+
+  out << "  \"totals\": {" << all << ", \"locks\": " << locks
+      << ", \"lock_bytes\": " << lock_bytes
+      << ", \"attribute_names\": " << by_attr.size() << "},\n";
+
+  out << "  \"sizes\": [";
+  sep = "\n";
+  for (int b = 0; b < histogram::nbuckets; b += 1) {
+    if (sizes.count[b] == 0) {
+      continue;
+    }
+    out << sep << "    {\"max\": ";
+    if (b == histogram::nbuckets - 1) {
+      out << "null";
+    } else {
+      out << (std::size_t{1} << b);
+    }
+    out << ", \"attributes\": " << sizes.count[b]
+        << ", \"bytes\": " << sizes.bytes[b] << '}';
+    sep = ",\n";
+  }
+  out << "\n  ],\n";
+
+  out << "  \"types\": {";
+  sep = "\n";
+  for (const auto &t : by_type) {
+    out << sep << "    " << json_string(t.first) << ": {" << t.second << '}';
+    sep = ",\n";
+  }
+  out << "\n  },\n";
+
+  out << "  \"attributes\": [";
+  sep = "\n";
+  for (auto a : top_by_bytes(by_attr, top)) {
+    out << sep << "    {\"name\": " << json_string(a->first) << ", "
+        << a->second << '}';
+    sep = ",\n";
+  }
+  out << "\n  ],\n";
+
+  out << "  \"owners\": [";
+  sep = "\n";
+  for (auto o : top_by_bytes(by_owner, top)) {
+    auto name = player_names.find(o->first);
+    out << sep << "    {\"dbref\": " << o->first << ", \"name\": "
+        << (name == player_names.end() ? "null"s : json_string(name->second))
+        << ", " << o->second << '}';
+    sep = ",\n";
+  }
+  out << "\n  ],\n";
+
+  std::size_t distinct = values.size(), duplicated = 0, saved = 0;
+  std::vector<const duplicate *> dups;
+  for (const auto &v : values) {
+    if (v.second.count > 1) {
+      duplicated += 1;
+      saved += (v.second.count - 1) * v.second.len;
+      dups.push_back(&v.second);
+    }
+  }
+  auto wasteful = [](const duplicate *a, const duplicate *b) {
+    auto wa = (a->count - 1) * a->len, wb = (b->count - 1) * b->len;
+    if (wa != wb) {
+      return wa > wb;
+    }
+    return a->where < b->where;
+  };
+  auto ndups = std::min(top, dups.size());
+  std::partial_sort(dups.begin(), dups.begin() + ndups, dups.end(), wasteful);
+  out << "  \"duplicates\": {\"distinct_values\": " << distinct
+      << ", \"duplicated_values\": " << duplicated
+      << ", \"saved_bytes\": " << saved << ", \"top\": [";
+  sep = "\n";
+  for (std::size_t n = 0; n < ndups; n += 1) {
+    out << sep << "    {\"count\": " << dups[n]->count
+        << ", \"bytes\": " << dups[n]->len << ", \"first\": "
+        << json_string("#"s + std::to_string(dups[n]->where) + "/" +
+                       dups[n]->attr)
+        << '}';
+    sep = ",\n";
+  }
+  out << "\n  ]},\n";
+
+  auto ratio = [&](std::size_t bytes) {
+    return comp.none() ? static_cast<double>(bytes) / comp.none() : 1.0;
+  };
+  auto huff = comp.huffman();
+  auto word = comp.word_bytes() + comp.word_table();
+  out << "  \"compression\": {\n"
+      << "    \"none\": {\"bytes\": " << comp.none() << ", \"ratio\": 1},\n"
+      << "    \"huffman\": {\"bytes\": " << huff
+      << ", \"ratio\": " << ratio(huff) << "},\n"
+      << "    \"word\": {\"bytes\": " << word
+      << ", \"table_bytes\": " << comp.word_table()
+      << ", \"ratio\": " << ratio(word) << "}\n  },\n";
+
+  // Ages are relative to the most recently modified object, so the
+  // report doesn't depend on when it was run.
+  std::time_t newest = 0;
+  for (const auto &m : modified) {
+    newest = std::max(newest, m.first);
+  }
+  std::array<std::pair<std::size_t, std::size_t>, age_days.size()> ages{};
+  for (const auto &m : modified) {
+    auto days = (newest - m.first) / (24 * 60 * 60);
+    std::size_t b = 0;
+    while (age_days[b] >= 0 && days >= age_days[b]) {
+      b += 1;
+    }
+    ages[b].first += 1;
+    ages[b].second += m.second;
+  }
+  out << "  \"modified\": [";
+  sep = "\n";
+  for (std::size_t b = 0; b < ages.size(); b += 1) {
+    out << sep << "    {\"max_days\": ";
+    if (age_days[b] < 0) {
+      out << "null";
+    } else {
+      out << age_days[b];
+    }
+    out << ", \"objects\": " << ages[b].first
+        << ", \"bytes\": " << ages[b].second << '}';
+    sep = ",\n";
+  }
+  out << "\n  ],\n";
+
+  std::sort(largest.begin(), largest.end(),
+            [](const object_size &a, const object_size &b) {
+              if (a.u.bytes != b.u.bytes) {
+                return a.u.bytes > b.u.bytes;
+              }
+              return a.num < b.num;
+            });
+  out << "  \"largest_objects\": [";
+  sep = "\n";
+  for (const auto &o : largest) {
+    out << sep << "    {\"dbref\": " << o.num
+        << ", \"name\": " << json_string(o.name)
+        << ", \"type\": " << json_string(type_name(o.type))
+        << ", \"attributes\": " << o.u.attribs << ", \"bytes\": " << o.u.bytes
+        << '}';
+    sep = ",\n";
+  }
+  out << "\n  ]\n}\n";
+}
+
+int
+main(int argc, char **argv)
+{
+  int comp{COMP::NONE};
+  std::string dbfile = "-";
+  dbstats stats;
+
+  namespace po = boost::program_options;
+  po::options_description desc("Options");
+  desc.add_options()("help,h", "print help message")(
+    ",z", po::value<int>(&comp)->implicit_value(COMP::GZ, "")->zero_tokens(),
+    "compressed with gzip")(
+    ",j", po::value<int>(&comp)->implicit_value(COMP::BZ2, "")->zero_tokens(),
+    "compressed with bzip2")("top,n", po::value<std::size_t>(&stats.top),
+                             "number of entries in top lists (default 10)");
+  po::options_description hidden("Hidden options");
+  hidden.add_options()("input-file", po::value<std::string>(), "input file");
+  po::positional_options_description p;
+  p.add("input-file", 1);
+  po::options_description allopts;
+  allopts.add(desc).add(hidden);
+
+  try {
+    po::variables_map vm;
+    po::store(
+      po::command_line_parser(argc, argv).options(allopts).positional(p).run(),
+      vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+      std::cout << "Usage: " << argv[0] << " [OPTIONS] [FILE]\n\n"
+                << "Report where the space in a Penn DB goes, as JSON.\n\n"
+                << desc << '\n';
+      return 0;
+    }
+
+    if (vm.count("input-file")) {
+      dbfile = vm["input-file"].as<std::string>();
+    }
+
+    db_reader db{dbfile, static_cast<COMP>(comp)};
+    dbthing obj;
+    while (db.next(obj)) {
+      stats.add(obj);
+    }
+    stats.report(std::cout, db.header());
+    return 0;
+  } catch (std::exception &e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+}
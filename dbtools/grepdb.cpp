@@ -1,10 +1,23 @@
 #include <iostream>
 #include <string>
-#include <regex>
+#include <vector>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include <boost/program_options.hpp>
 
 #include "database.h"
 
+#ifdef HAVE_PCRE2
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#else
+#include <regex>
+#endif
+
 using namespace std::literals::string_literals;
 
 struct search_fields {
@@ -13,58 +26,347 @@ struct search_fields {
   bool attribs = false;
 };
 
-void
-grep_db(const database &db, const std::regex &re, search_fields what)
+// A compiled pattern. Safe to share between threads; each thread needs
+// its own scratch space.
+class matcher {
+public:
+  matcher(const std::string &, bool);
+  ~matcher();
+  matcher(const matcher &) = delete;
+  matcher &operator=(const matcher &) = delete;
+
+  class scratch {
+  public:
+    explicit scratch(const matcher &);
+    ~scratch();
+    scratch(const scratch &) = delete;
+    scratch &operator=(const scratch &) = delete;
+
+  private:
+    friend class matcher;
+#ifdef HAVE_PCRE2
+    pcre2_match_data *md;
+#endif
+  };
+
+  bool search(const std::string &, scratch &) const;
+
+private:
+#ifdef HAVE_PCRE2
+  pcre2_code *re;
+#else
+  std::regex re;
+#endif
+};
+
+#ifdef HAVE_PCRE2
+matcher::matcher(const std::string &pattern, bool insensitive)
+{
+  int errcode;
+  PCRE2_SIZE erroffset;
+  std::uint32_t flags = 0;
+
+  if (insensitive) {
+    flags |= PCRE2_CASELESS;
+  }
+  re = pcre2_compile(reinterpret_cast<PCRE2_SPTR>(pattern.data()),
+                     pattern.size(), flags, &errcode, &erroffset, nullptr);
+  if (!re) {
+    PCRE2_UCHAR msg[256];
+    pcre2_get_error_message(errcode, msg, sizeof msg);
+    throw std::runtime_error{"Invalid regular expression: "s +
+                             reinterpret_cast<char *>(msg)};
+  }
+  pcre2_jit_compile(re, PCRE2_JIT_COMPLETE);
+}
+
+matcher::~matcher() { pcre2_code_free(re); }
+
+matcher::scratch::scratch(const matcher &m)
+  : md{pcre2_match_data_create_from_pattern(m.re, nullptr)}
+{
+}
+
+matcher::scratch::~scratch() { pcre2_match_data_free(md); }
+
+bool
+matcher::search(const std::string &s, scratch &sc) const
+{
+  return pcre2_match(re, reinterpret_cast<PCRE2_SPTR>(s.data()), s.size(), 0,
+                     0, sc.md, nullptr) >= 0;
+}
+#else
+matcher::matcher(const std::string &pattern, bool insensitive)
+{
+  auto flags =
+    std::regex_constants::ECMAScript | std::regex_constants::optimize;
+  if (insensitive) {
+    flags |= std::regex_constants::icase;
+  }
+  re = std::regex{pattern, flags};
+}
+
+matcher::~matcher() {}
+
+matcher::scratch::scratch(const matcher &) {}
+
+matcher::scratch::~scratch() {}
+
+bool
+matcher::search(const std::string &s, scratch &) const
 {
-  for (const auto &obj : db.objects) {
-    bool header = false;
+  return std::regex_search(s.begin(), s.end(), re);
+}
+#endif
 
-    if (what.name && std::regex_search(obj.name.begin(), obj.name.end(), re)) {
-      std::cout << '#' << obj.num << ":\n\tName: " << obj.name << '\n';
+// Append a report of where an object matches to out.
+void
+grep_object(const dbthing &obj, const matcher &re, matcher::scratch &sc,
+            search_fields what, std::string &out)
+{
+  bool header = false;
+  auto obj_header = [&]() {
+    if (!header) {
+      out += '#';
+      out += std::to_string(obj.num);
+      out += ":\n";
       header = true;
     }
+  };
 
-    if (what.locks) {
-      bool inlock = false;
-      for (const auto &l2 : obj.locks) {
-        const auto &lock = l2.second;
-        if (std::regex_search(lock.key.begin(), lock.key.end(), re)) {
-          if (!header) {
-            std::cout << '#' << obj.num << ":\n";
-            header = true;
-          }
-          if (!inlock) {
-            std::cout << "\tLocks:";
-            inlock = true;
-          }
-          std::cout << ' ' << lock.type;
+  if (what.name && re.search(obj.name, sc)) {
+    obj_header();
+    out += "\tName: ";
+    out += obj.name;
+    out += '\n';
+  }
+
+  if (what.locks) {
+    bool inlock = false;
+    for (const auto &l2 : obj.locks) {
+      const auto &lock = l2.second;
+      if (re.search(lock.key, sc)) {
+        obj_header();
+        if (!inlock) {
+          out += "\tLocks:";
+          inlock = true;
         }
-      }
-      if (inlock) {
-        std::cout << '\n';
+        out += ' ';
+        out += lock.type;
       }
     }
+    if (inlock) {
+      out += '\n';
+    }
+  }
 
-    if (what.attribs) {
-      bool inattr = false;
-      for (const auto &a2 : obj.attribs) {
-        const auto &a = a2.second;
-        if (std::regex_search(a.data.begin(), a.data.end(), re)) {
-          if (!header) {
-            std::cout << '#' << obj.num << ":\n";
-            header = true;
-          }
-          if (!inattr) {
-            std::cout << "\tAttributes:";
-            inattr = true;
-          }
-          std::cout << ' ' << a.name;
+  if (what.attribs) {
+    bool inattr = false;
+    for (const auto &a2 : obj.attribs) {
+      const auto &a = a2.second;
+      if (re.search(a.data, sc)) {
+        obj_header();
+        if (!inattr) {
+          out += "\tAttributes:";
+          inattr = true;
         }
+        out += ' ';
+        out += a.name;
+      }
+    }
+    if (inattr) {
+      out += '\n';
+    }
+  }
+}
+
+using batch = std::vector<dbthing>;
+constexpr std::size_t batch_size = 256;
+
+using clock_type = std::chrono::steady_clock;
+
+double
+seconds_since(clock_type::time_point start)
+{
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+// The parallel pipeline: the main thread parses objects into batches,
+// matcher threads turn batches into output, and a writer thread prints
+// the output in the original order.
+class grep_pipeline {
+public:
+  grep_pipeline(const matcher &m, search_fields w, int n)
+    : re(m), what(w), nthreads(n)
+  {
+  }
+
+  void run(db_reader &);
+
+  double match_time = 0.0; // Summed over every matcher thread
+  double read_time = 0.0;
+  std::size_t objects = 0;
+
+private:
+  const matcher &re;
+  search_fields what;
+  int nthreads;
+
+  std::mutex lock;
+  std::condition_variable work_ready, room_ready, output_ready;
+  std::deque<std::pair<std::size_t, batch>> work;
+  std::map<std::size_t, std::string> output;
+  bool reading_done = false;
+  std::size_t matchers_running = 0;
+
+  void match_thread();
+  void write_thread();
+};
+
+void
+grep_pipeline::match_thread()
+{
+  matcher::scratch sc{re};
+  double busy = 0.0;
+
+  for (;;) {
+    std::pair<std::size_t, batch> job;
+    {
+      std::unique_lock<std::mutex> guard{lock};
+      work_ready.wait(guard, [&] { return !work.empty() || reading_done; });
+      if (work.empty()) {
+        break;
+      }
+      job = std::move(work.front());
+      work.pop_front();
+      room_ready.notify_one();
+    }
+
+    auto start = clock_type::now();
+    std::string out;
+    for (const auto &obj : job.second) {
+      grep_object(obj, re, sc, what, out);
+    }
+    busy += seconds_since(start);
+
+    std::lock_guard<std::mutex> guard{lock};
+    output.emplace(job.first, std::move(out));
+    output_ready.notify_one();
+  }
+
+  std::lock_guard<std::mutex> guard{lock};
+  match_time += busy;
+  matchers_running -= 1;
+  output_ready.notify_one();
+}
+
+void
+grep_pipeline::write_thread()
+{
+  std::size_t next = 0;
+
+  for (;;) {
+    std::string out;
+    {
+      std::unique_lock<std::mutex> guard{lock};
+      output_ready.wait(guard, [&] {
+        return output.count(next) || (matchers_running == 0 && work.empty());
+      });
+      auto it = output.find(next);
+      if (it == output.end()) {
+        break;
+      }
+      out = std::move(it->second);
+      output.erase(it);
+    }
+    std::cout << out;
+    next += 1;
+  }
+  std::cout.flush();
+}
+
+void
+grep_pipeline::run(db_reader &in)
+{
+  std::vector<std::thread> matchers;
+
+  matchers_running = nthreads;
+  for (int n = 0; n < nthreads; n += 1) {
+    matchers.emplace_back(&grep_pipeline::match_thread, this);
+  }
+  std::thread writer{&grep_pipeline::write_thread, this};
+
+  auto finish = [&] {
+    {
+      std::lock_guard<std::mutex> guard{lock};
+      reading_done = true;
+      work_ready.notify_all();
+    }
+    for (auto &t : matchers) {
+      t.join();
+    }
+    writer.join();
+  };
+
+  std::size_t seq = 0;
+  batch b;
+  dbthing obj;
+  auto start = clock_type::now();
+  try {
+    for (;;) {
+      bool more = in.next(obj);
+      if (more) {
+        objects += 1;
+        b.push_back(std::move(obj));
+      }
+      if (b.size() == batch_size || (!more && !b.empty())) {
+        read_time += seconds_since(start);
+        std::unique_lock<std::mutex> guard{lock};
+        // Don't let the reader get too far ahead of the matchers
+        room_ready.wait(guard, [&] {
+          return work.size() < static_cast<std::size_t>(nthreads) * 4;
+        });
+        work.emplace_back(seq++, std::move(b));
+        b.clear();
+        work_ready.notify_one();
+        start = clock_type::now();
       }
-      if (inattr) {
-        std::cout << '\n';
+      if (!more) {
+        read_time += seconds_since(start);
+        break;
       }
     }
+  } catch (...) {
+    // A bad db; stop the other threads before letting the error out,
+    // or their destructors terminate the program.
+    finish();
+    throw;
+  }
+  finish();
+}
+
+// Without threads, just match each object as it is read.
+void
+grep_serial(db_reader &in, const matcher &re, search_fields what,
+            grep_pipeline &stats)
+{
+  matcher::scratch sc{re};
+  dbthing obj;
+  std::string out;
+
+  for (;;) {
+    auto start = clock_type::now();
+    bool more = in.next(obj);
+    stats.read_time += seconds_since(start);
+    if (!more) {
+      break;
+    }
+    stats.objects += 1;
+    start = clock_type::now();
+    out.clear();
+    grep_object(obj, re, sc, what, out);
+    std::cout << out;
+    stats.match_time += seconds_since(start);
   }
 }
 
@@ -72,9 +374,14 @@ int
 main(int argc, char **argv)
 {
   int comp{COMP::NONE};
-  bool insensitive{false}, all{false};
+  bool insensitive{false}, all{false}, timing{false};
+  int threads = std::thread::hardware_concurrency();
   search_fields what;
 
+  if (threads < 1) {
+    threads = 1;
+  }
+
   namespace po = boost::program_options;
   po::options_description desc("Options");
   desc.add_options()("help,h", "print help message")(
@@ -86,7 +393,10 @@ main(int argc, char **argv)
     "compressed with gzip")(
     ",j", po::value<int>(&comp)->implicit_value(COMP::BZ2, "")->zero_tokens(),
     "compressed with bzip2")(",i", po::bool_switch(&insensitive),
-                             "case-insensitive match");
+                             "case-insensitive match")(
+    "threads", po::value<int>(&threads),
+    "number of matcher threads (1 for none)")(
+    "timing", po::bool_switch(&timing), "print timing information");
   po::options_description hidden("Hidden options");
   hidden.add_options()("pattern", po::value<std::string>(),
                        "regex to search for")(
@@ -124,21 +434,30 @@ main(int argc, char **argv)
       input_db = vm["input-file"].as<std::string>();
     }
 
-    auto db = read_database(input_db, static_cast<COMP>(comp), false);
-
-    auto flags =
-      std::regex_constants::ECMAScript | std::regex_constants::optimize;
-    if (insensitive) {
-      flags |= std::regex_constants::icase;
-    }
-
     if (all ||
         (what.name == false && what.locks == false && what.attribs == false)) {
       what.name = what.locks = what.attribs = true;
     }
 
-    grep_db(db, std::regex{pattern, flags}, what);
+    auto start = clock_type::now();
+    matcher re{pattern, insensitive};
+    db_reader db{input_db, static_cast<COMP>(comp), false};
+    grep_pipeline pipeline{re, what, threads};
+
+    if (threads > 1) {
+      pipeline.run(db);
+    } else {
+      threads = 1;
+      grep_serial(db, re, what, pipeline);
+    }
 
+    if (timing) {
+      std::cerr << "Searched " << pipeline.objects << " objects in "
+                << seconds_since(start) << " seconds.\n"
+                << "Reading: " << pipeline.read_time << " seconds.\n"
+                << "Matching: " << pipeline.match_time << " seconds over "
+                << threads << (threads == 1 ? " thread.\n" : " threads.\n");
+    }
   } catch (std::exception &e) {
     std::cerr << "Error: " << e.what() << '\n';
     return 1;
@@ -210,6 +210,7 @@ typedef struct _ansi_string {
 
 int ansi_strcmp(const char *astr, const char *bstr);
 char *remove_markup(const char *orig, size_t *stripped_len);
+char *remove_markup_r(const char *orig, char *buff, size_t *stripped_len);
 void sanitize_moniker(const char *input, char *buff, char **bp);
 char *skip_leading_ansi(const char *p, const char *bound);
 
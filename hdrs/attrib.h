@@ -23,6 +23,18 @@ struct attr {
   chunk_reference_t data; /**< The attribute's value, compressed */
 };
 
+/** A sorted run of an object's attributes.
+ * An object's attribute list is a sorted array of leaves of bounded
+ * size, so adding or removing an attribute only has to shift the entries
+ * of a single leaf. Only an object with a single leaf can have an empty
+ * one, and atrs[count] is always an entry with a NULL name.
+ */
+struct attr_leaf {
+  int count;   /**< Number of attributes in the leaf */
+  int cap;     /**< Number of slots, not counting the terminator */
+  ATTR atrs[]; /**< The attributes */
+};
+
 /** An alias for an attribute.
  */
 typedef struct atr_alias {
@@ -66,8 +78,8 @@ typedef enum {
 
 int good_atr_name(char const *s);
 ATTR *atr_match(char const *string);
-ATTR *atr_sub_branch(ATTR *branch);
-ATTR *atr_sub_branch_prev(ATTR *branch);
+ATTR *atr_sub_branch(dbref thing, ATTR *branch);
+ATTR *atr_next(dbref thing, ATTR *atr);
 void atr_new_add(dbref thing, char const *RESTRICT atr, char const *RESTRICT s,
                  dbref player, uint32_t flags, uint8_t derefs, bool makeroots);
 atr_err atr_add(dbref thing, char const *RESTRICT atr, char const *RESTRICT s,
@@ -186,8 +198,22 @@ extern ATTR attr[]; /**< external predefined attributes. */
 #define AL_FLAGS(alist) ((alist)->flags)
 #define AL_DEREFS(alist) ((alist)->data ? chunk_derefs((alist)->data) : 0)
 
+/** Loop over all of an object's attributes in name order.
+ * The inner loop runs over one leaf at a time; it only moves on to the
+ * next leaf when it reaches the end of the current one, so break and
+ * continue in the body behave as they would in a single loop.
+ */
 #define ATTR_FOR_EACH(obj, var)                                                \
-  if (List(obj))                                                               \
-    for (var = List(obj); AL_NAME(var); var++)
+  ATTR_FOR_EACH_LEAF (List(obj), AttrLeaves(obj), var)
+
+/** Loop over the attributes in a list of nleaves leaves, such as one
+ * copied from an object. */
+#define ATTR_FOR_EACH_LEAF(leaves, nleaves, var)                               \
+  if (leaves)                                                                  \
+    for (ATTR_LEAF **atr_leaf_ = (leaves), **atr_end_ = atr_leaf_ + (nleaves), \
+                   **atr_next_ = NULL;                                         \
+         atr_leaf_ && atr_leaf_ < atr_end_; atr_leaf_ = atr_next_)             \
+      for (var = (atr_next_ = NULL, (*atr_leaf_)->atrs);                       \
+           AL_NAME(var) || (atr_next_ = atr_leaf_ + 1, 0); var++)
 
 #endif /* __ATTRIB_H */
@@ -9,7 +9,8 @@
    UTF-16 and UTF-32 strings assume the string is well formed and
    again don't do sanity checks. This might change in the future to
    act the same as the UTF-8 ones. UTF-16 and UTF-32 byte ordering is
-   native. */
+   native. _r versions write into a caller-supplied buffer instead of
+   allocating one, and are safe to use from any thread. */
 
 bool valid_utf8(const char *);
 
@@ -20,11 +21,17 @@ char *latin1_to_utf8(const char *restrict, int, int *,
                      const char *) __attribute_malloc__;
 char *latin1_to_utf8_tn(const char *restrict, int, int *, bool,
                         const char *) __attribute_malloc__;
+int latin1_to_utf8_r(const char *restrict, int, char *restrict, int);
+int latin1_to_utf8_tn_r(const char *restrict, int, char *restrict, int, bool);
 
 char *utf8_to_latin1(const char *restrict, int, int *, bool,
                      const char *) __attribute_malloc__;
 char *utf8_to_latin1_us(const char *restrict, int, int *, bool,
                         const char *) __attribute_malloc__;
+int utf8_to_latin1_r(const char *restrict, int, char *restrict, int, bool);
+int utf8_to_latin1_us_r(const char *restrict, int, char *restrict, int, bool);
+
+int safe_latin1_to_ascii(const char *restrict, int, char *, char **);
 
 char *utf16_to_utf8(const UChar *, int, int *,
                     const char *) __attribute_malloc__;
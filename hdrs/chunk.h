@@ -12,6 +12,9 @@ typedef uintptr_t chunk_reference_t;
 #define NULL_CHUNK_REFERENCE 0
 
 chunk_reference_t chunk_create(char const *data, uint32_t len, uint8_t derefs);
+chunk_reference_t chunk_create_shared(char const *data, uint32_t len,
+                                      uint8_t derefs);
+chunk_reference_t chunk_share(chunk_reference_t *reference);
 void chunk_delete(chunk_reference_t reference);
 uint32_t chunk_fetch(chunk_reference_t reference, char *buffer,
                      uint32_t buffer_len);
@@ -281,6 +281,7 @@ struct options_table {
   int count_all; /**< Are hidden players included in total player counts? */
   int exits_connect_rooms; /**< Does the presence of an exit make a room
                               connected? */
+  int lazy_attributes; /**< Are attributes read from the db when first used? */
   int
     zone_control; /**< Are only ZMPs allowed to determine zone-based control? */
   int link_to_object; /**< Can exits be linked to objects? */
@@ -291,6 +292,8 @@ struct options_table {
   int player_name_spaces; /**< Can players have multiword names? */
   int max_aliases;        /**< Maximum allowed aliases per player */
   int forking_dump;       /**< Should we fork to dump? */
+  int snapshot_dump;      /**< Should forking dumps use a snapshot instead? */
+  int dump_threads;       /**< Worker threads for paranoid dumps */
   int restrict_building;  /**< Is the builder power required to build? */
   int free_objects; /**< If builder power is required, can you create without
                        it? */
@@ -329,6 +332,8 @@ struct options_table {
   int float_precision;      /**< Precision of floating point display */
   int player_name_len;      /**< Maximum length of player names */
   int queue_entry_cpu_time; /**< Maximum cpu time allowed per queue entry */
+  int grep_threads;         /**< Worker threads used by @grep/all */
+  int grep_cpu_time;        /**< Maximum cpu time allowed per @grep/all */
   int ascii_names; /**< Are object names restricted to ascii characters? */
   int use_chunk;   /**< Use the chunk system? */
   char chunk_swap_file[FILE_PATH_LEN]; /**< Name of the attribute swap file */
@@ -336,7 +341,10 @@ struct options_table {
                                  kibibytes */
   int chunk_cache_memory;     /**< Memory to use for the attribute cache */
   int chunk_migrate_amount;   /**< Number of attrs to migrate each second */
+  int chunk_dedup; /**< Store identical attribute values once? */
   char attr_compression[256]; /**< How to compress attribute text in-memory */
+  char compression_dictionary[FILE_PATH_LEN]; /**< Where to save the trained
+                                                 compression dictionary */
   int read_remote_desc; /**< Can players read DESCRIBE attribute remotely? */
   char ssl_private_key_file[FILE_PATH_LEN]; /**< File to load the server's key
                                                from */
@@ -354,6 +362,7 @@ struct options_table {
   char wizard_log[FILE_PATH_LEN];  /**< File to log wizard commands */
   char command_log[FILE_PATH_LEN]; /**< File to log suspect commands */
   char trace_log[FILE_PATH_LEN];   /**< File to log trace data */
+  char capture_log[FILE_PATH_LEN]; /**< File to capture player input to */
   char checkpt_log[FILE_PATH_LEN]; /**< File to log checkpoint data */
   char sql_platform[256];          /**< Type of SQL server, or "disabled" */
   char sql_host[256];              /**< Hostname of sql server */
@@ -483,6 +492,7 @@ int can_view_config_option(dbref player, const PENNCONF *opt);
 #define FREE_OBJECTS (options.free_objects)
 #define RESTRICTED_BUILDING (options.restrict_building)
 #define NO_FORK (!options.forking_dump)
+#define SNAPSHOT_DUMP (options.snapshot_dump)
 #define PLAYER_NAME_SPACES (options.player_name_spaces)
 #define MAX_ALIASES (options.max_aliases)
 #define SAFER_UFUN (options.safer_ufun)
@@ -531,6 +541,7 @@ int can_view_config_option(dbref player, const PENNCONF *opt);
 #define WIZLOG (options.wizard_log)
 #define CMDLOG (options.command_log)
 #define TRACELOG (options.trace_log)
+#define CAPTURELOG (options.capture_log)
 #define CHECKLOG (options.checkpt_log)
 #define SQL_PLATFORM (options.sql_platform)
 #define SQL_HOST (options.sql_host)
@@ -16,6 +16,24 @@
 
 extern dbref first_free; /* pointer to free list */
 
+/* With lazy_attributes, an object's attributes are read from the
+ * database the first time they're looked at. */
+extern int attrs_unloaded;
+bool attrs_load(dbref thing);
+bool attrs_loaded(dbref thing);
+bool attrs_load_some(int count);
+void attrs_load_all(void);
+bool attrs_map(const char *filename);
+/* Attributes noted while skipping an object's attributes */
+#define LAZY_STARTUP 0x1
+#define LAZY_ALIAS 0x2
+bool attrs_lack(dbref thing, int which);
+#define LoadAttrs(x) ((void) (attrs_unloaded && attrs_load(x)))
+
+/* Called before an object's name, flags, locks or attributes change,
+ * for a snapshot dump that hasn't written it yet. */
+void snapshot_preserve(dbref thing);
+
 /*-------------------------------------------------------------------------
  * Database access macros
  */
@@ -34,7 +52,7 @@ extern dbref first_free; /* pointer to free list */
 #define Next(x) (db[(x)].next)
 #define Home(x) (db[(x)].exits)
 #define Exits(x) (db[(x)].exits)
-#define List(x) (db[(x)].list)
+#define List(x) (*(LoadAttrs(x), &db[(x)].list))
 
 /* These are only for exits */
 #define Source(x) (db[(x)].exits)
@@ -46,7 +64,8 @@ extern dbref first_free; /* pointer to free list */
 #define ModTime(x) (db[(x)].modification_time)
 
 #define AttrCount(x) (db[(x)].attrcount)
-#define AttrCap(x) (db[(x)].attrcap)
+#define AttrLeaves(x) (*(LoadAttrs(x), &db[(x)].attrleaves))
+#define AttrIndex(x) (*(LoadAttrs(x), &db[(x)].attrindex))
 
 /* Moved from warnings.c because create.c needs it. */
 #define Warnings(x) (db[(x)].warnings)
@@ -265,13 +284,14 @@ struct object {
    * For other objects, the time/date of last modification to its attributes.
    */
   time_t modification_time;
-  int attrcount;           /**< Number of attribs on the object */
-  int attrcap;             /**< Size of the attribute array */
-  int type;                /**< Object's type */
-  object_flag_type flags;  /**< Pointer to flag bit array */
-  object_flag_type powers; /**< Pointer to power bit array */
-  struct lock_list *locks; /**< list of locks set on the object */
-  ALIST *list;             /**< list of attributes on the object */
+  int attrcount;                /**< Number of attribs on the object */
+  int attrleaves;               /**< Number of leaves in the attribute list */
+  int type;                     /**< Object's type */
+  object_flag_type flags;       /**< Pointer to flag bit array */
+  object_flag_type powers;      /**< Pointer to power bit array */
+  struct lock_list *locks;      /**< list of locks set on the object */
+  ATTR_LEAF **list;             /**< list of attributes on the object */
+  struct attr_index *attrindex; /**< hash index of list, for big objects */
 };
 
 /** A structure to hold database statistics.
@@ -20,16 +20,23 @@
 extern jmp_buf db_err;
 
 typedef struct pennfile {
-  enum { PFT_FILE, PFT_PIPE, PFT_GZFILE } type;
+  enum { PFT_FILE, PFT_PIPE, PFT_GZFILE, PFT_MEMORY } type;
   union {
     FILE *f;
 #ifdef HAVE_LIBZ
     gzFile g;
 #endif
+    struct {
+      char *buf;   /**< Contents, NUL-terminated */
+      size_t len;  /**< Bytes written */
+      size_t size; /**< Allocated size of buf */
+      size_t pos;  /**< Where the next read starts */
+    } m;
   } handle;
 } PENNFILE;
 
 PENNFILE *penn_fopen(const char *, const char *);
+PENNFILE *penn_mopen(void);
 void penn_fclose(PENNFILE *);
 
 int penn_fgetc(PENNFILE *);
@@ -54,6 +61,12 @@ void db_write_labeled_dbref(PENNFILE *f, char const *label, dbref value);
 
 dbref db_write(PENNFILE *f, int flag);
 int db_paranoid_write(PENNFILE *f, int flag);
+bool db_has_sums(void);
+int db_check_sums(PENNFILE *f);
+void snapshot_begin(PENNFILE *f);
+bool snapshot_write_some(int count);
+int snapshot_end(void);
+bool snapshot_running(void);
 
 /* Input functions */
 char *getstring_noalloc(PENNFILE *f);
@@ -100,6 +100,7 @@ void generic_command_failure(dbref executor, dbref enactor, char *string,
 bool init_compress(PENNFILE *);
 char *safe_uncompress(char const *) __attribute_malloc__;
 char *text_uncompress(char const *);
+char *text_uncompress_r(char const *, char *);
 char *text_compress(char const *) __attribute_malloc__;
 #define compress text_compress
 #define uncompress text_uncompress
@@ -168,6 +169,7 @@ void do_halt(dbref owner, const char *ncom, dbref victim);
 #define SYSEVENT -1
 bool queue_event(dbref enactor, const char *event, const char *fmt, ...)
   __attribute__((__format__(__printf__, 3, 4)));
+void event_handlers_changed(void);
 void parse_que_attr(dbref executor, dbref enactor, char *actionlist,
                     PE_REGS *pe_regs, const ATTR *a, bool force_debug);
 void insert_que(MQUE *queue_entry, MQUE *parent_queue);
@@ -234,9 +236,12 @@ int Commer(dbref thing);
 int Listener(dbref thing);
 int parse_chat(dbref player, char *command);
 bool fork_and_dump(int forking);
+void snapshot_dump_finish(void);
+void snapshot_dump_abort(void);
 void reserve_fd(void);
 void release_fd(void);
 void do_scan(dbref player, const char *command, int flag);
+char *passwd_filter(const char *cmd);
 
 /* From look.c */
 #define LOOK_NORMAL 0      /* You typed "look" */
@@ -511,6 +516,9 @@ int can_interact(dbref from, dbref to, int type, NEW_PE_INFO *pe_info);
 char *ansi_name(dbref thing, bool accents, bool *had_moniker, int maxlen);
 /* From warnings.c */
 void run_topology(void);
+bool run_topology_changes(void);
+void warnings_changed(dbref thing);
+void warnings_connected(dbref player);
 void do_warnings(dbref player, const char *name, const char *warns);
 void do_wcheck(dbref player, const char *name);
 void do_wcheck_me(dbref player);
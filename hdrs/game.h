@@ -122,6 +122,12 @@ void do_verb(dbref executor, dbref enactor, const char *arg1, char **argv,
 extern void do_grep(dbref player, char *obj, char *lookfor, int flag,
                     int insensitive);
 
+/* From dbgrep.c */
+void do_grep_all(dbref player, const char *attrs, const char *lookfor,
+                 int flags);
+void do_grep_status(dbref player);
+void do_grep_stop(dbref player);
+
 /* From rob.c */
 void do_give(dbref player, const char *recipient, const char *amnt, int silent,
              NEW_PE_INFO *pe_info);
@@ -15,9 +15,14 @@
  * file and an in-memory index.
  */
 typedef struct {
-  char *command; /**< The name of the help command */
-  char *file;    /**< The file of help text */
-  int admin;     /**< Is this an admin-only help command? */
+  char *command;             /**< The name of the help command */
+  char *file;                /**< The file of help text */
+  int admin;                 /**< Is this an admin-only help command? */
+  int64_t modified;          /**< Timestamp of the file when last indexed */
+  struct help_topic *topics; /**< Topic names, sorted like the database */
+  int ntopics;               /**< Number of topics */
+  char **pages;              /**< Rendered 'help entries' pages, or NULL */
+  int npages;                /**< Number of index pages */
 } help_file;
 
 void init_help_files(void);
@@ -169,6 +169,13 @@ struct mque {
   MQUE *inplace; /**< Queue entry to run, either via \@include or \@break,
                     \@foo/inplace, etc */
   MQUE *next;    /**< The next queue entry in the linked list */
+  MQUE *prev;    /**< The previous entry in the command, wait or semaphore
+                    queue */
+  MQUE *exec_next; /**< The next queued entry with the same executor */
+  MQUE *exec_prev; /**< The previous queued entry with the same executor */
+  struct exec_queue *exec_queue; /**< The executor's index of queue entries */
+  uint64_t seq; /**< When this entry was put on its current queue */
+  int list;     /**< Which queue this entry is on, QLIST_* in cque.c */
 
   char
     *action_list; /**< The action list of commands to run in this queue entry */
@@ -186,6 +193,7 @@ struct mque {
 /* new attribute foo */
 typedef struct attr ATTR;
 typedef ATTR ALIST;
+typedef struct attr_leaf ATTR_LEAF;
 
 /** A text block
  */
@@ -63,7 +63,8 @@ uint64_t parse_uint64(const char *, char **, int);
  * long, unsigned long, size_t, intmax_t, int32_t, uint32_t, int64_t
  * uint64_t, time_t */
 
-#define parse_number(str) strtod(str, NULL)
+NVAL parse_nval(const char *, char **);
+#define parse_number(str) parse_nval(str, NULL)
 
 /* The following routines all take various arguments, and return
  * string representations of same.  The string representations
@@ -4,6 +4,8 @@
  */
 #pragma once
 
+#include <stdint.h>
+
 #include "log.h"
 
 #define TEST_GROUP(name) void test_##name (int *success, int *failure)
@@ -18,4 +20,16 @@
         } \
     } while (0)
 
+/* Run a block of code a number of times and log how long it took.
+ * Benchmarks are informational and don't count as tests. */
+#define BENCHMARK(name, iterations, ...) \
+    do { \
+        uint64_t bench_start_ = bench_usecs(); \
+        for (int bench_n_ = 0; bench_n_ < (iterations); bench_n_ += 1) \
+            __VA_ARGS__ \
+        log_benchmark(name, (iterations), bench_usecs() - bench_start_); \
+    } while (0)
+
 bool run_tests(void);
+uint64_t bench_usecs(void);
+void log_benchmark(const char *name, int iterations, uint64_t usecs);
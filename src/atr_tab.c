@@ -428,6 +428,7 @@ alias_attribute(const char *atr, const char *alias)
     return 0;
 
   ptab_insert_one(&ptab_attrib, strupper(alias), ap);
+  event_handlers_changed();
   return 1;
 }
 
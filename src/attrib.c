@@ -30,6 +30,7 @@
 #include "sort.h"
 #include "strtree.h"
 #include "strutil.h"
+#include "tests.h"
 
 #ifdef WIN32
 #pragma warning(disable : 4761) /* disable warning re conversion */
@@ -53,7 +54,7 @@ static char missing_name[ATTRIBUTE_NAME_LIMIT + 1];
 static atr_err real_atr_clr(dbref thing, char const *atr, dbref player,
                         int we_are_wiping);
 static void atr_free_one(dbref, const ATTR *);
-static int find_atr_pos_in_list(dbref thing, char const *name);
+static ATTR *atr_lower_bound(dbref thing, char const *prefix, size_t len);
 static atr_err can_create_attr(dbref player, dbref obj, char const *atr_name,
                                uint32_t flags);
 static ATTR *find_atr_in_list(dbref, char const *name);
@@ -117,62 +118,24 @@ atr_match(const char *string)
 }
 
 /** Find the first attribute branching off the specified attribute.
+ * \param thing the object the attribute is on
  * \param branch the attribute to look under
+ * \return the first attribute under branch, or NULL if it has none.
  */
 ATTR *
-atr_sub_branch(ATTR *branch)
+atr_sub_branch(dbref thing, ATTR *branch)
 {
-  char const *name;
+  char prefix[ATTRIBUTE_NAME_LIMIT + 2];
   size_t len;
+  ATTR *sub;
 
-  name = AL_NAME(branch);
-  len = strlen(name);
-
-  for (branch++; AL_NAME(branch); branch++) {
-    const char *n2 = AL_NAME(branch);
-    if (strlen(n2) <= len)
-      return NULL;
-    if (n2[len] == '`') {
-      if (memcmp(n2, name, len) == 0) {
-        return branch;
-      } else {
-        return NULL;
-      }
-    }
-  }
-  return NULL;
-}
-
-/** Find the attr immediately before the first child of 'branch'. This is
- *  not necessarily 'branch' itself.
- * \param branch the attr to look for children of
- * \return the attr immediately before branch's first child, or NULL
- *        if it has no children
- */
-ATTR *
-atr_sub_branch_prev(ATTR *branch)
-{
-  char const *name;
-  size_t len;
-  ATTR *prev;
-
-  name = AL_NAME(branch);
-  len = strlen(name);
-  prev = branch;
+  len = strlen(AL_NAME(branch));
+  memcpy(prefix, AL_NAME(branch), len);
+  prefix[len++] = '`';
 
-  for (branch++; AL_NAME(branch); branch++) {
-    const char *n2 = AL_NAME(branch);
-    if (strlen(n2) <= len) {
-      return NULL;
-    }
-    if (n2[len] == '`') {
-      if (memcmp(n2, name, len) == 0) {
-        return prev;
-      } else {
-        return NULL;
-      }
-    }
-    prev = branch;
+  sub = atr_lower_bound(thing, prefix, len);
+  if (AL_NAME(sub) && strncmp(AL_NAME(sub), prefix, len) == 0) {
+    return sub;
   }
   return NULL;
 }
@@ -458,7 +421,7 @@ can_create_attr(dbref player, dbref obj, char const *atr_name, uint32_t flags)
     return AE_ERROR;
 
   strcpy(missing_name, atr_name);
-  atr = List(obj);
+  atr = NULL;
   for (p = strchr(missing_name, '`'); p; p = strchr(p + 1, '`')) {
     *p = '\0';
     if (atr != &tmpatr)
@@ -505,26 +468,340 @@ can_create_attr(dbref player, dbref obj, char const *atr_name, uint32_t flags)
          is greater than this. */
 #define LINEAR_CUT_OFF                                                         \
   32 /**< Switch to binary search when at least                                \
-        this many attributes are on an                                         \
-        object. Benchmarking shows binary is                                   \
+        this many attributes are in a leaf.                                    \
+        Benchmarking shows binary is                                           \
         slower before this point. */
+#define ATTR_LEAF_MAX                                                          \
+  128 /**< Most attributes a leaf can hold. An object's first                  \
+         leaf grows up to this size; after that, full leaves                   \
+         are split. */
 
-/** Comparison function to use with bsearch() on an attribute
-    array. */
+/** Leaf i of an object's attribute list */
+#define Leaf(thing, i) (List(thing)[(i)])
+
+/** The terminator returned by searches of an object with no attributes */
+static ATTR atr_list_end;
+
+/** Allocate an empty attribute leaf.
+ * \param cap the number of attributes it can hold.
+ * \return the new leaf, or NULL.
+ */
+static ATTR_LEAF *
+atr_leaf_new(int cap)
+{
+  ATTR_LEAF *leaf;
+
+  leaf = mush_malloc_zero(sizeof(ATTR_LEAF) + sizeof(ATTR) * (cap + 1),
+                          "obj.attributes");
+  if (leaf) {
+    leaf->cap = cap;
+  }
+  return leaf;
+}
+
+/** Find the leaf to search for an attribute name or prefix.
+ * This is the last leaf whose first attribute sorts before the first len
+ * bytes of name, or the first leaf. The first attribute that doesn't sort
+ * before name is in that leaf or starts the one after it.
+ * \param thing the object. Must have at least one leaf.
+ * \param name the attribute name or prefix.
+ * \param len how many bytes of name to compare.
+ * \return the index of the leaf.
+ */
+static int
+atr_leaf_find(dbref thing, char const *name, size_t len)
+{
+  int lo = 0, hi = AttrLeaves(thing) - 1;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo + 1) / 2;
+    if (strncmp(AL_NAME(Leaf(thing, mid)->atrs), name, len) < 0) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
+}
+
+/** Find the first slot in a leaf whose attribute does not sort before
+ * the first len bytes of name.
+ *
+ * Use a linear search, switching to binary when the leaf gets above a
+ * certain size.
+ *
+ * \param leaf the leaf to search.
+ * \param name the attribute name or prefix.
+ * \param len how many bytes of name to compare.
+ * \return the index of the slot; leaf->count if every attribute sorts
+ * before name.
+ */
 static int
-atr_comp(const void *pa, const void *pb)
+atr_leaf_pos(const ATTR_LEAF *leaf, char const *name, size_t len)
+{
+  int lo = 0, hi = leaf->count;
+
+  if (leaf->count < LINEAR_CUT_OFF) {
+    for (; lo < hi; lo++) {
+      if (strncmp(AL_NAME(leaf->atrs + lo), name, len) >= 0) {
+        break;
+      }
+    }
+    return lo;
+  }
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (strncmp(AL_NAME(leaf->atrs + mid), name, len) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/** Find the first attribute on an object whose name sorts at or after
+ * the first len bytes of a name or prefix.
+ * \param thing the object.
+ * \param prefix the name or prefix.
+ * \param len how much of the prefix to use.
+ * \return the attribute, or an entry with a NULL name if there are none.
+ */
+static ATTR *
+atr_lower_bound(dbref thing, char const *prefix, size_t len)
+{
+  ATTR_LEAF *leaf;
+  int l, pos;
+
+  if (!AttrLeaves(thing)) {
+    return &atr_list_end;
+  }
+  l = atr_leaf_find(thing, prefix, len);
+  leaf = Leaf(thing, l);
+  pos = atr_leaf_pos(leaf, prefix, len);
+  if (pos == leaf->count && l + 1 < AttrLeaves(thing)) {
+    return Leaf(thing, l + 1)->atrs;
+  }
+  return leaf->atrs + pos;
+}
+
+/** Find the index of the leaf an attribute is in.
+ * \param thing the object the attribute is on.
+ * \param a the attribute.
+ * \return the index of its leaf.
+ */
+static int
+atr_leaf_of(dbref thing, const ATTR *a)
+{
+  int l = atr_leaf_find(thing, AL_NAME(a), strlen(AL_NAME(a)) + 1);
+
+  if (l + 1 < AttrLeaves(thing) && Leaf(thing, l + 1)->atrs == a) {
+    l += 1;
+  }
+  return l;
+}
+
+/** Return the attribute following another in an object's list.
+ * \param thing the object the attributes are on.
+ * \param atr an attribute on thing.
+ * \return the next attribute, or an entry with a NULL name if atr was the
+ * last one.
+ */
+ATTR *
+atr_next(dbref thing, ATTR *atr)
+{
+  int l;
+
+  if (AL_NAME(atr + 1) || AttrLeaves(thing) == 1) {
+    return atr + 1;
+  }
+  /* End of a leaf; move on to the next one, if any */
+  l = atr_leaf_of(thing, atr);
+  if (l + 1 < AttrLeaves(thing)) {
+    return Leaf(thing, l + 1)->atrs;
+  }
+  return atr + 1;
+}
+
+/*======================================================================*/
+
+/* Objects with many attributes also keep a hash table from attribute
+ * name to attribute, so looking one up takes a single string comparison
+ * instead of one per step of a binary search. The table holds pointers
+ * into the leaves, so anything that moves attributes around in a leaf
+ * has to tell it where they went. */
+
+#define ATTR_INDEX_MIN                                                         \
+  64 /**< Index objects with at least this many attributes. Below this,        \
+        searching the leaves is as fast. */
+
+/** One slot of an attribute index */
+struct attr_slot {
+  uint32_t hash;    /**< Hash of the attribute's name; 0 if the slot is empty */
+  char const *name; /**< The attribute's name, which doesn't move with it */
+  ATTR *atr;        /**< The attribute */
+};
+
+/** A hash index of an object's attributes, using linear probing. */
+struct attr_index {
+  uint32_t mask;            /**< Number of slots, minus one */
+  uint32_t used;            /**< Number of slots in use */
+  struct attr_slot slots[]; /**< The slots */
+};
+
+/** Hash an attribute name for an attribute index.
+ * \param name the name.
+ * \return its hash, never 0.
+ */
+static uint32_t
+atr_name_hash(char const *name)
+{
+  uint32_t h = 2166136261U;
+
+  for (; *name; name++) {
+    h = (h ^ (unsigned char) *name) * 16777619U;
+  }
+  return h ? h : 1;
+}
+
+/** Find the slot for an attribute name in an index.
+ * \param idx the index.
+ * \param name the attribute name.
+ * \param hash the hash of name.
+ * \return the slot holding name, or the empty slot where it would go.
+ */
+static struct attr_slot *
+atr_index_slot(struct attr_index *idx, char const *name, uint32_t hash)
+{
+  uint32_t i = hash & idx->mask;
+
+  for (;;) {
+    struct attr_slot *slot = idx->slots + i;
+    if (!slot->hash ||
+        (slot->hash == hash &&
+         (slot->name == name || strcmp(slot->name, name) == 0))) {
+      return slot;
+    }
+    i = (i + 1) & idx->mask;
+  }
+}
+
+/** Free an object's attribute index, if it has one.
+ * \param thing the object.
+ */
+static void
+atr_index_free(dbref thing)
+{
+  if (AttrIndex(thing)) {
+    mush_free(AttrIndex(thing), "obj.attrindex");
+    AttrIndex(thing) = NULL;
+  }
+}
+
+static void atr_index_build(dbref thing, uint32_t size);
+
+/** Record where an attribute is in an object's index.
+ * \param thing the object. Must have an index.
+ * \param a the attribute, new or moved.
+ */
+static void
+atr_index_set(dbref thing, ATTR *a)
+{
+  struct attr_index *idx = AttrIndex(thing);
+  uint32_t hash = atr_name_hash(AL_NAME(a));
+  struct attr_slot *slot = atr_index_slot(idx, AL_NAME(a), hash);
+
+  if (!slot->hash) {
+    if ((idx->used + 1) * 2 > idx->mask + 1) {
+      /* Too full; the rebuilt index includes a */
+      atr_index_build(thing, (idx->mask + 1) * 2);
+      return;
+    }
+    slot->hash = hash;
+    slot->name = AL_NAME(a);
+    idx->used += 1;
+  }
+  slot->atr = a;
+}
+
+/** Build a new attribute index for an object.
+ * \param thing the object.
+ * \param size the number of slots, a power of two. It is doubled until
+ * there are at least twice as many as attributes.
+ */
+static void
+atr_index_build(dbref thing, uint32_t size)
+{
+  struct attr_index *idx;
+  ATTR *a;
+
+  while (size < (uint32_t) AttrCount(thing) * 2) {
+    size *= 2;
+  }
+  atr_index_free(thing);
+  idx = mush_malloc_zero(sizeof(struct attr_index) +
+                           sizeof(struct attr_slot) * size,
+                         "obj.attrindex");
+  if (!idx) {
+    return;
+  }
+  idx->mask = size - 1;
+  AttrIndex(thing) = idx;
+  ATTR_FOR_EACH (thing, a) {
+    atr_index_set(thing, a);
+  }
+}
+
+/** Remove an attribute name from an object's index.
+ * \param thing the object. Must have an index.
+ * \param name the attribute name.
+ */
+static void
+atr_index_delete(dbref thing, char const *name)
 {
-  const ATTR *a = pa;
-  const ATTR *b = pb;
-  return strcmp(AL_NAME(a), AL_NAME(b));
+  struct attr_index *idx = AttrIndex(thing);
+  struct attr_slot *slot = atr_index_slot(idx, name, atr_name_hash(name));
+  uint32_t i, j;
+
+  if (!slot->hash) {
+    return;
+  }
+  /* Pull later entries of the same probe run back into the hole, so no
+   * tombstones are needed. */
+  i = slot - idx->slots;
+  for (j = (i + 1) & idx->mask; idx->slots[j].hash; j = (j + 1) & idx->mask) {
+    uint32_t home = idx->slots[j].hash & idx->mask;
+    if (((j - home) & idx->mask) >= ((j - i) & idx->mask)) {
+      idx->slots[i] = idx->slots[j];
+      i = j;
+    }
+  }
+  memset(idx->slots + i, 0, sizeof(struct attr_slot));
+  idx->used -= 1;
+}
+
+/** Update an object's index after attributes in a leaf have moved.
+ * \param thing the object.
+ * \param leaf the leaf.
+ * \param from the first slot of the leaf that has changed.
+ */
+static void
+atr_index_leaf(dbref thing, ATTR_LEAF *leaf, int from)
+{
+  if (!AttrIndex(thing)) {
+    return;
+  }
+  for (; from < leaf->count; from++) {
+    atr_index_set(thing, leaf->atrs + from);
+  }
 }
 
 /** Search an attribute list for an attribute with the specified name.
  *
- * Attributes are stored as a sorted array. Use a linear search,
- * switching to binary when the attribute count gets above a certain
- * threshold. Always special case instances of 0 or 1 attribute on an
- * object (Those two cases account for almost 6000 things on M*U*S*H)
+ * Attributes are stored sorted by name. Use a binary search,
+ * switching to a hash index when the attribute count gets above a
+ * certain threshold. Always special case instances of 0 attributes
+ * on an object.
  *
  * \param thing the object to search on.
  * \param name the attribute name to look for
@@ -533,58 +810,60 @@ atr_comp(const void *pa, const void *pb)
 static ATTR *
 find_atr_in_list(dbref thing, char const *name)
 {
-  int count = AttrCount(thing);
-  if (count == 0) {
+  ATTR *a;
+
+  if (AttrCount(thing) == 0) {
     return NULL;
-  } else if (count == 1) {
-    if (strcmp(name, AL_NAME(List(thing))) == 0) {
-      return List(thing);
-    } else {
-      return NULL;
+  }
+  if (AttrCount(thing) >= ATTR_INDEX_MIN) {
+    struct attr_slot *slot;
+    if (!AttrIndex(thing)) {
+      atr_index_build(thing, ATTR_INDEX_MIN * 2);
     }
-  } else if (count < LINEAR_CUT_OFF) {
-    ATTR *a;
-    ATTR_FOR_EACH (thing, a) {
-      int c = strcmp(name, AL_NAME(a));
-      if (c == 0) {
-        return a;
-      } else if (c < 0) {
-        return NULL;
-      }
+    if (AttrIndex(thing)) {
+      slot = atr_index_slot(AttrIndex(thing), name, atr_name_hash(name));
+      return slot->hash ? slot->atr : NULL;
     }
-    return NULL;
+  }
+  a = atr_lower_bound(thing, name, strlen(name) + 1);
+  if (AL_NAME(a) && strcmp(AL_NAME(a), name) == 0) {
+    return a;
   } else {
-    ATTR dummy;
-    AL_NAME(&dummy) = name;
-
-    return bsearch(&dummy, List(thing), AttrCount(thing), sizeof(ATTR),
-                   atr_comp);
+    return NULL;
   }
 }
 
-/** Find the place to insert/delete an attribute with the specified name.
- * \param thing the object to insert the attribute on
- * \param name the attribute name to look for
- * \return the index of the array where the attribute should go.
+/** Resize the only leaf of an attribute list.
+ *
+ * \param thing the object the attributes are on
+ * \param cap the new capacity, at least the current count.
+ * \return true on success.
  */
-static int
-find_atr_pos_in_list(dbref thing, char const *name)
+static bool
+atr_leaf_resize(dbref thing, int cap)
 {
-  int pos = 0;
-  ATTR *a;
-  /* TODO: Binary search? */
-  ATTR_FOR_EACH (thing, a) {
-    int comp = strcmp(name, AL_NAME(a));
-    if (comp <= 0)
-      return pos;
-    pos += 1;
-  }
+  ATTR_LEAF *leaf = Leaf(thing, 0);
+  int oldcap = leaf->cap;
 
-  return pos;
+  leaf = mush_realloc(leaf, sizeof(ATTR_LEAF) + sizeof(ATTR) * (cap + 1),
+                      "obj.attributes");
+  if (!leaf) {
+    return false;
+  }
+  if (cap > oldcap) {
+    memset(leaf->atrs + oldcap + 1, 0, sizeof(ATTR) * (cap - oldcap));
+  }
+  leaf->cap = cap;
+  if (leaf != Leaf(thing, 0)) {
+    Leaf(thing, 0) = leaf;
+    atr_index_leaf(thing, leaf, 0);
+  }
+  return true;
 }
 
-/** Make sure an attribute array can hold at least a given number of attributes,
- * growing if needed.
+/** Make sure an attribute list can hold at least a given number of
+ * attributes, growing if needed. Capacity beyond the size of a single
+ * leaf is allocated a leaf at a time as attributes are added.
  *
  * \param thing the object the attributes are on
  * \param capacity the desired capacity.
@@ -593,48 +872,132 @@ find_atr_pos_in_list(dbref thing, char const *name)
 bool
 attr_reserve(dbref thing, int cap)
 {
-  int oldcap;
-  ATTR *newattrs;
+  snapshot_preserve(thing);
+  if (cap > ATTR_LEAF_MAX) {
+    cap = ATTR_LEAF_MAX;
+  }
 
-  oldcap = AttrCap(thing);
+  if (!AttrLeaves(thing)) {
+    ATTR_LEAF *leaf;
 
-  if (oldcap >= cap)
+    if (cap <= 0) {
+      return true;
+    }
+    List(thing) = mush_malloc(sizeof(ATTR_LEAF *), "obj.attributes");
+    if (!List(thing)) {
+      return false;
+    }
+    leaf = atr_leaf_new(cap);
+    if (!leaf) {
+      mush_free(List(thing), "obj.attributes");
+      List(thing) = NULL;
+      return false;
+    }
+    Leaf(thing, 0) = leaf;
+    AttrLeaves(thing) = 1;
+    return true;
+  } else if (AttrLeaves(thing) > 1 || Leaf(thing, 0)->cap >= cap) {
     return true;
+  } else {
+    return atr_leaf_resize(thing, cap);
+  }
+}
 
-  newattrs =
-    mush_realloc(List(thing), (cap + 1) * sizeof(ATTR), "obj.attributes");
+/** Insert a leaf into an object's list of leaves.
+ * \param thing the object.
+ * \param l the index the new leaf will have.
+ * \param leaf the leaf.
+ * \return true on success.
+ */
+static bool
+atr_leaf_insert(dbref thing, int l, ATTR_LEAF *leaf)
+{
+  ATTR_LEAF **leaves;
 
-  if (!newattrs) {
+  leaves = mush_realloc(List(thing),
+                        sizeof(ATTR_LEAF *) * (AttrLeaves(thing) + 1),
+                        "obj.attributes");
+  if (!leaves) {
     return false;
   }
-
-  memset(newattrs + oldcap, 0, sizeof(ATTR) * (cap - oldcap + 1));
-  List(thing) = newattrs;
-  AttrCap(thing) = cap;
+  memmove(leaves + l + 1, leaves + l,
+          sizeof(ATTR_LEAF *) * (AttrLeaves(thing) - l));
+  leaves[l] = leaf;
+  List(thing) = leaves;
+  AttrLeaves(thing) += 1;
   return true;
 }
 
-/** Make sure an attribute array has enough capacity to hold another attribute,
- * and expand it if needed.
- *
- * \param thing the object the attribute is being added to.
- * \return true if another dbref can be added.
+/** Remove and free a leaf of an object's attribute list.
+ * \param thing the object.
+ * \param l the index of the leaf.
+ */
+static void
+atr_leaf_delete(dbref thing, int l)
+{
+  ATTR_LEAF **leaves;
+
+  mush_free(Leaf(thing, l), "obj.attributes");
+  memmove(List(thing) + l, List(thing) + l + 1,
+          sizeof(ATTR_LEAF *) * (AttrLeaves(thing) - l - 1));
+  AttrLeaves(thing) -= 1;
+  leaves = mush_realloc(List(thing), sizeof(ATTR_LEAF *) * AttrLeaves(thing),
+                        "obj.attributes");
+  if (leaves) {
+    List(thing) = leaves;
+  }
+}
+
+/** Make room in a full leaf for one more attribute.
+ * A lone leaf smaller than ATTR_LEAF_MAX is grown; otherwise, the leaf is
+ * split in two. Appending past the end of the last leaf starts a new leaf
+ * instead of splitting, so lists built in order, like those loaded from
+ * a database, end up with full leaves.
+ * \param thing the object.
+ * \param l the index of the full leaf, updated if the slot moves to a new
+ * leaf.
+ * \param pos the slot the new attribute will go in, also updated.
+ * \return true on success.
  */
 static bool
-atr_check_capacity(dbref thing)
+atr_leaf_make_room(dbref thing, int *l, int *pos)
 {
-  int oldcap = AttrCap(thing);
-  if (oldcap == 0) {
-    return attr_reserve(thing, 5);
-  } else if (AttrCount(thing) < oldcap) {
-    return true;
-  } else {
-    int newcap = oldcap * GROWTH_FACTOR;
+  ATTR_LEAF *leaf = Leaf(thing, *l), *right;
+  bool append;
+  int keep;
+
+  if (leaf->cap < ATTR_LEAF_MAX) {
+    int newcap = leaf->cap * GROWTH_FACTOR;
     if (newcap < 5) {
       newcap = 5;
+    } else if (newcap > ATTR_LEAF_MAX) {
+      newcap = ATTR_LEAF_MAX;
     }
-    return attr_reserve(thing, newcap);
+    return atr_leaf_resize(thing, newcap);
+  }
+
+  append = *l == AttrLeaves(thing) - 1 && *pos == leaf->count;
+  keep = append ? leaf->count : leaf->count / 2;
+
+  right = atr_leaf_new(ATTR_LEAF_MAX);
+  if (!right) {
+    return false;
+  }
+  if (!atr_leaf_insert(thing, *l + 1, right)) {
+    mush_free(right, "obj.attributes");
+    return false;
   }
+  right->count = leaf->count - keep;
+  memcpy(right->atrs, leaf->atrs + keep, sizeof(ATTR) * (right->count + 1));
+  memset(leaf->atrs + keep, 0, sizeof(ATTR) * (leaf->count - keep + 1));
+  leaf->count = keep;
+  atr_index_leaf(thing, right, 0);
+
+  if (*pos > keep || append) {
+    *l += 1;
+    *pos -= keep;
+  }
+  return true;
 }
 
 /** Shrink capacity if there's too much unused space.
@@ -644,62 +1007,38 @@ atr_check_capacity(dbref thing)
 void
 attr_shrink(dbref thing)
 {
-  ATTR *newattrs;
+  ATTR_LEAF *leaf;
   int newcap;
 
+  snapshot_preserve(thing);
+
   if (AttrCount(thing) == 0) {
     /* No attributes, but space; Free it */
-    if (AttrCap(thing)) {
+    atr_index_free(thing);
+    if (AttrLeaves(thing)) {
+      while (AttrLeaves(thing)) {
+        AttrLeaves(thing) -= 1;
+        mush_free(Leaf(thing, AttrLeaves(thing)), "obj.attributes");
+      }
       mush_free(List(thing), "obj.attributes");
       List(thing) = NULL;
-      AttrCap(thing) = 0;
     }
     return;
-  } else if (AttrCap(thing) <= 5 ||
-             ((double) AttrCap(thing) / (double) AttrCount(thing)) <
-               SHRINK_FACTOR) {
+  } else if (AttrLeaves(thing) > 1) {
+    /* Leaves are merged as attributes are removed. */
     return;
-  } else if (AttrCount(thing) == 1) {
-    newcap = 5;
-  } else {
-    newcap = round(AttrCount(thing) * GROWTH_FACTOR);
   }
 
-  newattrs =
-    mush_realloc(List(thing), sizeof(ATTR) * (newcap + 1), "obj.attributes");
-  if (newattrs) {
-    List(thing) = newattrs;
-    AttrCap(thing) = newcap;
-  }
-}
-
-/** Make room for a new attribute at a given index. The attribute
- * array must have capacity greater than its current count.
- *
- * \param thing the object the attributes are on
- * \param pos the index a new attribute will go at.
- */
-static void
-atr_move_down(dbref thing, ptrdiff_t pos)
-{
-  memmove(db[thing].list + pos + 1, db[thing].list + pos,
-          sizeof(ATTR) * (db[thing].attrcount - pos));
-}
-
-/** Shift an attribute array up to fill in a deleted attribute at a
- *  given index.
- *
- * \param thing the the object the attributes are on.
- * \param pos the position to shift everything to the right over by one.
- */
-static void
-atr_move_up(dbref thing, ptrdiff_t pos)
-{
-  if (pos < AttrCount(thing) - 1) {
-    memmove(List(thing) + pos, List(thing) + pos + 1,
-            sizeof(ATTR) * (AttrCount(thing) - pos - 1));
+  leaf = Leaf(thing, 0);
+  if (leaf->cap <= 5 ||
+      ((double) leaf->cap / (double) leaf->count) < SHRINK_FACTOR) {
+    return;
+  } else if (leaf->count == 1) {
+    newcap = 5;
+  } else {
+    newcap = round(leaf->count * GROWTH_FACTOR);
   }
-  memset(List(thing) + AttrCount(thing) - 1, 0, sizeof(ATTR));
+  atr_leaf_resize(thing, newcap);
 }
 
 /** Do the work of creating the attribute entry on an object.
@@ -710,12 +1049,24 @@ atr_move_up(dbref thing, ptrdiff_t pos)
 static ATTR *
 create_atr(dbref thing, char const *atr_name)
 {
+  ATTR_LEAF *leaf;
   ATTR *ptr;
   char const *name;
-  int pos;
+  int l, pos;
+
+  snapshot_preserve(thing);
+
+  /* make sure there's a leaf to put it in */
+  if (!AttrLeaves(thing) && !attr_reserve(thing, 5)) {
+    return NULL;
+  }
 
-  /* grow the attribute array if needed */
-  if (!atr_check_capacity(thing)) {
+  l = atr_leaf_find(thing, atr_name, strlen(atr_name) + 1);
+  pos = atr_leaf_pos(Leaf(thing, l), atr_name, strlen(atr_name) + 1);
+
+  /* grow or split the leaf if needed */
+  if (Leaf(thing, l)->count == Leaf(thing, l)->cap &&
+      !atr_leaf_make_room(thing, &l, &pos)) {
     return NULL;
   }
 
@@ -725,19 +1076,75 @@ create_atr(dbref thing, char const *atr_name)
     return NULL;
   }
 
-  pos = find_atr_pos_in_list(thing, name);
-  atr_move_down(thing, pos);
-  ptr = List(thing) + pos;
+  leaf = Leaf(thing, l);
+  memmove(leaf->atrs + pos + 1, leaf->atrs + pos,
+          sizeof(ATTR) * (leaf->count - pos + 1));
+  ptr = leaf->atrs + pos;
+  leaf->count += 1;
 
   /* initialize atr */
   AL_NAME(ptr) = name;
   ptr->data = NULL_CHUNK_REFERENCE;
   AL_FLAGS(ptr) = 0;
   AttrCount(thing)++;
+  atr_index_leaf(thing, leaf, pos);
+  if (thing == EVENT_HANDLER) {
+    event_handlers_changed();
+  }
+  warnings_changed(thing);
 
   return ptr;
 }
 
+/** Remove an attribute's entry from an object's attribute list.
+ * Entries before it are not moved; a following entry in the same leaf
+ * slides down into its slot. An emptied leaf is freed, and a leaf that
+ * becomes small enough absorbs the one after it.
+ *
+ * \param thing the object the attribute is on.
+ * \param a the attribute to remove.
+ */
+static void
+atr_list_remove(dbref thing, const ATTR *a)
+{
+  ATTR_LEAF *leaf;
+  int l, pos;
+
+  l = atr_leaf_of(thing, a);
+  leaf = Leaf(thing, l);
+  pos = a - leaf->atrs;
+
+  if (AttrIndex(thing)) {
+    if (AttrCount(thing) <= ATTR_INDEX_MIN / 2) {
+      atr_index_free(thing);
+    } else {
+      atr_index_delete(thing, AL_NAME(a));
+    }
+  }
+
+  memmove(leaf->atrs + pos, leaf->atrs + pos + 1,
+          sizeof(ATTR) * (leaf->count - pos));
+  memset(leaf->atrs + leaf->count, 0, sizeof(ATTR));
+  leaf->count -= 1;
+  AttrCount(thing) -= 1;
+  atr_index_leaf(thing, leaf, pos);
+
+  if (AttrLeaves(thing) == 1) {
+    return;
+  } else if (leaf->count == 0) {
+    atr_leaf_delete(thing, l);
+  } else if (l + 1 < AttrLeaves(thing) &&
+             leaf->count + Leaf(thing, l + 1)->count <= ATTR_LEAF_MAX / 2) {
+    ATTR_LEAF *next = Leaf(thing, l + 1);
+    memcpy(leaf->atrs + leaf->count, next->atrs,
+           sizeof(ATTR) * (next->count + 1));
+    pos = leaf->count;
+    leaf->count += next->count;
+    atr_leaf_delete(thing, l + 1);
+    atr_index_leaf(thing, leaf, pos);
+  }
+}
+
 /** Add an attribute to an object, dangerously.
  * This is a stripped down version of atr_add, without duplicate checking,
  * permissions checking, attribute count checking, or auto-ODARKing.
@@ -762,6 +1169,8 @@ atr_new_add(dbref thing, const char *RESTRICT atr, const char *RESTRICT s,
   if (!EMPTY_ATTRS && !*s && !(flags & AF_ROOT))
     return;
 
+  snapshot_preserve(thing);
+
   /* Don't fail on a bad name, but do log it */
   if (!good_atr_name(atr))
     do_rawlog(LT_ERR, "Bad attribute name %s on object %s", atr,
@@ -789,7 +1198,7 @@ atr_new_add(dbref thing, const char *RESTRICT atr, const char *RESTRICT s,
       if (!t)
         return;
 
-      ptr->data = chunk_create(t, strlen(t), derefs);
+      ptr->data = chunk_create_shared(t, strlen(t), derefs);
       free(t);
       set_cmd_flags(ptr);
     }
@@ -830,7 +1239,7 @@ atr_new_add(dbref thing, const char *RESTRICT atr, const char *RESTRICT s,
     if (!t)
       return;
 
-    ptr->data = chunk_create(t, strlen(t), derefs);
+    ptr->data = chunk_create_shared(t, strlen(t), derefs);
     free(t);
     set_cmd_flags(ptr);
   }
@@ -932,6 +1341,8 @@ atr_add(dbref thing, const char *RESTRICT atr, const char *RESTRICT s,
   if (!good_atr_name(atr))
     return AE_BADNAME;
 
+  snapshot_preserve(thing);
+
   /* walk the list, looking for a preexisting value */
   ptr = find_atr_in_list(thing, atr);
 
@@ -972,7 +1383,7 @@ atr_add(dbref thing, const char *RESTRICT atr, const char *RESTRICT s,
           if (!t) {
             mush_panic("Unable to allocate memory in atr_add()!");
           } else {
-            root->data = chunk_create(t, strlen(t), 0);
+            root->data = chunk_create_shared(t, strlen(t), 0);
             free(t);
           }
         }
@@ -1009,7 +1420,7 @@ atr_add(dbref thing, const char *RESTRICT atr, const char *RESTRICT s,
       ptr->data = NULL_CHUNK_REFERENCE;
       return AE_ERROR;
     }
-    ptr->data = chunk_create(t, strlen(t), 0);
+    ptr->data = chunk_create_shared(t, strlen(t), 0);
     free(t);
     set_cmd_flags(ptr);
     if (AF_Command(ptr) && AF_Regexp(ptr)) {
@@ -1031,49 +1442,45 @@ atr_clear_children(dbref player, dbref thing, ATTR *root)
 {
   int skipped = 0;
   size_t len;
-  const char *name;
+  char prefix[ATTRIBUTE_NAME_LIMIT + 2];
+  char name[ATTRIBUTE_NAME_LIMIT + 2];
   ATTR *sub;
 
   if (!root)
     return 1;
 
-  name = AL_NAME(root);
-  len = strlen(name);
+  len = strlen(AL_NAME(root));
+  memcpy(prefix, AL_NAME(root), len);
+  prefix[len++] = '`';
+  prefix[len] = '\0';
 
-  sub = atr_sub_branch_prev(root);
+  sub = atr_lower_bound(thing, prefix, len);
 
-  if (!sub) {
-    return 1;
-  }
-  sub += 1;
-
-  while (AL_NAME(sub)) {
-    const char *n2 = AL_NAME(sub);
-    size_t len2 = strlen(n2);
-    if (len2 < (len + 1) || n2[len] != '`' || strncmp(n2, name, len) != 0)
-      break;
+  while (AL_NAME(sub) && strncmp(AL_NAME(sub), prefix, len) == 0) {
     if (AF_Root(sub)) {
       if (!atr_clear_children(player, thing, sub)) {
+        size_t len2 = strlen(AL_NAME(sub));
         skipped++;
-        while (AL_NAME(++sub)) {
-          const char *n3 = AL_NAME(sub);
-          if (!n3 || strlen(n3) < (len2 + 1) || n3[len2] != '`' ||
-              strncmp(n2, n3, len2) != 0) {
-            break;
-          }
-        }
+        /* Skip over what's left of this branch */
+        memcpy(name, AL_NAME(sub), len2);
+        name[len2++] = '`';
+        do {
+          sub = atr_next(thing, sub);
+        } while (AL_NAME(sub) && strncmp(AL_NAME(sub), name, len2) == 0);
         continue;
       }
     }
 
     if (!Can_Write_Attr(player, thing, sub)) {
       skipped++;
-      sub++;
+      sub = atr_next(thing, sub);
       continue;
     }
 
-    /* Can safely delete attribute.  */
+    /* Can safely delete attribute. Carry on from whatever follows it. */
+    strcpy(name, AL_NAME(sub));
     atr_free_one(thing, sub);
+    sub = atr_lower_bound(thing, name, strlen(name));
   }
 
   return !skipped;
@@ -1137,7 +1544,7 @@ real_atr_clr(dbref thing, char const *atr, dbref player, int we_are_wiping)
         do_rawlog(LT_ERR, "Attribute %s on object #%d lacks a parent!",
                   root_name, thing);
       } else {
-        if (!atr_sub_branch(root))
+        if (!atr_sub_branch(thing, root))
           AL_FLAGS(root) &= ~AF_ROOT;
       }
     }
@@ -1317,6 +1724,342 @@ atr_get_noparent(dbref thing, char const *atr)
   return NULL;
 }
 
+/*======================================================================*/
+
+/* Wildcard attribute iteration.
+ *
+ * Attribute lists are sorted, so only the slice of the list starting
+ * with a pattern's literal prefix can possibly match it. Patterns that
+ * are nothing more than a prefix followed by *'s are matched with a
+ * plain string comparison; everything else is compiled once and kept in
+ * a small cache, so repeated lattr()s and @decompiles of the same
+ * pattern don't pay for a pcre2 compile every time.
+ */
+
+#define AIG_CACHE_SIZE 8 /**< Number of compiled patterns to cache */
+
+/** A compiled attribute pattern */
+struct aig_compiled {
+  char *pattern;          /**< The glob or regexp as given */
+  bool regex;             /**< Is pattern a regexp instead of a glob? */
+  pcre2_code *re;         /**< The compiled pattern */
+  pcre2_match_data *md;   /**< Match data for re */
+  int users;              /**< Number of iterations using this entry */
+  unsigned long last_use; /**< For picking an entry to evict */
+};
+
+static struct aig_compiled aig_cache[AIG_CACHE_SIZE];
+static unsigned long aig_clock = 0;
+
+/** How a pattern is matched against an attribute list */
+struct aig_plan {
+  char prefix[BUFFER_LEN]; /**< Upper-cased literal prefix of the pattern */
+  size_t plen;             /**< Length of prefix */
+  size_t rootlen;          /**< Length of prefix up to its first ` */
+  bool pure;               /**< Is the pattern just prefix followed by *'s? */
+  struct aig_compiled *comp;    /**< Compiled pattern, if not pure */
+  struct aig_compiled uncached; /**< Used when every cache entry is busy */
+};
+
+/** Compile an attribute glob or regexp.
+ * \param name the pattern.
+ * \param regex true if name is a regexp, false for a glob.
+ * \return the compiled pattern, or NULL on error.
+ */
+static pcre2_code *
+aig_compile(const char *name, bool regex)
+{
+  pcre2_code *re = NULL;
+  int errcode;
+  PCRE2_SIZE erroffset;
+  size_t len = strlen(name);
+
+  if (regex) {
+    re = pcre2_compile((const PCRE2_UCHAR *) name, len,
+                       re_compile_flags | PCRE2_CASELESS, &errcode, &erroffset,
+                       re_compile_ctx);
+  } else {
+    /* Compile wildcard to regexp */
+    PCRE2_UCHAR *as_re = NULL;
+    PCRE2_SIZE rlen;
+    char *glob;
+
+    if (len && name[len - 1] == '`') {
+      glob = sqlite3_mprintf("%s*", name);
+      len += 1;
+    } else {
+      glob = sqlite3_mprintf("%s", name);
+    }
+
+    if (pcre2_pattern_convert((const PCRE2_UCHAR *) glob, len,
+                              PCRE2_CONVERT_GLOB, &as_re, &rlen,
+                              glob_convert_ctx) == 0) {
+      re = pcre2_compile(as_re, rlen, re_compile_flags | PCRE2_CASELESS,
+                         &errcode, &erroffset, re_compile_ctx);
+      pcre2_converted_pattern_free(as_re);
+    }
+    sqlite3_free(glob);
+  }
+  if (re) {
+    pcre2_jit_compile(re, PCRE2_JIT_COMPLETE);
+  }
+  return re;
+}
+
+/** Free the compiled pattern held in a cache entry. */
+static void
+aig_compiled_clear(struct aig_compiled *comp)
+{
+  if (comp->pattern) {
+    mush_free(comp->pattern, "aig.pattern");
+  }
+  if (comp->re) {
+    pcre2_code_free(comp->re);
+  }
+  if (comp->md) {
+    pcre2_match_data_free(comp->md);
+  }
+  comp->pattern = NULL;
+  comp->re = NULL;
+  comp->md = NULL;
+  comp->users = 0;
+  comp->last_use = 0;
+}
+
+/** Look up a compiled pattern, compiling and caching it if needed.
+ * Entries in use by an iteration further up the stack are never evicted;
+ * if they all are, the pattern is compiled into spare instead.
+ * \param name the pattern.
+ * \param regex true if name is a regexp, false for a glob.
+ * \param spare storage to use if the cache is full.
+ * \return the compiled pattern, or NULL on error.
+ */
+static struct aig_compiled *
+aig_compiled_get(const char *name, bool regex, struct aig_compiled *spare)
+{
+  struct aig_compiled *slot = NULL;
+  pcre2_code *re;
+  int n;
+
+  for (n = 0; n < AIG_CACHE_SIZE; n++) {
+    struct aig_compiled *c = &aig_cache[n];
+    if (c->pattern && c->regex == regex && strcmp(c->pattern, name) == 0) {
+      c->users += 1;
+      c->last_use = ++aig_clock;
+      return c;
+    }
+    if (!c->users && (!slot || c->last_use < slot->last_use)) {
+      slot = c;
+    }
+  }
+
+  re = aig_compile(name, regex);
+  if (!re) {
+    return NULL;
+  }
+  if (slot) {
+    aig_compiled_clear(slot);
+    slot->pattern = mush_strdup(name, "aig.pattern");
+    slot->last_use = ++aig_clock;
+  } else {
+    slot = spare;
+    slot->pattern = NULL;
+  }
+  slot->regex = regex;
+  slot->re = re;
+  slot->md = pcre2_match_data_create_from_pattern(re, NULL);
+  slot->users = 1;
+  return slot;
+}
+
+/** Work out how to match a pattern against attribute lists.
+ * \param plan the plan to fill in.
+ * \param name the glob or regexp.
+ * \param flags atr_iter_get flags.
+ * \return false if name is an invalid regexp, true otherwise.
+ */
+static bool
+aig_plan_init(struct aig_plan *plan, const char *name, unsigned flags)
+{
+  const char *p;
+
+  plan->plen = 0;
+  plan->pure = false;
+  plan->comp = NULL;
+
+  if (!(flags & AIG_REGEX)) {
+    for (p = name; *p && !strchr("*?[\\", *p) && plan->plen < BUFFER_LEN - 1;
+         p++) {
+      plan->prefix[plan->plen++] = toupper((unsigned char) *p);
+    }
+    /* '*' matches across `'s, so the rest of the pattern being all *'s
+     * means any name with the prefix matches. A pattern ending in ` is
+     * treated as if it ended in `*, which is the same thing. */
+    if (*p == '*' || (plan->plen && plan->prefix[plan->plen - 1] == '`')) {
+      for (; *p == '*'; p++)
+        ;
+      plan->pure = !*p;
+    }
+  }
+  plan->prefix[plan->plen] = '\0';
+  p = strchr(plan->prefix, '`');
+  plan->rootlen = p ? (size_t) (p - plan->prefix) : plan->plen;
+
+  if (!plan->pure) {
+    plan->comp =
+      aig_compiled_get(name, (flags & AIG_REGEX) != 0, &plan->uncached);
+    if (!plan->comp && (flags & AIG_REGEX)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Release the resources held by a plan. */
+static void
+aig_plan_free(struct aig_plan *plan)
+{
+  if (!plan->comp) {
+    return;
+  } else if (plan->comp == &plan->uncached) {
+    aig_compiled_clear(plan->comp);
+  } else {
+    plan->comp->users -= 1;
+  }
+}
+
+/** Does an attribute name start with the first len bytes of the prefix? */
+static inline bool
+aig_in_range(const struct aig_plan *plan, const char *aname, size_t len)
+{
+  return strncmp(aname, plan->prefix, len) == 0;
+}
+
+/** Does an attribute name match a planned pattern?
+ * \param plan the plan.
+ * \param name the original pattern, used if it couldn't be compiled.
+ * \param aname the attribute name.
+ * \return true if it matches.
+ */
+static bool
+aig_plan_match(const struct aig_plan *plan, const char *name,
+               const char *aname)
+{
+  if (plan->pure) {
+    return aig_in_range(plan, aname, plan->plen);
+  } else if (plan->comp) {
+    return qcomp_regexp_match(plan->comp->re, plan->comp->md, aname,
+                              PCRE2_ZERO_TERMINATED);
+  } else {
+    return atr_wild(name, aname);
+  }
+}
+
+TEST_GROUP(aig_plan)
+{
+  static const char *patterns[] = {"*",       "foo*",    "FOO**",  "FOO`",
+                                   "FOO`*",   "FOO`BA*", "F?O*",   "FOO*Z",
+                                   "[A-F]*",  "FOO\\*",  "*`BAZ",  "FOO`BAR`",
+                                   "FOO*`B*", "fooB",    NULL};
+  static const char *names[] = {"FOO",     "FOO`BAR", "FOO`BAR`BAZ", "FOOBAR",
+                                "FO",      "BAR",     "FOO*",        "FOO`BAZ",
+                                "FOOZ",    "FOOB",    "FOO1`BAR",    "GOO",
+                                "FOO`BA",  NULL};
+  struct aig_plan plan;
+  int n, m, bad = 0;
+
+  for (n = 0; patterns[n]; n++) {
+    pcre2_code *re = aig_compile(patterns[n], 0);
+    pcre2_match_data *md = pcre2_match_data_create_from_pattern(re, NULL);
+    aig_plan_init(&plan, patterns[n], 0);
+    for (m = 0; names[m]; m++) {
+      bool want =
+        qcomp_regexp_match(re, md, names[m], PCRE2_ZERO_TERMINATED) != 0;
+      /* A name outside the prefix range must never match */
+      if (aig_plan_match(&plan, patterns[n], names[m]) != want ||
+          (want && !aig_in_range(&plan, names[m], plan.rootlen))) {
+        bad += 1;
+      }
+    }
+    aig_plan_free(&plan);
+    pcre2_match_data_free(md);
+    pcre2_code_free(re);
+  }
+  TEST("aig_plan.1", bad == 0);
+  aig_plan_init(&plan, "foo*", 0);
+  TEST("aig_plan.2", plan.pure && strcmp(plan.prefix, "FOO") == 0 &&
+                       plan.rootlen == 3 && !plan.comp);
+  aig_plan_free(&plan);
+  aig_plan_init(&plan, "FOO`BA?", 0);
+  TEST("aig_plan.3", !plan.pure && plan.plen == 6 && plan.rootlen == 3 &&
+                       plan.comp);
+  aig_plan_free(&plan);
+  aig_plan_init(&plan, "FOO`BAR`", 0);
+  TEST("aig_plan.4", plan.pure && plan.plen == 8 && plan.rootlen == 3);
+  aig_plan_free(&plan);
+  aig_plan_init(&plan, "^FOO", AIG_REGEX);
+  TEST("aig_plan.5", !plan.pure && plan.plen == 0 && plan.comp);
+  aig_plan_free(&plan);
+  TEST("aig_plan.6", !aig_plan_init(&plan, "(FOO", AIG_REGEX));
+}
+
+TEST_GROUP(attr_index)
+{
+  /* Check every attribute in the loaded database can be found, and time
+   * lookups on the object with the most attributes with and without
+   * its index. */
+  dbref thing, big = NOTHING;
+  ATTR *a;
+  char **names;
+  int n, count, bad = 0, found = 0;
+
+  for (thing = 0; thing < db_top; thing++) {
+    ATTR_FOR_EACH (thing, a) {
+      if (find_atr_in_list(thing, AL_NAME(a)) != a) {
+        bad += 1;
+      }
+    }
+    if (AttrIndex(thing) &&
+        AttrIndex(thing)->used != (uint32_t) AttrCount(thing)) {
+      bad += 1;
+    }
+    if (AttrCount(thing) >= ATTR_INDEX_MIN &&
+        (big == NOTHING || AttrCount(thing) > AttrCount(big))) {
+      big = thing;
+    }
+  }
+  TEST("attr_index.1", bad == 0);
+  if (big == NOTHING) {
+    return;
+  }
+  TEST("attr_index.2", !find_atr_in_list(big, "NO`SUCH`ATTRIBUTE"));
+
+  /* Copies, so the names aren't the interned pointers */
+  count = AttrCount(big);
+  names = mush_calloc(count, sizeof *names, "attr_index.test");
+  n = 0;
+  ATTR_FOR_EACH (big, a) {
+    names[n++] = mush_strdup(AL_NAME(a), "attr_index.test");
+  }
+  do_rawlog(LT_TRACE, "Looking up %d attributes on #%d.", count, big);
+  BENCHMARK("attribute lookup (leaves)", 100, {
+    for (n = 0; n < count; n++) {
+      a = atr_lower_bound(big, names[n], strlen(names[n]) + 1);
+      found += AL_NAME(a) && strcmp(AL_NAME(a), names[n]) == 0;
+    }
+  });
+  BENCHMARK("attribute lookup (index)", 100, {
+    for (n = 0; n < count; n++) {
+      found += find_atr_in_list(big, names[n]) != NULL;
+    }
+  });
+  TEST("attr_index.3", found == count * 200);
+  for (n = 0; n < count; n++) {
+    mush_free(names[n], "attr_index.test");
+  }
+  mush_free(names, "attr_index.test");
+}
+
 /** Apply a function to a set of attributes.
  * This function applies another function to a set of attributes on an
  * object specified by a (wildcarded) pattern to match against the
@@ -1358,90 +2101,76 @@ atr_iter_get(dbref player, dbref thing, const char *name, unsigned flags,
                                      : Can_Read_Attr(player, thing, ptr)))
       result = func(player, thing, NOTHING, name, ptr, args);
   } else if (AttrCount(thing)) {
-    pcre2_code *re = NULL;
-    pcre2_match_data *md = NULL;
-    int errcode;
-    PCRE2_SIZE erroffset;
-
-    if (flags & AIG_REGEX) {
-      re = pcre2_compile((const PCRE2_UCHAR *) name, len,
-                         re_compile_flags | PCRE2_CASELESS, &errcode,
-                         &erroffset, re_compile_ctx);
-      if (!re) {
-        return 0;
-      }
-    } else {
-      /* Compile wildcard to regexp */
-      PCRE2_UCHAR *as_re = NULL;
-      PCRE2_SIZE rlen;
-      char *glob;
-
-      if (name[len - 1] == '`') {
-        glob = sqlite3_mprintf("%s*", name);
-        len += 1;
-      } else {
-        glob = sqlite3_mprintf("%s", name);
-      }
+    struct aig_plan plan;
 
-      if (pcre2_pattern_convert((const PCRE2_UCHAR *) glob, len,
-                                PCRE2_CONVERT_GLOB, &as_re, &rlen,
-                                glob_convert_ctx) == 0) {
-        re = pcre2_compile(as_re, rlen, re_compile_flags | PCRE2_CASELESS,
-                           &errcode, &erroffset, re_compile_ctx);
-        pcre2_converted_pattern_free(as_re);
-      }
-      sqlite3_free(glob);
-    }
-    if (re) {
-      flags |= AIG_REGEX;
-      pcre2_jit_compile(re, PCRE2_JIT_COMPLETE);
-      md = pcre2_match_data_create_from_pattern(re, NULL);
+    if (!aig_plan_init(&plan, name, flags)) {
+      return 0;
     }
 
-    ATTR_FOR_EACH (thing, ptr) {
+    ptr = atr_lower_bound(thing, plan.prefix, plan.rootlen);
+    while (AL_NAME(ptr) && aig_in_range(&plan, AL_NAME(ptr), plan.rootlen)) {
+      char here[ATTRIBUTE_NAME_LIMIT + 2];
+      char const *tick;
+      size_t hlen;
+
       if (cpu_time_limit_hit)
         break;
-      if (strchr(AL_NAME(ptr), '`')) {
+      if ((tick = strchr(AL_NAME(ptr), '`'))) {
+        /* A branch visited through its root; "ROOTa" sorts after "ROOT`*" */
+        hlen = tick - AL_NAME(ptr);
+        memcpy(here, AL_NAME(ptr), hlen);
+        here[hlen] = '`' + 1;
+        ptr = atr_lower_bound(thing, here, hlen + 1);
         continue;
       }
+      /* func may wipe ptr, so remember where we are by name */
+      hlen = strlen(AL_NAME(ptr));
+      memcpy(here, AL_NAME(ptr), hlen + 1);
       if (((flags & AIG_MORTAL) ? Is_Visible_Attr(thing, ptr)
                                 : Can_Read_Attr(player, thing, ptr)) &&
-          ((flags & AIG_REGEX)
-             ? qcomp_regexp_match(re, md, AL_NAME(ptr), PCRE2_ZERO_TERMINATED)
-             : atr_wild(name, AL_NAME(ptr)))) {
+          aig_plan_match(&plan, name, AL_NAME(ptr))) {
         int r = func(player, thing, NOTHING, name, ptr, args);
         result += r;
         if (r && in_wipe) {
-          ptr -= 1;
+          ptr = atr_lower_bound(thing, here, hlen);
           continue;
         }
       }
-      if (AL_FLAGS(ptr) & AF_ROOT) {
-        ATTR *prev = ptr;
-        for (ptr = atr_sub_branch(ptr);
-             AL_NAME(ptr) && is_atree_root(AL_NAME(prev), AL_NAME(ptr));
-             ptr++) {
-          if (((flags & AIG_MORTAL) ? Is_Visible_Attr(thing, ptr)
-                                    : Can_Read_Attr(player, thing, ptr)) &&
-              ((flags & AIG_REGEX) ? qcomp_regexp_match(re, md, AL_NAME(ptr),
-                                                        PCRE2_ZERO_TERMINATED)
-                                   : atr_wild(name, AL_NAME(ptr)))) {
-            int r = func(player, thing, NOTHING, name, ptr, args);
-            result += r;
-            if (r && in_wipe) {
-              ptr -= 1;
-            }
+      if (!(AL_FLAGS(ptr) & AF_ROOT)) {
+        ptr = atr_next(thing, ptr);
+        continue;
+      }
+      /* If the prefix reaches into this branch, skip straight to it */
+      if (plan.plen > plan.rootlen && hlen == plan.rootlen) {
+        ptr = atr_lower_bound(thing, plan.prefix, plan.plen);
+      } else {
+        ptr = atr_sub_branch(thing, ptr);
+      }
+      while (ptr && AL_NAME(ptr) && is_atree_root(here, AL_NAME(ptr)) &&
+             aig_in_range(&plan, AL_NAME(ptr), plan.plen)) {
+        if (((flags & AIG_MORTAL) ? Is_Visible_Attr(thing, ptr)
+                                  : Can_Read_Attr(player, thing, ptr)) &&
+            aig_plan_match(&plan, name, AL_NAME(ptr))) {
+          char sub[ATTRIBUTE_NAME_LIMIT + 1];
+          int r;
+
+          if (in_wipe) {
+            strcpy(sub, AL_NAME(ptr));
+          }
+          r = func(player, thing, NOTHING, name, ptr, args);
+          result += r;
+          if (r && in_wipe) {
+            ptr = atr_lower_bound(thing, sub, strlen(sub));
+            continue;
           }
         }
-        ptr = prev;
+        ptr = atr_next(thing, ptr);
       }
+      /* Resume just after the root; the branch itself is skipped above */
+      here[hlen] = '\001';
+      ptr = atr_lower_bound(thing, here, hlen + 1);
     }
-    if (re) {
-      pcre2_code_free(re);
-    }
-    if (md) {
-      pcre2_match_data_free(md);
-    }
+    aig_plan_free(&plan);
   }
 
   return result;
@@ -1532,51 +2261,22 @@ atr_iter_get_parent(dbref player, dbref thing, const char *name, unsigned flags,
   } else {
     StrTree seen;
     int parent_depth;
-    pcre2_code *re = NULL;
-    pcre2_match_data *md = NULL;
-    int errcode;
-    PCRE2_SIZE erroffset;
-
-    if (flags & AIG_REGEX) {
-      re = pcre2_compile((const PCRE2_UCHAR *) name, len,
-                         re_compile_flags | PCRE2_CASELESS, &errcode,
-                         &erroffset, re_compile_ctx);
-      if (!re) {
-        return 0;
-      }
-    } else {
-      /* Compile wildcard to regexp */
-      PCRE2_UCHAR *as_re = NULL;
-      PCRE2_SIZE rlen;
-      char *glob;
-
-      if (name[len - 1] == '`') {
-        glob = sqlite3_mprintf("%s*", name);
-        len += 1;
-      } else {
-        glob = sqlite3_mprintf("%s", name);
-      }
+    struct aig_plan plan;
 
-      if (pcre2_pattern_convert((const PCRE2_UCHAR *) glob, len,
-                                PCRE2_CONVERT_GLOB, &as_re, &rlen,
-                                glob_convert_ctx) == 0) {
-        re = pcre2_compile(as_re, rlen, re_compile_flags | PCRE2_CASELESS,
-                           &errcode, &erroffset, re_compile_ctx);
-        pcre2_converted_pattern_free(as_re);
-      }
-      sqlite3_free(glob);
-    }
-    if (re) {
-      flags |= AIG_REGEX;
-      pcre2_jit_compile(re, PCRE2_JIT_COMPLETE);
-      md = pcre2_match_data_create_from_pattern(re, NULL);
+    if (!aig_plan_init(&plan, name, flags)) {
+      return 0;
     }
 
     st_init(&seen, "AttrsSeenTree");
     for (parent_depth = MAX_PARENTS + 1, parent = thing;
          parent_depth-- && parent != NOTHING && !cpu_time_limit_hit;
          parent = Parent(parent)) {
-      ATTR_FOR_EACH (parent, ptr) {
+      if (!AttrCount(parent)) {
+        continue;
+      }
+      for (ptr = atr_lower_bound(parent, plan.prefix, plan.rootlen);
+           AL_NAME(ptr) && aig_in_range(&plan, AL_NAME(ptr), plan.rootlen);
+           ptr = atr_next(parent, ptr)) {
         if (cpu_time_limit_hit)
           break;
         if (!st_find(AL_NAME(ptr), &seen)) {
@@ -1588,16 +2288,15 @@ atr_iter_get_parent(dbref player, dbref thing, const char *name, unsigned flags,
 
           if (((flags & AIG_MORTAL) ? Is_Visible_Attr(parent, ptr)
                                     : Can_Read_Attr(player, parent, ptr)) &&
-              ((flags & AIG_REGEX) ? qcomp_regexp_match(re, md, AL_NAME(ptr),
-                                                        PCRE2_ZERO_TERMINATED)
-                                   : atr_wild(name, AL_NAME(ptr)))) {
+              aig_plan_match(&plan, name, AL_NAME(ptr))) {
             result += func(player, thing, parent, name, ptr, args);
           }
           if (AL_FLAGS(ptr) & AF_ROOT) {
             ATTR *prev = ptr;
-            for (ptr = atr_sub_branch(ptr);
-                 AL_NAME(ptr) && is_atree_root(AL_NAME(prev), AL_NAME(ptr));
-                 ptr++) {
+            for (ptr = atr_sub_branch(parent, ptr);
+                 ptr && AL_NAME(ptr) &&
+                 is_atree_root(AL_NAME(prev), AL_NAME(ptr));
+                 ptr = atr_next(parent, ptr)) {
               if (AF_Private(ptr) && thing != parent) {
                 continue;
               }
@@ -1627,10 +2326,7 @@ atr_iter_get_parent(dbref player, dbref thing, const char *name, unsigned flags,
               if (!st_find(AL_NAME(ptr), &seen) &&
                   ((flags & AIG_MORTAL) ? Is_Visible_Attr(thing, ptr)
                                         : Can_Read_Attr(player, thing, ptr)) &&
-                  ((flags & AIG_REGEX)
-                     ? qcomp_regexp_match(re, md, AL_NAME(ptr),
-                                          PCRE2_ZERO_TERMINATED)
-                     : atr_wild(name, AL_NAME(ptr)))) {
+                  aig_plan_match(&plan, name, AL_NAME(ptr))) {
                 st_insert(AL_NAME(ptr), &seen);
                 result += func(player, thing, parent, name, ptr, args);
               }
@@ -1640,12 +2336,7 @@ atr_iter_get_parent(dbref player, dbref thing, const char *name, unsigned flags,
         }
       }
     }
-    if (re) {
-      pcre2_code_free(re);
-    }
-    if (md) {
-      pcre2_match_data_free(md);
-    }
+    aig_plan_free(&plan);
     st_flush(&seen);
   }
 
@@ -1663,10 +2354,12 @@ void
 atr_free_all(dbref thing)
 {
 
-  if (AttrCap(thing) == 0) {
+  if (AttrLeaves(thing) == 0) {
     return;
   }
 
+  snapshot_preserve(thing);
+
   if (!IsPlayer(thing) && AttrCount(thing)) {
     ModTime(thing) = mudtime;
   }
@@ -1678,9 +2371,84 @@ atr_free_all(dbref thing)
     st_delete(AL_NAME(ptr), &atr_names);
   }
 
-  mush_free(List(thing), "obj.attributes");
-  AttrCount(thing) = AttrCap(thing) = 0;
-  List(thing) = NULL;
+  AttrCount(thing) = 0;
+  attr_shrink(thing);
+}
+
+/** Replace an object's attribute leaves with ones holding a sorted array
+ * of attributes. Only the leaves are freed; the attributes themselves
+ * move to the new leaves.
+ * \param thing the object.
+ * \param atrs the attributes, in order.
+ * \param count how many there are.
+ */
+static void
+atr_list_build(dbref thing, const ATTR *atrs, int count)
+{
+  int l, nleaves;
+
+  atr_index_free(thing);
+  if (AttrLeaves(thing)) {
+    while (AttrLeaves(thing)) {
+      AttrLeaves(thing) -= 1;
+      mush_free(Leaf(thing, AttrLeaves(thing)), "obj.attributes");
+    }
+    mush_free(List(thing), "obj.attributes");
+    List(thing) = NULL;
+  }
+  AttrCount(thing) = count;
+  if (!count) {
+    return;
+  }
+
+  /* Full leaves, as when loading a database. Only a lone leaf can have
+   * less room than ATTR_LEAF_MAX. */
+  nleaves = (count + ATTR_LEAF_MAX - 1) / ATTR_LEAF_MAX;
+  List(thing) = mush_malloc(sizeof(ATTR_LEAF *) * nleaves, "obj.attributes");
+  if (!List(thing)) {
+    mush_panic("Unable to allocate attribute list");
+  }
+  for (l = 0; l < nleaves; l++) {
+    int n = count - l * ATTR_LEAF_MAX;
+    ATTR_LEAF *leaf;
+
+    if (n > ATTR_LEAF_MAX) {
+      n = ATTR_LEAF_MAX;
+    }
+    leaf = atr_leaf_new(nleaves > 1 ? ATTR_LEAF_MAX : n < 5 ? 5 : n);
+    if (!leaf) {
+      mush_panic("Unable to allocate attribute list");
+    }
+    memcpy(leaf->atrs, atrs + l * ATTR_LEAF_MAX, sizeof(ATTR) * n);
+    leaf->count = n;
+    Leaf(thing, l) = leaf;
+  }
+  AttrLeaves(thing) = nleaves;
+}
+
+/** Find an attribute in a sorted array of attributes.
+ * \param atrs the attributes.
+ * \param count how many there are.
+ * \param name the name to look for.
+ * \return the attribute, or NULL.
+ */
+static ATTR *
+atr_array_find(ATTR *atrs, int count, char const *name)
+{
+  int lo = 0, hi = count;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    int cmp = strcmp(AL_NAME(atrs + mid), name);
+    if (cmp == 0) {
+      return atrs + mid;
+    } else if (cmp < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return NULL;
 }
 
 /** Copy all of the attributes from one object to another.
@@ -1688,27 +2456,226 @@ atr_free_all(dbref thing)
  * This function is used by @clone to copy all of the attributes
  * from one object to another.
  * \endverbatim
+ * The result is the same as adding each attribute with atr_new_add(),
+ * but the two sorted lists are merged in one pass into new leaves, and
+ * the copies share the source's values instead of storing them again.
  * \param dest destination object to receive attributes.
  * \param source source object containing attributes.
  */
 void
 atr_cpy(dbref dest, dbref source)
 {
-  ATTR *ptr;
-  int max_attrs;
-
+  ATTR *ptr, *d, *out, *root;
+  int max_attrs, count, n = 0;
+  char root_name[ATTRIBUTE_NAME_LIMIT + 1], *p;
+
+  /* Read lazily loaded attributes first; the counts may change. */
+  LoadAttrs(dest);
+  LoadAttrs(source);
+  if (!AttrCount(source) || dest == source) {
+    return;
+  }
   max_attrs = (Many_Attribs(dest) ? HARD_MAX_ATTRCOUNT : MAX_ATTRCOUNT);
-  attr_reserve(dest, AttrCount(source));
+
+  /* Both end up holding shared references to the values */
+  snapshot_preserve(dest);
+  snapshot_preserve(source);
+
+  out = mush_malloc(sizeof(ATTR) * (AttrCount(dest) + AttrCount(source)),
+                    "atr_cpy.list");
+  if (!out) {
+    mush_panic("Unable to allocate memory in atr_cpy");
+  }
+  count = AttrCount(dest);
+  d = AttrLeaves(dest) ? Leaf(dest, 0)->atrs : &atr_list_end;
 
   ATTR_FOR_EACH (source, ptr) {
-    if (AttrCount(dest) > max_attrs) {
+    if (count > max_attrs) {
       break;
     }
-    if (!AF_Nocopy(ptr)) {
-      atr_new_add(dest, AL_NAME(ptr), atr_value(ptr), AL_CREATOR(ptr),
-                  AL_FLAGS(ptr), AL_DEREFS(ptr), 0);
+    if (AF_Nocopy(ptr) || (!EMPTY_ATTRS && !ptr->data && !AF_Root(ptr))) {
+      continue;
+    }
+    /* dest's own attributes that sort first */
+    while (AL_NAME(d) && strcmp(AL_NAME(d), AL_NAME(ptr)) < 0) {
+      out[n++] = *d;
+      d = atr_next(dest, d);
+    }
+
+    if (AL_NAME(d) && strcmp(AL_NAME(d), AL_NAME(ptr)) == 0) {
+      /* Already there; replace its value */
+      out[n] = *d;
+      AL_FLAGS(out + n) |= AL_FLAGS(ptr);
+      AL_FLAGS(out + n) &= ~AF_COMMAND & ~AF_LISTEN;
+      AL_FLAGS(out + n) |= AL_FLAGS(ptr) & (AF_COMMAND | AF_LISTEN);
+      AL_CREATOR(out + n) = AL_CREATOR(ptr);
+      if (out[n].data) {
+        chunk_delete(out[n].data);
+      }
+      out[n++].data = chunk_share(&ptr->data);
+      d = atr_next(dest, d);
+      continue;
+    }
+
+    /* A branch is only copied if its root made it */
+    strcpy(root_name, AL_NAME(ptr));
+    if ((p = strrchr(root_name, '`'))) {
+      *p = '\0';
+      root = atr_array_find(out, n, root_name);
+      if (!root) {
+        continue;
+      }
+      AL_FLAGS(root) |= AF_ROOT;
+    }
+
+    out[n] = *ptr;
+    AL_NAME(out + n) = st_insert(AL_NAME(ptr), &atr_names);
+    if (!AL_NAME(out + n)) {
+      continue;
+    }
+    out[n++].data = chunk_share(&ptr->data);
+    count++;
+  }
+  for (; AL_NAME(d); d = atr_next(dest, d)) {
+    out[n++] = *d;
+  }
+
+  atr_list_build(dest, out, n);
+  mush_free(out, "atr_cpy.list");
+  if (dest == EVENT_HANDLER) {
+    event_handlers_changed();
+  }
+  warnings_changed(dest);
+}
+
+/* Tests that need an object without attributes borrow one, putting its
+ * own attributes back afterwards */
+struct borrowed_attrs {
+  ATTR_LEAF **list;
+  struct attr_index *index;
+  int count, leaves;
+};
+
+static void
+atr_borrow(dbref thing, struct borrowed_attrs *b)
+{
+  b->list = List(thing);
+  b->index = AttrIndex(thing);
+  b->count = AttrCount(thing);
+  b->leaves = AttrLeaves(thing);
+  List(thing) = NULL;
+  AttrIndex(thing) = NULL;
+  AttrCount(thing) = 0;
+  AttrLeaves(thing) = 0;
+}
+
+static void
+atr_unborrow(dbref thing, struct borrowed_attrs *b)
+{
+  atr_free_all(thing);
+  List(thing) = b->list;
+  AttrIndex(thing) = b->index;
+  AttrCount(thing) = b->count;
+  AttrLeaves(thing) = b->leaves;
+}
+
+static int
+atr_test_wipe(dbref player, dbref thing,
+              dbref parent __attribute__((__unused__)),
+              char const *pattern __attribute__((__unused__)), ATTR *atr,
+              void *args __attribute__((__unused__)))
+{
+  int count = AttrCount(thing);
+
+  wipe_atr(thing, AL_NAME(atr), player);
+  return count - AttrCount(thing);
+}
+
+TEST_GROUP(atr_cpy)
+{
+  struct borrowed_attrs src, dst;
+  char name[ATTRIBUTE_NAME_LIMIT + 1];
+  extern bool in_wipe;
+  ATTR *a, *b;
+  int n, bad = 0, wiped = 0, saved = options.max_attrcount;
+  int dedup = options.chunk_dedup;
+
+  options.max_attrcount = HARD_MAX_ATTRCOUNT;
+  atr_borrow(0, &src);
+  atr_borrow(GOD, &dst);
+  for (n = 0; n < 1000; n++) {
+    snprintf(name, sizeof name, "BULK%04d", n);
+    atr_add(0, name, n % 3 ? "$bulk *:think %0" : "x", GOD, 0);
+  }
+  atr_add(0, "BULKNC", "nocopy", GOD, AF_NOCOPY);
+  atr_add(0, "BULKT", "root", GOD, AF_NOCOPY);
+  atr_add(0, "BULKT`X", "branch of a nocopy root", GOD, 0);
+  atr_add(GOD, "AAA", "already here", GOD, 0);
+  atr_add(GOD, "BULK0005", "replaced", GOD, 0);
+
+  atr_cpy(GOD, 0);
+  TEST("atr_cpy.1", AttrCount(GOD) == 1001);
+  ATTR_FOR_EACH (0, a) {
+    b = find_atr_in_list(GOD, AL_NAME(a));
+    if (AF_Nocopy(a) || !strcmp(AL_NAME(a), "BULKT`X")) {
+      bad += b != NULL;
+    } else {
+      bad += !b || b->data != a->data || AL_FLAGS(b) != AL_FLAGS(a) ||
+             AL_NAME(b) != AL_NAME(a);
     }
   }
+  TEST("atr_cpy.2", bad == 0);
+  TEST("atr_cpy.3", strcmp(atr_value(atr_get_noparent(GOD, "AAA")),
+                           "already here") == 0);
+  TEST("atr_cpy.4", strcmp(atr_value(atr_get_noparent(GOD, "BULK0005")),
+                           "$bulk *:think %0") == 0);
+  TEST("atr_cpy.5",
+       AF_Command(atr_get_noparent(GOD, "BULK0001")) &&
+         !AF_Command(atr_get_noparent(GOD, "BULK0003")));
+  atr_clr(0, "BULK0001", GOD);
+  TEST("atr_cpy.6", strcmp(atr_value(atr_get_noparent(GOD, "BULK0001")),
+                           "$bulk *:think %0") == 0);
+  atr_free_all(GOD);
+
+  for (n = 0; n < 1000; n++) {
+    snprintf(name, sizeof name, "BULKMORE%04d", n);
+    atr_add(0, name, name, GOD, 0);
+  }
+  do_rawlog(LT_TRACE, "Copying %d attributes.", AttrCount(0));
+  BENCHMARK("atr_cpy + atr_free_all (one at a time)", 10, {
+    ATTR_FOR_EACH (0, a) {
+      if (!AF_Nocopy(a)) {
+        atr_new_add(GOD, AL_NAME(a), atr_value(a), AL_CREATOR(a), AL_FLAGS(a),
+                    AL_DEREFS(a), 0);
+      }
+    }
+    atr_free_all(GOD);
+  });
+  BENCHMARK("atr_cpy + atr_free_all", 10, {
+    atr_cpy(GOD, 0);
+    atr_free_all(GOD);
+  });
+  BENCHMARK("@wipe", 10, {
+    atr_cpy(GOD, 0);
+    in_wipe = true;
+    wiped += atr_iter_get(GOD, GOD, "**", AIG_NONE, atr_test_wipe, NULL);
+    in_wipe = false;
+  });
+  TEST("atr_cpy.7", wiped == 10 * (AttrCount(0) - 3) && AttrCount(GOD) == 0);
+
+  /* Sharing a value that wasn't yet doesn't count as using it */
+  options.chunk_dedup = 0;
+  atr_add(0, "BULKU", "not shared yet", GOD, 0);
+  options.chunk_dedup = dedup;
+  a = atr_get_noparent(0, "BULKU");
+  n = AL_DEREFS(a);
+  atr_cpy(GOD, 0);
+  TEST("atr_cpy.8", AL_DEREFS(a) == n);
+  atr_free_all(GOD);
+
+  atr_unborrow(GOD, &dst);
+  atr_unborrow(0, &src);
+  options.max_attrcount = saved;
 }
 
 static bool
@@ -1940,10 +2907,10 @@ atr_comm_match(dbref thing, dbref player, int type, int end, char const *str,
              are skipped. */
           st_insert(AL_NAME(ptr), &nocmd_roots);
           if (AF_Root(ptr)) {
-            ATTR *p2 = atr_sub_branch(ptr);
+            ATTR *p2 = atr_sub_branch(current, ptr);
             if (p2) {
               for (; AL_NAME(p2) && is_atree_root(AL_NAME(ptr), AL_NAME(p2));
-                   p2++) {
+                   p2 = atr_next(current, p2)) {
                 st_insert(AL_NAME(p2), &nocmd_roots);
               }
             }
@@ -1958,10 +2925,10 @@ atr_comm_match(dbref thing, dbref player, int type, int end, char const *str,
         if (st_find(AL_NAME(ptr), &nocmd_roots)) {
           /* Skip attributes that are masked by an earlier nocommand */
           if (AF_Root(ptr)) {
-            ATTR *p2 = atr_sub_branch(ptr);
+            ATTR *p2 = atr_sub_branch(current, ptr);
             if (p2) {
               for (; AL_NAME(p2) && is_atree_root(AL_NAME(ptr), AL_NAME(p2));
-                   p2++) {
+                   p2 = atr_next(current, p2)) {
                 st_insert(AL_NAME(p2), &nocmd_roots);
                 st_insert(AL_NAME(p2), &private_attrs);
               }
@@ -1974,10 +2941,10 @@ atr_comm_match(dbref thing, dbref player, int type, int end, char const *str,
              with the same name can be */
           st_insert(AL_NAME(ptr), &private_attrs);
           if (AF_Root(ptr)) {
-            ATTR *p2 = atr_sub_branch(ptr);
+            ATTR *p2 = atr_sub_branch(current, ptr);
             if (p2) {
               for (; AL_NAME(p2) && is_atree_root(AL_NAME(ptr), AL_NAME(p2));
-                   p2++) {
+                   p2 = atr_next(current, p2)) {
                 st_insert(AL_NAME(p2), &private_attrs);
               }
             }
@@ -1989,10 +2956,10 @@ atr_comm_match(dbref thing, dbref player, int type, int end, char const *str,
              are skipped. */
           st_insert(AL_NAME(ptr), &nocmd_roots);
           if (AF_Root(ptr)) {
-            ATTR *p2 = atr_sub_branch(ptr);
+            ATTR *p2 = atr_sub_branch(current, ptr);
             if (p2) {
               for (; AL_NAME(p2) && is_atree_root(AL_NAME(ptr), AL_NAME(p2));
-                   p2++) {
+                   p2 = atr_next(current, p2)) {
                 st_insert(AL_NAME(p2), &nocmd_roots);
               }
             }
@@ -2528,6 +3495,7 @@ do_atrlock(dbref player, const char *src, const char *action)
            T("You need to be able to set the attribute to change its lock."));
     return;
   } else {
+    snapshot_preserve(thing);
     if (status == ATRLOCK_LOCK) {
       AL_FLAGS(ptr) |= AF_LOCKED;
       AL_CREATOR(ptr) = Owner(player);
@@ -2603,6 +3571,7 @@ do_atrchown(dbref player, const char *xarg1, const char *arg2)
         retval = 0;
         goto cleanup;
       }
+      snapshot_preserve(thing);
       AL_CREATOR(ptr) = Owner(new_owner);
       notify(player, T("Attribute owner changed."));
       retval = 1;
@@ -2631,17 +3600,17 @@ cleanup:
 static void
 atr_free_one(dbref thing, const ATTR *a)
 {
-  ptrdiff_t pos;
+  char const *name;
 
   if (!a)
     return;
-  st_delete(AL_NAME(a), &atr_names);
+  snapshot_preserve(thing);
   if (a->data)
     chunk_delete(a->data);
-
-  pos = a - List(thing);
-  atr_move_up(thing, pos);
-  AttrCount(thing) -= 1;
+  name = AL_NAME(a);
+  atr_list_remove(thing, a);
+  st_delete(name, &atr_names);
+  warnings_changed(thing);
 }
 
 /** Return the compressed data for an attribute.
@@ -434,6 +434,8 @@ static int check_connect(DESC *d, const char *msg);
 static void parse_connect(const char *msg, char *command, char *user,
                           char *pass);
 static void close_sockets(void);
+static void capture_close(void);
+static void capture_event(DESC *d, char event, const char *data);
 dbref find_player_by_desc(int port);
 DESC *lookup_desc(dbref executor, const char *name);
 void WIN32_CDECL bailout(int sig);
@@ -908,6 +910,7 @@ main(int argc, char **argv)
   do_rawlog(LT_ERR, "MUSH shutdown completed.");
 
   end_all_logs();
+  capture_close();
 
   shutdown_sqlite();
 
@@ -2247,6 +2250,65 @@ logout_sock(DESC *d)
   welcome_user(d, 0);
 }
 
+/* Input capture, for replaying real load with utils/replay.pl. */
+static FILE *capture_fp = NULL;
+static char capture_file[FILE_PATH_LEN] = "";
+
+/** Close the input capture log, if it's open. */
+static void
+capture_close(void)
+{
+  if (capture_fp) {
+    fclose(capture_fp);
+    capture_fp = NULL;
+  }
+  capture_file[0] = '\0';
+}
+
+/** Append an event to the input capture log named by capture_log.
+ * Each line is "<ms> <event> <descriptor>[ <data>]", where ms is the
+ * wall-clock time in milliseconds and event is one of C (connect),
+ * L (login, data is the player's dbref), I (input, data is the line
+ * as run) or D (disconnect). Addresses are never written, and input
+ * is only captured from descriptors connected to a player, so the
+ * passwords in connect and create lines stay out of the file; ones
+ * given to @password and friends are masked like in the command log.
+ * \param d descriptor the event happened on.
+ * \param event event code.
+ * \param data event data, or NULL.
+ */
+static void
+capture_event(DESC *d, char event, const char *data)
+{
+  struct timeval now;
+
+  if (!*CAPTURELOG) {
+    if (capture_fp)
+      capture_close();
+    return;
+  }
+  if (capture_fp && strcmp(capture_file, CAPTURELOG))
+    capture_close();
+  if (!capture_fp) {
+    capture_fp = fopen(CAPTURELOG, "a");
+    if (!capture_fp) {
+      do_rawlog(LT_ERR, "Unable to open capture log %s: %s", CAPTURELOG,
+                strerror(errno));
+      options.capture_log[0] = '\0';
+      return;
+    }
+    mush_strncpy(capture_file, CAPTURELOG, sizeof capture_file);
+  }
+  penn_gettimeofday(&now);
+  fprintf(capture_fp, "%lld %c %d",
+          (long long) now.tv_sec * 1000 + now.tv_usec / 1000, event,
+          d->descriptor);
+  if (data)
+    fprintf(capture_fp, " %s", data);
+  fputc('\n', capture_fp);
+  fflush(capture_fp);
+}
+
 /** Disconnect a descriptor.
  * This sends appropriate disconnection text, announcements, queues events,
  * logs, etc.
@@ -2257,6 +2319,7 @@ static void
 disconnect_desc(DESC *d)
 {
   const char *reason = d->close_reason;
+  capture_event(d, 'D', NULL);
   if (d->connected == CONN_PLAYER) {
     disconnect_player(d, DISCONNECT_QUIT);
   } else {
@@ -2373,6 +2436,7 @@ initializesock(int s, const char *addr, const char *ip, conn_source source)
      d->connlog_id = connlog_connection(ip, addr, is_ssl_desc(d));
      d->conn_timer = sq_register_in(1, test_telnet_wrapper, (void *) d, NULL);
      queue_event(SYSEVENT, "SOCKET`CONNECT", "%d,%s", d->descriptor, d->ip);
+     capture_event(d, 'C', NULL);
      return d;
   }
 }
@@ -2641,12 +2705,21 @@ static void
 save_command(DESC *d, char *command)
 {
   if (d->conn_flags & CONN_UTF8) {
-    char *latin1;
+    char *latin1, *tofree;
     int llen;
 #ifdef HAVE_ICU
-    latin1 = translate_utf8_to_latin1(command, -1, &llen, "string");
+    latin1 = tofree = translate_utf8_to_latin1(command, -1, &llen, "string");
 #else
-    latin1 = utf8_to_latin1(command, -1, &llen, 1, "string");
+    char latin1buf[BUFFER_LEN];
+    int clen = strlen(command);
+    /* Transliteration can expand a character into up to 4 */
+    if (clen * 4 + 1 <= (int) sizeof latin1buf) {
+      llen = utf8_to_latin1_r(command, clen, latin1buf, sizeof latin1buf, 1);
+      latin1 = latin1buf;
+      tofree = NULL;
+    } else {
+      latin1 = tofree = utf8_to_latin1(command, clen, &llen, 1, "string");
+    }
 #endif
     if (latin1) {
       char *c;
@@ -2656,7 +2729,9 @@ save_command(DESC *d, char *command)
         }
       }
       add_to_queue(&d->input, latin1, llen + 1);
-      mush_free(latin1, "string");
+      if (tofree) {
+        mush_free(tofree, "string");
+      }
     } else {
       const char errmsg[] =
         "ERROR: Unicode sanitization+normalization failed.\r\n";
@@ -4168,6 +4243,9 @@ do_command(DESC *d, char *command)
     return CRES_OK;
   }
 
+  if (d->connected == CONN_PLAYER)
+    capture_event(d, 'I', passwd_filter(command));
+
   if (!strncmp(command, IDLE_COMMAND, strlen(IDLE_COMMAND))) {
     j = strlen(IDLE_COMMAND);
     if ((int) strlen(command) > j) {
@@ -4379,6 +4457,7 @@ dump_messages(DESC *d, dbref player, int isnew)
                      "ON-VACATION flag"));
   }
   local_connect(player, isnew, num);
+  capture_event(d, 'L', unparse_dbref(player));
   return 1;
 }
 
@@ -5915,6 +5994,7 @@ announce_connect(DESC *d, int isnew, int num)
   dbref player = d->player;
 
   set_flag_internal(player, "CONNECTED");
+  warnings_connected(player);
 
   if (isnew) {
     /* A brand new player created. */
@@ -7718,6 +7798,7 @@ do_reboot(dbref player, int flag)
   shutdown_conndb(1);
   close_help_files();
   end_all_logs();
+  capture_close();
 #ifndef WIN32
   {
     const char *args[8];
@@ -9,6 +9,13 @@
 #include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#endif
+
+#ifdef HAVE_SSE2
+#include <emmintrin.h>
+#endif
 
 #ifdef HAVE_ICU
 #include <unicode/ustring.h>
@@ -28,6 +35,93 @@
 #include "strutil.h"
 #include "tests.h"
 
+/** Return the length of the leading run of 7-bit ASCII characters in a
+ * string.
+ *
+ * With SSE2, checks 16 bytes at a time; otherwise 8 at a time.
+ *
+ * \param s the string.
+ * \param len the length of the string.
+ * \return the number of bytes before the first one with the high bit set.
+ */
+static inline int
+ascii_run_length(const char *s, int len)
+{
+  int i = 0;
+
+#ifdef HAVE_SSE2
+  while (i + 16 <= len) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *) (s + i));
+    if (_mm_movemask_epi8(chunk)) {
+      break;
+    }
+    i += 16;
+  }
+#else
+  while (i + 8 <= len) {
+    uint64_t chunk;
+    memcpy(&chunk, s + i, sizeof chunk);
+    if (chunk & UINT64_C(0x8080808080808080)) {
+      break;
+    }
+    i += 8;
+  }
+#endif
+
+  while (i < len && !(s[i] & 0x80)) {
+    i += 1;
+  }
+  return i;
+}
+
+/**
+ * Convert a latin-1 encoded string to utf-8 in a caller-supplied buffer.
+ *
+ * Doesn't allocate memory or use any shared state, so it's safe to call
+ * from any thread. Runs of ASCII characters are copied as-is. If the
+ * buffer is too small, the output is truncated at a character boundary;
+ * 2 * len + 1 bytes is always enough.
+ *
+ * \param latin1 the latin-1 string.
+ * \param len the length of the string, or -1 to use strlen().
+ * \param utf8 the buffer to write the utf-8 string to.
+ * \param size the size of the buffer, including room for the trailing nul.
+ * \return the number of bytes written, NOT counting the trailing nul.
+ */
+int
+latin1_to_utf8_r(const char *restrict latin1, int len, char *restrict utf8,
+                 int size)
+{
+  int i, o;
+
+  if (len < 0) {
+    len = strlen(latin1);
+  }
+  for (i = 0, o = 0; i < len;) {
+    int run, room = size - 1 - o;
+    if (room <= 0) {
+      break;
+    }
+    run = ascii_run_length(latin1 + i, len - i);
+    if (run > 0) {
+      if (run > room) {
+        run = room;
+      }
+      memcpy(utf8 + o, latin1 + i, run);
+      i += run;
+      o += run;
+    } else {
+      if (room < 2) {
+        break;
+      }
+      U8_APPEND_UNSAFE(utf8, o, (UChar32) (unsigned char) latin1[i]);
+      i += 1;
+    }
+  }
+  utf8[o] = '\0';
+  return o;
+}
+
 /**
  * Convert a latin-1 encoded string to utf-8.
  *
@@ -42,16 +136,14 @@ latin1_to_utf8(const char *restrict latin1, int len, int *outlen,
                const char *name)
 {
   char *utf8;
-  int i, o;
+  int o;
 
   if (len < 0) {
     len = strlen(latin1);
   }
   /* Worst case, every character takes two bytes */
-  utf8 = mush_calloc((len * 2) + 1, 1, name);
-  for (i = 0, o = 0; i < len; i += 1) {
-    U8_APPEND_UNSAFE(utf8, o, (UChar32) latin1[i]);
-  }
+  utf8 = mush_malloc((len * 2) + 1, name);
+  o = latin1_to_utf8_r(latin1, len, utf8, (len * 2) + 1);
   if (outlen) {
     *outlen = o;
   }
@@ -69,70 +161,149 @@ TEST_GROUP(latin1_to_utf8) {
   mush_free(utf8, "string");
 }
 
+TEST_GROUP(latin1_to_utf8_r) {
+  char buf[32];
+  int len;
+  len = latin1_to_utf8_r("a plain ascii string, 30 bytes", -1, buf, sizeof buf);
+  TEST("latin1_to_utf8_r.1",
+       strcmp(buf, "a plain ascii string, 30 bytes") == 0 && len == 30);
+  len = latin1_to_utf8_r("\xE1 bc", 4, buf, sizeof buf);
+  TEST("latin1_to_utf8_r.2", strcmp(buf, "\u00E1 bc") == 0 && len == 5);
+  len = latin1_to_utf8_r("abcdefgh", 8, buf, 5);
+  TEST("latin1_to_utf8_r.3", strcmp(buf, "abcd") == 0 && len == 4);
+  len = latin1_to_utf8_r("abc\xE1", 4, buf, 5);
+  TEST("latin1_to_utf8_r.4", strcmp(buf, "abc") == 0 && len == 3);
+  len = latin1_to_utf8_tn_r("a\xFF\xFF" "b\xFF\xFB\x01", 7, buf, sizeof buf, 1);
+  TEST("latin1_to_utf8_tn_r.1",
+       memcmp(buf, "a\xC3\xBF" "b\xFF\xFB\x01", 7) == 0 && len == 7);
+}
+
 /**
- * Convert a latin-1 encoded string to utf-8 optionally handling
- * telnet escape sequences.
+ * Convert a latin-1 encoded string to utf-8 in a caller-supplied buffer,
+ * optionally handling telnet escape sequences.
  *
- * \param s the latin-1 string.
- * \param latin the length of the string.
- * \param outlen the number of bytes of the returned string, NOT counting the
- * trailing nul. \param telnet true if we should handle telnet escape sequences.
- * \param name memcheck tag.
- * \return a newly allocated utf-8 string.
+ * Like latin1_to_utf8_r(), this doesn't allocate memory and is safe to
+ * call from any thread. 2 * len + 1 bytes is always enough room.
+ *
+ * \param latin1 the latin-1 string.
+ * \param len the length of the string, or -1 to use strlen().
+ * \param utf8 the buffer to write the utf-8 string to.
+ * \param size the size of the buffer, including room for the trailing nul.
+ * \param telnet true if we should handle telnet escape sequences.
+ * \return the number of bytes written, NOT counting the trailing nul.
  */
-char *
-latin1_to_utf8_tn(const char *restrict latin1, int len, int *outlen,
-                  bool telnet, const char *name)
+int
+latin1_to_utf8_tn_r(const char *restrict latin1, int len, char *restrict utf8,
+                    int size, bool telnet)
 {
-  char *utf8;
   int i, o;
 
   if (len < 0) {
     len = strlen(latin1);
   }
-  /* Worst case, every character takes two bytes */
-  utf8 = mush_calloc((len * 2) + 1, 1, name);
   for (i = 0, o = 0; i < len;) {
-    UChar32 c = latin1[i++];
+    UChar32 c;
+    int run, room = size - 1 - o;
+    if (room <= 0) {
+      break;
+    }
+    /* IAC has the high bit set, so it never shows up in an ASCII run. */
+    run = ascii_run_length(latin1 + i, len - i);
+    if (run > 0) {
+      if (run > room) {
+        run = room;
+      }
+      memcpy(utf8 + o, latin1 + i, run);
+      i += run;
+      o += run;
+      continue;
+    }
+    c = (unsigned char) latin1[i];
     if (telnet && c == IAC) {
+      int seqlen;
       /* Single IAC is the start of a telnet sequence. Double IAC IAC is
        * an escape for a single character. */
-      switch (latin1[i]) {
+      switch (latin1[i + 1]) {
       case IAC:
+        if (room < 2) {
+          goto done;
+        }
+        i += 2;
         U8_APPEND_UNSAFE(utf8, o, IAC);
-        i += 1;
         break;
       case SB:
-        utf8[o++] = IAC;
-        utf8[o++] = SB;
-        i += 1;
-        while (latin1[i] != SE) {
-          utf8[o++] = latin1[i++];
+        for (seqlen = 2; latin1[i + seqlen] != SE; seqlen += 1)
+          ;
+        seqlen += 1;
+        if (room < seqlen) {
+          goto done;
         }
-        utf8[o++] = latin1[i++];
+        memcpy(utf8 + o, latin1 + i, seqlen);
+        i += seqlen;
+        o += seqlen;
         break;
       case DO:
       case DONT:
       case WILL:
       case WONT:
-        utf8[o++] = IAC;
-        utf8[o++] = latin1[i++];
-        utf8[o++] = latin1[i++];
+        if (room < 3) {
+          goto done;
+        }
+        memcpy(utf8 + o, latin1 + i, 3);
+        i += 3;
+        o += 3;
         break;
       case NOP:
+        if (room < 2) {
+          goto done;
+        }
         utf8[o++] = IAC;
         utf8[o++] = NOP;
-        i += 1;
+        i += 2;
         break;
       default:
         /* This should never be reached. */
-        do_rawlog(LT_ERR, "Invalid telnet sequence character %X", latin1[i]);
-        i += 1;
+        do_rawlog(LT_ERR, "Invalid telnet sequence character %X",
+                  latin1[i + 1]);
+        i += 2;
       }
     } else {
+      if (room < 2) {
+        break;
+      }
       U8_APPEND_UNSAFE(utf8, o, c);
+      i += 1;
     }
   }
+done:
+  utf8[o] = '\0';
+  return o;
+}
+
+/**
+ * Convert a latin-1 encoded string to utf-8 optionally handling
+ * telnet escape sequences.
+ *
+ * \param s the latin-1 string.
+ * \param latin the length of the string.
+ * \param outlen the number of bytes of the returned string, NOT counting the
+ * trailing nul. \param telnet true if we should handle telnet escape sequences.
+ * \param name memcheck tag.
+ * \return a newly allocated utf-8 string.
+ */
+char *
+latin1_to_utf8_tn(const char *restrict latin1, int len, int *outlen,
+                  bool telnet, const char *name)
+{
+  char *utf8;
+  int o;
+
+  if (len < 0) {
+    len = strlen(latin1);
+  }
+  /* Worst case, every character takes two bytes */
+  utf8 = mush_malloc((len * 2) + 1, name);
+  o = latin1_to_utf8_tn_r(latin1, len, utf8, (len * 2) + 1, telnet);
   if (outlen) {
     *outlen = o;
   }
@@ -565,6 +736,107 @@ translit_to_latin1(UChar32 c, char rep[4])
   }
 }
 
+/** Append a single character to a latin-1 buffer, transliterating or
+ * replacing it with a question mark if it's outside the latin-1 range.
+ *
+ * \param c the character.
+ * \param translit true to try to transliterate characters.
+ * \param latin1 the buffer.
+ * \param o the current length of the buffer, updated on success.
+ * \param size the size of the buffer, including room for the trailing nul.
+ * \return false if there wasn't room for the character.
+ */
+static inline bool
+append_latin1(UChar32 c, bool translit, char *restrict latin1, int *o,
+              int size)
+{
+  char rep[4];
+  int n;
+
+  if (translit) {
+    switch (translit_to_latin1(c, rep)) {
+    case TRANS_KEEP:
+      rep[0] = c;
+      n = 1;
+      break;
+    case TRANS_REPLACE:
+      for (n = 0; n < 4 && rep[n]; n += 1)
+        ;
+      break;
+    case TRANS_SKIP:
+    default:
+      return true;
+    }
+  } else if (c <= 0xFF) {
+    rep[0] = c;
+    n = 1;
+  } else {
+    rep[0] = '?';
+    n = 1;
+  }
+
+  if (*o + n > size - 1) {
+    return false;
+  }
+  memcpy(latin1 + *o, rep, n);
+  *o += n;
+  return true;
+}
+
+/**
+ * Convert a UTF-8 encoded string to Latin-1 in a caller-supplied buffer.
+ *
+ * Invalid byte sequences are turned into question marks. Characters
+ * outside the Latin-1 range are either turned into question marks or
+ * transliterated into ASCII equivalents. Doesn't allocate memory or
+ * use any shared state, so it's safe to call from any thread. If the
+ * buffer is too small, the output is truncated at a character boundary;
+ * len + 1 bytes is always enough without transliteration, and 4 * len + 1
+ * with it.
+ *
+ * \param utf8 a utf-8 string. It should be normalized in NFC/NFKC for best
+ * results.
+ * \param len the length of the string in bytes, or -1 to use strlen().
+ * \param latin1 the buffer to write the latin-1 string to.
+ * \param size the size of the buffer, including room for the trailing nul.
+ * \param translit true to try to transliterate characters to latin-1
+ * equivalents.
+ * \return the length of the latin-1 string, NOT including trailing nul.
+ */
+int
+utf8_to_latin1_r(const char *restrict utf8, int len, char *restrict latin1,
+                 int size, bool translit)
+{
+  int i, o;
+
+  if (len < 0) {
+    len = strlen(utf8);
+  }
+  for (i = 0, o = 0; i < len;) {
+    UChar32 c;
+    int run, room = size - 1 - o;
+    if (room <= 0) {
+      break;
+    }
+    run = ascii_run_length(utf8 + i, len - i);
+    if (run > 0) {
+      if (run > room) {
+        run = room;
+      }
+      memcpy(latin1 + o, utf8 + i, run);
+      i += run;
+      o += run;
+      continue;
+    }
+    U8_NEXT_OR_FFFD(utf8, i, len, c);
+    if (!append_latin1(c, translit, latin1, &o, size)) {
+      break;
+    }
+  }
+  latin1[o] = '\0';
+  return o;
+}
+
 /**
  * Convert a UTF-8 encoded string to Latin-1
  *
@@ -583,42 +855,15 @@ utf8_to_latin1(const char *restrict utf8, int len, int *outlen, bool translit,
                const char *name)
 {
   char *latin1;
-  int i, o;
+  int size, o;
 
   if (len < 0) {
     len = strlen(utf8);
   }
 
-  latin1 = mush_calloc((translit ? len * 4 : len) + 1, 1, name);
-  for (i = 0, o = 0; i < len;) {
-    UChar32 c;
-    U8_NEXT_OR_FFFD(utf8, i, len, c);
-    if (translit) {
-      char rep[4];
-      int n;
-      switch (translit_to_latin1(c, rep)) {
-      case TRANS_KEEP:
-        latin1[o++] = c;
-        break;
-      case TRANS_REPLACE:
-        for (n = 0; n < 4; n += 1) {
-          if (rep[n]) {
-            latin1[o++] = rep[n];
-          } else {
-            break;
-          }
-        }
-        break;
-      case TRANS_SKIP:
-      default:
-        break;
-      }
-    } else if (c <= 0xFF) {
-      latin1[o++] = c;
-    } else {
-      latin1[o++] = '?';
-    }
-  }
+  size = (translit ? len * 4 : len) + 1;
+  latin1 = mush_malloc(size, name);
+  o = utf8_to_latin1_r(utf8, len, latin1, size, translit);
   if (outlen) {
     *outlen = o;
   }
@@ -648,6 +893,73 @@ TEST_GROUP(utf8_to_latin1) {
   mush_free(latin1, "string");
 }
 
+TEST_GROUP(utf8_to_latin1_r) {
+  char buf[32];
+  int len;
+  len = utf8_to_latin1_r("a plain ascii string, 30 bytes", -1, buf, sizeof buf,
+                         0);
+  TEST("utf8_to_latin1_r.1",
+       strcmp(buf, "a plain ascii string, 30 bytes") == 0 && len == 30);
+  len = utf8_to_latin1_r("\xC3\xA1qq", 4, buf, sizeof buf, 0);
+  TEST("utf8_to_latin1_r.2", strcmp(buf, "\xE1qq") == 0 && len == 3);
+  len = utf8_to_latin1_r("\xEF\xAC\x83x", -1, buf, 3, 1);
+  TEST("utf8_to_latin1_r.3", strcmp(buf, "") == 0 && len == 0);
+  len = utf8_to_latin1_r("\xEF\xAC\x83x", -1, buf, 5, 1);
+  TEST("utf8_to_latin1_r.4", strcmp(buf, "ffix") == 0 && len == 4);
+  len = utf8_to_latin1_us_r("\xE2\x80\x9Ctest\xE2\x80\x9D", -1, buf,
+                            sizeof buf, 1);
+  TEST("utf8_to_latin1_us_r.1", strcmp(buf, "\"test\"") == 0 && len == 6);
+}
+
+/**
+ * Convert a well-formed UTF-8 encoded string to Latin-1 in a
+ * caller-supplied buffer.
+ *
+ * Like utf8_to_latin1_r(), but without checks for invalid byte sequences.
+ *
+ * \param utf8 a utf-8 string. It should be normalized in NFC/NFKC for best
+ * results.
+ * \param len the length of the string in bytes, or -1 to use strlen().
+ * \param latin1 the buffer to write the latin-1 string to.
+ * \param size the size of the buffer, including room for the trailing nul.
+ * \param translit true to try to transliterate characters to latin-1
+ * equivalents.
+ * \return the length of the latin-1 string, NOT including trailing nul.
+ */
+int
+utf8_to_latin1_us_r(const char *restrict utf8, int len, char *restrict latin1,
+                    int size, bool translit)
+{
+  int i, o;
+
+  if (len < 0) {
+    len = strlen(utf8);
+  }
+  for (i = 0, o = 0; i < len;) {
+    UChar32 c;
+    int run, room = size - 1 - o;
+    if (room <= 0) {
+      break;
+    }
+    run = ascii_run_length(utf8 + i, len - i);
+    if (run > 0) {
+      if (run > room) {
+        run = room;
+      }
+      memcpy(latin1 + o, utf8 + i, run);
+      i += run;
+      o += run;
+      continue;
+    }
+    U8_NEXT_UNSAFE(utf8, i, c);
+    if (!append_latin1(c, translit, latin1, &o, size)) {
+      break;
+    }
+  }
+  latin1[o] = '\0';
+  return o;
+}
+
 /**
  * Convert a well-formed UTF-8 encoded string to Latin-1
  *
@@ -665,42 +977,15 @@ utf8_to_latin1_us(const char *restrict utf8, int len, int *outlen,
                   bool translit, const char *name)
 {
   char *latin1;
-  int i, o;
+  int size, o;
 
   if (len < 0) {
     len = strlen(utf8);
   }
 
-  latin1 = mush_calloc((translit ? len * 4 : len) + 1, 1, name);
-  for (i = 0, o = 0; i < len;) {
-    UChar32 c;
-    U8_NEXT_UNSAFE(utf8, i, c);
-    if (translit) {
-      char rep[4];
-      int n;
-      switch (translit_to_latin1(c, rep)) {
-      case TRANS_KEEP:
-        latin1[o++] = c;
-        break;
-      case TRANS_REPLACE:
-        for (n = 0; n < 4; n += 1) {
-          if (rep[n]) {
-            latin1[o++] = rep[n];
-          } else {
-            break;
-          }
-        }
-        break;
-      case TRANS_SKIP:
-      default:
-        break;
-      }
-    } else if (c <= 0xFF) {
-      latin1[o++] = c;
-    } else {
-      latin1[o++] = '?';
-    }
-  }
+  size = (translit ? len * 4 : len) + 1;
+  latin1 = mush_malloc(size, name);
+  o = utf8_to_latin1_us_r(utf8, len, latin1, size, translit);
   if (outlen) {
     *outlen = o;
   }
@@ -724,6 +1009,99 @@ TEST_GROUP(utf8_to_latin1_us) {
   mush_free(latin1, "string");
 }
 
+/* From spellfix.c */
+int spellfix_translit_char(int c, unsigned char *out);
+
+/** ASCII transliterations of the latin-1 characters 0x80-0xFF, built
+ * from the spellfix table the first time they're needed. Characters
+ * without a mapping become a question mark, like spellfix1_translit()
+ * does. */
+static struct latin1_ascii {
+  unsigned char len;
+  char rep[4];
+} latin1_ascii[128];
+static bool latin1_ascii_ready = false;
+
+static void
+init_latin1_ascii(void)
+{
+  int c;
+
+  for (c = 0x80; c <= 0xFF; c += 1) {
+    struct latin1_ascii *la = latin1_ascii + (c - 0x80);
+    la->len = spellfix_translit_char(c, (unsigned char *) la->rep);
+    if (la->len == 0) {
+      la->rep[0] = '?';
+      la->len = 1;
+    }
+  }
+  latin1_ascii_ready = true;
+}
+
+/**
+ * Transliterate a latin-1 string into ASCII, appending it to a buffer.
+ *
+ * Uses the same table as the spellfix1_translit() SQL function, but
+ * without having to convert the string to UTF-8 or going through sqlite.
+ * Runs of plain ASCII are copied as-is.
+ *
+ * \param latin1 the latin-1 string.
+ * \param len the length of the string, or -1 to use strlen().
+ * \param buff the buffer to append to.
+ * \param bp pointer to the insertion point in buff.
+ * \return 0 on success, non-zero if the buffer filled up.
+ */
+int
+safe_latin1_to_ascii(const char *restrict latin1, int len, char *buff,
+                     char **bp)
+{
+  int i;
+
+  if (len < 0) {
+    len = strlen(latin1);
+  }
+  if (!latin1_ascii_ready) {
+    init_latin1_ascii();
+  }
+
+  for (i = 0; i < len;) {
+    int run = ascii_run_length(latin1 + i, len - i);
+    if (run > 0) {
+      if (safe_strl(latin1 + i, run, buff, bp)) {
+        return 1;
+      }
+      i += run;
+    } else {
+      const struct latin1_ascii *la = latin1_ascii + ((unsigned char) latin1[i] - 0x80);
+      if (safe_strl(la->rep, la->len, buff, bp)) {
+        return 1;
+      }
+      i += 1;
+    }
+  }
+  return 0;
+}
+
+TEST_GROUP(safe_latin1_to_ascii) {
+  char buff[BUFFER_LEN], *bp;
+  bp = buff;
+  safe_latin1_to_ascii("abcd", 4, buff, &bp);
+  *bp = '\0';
+  TEST("safe_latin1_to_ascii.1", strcmp(buff, "abcd") == 0);
+  bp = buff;
+  safe_latin1_to_ascii("\xC9t\xE9 \xC6sir", -1, buff, &bp);
+  *bp = '\0';
+  TEST("safe_latin1_to_ascii.2", strcmp(buff, "Ete AEsir") == 0);
+  bp = buff;
+  safe_latin1_to_ascii("a long run of plain ascii text\xFC\x80", -1, buff, &bp);
+  *bp = '\0';
+  TEST("safe_latin1_to_ascii.3",
+       strcmp(buff, "a long run of plain ascii textue?") == 0);
+  bp = buff;
+  safe_latin1_to_ascii("", 0, buff, &bp);
+  TEST("safe_latin1_to_ascii.4", bp == buff);
+}
+
 /**
  * Check to see if a string is valid utf-8 or not.
  * \param utf8 string to validate
@@ -1219,6 +1597,40 @@ cleanup:
   return upper;
 }
 
+/** Change the case of a pure ASCII string, which needs none of ICU's
+ * locale rules.
+ *
+ * \param s the string.
+ * \param len the length of the string.
+ * \param outlen set to the length of the returned string.
+ * \param upper true to upper case, false to lower case.
+ * \param name memcheck tag
+ * \return newly allocated string.
+ */
+static char *
+ascii_change_case(const char *restrict s, int len, int *outlen, bool upper,
+                  const char *name)
+{
+  char *res;
+  int i;
+
+  res = mush_malloc(len + 1, name);
+  for (i = 0; i < len; i += 1) {
+    if (upper && s[i] >= 'a' && s[i] <= 'z') {
+      res[i] = s[i] - 'a' + 'A';
+    } else if (!upper && s[i] >= 'A' && s[i] <= 'Z') {
+      res[i] = s[i] - 'A' + 'a';
+    } else {
+      res[i] = s[i];
+    }
+  }
+  res[len] = '\0';
+  if (outlen) {
+    *outlen = len;
+  }
+  return res;
+}
+
 /** Return a smart lower-cased utf-8 string.
  *
  * Invalid byte sequences are replaced with U+FFFD
@@ -1237,6 +1649,13 @@ utf8_to_lower(const char *restrict s, int len, int *outlen, const char *name)
   int ulen, llen;
   UErrorCode uerr = U_ZERO_ERROR;
 
+  if (len < 0) {
+    len = strlen(s);
+  }
+  if (ascii_run_length(s, len) == len) {
+    return ascii_change_case(s, len, outlen, false, name);
+  }
+
   utf16 = utf8_to_utf16(s, len, &ulen, "temp.utf16");
 
   lower16 = mush_calloc(ulen + 1, sizeof(UChar), "temp.utf16");
@@ -1282,6 +1701,13 @@ utf8_to_upper(const char *restrict s, int len, int *outlen, const char *name)
   int ulen, llen;
   UErrorCode uerr = U_ZERO_ERROR;
 
+  if (len < 0) {
+    len = strlen(s);
+  }
+  if (ascii_run_length(s, len) == len) {
+    return ascii_change_case(s, len, outlen, true, name);
+  }
+
   utf16 = utf8_to_utf16(s, len, &ulen, "temp.utf16");
   upper16 = mush_calloc(ulen + 1, sizeof(UChar), "temp.utf16");
   llen = ulen + 1;
@@ -1414,6 +1840,21 @@ translate_utf8_to_latin1(const char *restrict utf8, int len, int *outlen,
   char *norm8;
   int ulen, nlen;
 
+  if (len < 0) {
+    len = strlen(utf8);
+  }
+
+  /* Plain ASCII is already normalized and needs no translation. */
+  if (ascii_run_length(utf8, len) == len) {
+    norm8 = mush_malloc(len + 1, name);
+    memcpy(norm8, utf8, len);
+    norm8[len] = '\0';
+    if (outlen) {
+      *outlen = len;
+    }
+    return norm8;
+  }
+
   utf16 = utf8_to_utf16(utf8, len, &ulen, "temp.utf16");
   if (!utf16) {
     return NULL;
@@ -1490,12 +1931,20 @@ sanitize_utf8(const char *restrict orig, int len, int *outlen, const char *name)
   }
   /* Allocate enough space for the worst case: every byte in orig is
      invalid. */
-  san8 = mush_calloc((len * 3) + 1, 1, name);
+  san8 = mush_malloc((len * 3) + 1, name);
   for (i = 0, o = 0; i < len;) {
     UChar32 c;
+    int run = ascii_run_length(orig + i, len - i);
+    if (run > 0) {
+      memcpy(san8 + o, orig + i, run);
+      i += run;
+      o += run;
+      continue;
+    }
     U8_NEXT_OR_FFFD(orig, i, len, c);
     U8_APPEND_UNSAFE(san8, o, c);
   }
+  san8[o] = '\0';
   if (outlen) {
     *outlen = o;
   }
@@ -1518,3 +1967,45 @@ TEST_GROUP(sanitize_utf8) {
   TEST("valid_utf8.4", strcmp(s, "test\xEF\xBF\xBDtest") == 0 && len == 11);
   mush_free(s, "string");
 }
+
+// TEST charconv_benchmark REQUIRES latin1_to_utf8_r utf8_to_latin1_r
+TEST_GROUP(charconv_benchmark) {
+  /* Typical MUSH output: mostly ASCII with the occasional accented
+   * character, and a long line that's all ASCII. */
+  static const char mixed[] =
+    "You say, \"Voil\xE0, the caf\xE9 is open.\" Bob waves to Zo\xEB.";
+  char latin1[BUFFER_LEN], utf8[BUFFER_LEN * 2 + 1], back[BUFFER_LEN];
+  int llen = 0, ulen, blen;
+
+  while (llen + (int) sizeof mixed < BUFFER_LEN / 2) {
+    memcpy(latin1 + llen, mixed, sizeof mixed - 1);
+    llen += sizeof mixed - 1;
+  }
+  latin1[llen] = '\0';
+
+  ulen = latin1_to_utf8_r(latin1, llen, utf8, sizeof utf8);
+  blen = utf8_to_latin1_r(utf8, ulen, back, sizeof back, 0);
+  TEST("charconv_benchmark.1", blen == llen && memcmp(back, latin1, llen) == 0);
+
+  BENCHMARK("latin1_to_utf8 (mixed)", 1000, {
+    char *u = latin1_to_utf8(latin1, llen, NULL, "string");
+    mush_free(u, "string");
+  });
+  BENCHMARK("latin1_to_utf8_r (mixed)", 1000,
+            { latin1_to_utf8_r(latin1, llen, utf8, sizeof utf8); });
+  BENCHMARK("utf8_to_latin1 (mixed)", 1000, {
+    char *l = utf8_to_latin1(utf8, ulen, NULL, 1, "string");
+    mush_free(l, "string");
+  });
+  BENCHMARK("utf8_to_latin1_r (mixed)", 1000,
+            { utf8_to_latin1_r(utf8, ulen, back, sizeof back, 1); });
+
+  memset(latin1, 'x', BUFFER_LEN / 2);
+  latin1[BUFFER_LEN / 2] = '\0';
+  llen = BUFFER_LEN / 2;
+  BENCHMARK("latin1_to_utf8_r (ascii)", 1000,
+            { ulen = latin1_to_utf8_r(latin1, llen, utf8, sizeof utf8); });
+  BENCHMARK("utf8_to_latin1_r (ascii)", 1000,
+            { utf8_to_latin1_r(utf8, ulen, back, sizeof back, 1); });
+  TEST("charconv_benchmark.2", ulen == llen);
+}
@@ -104,6 +104,18 @@
  * should be a period change about every 2.6 days.
  *
  *
+ * <h3>Sharing:</h3>
+ * Attribute values are created with chunk_create_shared(), which
+ * (when the chunk_dedup option is on) looks the value up by a hash of
+ * its contents and reuses an existing identical chunk instead of making
+ * a new one.  Shared references carry a tag bit and index a table that
+ * holds the single underlying reference and a count of its users, so
+ * migration moves the one real chunk and every user sees the move.
+ * Copying an attribute, as \@clone does, uses chunk_share() to add a
+ * user to the value's chunk instead of storing the value again.
+ * Since chunks are immutable, changing a value just drops one user of
+ * the old chunk; it is freed when the last user deletes it.
+ *
  * <h3>Statistics:</h3>
  * The chunk memory management system keeps several statistics about
  * the allocation pool, both to maintain good operation through active
@@ -243,6 +255,7 @@
 #include "conf.h"
 #include "dbdefs.h"
 #include "externs.h"
+#include "hash_function.h"
 #include "intrface.h"
 #include "log.h"
 #include "mymalloc.h"
@@ -2393,8 +2406,9 @@ acc_chunk_delete(chunk_reference_t reference)
   stat_delete++;
 }
 
+/* Fetch a chunk's data without counting it as a dereference. */
 static uint32_t
-acc_chunk_fetch(chunk_reference_t reference, char *buffer, uint32_t buffer_len)
+acc_chunk_peek(chunk_reference_t reference, char *buffer, uint32_t buffer_len)
 {
   uint32_t region, offset, len;
   region = ChunkReferenceToRegion(reference);
@@ -2408,6 +2422,16 @@ acc_chunk_fetch(chunk_reference_t reference, char *buffer, uint32_t buffer_len)
   if (len <= buffer_len)
     memcpy(buffer, ChunkDataPtr(region, offset), len);
   touch_cache_region(regions[region].in_memory);
+  return len;
+}
+
+static uint32_t
+acc_chunk_fetch(chunk_reference_t reference, char *buffer, uint32_t buffer_len)
+{
+  uint32_t region, offset, len;
+  len = acc_chunk_peek(reference, buffer, buffer_len);
+  region = ChunkReferenceToRegion(reference);
+  offset = ChunkReferenceToOffset(reference);
   stat_deref_count++;
   if (ChunkDerefs(region, offset) < CHUNK_DEREF_MAX) {
     SetChunkDerefs(region, offset, ChunkDerefs(region, offset) + 1);
@@ -2760,6 +2784,7 @@ struct ac_funcs {
   chunk_reference_t (*chunk_create)(char const *, uint32_t, uint8_t);
   void (*chunk_delete)(chunk_reference_t);
   uint32_t (*fetch)(chunk_reference_t, char *, uint32_t);
+  uint32_t (*peek)(chunk_reference_t, char *, uint32_t);
   uint32_t (*len)(chunk_reference_t);
   uint8_t (*derefs)(chunk_reference_t);
   void (*migration)(int, chunk_reference_t **);
@@ -2774,20 +2799,285 @@ struct ac_funcs {
 };
 
 static struct ac_funcs malloc_interface = {
-  acm_chunk_create,      acm_chunk_delete,    acm_chunk_fetch,
-  acm_chunk_len,         acm_chunk_derefs,    acm_chunk_migration,
-  acm_chunk_num_swapped, acm_chunk_init,      acm_chunk_stats,
-  acm_chunk_new_period,  acm_chunk_fork_file, acm_chunk_fork_parent,
-  acm_chunk_fork_child,  acm_chunk_fork_done};
+  acm_chunk_create,      acm_chunk_delete,      acm_chunk_fetch,
+  acm_chunk_fetch,       acm_chunk_len,         acm_chunk_derefs,
+  acm_chunk_migration,   acm_chunk_num_swapped, acm_chunk_init,
+  acm_chunk_stats,       acm_chunk_new_period,  acm_chunk_fork_file,
+  acm_chunk_fork_parent, acm_chunk_fork_child,  acm_chunk_fork_done};
 
 static struct ac_funcs chunk_interface = {
-  acc_chunk_create,      acc_chunk_delete,    acc_chunk_fetch,
-  acc_chunk_len,         acc_chunk_derefs,    acc_chunk_migration,
-  acc_chunk_num_swapped, acc_chunk_init,      acc_chunk_stats,
-  acc_chunk_new_period,  acc_chunk_fork_file, acc_chunk_fork_parent,
-  acc_chunk_fork_child,  acc_chunk_fork_done};
+  acc_chunk_create,      acc_chunk_delete,      acc_chunk_fetch,
+  acc_chunk_peek,        acc_chunk_len,         acc_chunk_derefs,
+  acc_chunk_migration,   acc_chunk_num_swapped, acc_chunk_init,
+  acc_chunk_stats,       acc_chunk_new_period,  acc_chunk_fork_file,
+  acc_chunk_fork_parent, acc_chunk_fork_child,  acc_chunk_fork_done};
 
 static struct ac_funcs *chunker = NULL;
+
+/*
+ * Shared chunks
+ */
+
+/** Tag bit marking a reference as an index into shared_chunks */
+#define SHARED_CHUNK_FLAG                                                      \
+  ((chunk_reference_t) 1 << (sizeof(chunk_reference_t) * CHAR_BIT - 1))
+#define IsSharedChunk(ref) ((ref) &SHARED_CHUNK_FLAG)
+#define SharedChunkIndex(ref) ((uint32_t)((ref) & ~SHARED_CHUNK_FLAG))
+#define SHARED_CHUNK_NONE UINT32_MAX
+#define SHARED_CHUNK_SEED 0x5348415245444348ULL
+
+/** A chunk stored once for every identical value that uses it. */
+struct shared_chunk {
+  chunk_reference_t ref; /**< The underlying chunk */
+  uint32_t hash;         /**< Hash of the chunk's contents */
+  uint32_t len;          /**< Length of the chunk's contents */
+  uint32_t users;        /**< References to this entry; 0 if unused */
+  uint32_t next;         /**< Next entry in the hash bucket or free list */
+  uint32_t stamp;        /**< Last migration batch that included this */
+};
+
+static struct shared_chunk *shared_chunks = NULL;
+static uint32_t shared_size = 0;  /**< Allocated entries */
+static uint32_t shared_top = 0;   /**< Entries ever used */
+static uint32_t shared_free = SHARED_CHUNK_NONE;
+static uint32_t *shared_buckets = NULL;
+static uint32_t shared_nbuckets = 0; /**< Always a power of two */
+static uint32_t shared_count = 0;    /**< Entries in use */
+static uint32_t shared_users = 0;    /**< References to entries in use */
+static unsigned long shared_saved = 0; /**< Bytes not stored thanks to sharing */
+
+static struct shared_chunk *
+shared_chunk_entry(chunk_reference_t reference)
+{
+  uint32_t n = SharedChunkIndex(reference);
+
+  ASSERT(n < shared_top && shared_chunks[n].users);
+  return shared_chunks + n;
+}
+
+/** Resolve a possibly shared reference to a chunk reference. */
+static chunk_reference_t
+shared_chunk_resolve(chunk_reference_t reference)
+{
+  if (IsSharedChunk(reference))
+    return shared_chunk_entry(reference)->ref;
+  else
+    return reference;
+}
+
+static void
+shared_chunk_rehash(void)
+{
+  uint32_t n, size;
+
+  size = shared_nbuckets ? shared_nbuckets * 2 : 1024;
+  if (shared_buckets)
+    mush_free(shared_buckets, "chunk.shared.buckets");
+  shared_buckets =
+    mush_malloc(size * sizeof *shared_buckets, "chunk.shared.buckets");
+  if (!shared_buckets)
+    mush_panic("Unable to allocate shared chunk table");
+  shared_nbuckets = size;
+  for (n = 0; n < size; n++)
+    shared_buckets[n] = SHARED_CHUNK_NONE;
+  for (n = 0; n < shared_top; n++) {
+    struct shared_chunk *sc = shared_chunks + n;
+    if (sc->users) {
+      sc->next = shared_buckets[sc->hash & (size - 1)];
+      shared_buckets[sc->hash & (size - 1)] = n;
+    }
+  }
+}
+
+static uint32_t
+shared_chunk_alloc(void)
+{
+  uint32_t n;
+
+  if (shared_free != SHARED_CHUNK_NONE) {
+    n = shared_free;
+    shared_free = shared_chunks[n].next;
+    return n;
+  }
+  if (shared_top == shared_size) {
+    uint32_t size = shared_size ? shared_size * 2 : 1024;
+    struct shared_chunk *grown =
+      mush_realloc(shared_chunks, size * sizeof *shared_chunks,
+                   "chunk.shared.entries");
+    if (!grown)
+      mush_panic("Unable to allocate shared chunk table");
+    shared_chunks = grown;
+    shared_size = size;
+  }
+  return shared_top++;
+}
+
+/** Start sharing a chunk.
+ * \param ref the chunk, which now belongs to the shared entry.
+ * \param hash the hash of its contents.
+ * \param len the length of its contents.
+ * \return the shared reference, with one user.
+ */
+static chunk_reference_t
+shared_chunk_add(chunk_reference_t ref, uint32_t hash, uint32_t len)
+{
+  struct shared_chunk *sc;
+  uint32_t n;
+
+  if (shared_count >= shared_nbuckets)
+    shared_chunk_rehash();
+  n = shared_chunk_alloc();
+  sc = shared_chunks + n;
+  sc->ref = ref;
+  sc->hash = hash;
+  sc->len = len;
+  sc->users = 1;
+  sc->stamp = 0;
+  sc->next = shared_buckets[hash & (shared_nbuckets - 1)];
+  shared_buckets[hash & (shared_nbuckets - 1)] = n;
+  shared_count++;
+  shared_users++;
+  return SHARED_CHUNK_FLAG | n;
+}
+
+/** Allocate a chunk that may be shared with identical values.
+ * Behaves like chunk_create(), but if the chunk_dedup option is on
+ * and an identical chunk was already created this way, it is reused
+ * instead. Since chunks can't be changed, sharing is invisible to the
+ * holders of the reference: each one deletes it with chunk_delete()
+ * as usual, and the storage is freed when the last one does.
+ * \param data the data to be stored.
+ * \param len the length of the data to be stored.
+ * \param derefs the deref count to set on a newly created chunk.
+ * \return the chunk reference for retrieving (or deleting) the data.
+ */
+chunk_reference_t
+chunk_create_shared(char const *data, uint32_t len, uint8_t derefs)
+{
+  static char buff[BUFFER_LEN];
+  struct shared_chunk *sc;
+  uint32_t hash, n;
+
+  if (!options.chunk_dedup || len > sizeof buff)
+    return chunker->chunk_create(data, len, derefs);
+
+  hash = city_hash(data, len, SHARED_CHUNK_SEED);
+  if (shared_nbuckets) {
+    for (n = shared_buckets[hash & (shared_nbuckets - 1)];
+         n != SHARED_CHUNK_NONE; n = shared_chunks[n].next) {
+      sc = shared_chunks + n;
+      if (sc->hash == hash && sc->len == len &&
+          chunker->peek(sc->ref, buff, len) == len &&
+          memcmp(buff, data, len) == 0) {
+        sc->users++;
+        shared_users++;
+        shared_saved += len;
+        return SHARED_CHUNK_FLAG | n;
+      }
+    }
+  }
+
+  return shared_chunk_add(chunker->chunk_create(data, len, derefs), hash, len);
+}
+
+/** Get another reference to the data of a chunk, for a copy of whatever
+ * holds it. Since chunks can't be changed, the copy shares the data
+ * instead of getting a new chunk; each reference is deleted with
+ * chunk_delete() as usual. A reference that isn't shared yet is made
+ * into a shared one, so *reference may change.
+ * \param reference pointer to the reference to copy.
+ * \return a reference to the same data.
+ */
+chunk_reference_t
+chunk_share(chunk_reference_t *reference)
+{
+  static char buff[BUFFER_LEN];
+  struct shared_chunk *sc;
+  uint32_t len;
+
+  if (*reference == NULL_CHUNK_REFERENCE)
+    return NULL_CHUNK_REFERENCE;
+  if (!IsSharedChunk(*reference)) {
+    len = chunker->peek(*reference, buff, sizeof buff);
+    if (len > sizeof buff) {
+      /* Too long to hash in buff; make a copy the old way */
+      chunk_reference_t copy;
+      char *data = mush_malloc(len, "chunk.share");
+      chunker->peek(*reference, data, len);
+      copy = chunker->chunk_create(data, len, chunker->derefs(*reference));
+      mush_free(data, "chunk.share");
+      return copy;
+    }
+    *reference = shared_chunk_add(
+      *reference, city_hash(buff, len, SHARED_CHUNK_SEED), len);
+  }
+  sc = shared_chunk_entry(*reference);
+  sc->users++;
+  shared_users++;
+  shared_saved += sc->len;
+  return *reference;
+}
+
+static void
+shared_chunk_delete(chunk_reference_t reference)
+{
+  struct shared_chunk *sc = shared_chunk_entry(reference);
+  uint32_t n = SharedChunkIndex(reference);
+  uint32_t *prev;
+
+  shared_users--;
+  if (--sc->users) {
+    shared_saved -= sc->len;
+    return;
+  }
+
+  chunker->chunk_delete(sc->ref);
+  for (prev = &shared_buckets[sc->hash & (shared_nbuckets - 1)]; *prev != n;
+       prev = &shared_chunks[*prev].next)
+    ;
+  *prev = sc->next;
+  sc->ref = NULL_CHUNK_REFERENCE;
+  sc->next = shared_free;
+  shared_free = n;
+  shared_count--;
+}
+
+/** Point a migration batch at the underlying chunks of shared references.
+ * Each shared chunk is included at most once, however many of its users
+ * are in the batch.
+ * \return the new number of references in the batch.
+ */
+static int
+shared_chunk_migration(int count, chunk_reference_t **references)
+{
+  static uint32_t stamp = 0;
+  int from, to;
+
+  if (++stamp == 0)
+    stamp = 1;
+  for (from = to = 0; from < count; from++) {
+    if (IsSharedChunk(*references[from])) {
+      struct shared_chunk *sc = shared_chunk_entry(*references[from]);
+      if (sc->stamp == stamp)
+        continue;
+      sc->stamp = stamp;
+      references[to++] = &sc->ref;
+    } else
+      references[to++] = references[from];
+  }
+  return to;
+}
+
+/** Report how much sharing chunks saves.
+ * \param player the player to display it to, or NOTHING to log it.
+ */
+static void
+shared_chunk_stats(dbref player)
+{
+  STAT_OUT(player,
+           "Shared:    %10u values   (%10u references, %10lu bytes saved)",
+           shared_count, shared_users, shared_saved);
+}
 /*
  * Interface routines
  */
@@ -2809,7 +3099,10 @@ chunk_create(char const *data, uint32_t len, uint8_t derefs)
 void
 chunk_delete(chunk_reference_t reference)
 {
-  chunker->chunk_delete(reference);
+  if (IsSharedChunk(reference))
+    shared_chunk_delete(reference);
+  else
+    chunker->chunk_delete(reference);
 }
 
 /** Fetch a chunk of data.
@@ -2825,7 +3118,7 @@ chunk_delete(chunk_reference_t reference)
 uint32_t
 chunk_fetch(chunk_reference_t reference, char *buffer, uint32_t buffer_len)
 {
-  return chunker->fetch(reference, buffer, buffer_len);
+  return chunker->fetch(shared_chunk_resolve(reference), buffer, buffer_len);
 }
 
 /** Get the length of a chunk.
@@ -2838,7 +3131,7 @@ chunk_fetch(chunk_reference_t reference, char *buffer, uint32_t buffer_len)
 uint32_t
 chunk_len(chunk_reference_t reference)
 {
-  return chunker->len(reference);
+  return chunker->len(shared_chunk_resolve(reference));
 }
 
 /** Get the deref count of a chunk.
@@ -2850,18 +3143,21 @@ chunk_len(chunk_reference_t reference)
 uint8_t
 chunk_derefs(chunk_reference_t reference)
 {
-  return chunker->derefs(reference);
+  return chunker->derefs(shared_chunk_resolve(reference));
 }
 
 /** Migrate allocated chunks around.
  *
  * \param count the number of chunks to move.
  * \param references an array of pointers to chunk references,
- * which will be updated in place if necessary.
+ * which will be updated in place if necessary. The array itself
+ * may be rearranged.
  */
 void
 chunk_migration(int count, chunk_reference_t **references)
 {
+  if (shared_count)
+    count = shared_chunk_migration(count, references);
   chunker->migration(count, references);
 }
 
@@ -2901,6 +3197,8 @@ void
 chunk_stats(dbref player, enum chunk_stats_type which)
 {
   chunker->stats(player, which);
+  if (which == CSTATS_SUMMARY)
+    shared_chunk_stats(player);
 }
 
 /** Start a new migration period.
@@ -640,6 +640,14 @@ COMMAND(cmd_grep)
   int flags = 0;
   int print = 0;
 
+  if (SW_ISSET(sw, SWITCH_STATUS)) {
+    do_grep_status(executor);
+    return;
+  } else if (SW_ISSET(sw, SWITCH_OFF)) {
+    do_grep_stop(executor);
+    return;
+  }
+
   if (SW_ISSET(sw, SWITCH_IPRINT) || SW_ISSET(sw, SWITCH_ILIST) ||
       SW_ISSET(sw, SWITCH_NOCASE))
     flags |= GREP_NOCASE;
@@ -655,7 +663,10 @@ COMMAND(cmd_grep)
   if (SW_ISSET(sw, SWITCH_IPRINT) || SW_ISSET(sw, SWITCH_PRINT))
     print = 1;
 
-  do_grep(executor, arg_left, arg_right, print, flags);
+  if (SW_ISSET(sw, SWITCH_ALL))
+    do_grep_all(executor, arg_left, arg_right, flags);
+  else
+    do_grep(executor, arg_left, arg_right, print, flags);
 }
 
 COMMAND(cmd_halt)
@@ -170,8 +170,9 @@ COMLIST commands[] = {
    "ALIAS BUILTIN CLONE DELETE ENABLE DISABLE PRESERVE RESTORE RESTRICT",
    cmd_function, CMD_T_ANY | CMD_T_EQSPLIT | CMD_T_RS_ARGS | CMD_T_NOGAGGED, 0,
    0},
-  {"@GREP", "LIST PRINT ILIST IPRINT REGEXP WILD NOCASE PARENT", cmd_grep,
-   CMD_T_ANY | CMD_T_EQSPLIT | CMD_T_RS_NOPARSE | CMD_T_NOGAGGED, 0, 0},
+  {"@GREP", "LIST PRINT ILIST IPRINT REGEXP WILD NOCASE PARENT ALL STATUS OFF",
+   cmd_grep, CMD_T_ANY | CMD_T_EQSPLIT | CMD_T_RS_NOPARSE | CMD_T_NOGAGGED, 0,
+   0},
   {"@HALT", "ALL NOEVAL PID", cmd_halt,
    CMD_T_ANY | CMD_T_EQSPLIT | CMD_T_RS_BRACE, 0, 0},
   {"@HIDE", "NO OFF YES ON", cmd_hide, CMD_T_ANY, 0, 0},
@@ -0,0 +1,740 @@
+/**
+ * \file comp_dict.c
+ *
+ * \brief Trained dictionary compression.
+ *
+ * Softcode repeats the same fragments over and over: "[switch(", "%q<",
+ * "u(#123/" and so on. This method trains a dictionary of up to 65280
+ * common phrases from a sample of the attribute text in the database
+ * when the game starts, and replaces each use of one with a two or three
+ * byte code. Repeats within a single string are replaced with a copy of
+ * the earlier text, as in LZ77.
+ *
+ * Compressed strings never contain a nul. Each byte is either a literal
+ * or starts one of these codes:
+ *
+ *   DICT_ESCAPE c   the literal byte c, when c is one of the code bytes.
+ *   DICT_SHORT i    phrase i - 1, for i from 1 to 255.
+ *   DICT_LONG h l   phrase 255 + (h - 1) * 255 + (l - 1).
+ *   DICT_COPY d n   n + DICT_COPY_MIN - 1 bytes, starting d bytes back.
+ *
+ * Training finds the substrings of the sample that repeat most often,
+ * using a suffix array limited to DICT_MAX_PHRASE bytes, and keeps the
+ * ones that save the most space, up to DICT_MAX_TEXT bytes of phrases.
+ * Only phrases that can't be made longer without losing occurrences are
+ * kept, so the dictionary isn't filled with every prefix of a popular
+ * phrase.
+ *
+ * The trained dictionary is saved to the compression_dictionary file,
+ * and later starts load it from there instead of training a new one.
+ * Remove the file to retrain. Compressed text never outlives the
+ * process, so changing the dictionary doesn't need anything converted.
+ */
+
+#include "tests.h"
+
+#define DICT_ESCAPE 0x01 /**< Escapes a literal code byte */
+#define DICT_SHORT 0x04  /**< One byte phrase index */
+#define DICT_LONG 0x05   /**< Two byte phrase index */
+#define DICT_COPY 0x06   /**< Copy of earlier text */
+
+#define DICT_MIN_PHRASE 3  /**< Shortest phrase in the dictionary */
+#define DICT_MAX_PHRASE 32 /**< Longest phrase in the dictionary */
+#define DICT_SHORT_CODES 255
+#define DICT_MAX_PHRASES (DICT_SHORT_CODES + 255 * 255)
+#define DICT_COPY_MIN 4 /**< Shortest copy worth making */
+#define DICT_COPY_MAX (DICT_COPY_MIN + 254)
+#define DICT_WINDOW 255                /**< Farthest back a copy can start */
+#define DICT_COPY_HASH 1024            /**< Size of the copy finder's table */
+#define DICT_SAMPLE_SIZE (1024 * 1024) /**< Attribute text to train on */
+#define DICT_MAX_TEXT (128 * 1024)     /**< Most phrase text to keep */
+#define DICT_MAGIC "PennMUSH attribute dictionary 1\n"
+
+/** A phrase dictionary, and an index for finding phrases in text */
+struct dictionary {
+  uint32_t count;    /**< Number of phrases */
+  uint32_t *offsets; /**< Start of each phrase in text, and the end */
+  char *text;        /**< The phrases, one after another */
+  uint32_t *slots;   /**< Hash table of phrase number + 1 */
+  uint32_t mask;     /**< Size of slots - 1 */
+  uint32_t *lens;    /**< Phrase lengths by first two bytes, as bits */
+};
+
+static struct dictionary attr_dict;
+
+#define DictPhrase(d, n) ((d)->text + (d)->offsets[n])
+#define DictLen(d, n) ((d)->offsets[(n) + 1] - (d)->offsets[n])
+#define DictKey(s) ((((uint8_t) (s)[0]) << 8) | (uint8_t) (s)[1])
+
+static void
+dict_free(struct dictionary *d)
+{
+  if (d->offsets)
+    mush_free(d->offsets, "dict.offsets");
+  if (d->text)
+    mush_free(d->text, "dict.text");
+  if (d->slots)
+    mush_free(d->slots, "dict.slots");
+  if (d->lens)
+    mush_free(d->lens, "dict.lens");
+  memset(d, 0, sizeof *d);
+}
+
+static uint32_t
+dict_hash(const char *s, int len)
+{
+  return city_hash(s, len, 0x44494354);
+}
+
+/** Find a phrase in the dictionary.
+ * \return the phrase number, or -1.
+ */
+static int32_t
+dict_lookup(const struct dictionary *d, const char *s, uint32_t len)
+{
+  uint32_t i;
+
+  for (i = dict_hash(s, len) & d->mask; d->slots[i]; i = (i + 1) & d->mask) {
+    uint32_t n = d->slots[i] - 1;
+    if (DictLen(d, n) == len && memcmp(DictPhrase(d, n), s, len) == 0)
+      return n;
+  }
+  return -1;
+}
+
+/** Build the index used to find phrases while compressing. */
+static void
+dict_index(struct dictionary *d)
+{
+  uint32_t n, size;
+
+  for (size = 64; size < d->count * 2; size *= 2)
+    ;
+  d->mask = size - 1;
+  d->slots = mush_calloc(size, sizeof *d->slots, "dict.slots");
+  d->lens = mush_calloc(65536, sizeof *d->lens, "dict.lens");
+  if (!d->slots || !d->lens)
+    mush_panic("Out of memory in dictionary compression");
+
+  for (n = 0; n < d->count; n++) {
+    uint32_t len = DictLen(d, n);
+    uint32_t i = dict_hash(DictPhrase(d, n), len) & d->mask;
+    while (d->slots[i])
+      i = (i + 1) & d->mask;
+    d->slots[i] = n + 1;
+    d->lens[DictKey(DictPhrase(d, n))] |= 1U << (len - DICT_MIN_PHRASE);
+  }
+}
+
+/** Compress a string with a dictionary.
+ * \param d the dictionary.
+ * \param s the string to compress.
+ * \return a newly allocated compressed string.
+ */
+static char *
+dict_compress(const struct dictionary *d, const char *s)
+{
+  int32_t recent[DICT_COPY_HASH];
+  uint32_t len = strlen(s), pos = 0, inserted = 0;
+  uint8_t *buf, *b;
+
+  b = buf = malloc(len * 2 + 1);
+  if (!buf)
+    return NULL;
+  memset(recent, 0xFF, sizeof recent);
+
+  while (pos < len) {
+    const char *p = s + pos;
+    uint32_t left = len - pos;
+    uint32_t best = 0, best_len = 0, copy_from = 0;
+    int32_t phrase = -1;
+
+    /* Longest dictionary phrase starting here */
+    if (d->count && left >= DICT_MIN_PHRASE) {
+      uint32_t bits = d->lens[DictKey(p)];
+      uint32_t l = left < DICT_MAX_PHRASE ? left : DICT_MAX_PHRASE;
+      for (; bits && l >= DICT_MIN_PHRASE; l--) {
+        if (bits & (1U << (l - DICT_MIN_PHRASE))) {
+          phrase = dict_lookup(d, p, l);
+          if (phrase >= 0) {
+            best_len = l;
+            best = l - (phrase < DICT_SHORT_CODES ? 2 : 3);
+            break;
+          }
+        }
+      }
+    }
+
+    /* Longest copy of recent text starting here */
+    if (left >= DICT_COPY_MIN) {
+      uint32_t h = dict_hash(p, DICT_COPY_MIN) & (DICT_COPY_HASH - 1);
+      int32_t from = recent[h];
+      if (from >= 0 && pos - from <= DICT_WINDOW) {
+        uint32_t l = 0;
+        while (l < left && l < DICT_COPY_MAX && s[from + l] == p[l])
+          l++;
+        if (l >= DICT_COPY_MIN && l - 3 > best) {
+          best = l - 3;
+          best_len = l;
+          copy_from = from;
+          phrase = -2;
+        }
+      }
+    }
+
+    if (!best) {
+      uint8_t c = *p;
+      if (c == DICT_ESCAPE || c == DICT_SHORT || c == DICT_LONG ||
+          c == DICT_COPY)
+        *b++ = DICT_ESCAPE;
+      *b++ = c;
+      best_len = 1;
+    } else if (phrase == -2) {
+      *b++ = DICT_COPY;
+      *b++ = pos - copy_from;
+      *b++ = best_len - DICT_COPY_MIN + 1;
+    } else if (phrase < DICT_SHORT_CODES) {
+      *b++ = DICT_SHORT;
+      *b++ = phrase + 1;
+    } else {
+      phrase -= DICT_SHORT_CODES;
+      *b++ = DICT_LONG;
+      *b++ = phrase / 255 + 1;
+      *b++ = phrase % 255 + 1;
+    }
+
+    /* Remember where everything we just consumed started */
+    pos += best_len;
+    for (; inserted < pos && inserted + DICT_COPY_MIN <= len; inserted++)
+      recent[dict_hash(s + inserted, DICT_COPY_MIN) & (DICT_COPY_HASH - 1)] =
+        inserted;
+  }
+  *b = '\0';
+  return (char *) buf;
+}
+
+/** Uncompress a string compressed with a dictionary.
+ * \param d the dictionary it was compressed with.
+ * \param s the compressed string.
+ * \param buf a buffer of at least BUFFER_LEN bytes.
+ * \return buf, containing the uncompressed string.
+ */
+static char *
+dict_uncompress(const struct dictionary *d, const char *s, char *buf)
+{
+  const uint8_t *p = (const uint8_t *) s;
+  char *b = buf, *end = buf + BUFFER_LEN - 1;
+  uint32_t n, len;
+
+  while (*p && b < end) {
+    switch (*p) {
+    case DICT_ESCAPE:
+      *b++ = p[1];
+      p += 2;
+      break;
+    case DICT_SHORT:
+    case DICT_LONG:
+      if (*p == DICT_SHORT) {
+        n = p[1] - 1;
+        p += 2;
+      } else {
+        n = DICT_SHORT_CODES + (p[1] - 1) * 255 + (p[2] - 1);
+        p += 3;
+      }
+      len = DictLen(d, n);
+      if (len > (uint32_t) (end - b))
+        len = end - b;
+      memcpy(b, DictPhrase(d, n), len);
+      b += len;
+      break;
+    case DICT_COPY:
+      n = p[1];
+      len = p[2] + DICT_COPY_MIN - 1;
+      p += 3;
+      /* The copy can overlap what it's producing, so go byte by byte */
+      for (; len && b < end; len--, b++)
+        *b = b[-(ptrdiff_t) n];
+      break;
+    default:
+      *b++ = *p++;
+    }
+  }
+  *b = '\0';
+  return buf;
+}
+
+/* Training */
+
+/** A repeated substring of the training sample */
+struct dict_candidate {
+  uint32_t pos;   /**< Where it first appears in the sample */
+  uint32_t len;   /**< Its length */
+  uint32_t count; /**< How many times it appears */
+  uint64_t score; /**< Bytes saved by putting it in the dictionary */
+};
+
+static const char *dict_sample;
+static uint32_t dict_sample_len;
+
+/** Compare suffixes of the training sample, up to DICT_MAX_PHRASE bytes */
+static int
+dict_suffix_cmp(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+  uint32_t lx = dict_sample_len - x, ly = dict_sample_len - y;
+  uint32_t l = lx < ly ? lx : ly;
+  int r;
+
+  if (l > DICT_MAX_PHRASE)
+    l = DICT_MAX_PHRASE;
+  r = memcmp(dict_sample + x, dict_sample + y, l);
+  if (r == 0 && l < DICT_MAX_PHRASE)
+    return lx < ly ? -1 : (lx > ly);
+  return r;
+}
+
+static int
+dict_count_cmp(const void *a, const void *b)
+{
+  const struct dict_candidate *x = a, *y = b;
+
+  if (x->count != y->count)
+    return x->count < y->count ? 1 : -1;
+  return x->pos < y->pos ? -1 : (x->pos > y->pos);
+}
+
+/** Sort phrase candidates by how much space they save, best first */
+static int
+dict_score_cmp(const void *a, const void *b)
+{
+  const struct dict_candidate *x = a, *y = b;
+
+  if (x->score != y->score)
+    return x->score < y->score ? 1 : -1;
+  return x->pos < y->pos ? -1 : (x->pos > y->pos);
+}
+
+/** Keep the best candidates in a min-heap ordered by score */
+static void
+dict_heap_push(struct dict_candidate *heap, uint32_t *size,
+               struct dict_candidate *c)
+{
+  uint32_t i;
+
+  if (*size == DICT_MAX_PHRASES) {
+    if (c->score <= heap[0].score)
+      return;
+    /* Replace the smallest, and sift it down */
+    i = 0;
+    for (;;) {
+      uint32_t child = i * 2 + 1;
+      if (child >= *size)
+        break;
+      if (child + 1 < *size && heap[child + 1].score < heap[child].score)
+        child++;
+      if (heap[child].score >= c->score)
+        break;
+      heap[i] = heap[child];
+      i = child;
+    }
+    heap[i] = *c;
+    return;
+  }
+  for (i = (*size)++; i > 0 && heap[(i - 1) / 2].score > c->score;
+       i = (i - 1) / 2)
+    heap[i] = heap[(i - 1) / 2];
+  heap[i] = *c;
+}
+
+/** Train a dictionary.
+ * \param d the dictionary to fill in.
+ * \param sample nul-separated strings to train on.
+ * \param len the length of the sample.
+ */
+static void
+dict_train(struct dictionary *d, const char *sample, uint32_t len)
+{
+  uint32_t *sa, *lcp, *nul;
+  struct dict_candidate *heap, c;
+  uint32_t n, i, l, size = 0, total = 0;
+
+  memset(d, 0, sizeof *d);
+  if (len < DICT_MIN_PHRASE) {
+    dict_index(d);
+    return;
+  }
+
+  /* Sort every suffix by its first DICT_MAX_PHRASE bytes */
+  sa = mush_calloc(len, sizeof *sa, "dict.train");
+  lcp = mush_calloc(len + 1, sizeof *lcp, "dict.train");
+  nul = mush_calloc(len, sizeof *nul, "dict.train");
+  heap = mush_calloc(DICT_MAX_PHRASES, sizeof *heap, "dict.train");
+  if (!sa || !lcp || !nul || !heap)
+    mush_panic("Out of memory training compression dictionary");
+  for (n = 0; n < len; n++)
+    sa[n] = n;
+  dict_sample = sample;
+  dict_sample_len = len;
+  qsort(sa, len, sizeof *sa, dict_suffix_cmp);
+
+  /* How far from each position to the end of its string */
+  for (n = len, l = 0; n-- > 0;) {
+    l = sample[n] ? l + 1 : 0;
+    nul[n] = l;
+  }
+
+  /* lcp[i] is the common prefix of suffixes i - 1 and i */
+  for (i = 1; i < len; i++) {
+    const char *x = sample + sa[i - 1], *y = sample + sa[i];
+    uint32_t max = nul[sa[i - 1]] < nul[sa[i]] ? nul[sa[i - 1]] : nul[sa[i]];
+    if (max > DICT_MAX_PHRASE)
+      max = DICT_MAX_PHRASE;
+    for (l = 0; l < max && x[l] == y[l]; l++)
+      ;
+    lcp[i] = l;
+  }
+
+  /* Each run of suffixes sharing at least l bytes is a substring that
+   * appears once per suffix in the run. Skip it if every suffix in the
+   * run also shares l + 1 bytes, since the longer substring is as
+   * common. */
+  for (l = DICT_MIN_PHRASE; l <= DICT_MAX_PHRASE; l++) {
+    uint32_t start = 0, least = DICT_MAX_PHRASE + 1;
+    for (i = 1; i <= len; i++) {
+      if (i < len && lcp[i] >= l) {
+        if (lcp[i] < least)
+          least = lcp[i];
+        continue;
+      }
+      if (i - start >= 2 && (least == l || l == DICT_MAX_PHRASE)) {
+        c.pos = sa[start];
+        c.len = l;
+        c.count = i - start;
+        c.score = (uint64_t) c.count * (l - 2);
+        dict_heap_push(heap, &size, &c);
+      }
+      start = i;
+      least = DICT_MAX_PHRASE + 1;
+    }
+  }
+
+  /* Keep the dictionary small next to the text it compresses, so it
+   * learns what is common instead of memorizing the sample. */
+  qsort(heap, size, sizeof *heap, dict_score_cmp);
+  for (n = 0; n < size && total + heap[n].len <= DICT_MAX_TEXT; n++)
+    total += heap[n].len;
+  size = n;
+
+  /* The most common phrases get the short codes */
+  qsort(heap, size, sizeof *heap, dict_count_cmp);
+  d->count = size;
+  d->offsets = mush_calloc(size + 1, sizeof *d->offsets, "dict.offsets");
+  d->text = mush_malloc(total ? total : 1, "dict.text");
+  if (!d->offsets || !d->text)
+    mush_panic("Out of memory training compression dictionary");
+  for (n = 0, total = 0; n < size; n++) {
+    d->offsets[n] = total;
+    memcpy(d->text + total, sample + heap[n].pos, heap[n].len);
+    total += heap[n].len;
+  }
+  d->offsets[size] = total;
+
+  mush_free(sa, "dict.train");
+  mush_free(lcp, "dict.train");
+  mush_free(nul, "dict.train");
+  mush_free(heap, "dict.train");
+  dict_index(d);
+}
+
+/** Collect attribute text from a database to train on.
+ * \param f the database file.
+ * \param len set to the length of the sample.
+ * \return a newly allocated sample of nul-separated strings.
+ */
+static char *
+dict_read_sample(PENNFILE *f, uint32_t *len)
+{
+  static const char marker[] = "value \"";
+  char line[BUFFER_LEN * 2];
+  char *sample, *s;
+  uint32_t used = 0;
+
+  sample = mush_malloc(DICT_SAMPLE_SIZE, "dict.sample");
+  if (!sample)
+    mush_panic("Out of memory training compression dictionary");
+  while (used < DICT_SAMPLE_SIZE - 1 && penn_fgets(line, sizeof line, f)) {
+    for (s = line; *s == ' '; s++)
+      ;
+    if (strncmp(s, marker, sizeof marker - 1))
+      continue;
+    for (s += sizeof marker - 1; *s && used < DICT_SAMPLE_SIZE - 1; s++) {
+      if (*s == '\\' && s[1])
+        s++;
+      else if (*s == '"' || *s == '\n' || *s == '\r')
+        break;
+      sample[used++] = *s;
+    }
+    sample[used++] = '\0';
+  }
+  *len = used;
+  return sample;
+}
+
+static bool
+dict_load(struct dictionary *d, const char *file)
+{
+  FILE *fp;
+  char magic[sizeof DICT_MAGIC], line[32], *end;
+  unsigned long count;
+  uint32_t n, total = 0;
+  bool ok = false;
+
+  memset(d, 0, sizeof *d);
+  fp = fopen(file, "rb");
+  if (!fp)
+    return false;
+  if (fread(magic, 1, sizeof DICT_MAGIC - 1, fp) != sizeof DICT_MAGIC - 1 ||
+      memcmp(magic, DICT_MAGIC, sizeof DICT_MAGIC - 1) ||
+      !fgets(line, sizeof line, fp))
+    goto done;
+  /* Not fscanf(), which would skip a first phrase length that happens
+   * to be a whitespace character along with the newline. */
+  count = strtoul(line, &end, 10);
+  if (end == line || *end != '\n' || count > DICT_MAX_PHRASES)
+    goto done;
+
+  d->offsets = mush_calloc(count + 1, sizeof *d->offsets, "dict.offsets");
+  d->text = mush_malloc(count * DICT_MAX_PHRASE + 1, "dict.text");
+  if (!d->offsets || !d->text)
+    goto done;
+  for (n = 0; n < count; n++) {
+    int len = getc(fp);
+    if (len < DICT_MIN_PHRASE || len > DICT_MAX_PHRASE ||
+        fread(d->text + total, 1, len, fp) != (size_t) len)
+      goto done;
+    d->offsets[n] = total;
+    total += len;
+  }
+  d->offsets[count] = total;
+  d->count = count;
+  dict_index(d);
+  ok = true;
+
+done:
+  fclose(fp);
+  if (!ok) {
+    dict_free(d);
+    do_rawlog(LT_ERR, "Ignoring invalid compression dictionary %s", file);
+  }
+  return ok;
+}
+
+static void
+dict_save(const struct dictionary *d, const char *file)
+{
+  FILE *fp;
+  uint32_t n;
+
+  fp = fopen(file, "wb");
+  if (!fp) {
+    do_rawlog(LT_ERR, "Unable to save compression dictionary %s: %s", file,
+              strerror(errno));
+    return;
+  }
+  fputs(DICT_MAGIC, fp);
+  fprintf(fp, "%u\n", d->count);
+  for (n = 0; n < d->count; n++) {
+    putc(DictLen(d, n), fp);
+    fwrite(DictPhrase(d, n), 1, DictLen(d, n), fp);
+  }
+  if (fclose(fp) != 0)
+    do_rawlog(LT_ERR, "Unable to save compression dictionary %s: %s", file,
+              strerror(errno));
+}
+
+static bool
+dict_init_compress(PENNFILE *f)
+{
+  dict_free(&attr_dict);
+
+  if (*options.compression_dictionary &&
+      dict_load(&attr_dict, options.compression_dictionary)) {
+    do_rawlog(LT_ERR, "Loaded %u phrase compression dictionary from %s",
+              attr_dict.count, options.compression_dictionary);
+    return 1;
+  }
+
+  if (f) {
+    uint32_t len;
+    char *sample = dict_read_sample(f, &len);
+    dict_train(&attr_dict, sample, len);
+    mush_free(sample, "dict.sample");
+    do_rawlog(LT_ERR, "Trained %u phrase compression dictionary",
+              attr_dict.count);
+    if (attr_dict.count && *options.compression_dictionary)
+      dict_save(&attr_dict, options.compression_dictionary);
+  } else
+    dict_train(&attr_dict, "", 0);
+  return 1;
+}
+
+static char *
+dict_text_compress(char const *s)
+{
+  return dict_compress(&attr_dict, s);
+}
+
+static char *
+dict_text_uncompress_r(char const *s, char *buf)
+{
+  return dict_uncompress(&attr_dict, s, buf);
+}
+
+static char *
+dict_text_uncompress(char const *s)
+{
+  static char buf[BUFFER_LEN];
+  return dict_uncompress(&attr_dict, s, buf);
+}
+
+struct compression_ops dictionary_ops = {dict_init_compress, dict_text_compress,
+                                         dict_text_uncompress,
+                                         dict_text_uncompress_r};
+
+TEST_GROUP(dict_compress)
+{
+  static const char *samples[] = {
+    "$+who:@pemit %#=[switch(%0,*foo*,u(#123/FN_FOO,%0),u(#123/FN_BAR))]",
+    "$+where:@pemit %#=[switch(%1,*bar*,u(#123/FN_BAR,%1),u(#123/FN_FOO))]",
+    "&FN_FOO #123=[setq(0,%0)][iter(%q0,name(##),%b,%r)]",
+    "&FN_BAR #123=[setq(1,%1)][iter(%q1,name(##),%b,%r)]",
+    "A plain description of a plain room, plainly described.",
+    "Escapes: \x01\x04\x05\x06 \xC3\xA9 done"};
+  struct dictionary d;
+  char sample[BUFFER_LEN * 4], out[BUFFER_LEN], long_text[BUFFER_LEN];
+  char *p = sample, *c;
+  uint32_t n, plain = 0, packed = 0;
+  bool ok = true;
+
+  for (n = 0; n < sizeof samples / sizeof samples[0]; n++) {
+    strcpy(p, samples[n]);
+    p += strlen(samples[n]) + 1;
+  }
+  dict_train(&d, sample, p - sample);
+  TEST("dict_compress.1", d.count > 0);
+
+  for (n = 0; n < sizeof samples / sizeof samples[0]; n++) {
+    c = dict_compress(&d, samples[n]);
+    ok = ok && strcmp(dict_uncompress(&d, c, out), samples[n]) == 0;
+    plain += strlen(samples[n]);
+    packed += strlen(c);
+    free(c);
+  }
+  TEST("dict_compress.2", ok);
+  TEST("dict_compress.3", packed < plain);
+
+  /* Copies that overlap what they produce */
+  memset(long_text, 'x', BUFFER_LEN - 1);
+  long_text[BUFFER_LEN - 1] = '\0';
+  c = dict_compress(&d, long_text);
+  TEST("dict_compress.4", strlen(c) < 200);
+  TEST("dict_compress.5", strcmp(dict_uncompress(&d, c, out), long_text) == 0);
+  free(c);
+
+  c = dict_compress(&d, "");
+  TEST("dict_compress.6", c && !*c && !*dict_uncompress(&d, c, out));
+  free(c);
+
+  dict_free(&d);
+  dict_train(&d, "", 0);
+  c = dict_compress(&d, samples[0]);
+  TEST("dict_compress.7",
+       strcmp(dict_uncompress(&d, c, out), samples[0]) == 0);
+  free(c);
+  dict_free(&d);
+
+  /* Phrase lengths that are whitespace characters survive a reload */
+  d.count = 2;
+  d.offsets = mush_calloc(3, sizeof *d.offsets, "dict.offsets");
+  d.text = mush_malloc(9 + DICT_MAX_PHRASE + 1, "dict.text");
+  strcpy(d.text, "\tnine is ");
+  memset(d.text + 9, ' ', DICT_MAX_PHRASE);
+  d.offsets[1] = 9;
+  d.offsets[2] = 9 + DICT_MAX_PHRASE;
+  dict_save(&d, "dicttestdata");
+  dict_free(&d);
+  TEST("dict_compress.8", dict_load(&d, "dicttestdata") && d.count == 2 &&
+                            DictLen(&d, 0) == 9 &&
+                            DictLen(&d, 1) == DICT_MAX_PHRASE &&
+                            memcmp(DictPhrase(&d, 0), "\tnine is ", 9) == 0);
+  remove("dicttestdata");
+  dict_free(&d);
+}
+
+TEST_GROUP(dict_benchmark)
+{
+  /* Compare against whatever attr_compression is in use, on the
+   * attributes of the loaded database. The dictionary is trained on
+   * every other attribute, so half of them are text it hasn't seen. */
+  char *sample, *train, *s, **packed, **packed_dict;
+  char out[BUFFER_LEN];
+  uint32_t used = 0, train_used = 0, count = 0, n, plain = 0, size = 0,
+           size_dict = 0;
+  struct dictionary d;
+  ATTR *a;
+  dbref thing;
+  bool ok = true;
+
+  sample = mush_malloc(DICT_SAMPLE_SIZE, "dict.sample");
+  train = mush_malloc(DICT_SAMPLE_SIZE, "dict.sample");
+  for (thing = 0; thing < db_top; thing++) {
+    ATTR_FOR_EACH (thing, a) {
+      s = atr_value(a);
+      n = strlen(s) + 1;
+      if (used + n > DICT_SAMPLE_SIZE)
+        break;
+      memcpy(sample + used, s, n);
+      used += n;
+      if (count++ % 2 == 0) {
+        memcpy(train + train_used, s, n);
+        train_used += n;
+      }
+    }
+  }
+  dict_train(&d, train, train_used);
+  mush_free(train, "dict.sample");
+
+  packed = mush_calloc(count + 1, sizeof *packed, "dict.bench");
+  packed_dict = mush_calloc(count + 1, sizeof *packed_dict, "dict.bench");
+  for (n = 0, s = sample; n < count; n++, s += strlen(s) + 1) {
+    packed[n] = text_compress(s);
+    packed_dict[n] = dict_compress(&d, s);
+    plain += strlen(s) + 1;
+    size += strlen(packed[n]) + 1;
+    size_dict += strlen(packed_dict[n]) + 1;
+  }
+  do_rawlog(LT_TRACE,
+            "BENCHMARK compression of %u attributes, %u bytes: %s %u bytes, "
+            "dictionary %u bytes.",
+            count, plain, options.attr_compression, size, size_dict);
+
+  BENCHMARK("uncompress (attr_compression)", 100, {
+    for (n = 0; n < count; n++)
+      text_uncompress_r(packed[n], out);
+  });
+  BENCHMARK("uncompress (dictionary)", 100, {
+    for (n = 0; n < count; n++)
+      dict_uncompress(&d, packed_dict[n], out);
+  });
+
+  for (n = 0, s = sample; n < count; n++, s += strlen(s) + 1) {
+    ok = ok && strcmp(dict_uncompress(&d, packed_dict[n], out), s) == 0;
+    free(packed[n]);
+    free(packed_dict[n]);
+  }
+  TEST("dict_benchmark.1", ok);
+  mush_free(packed, "dict.bench");
+  mush_free(packed_dict, "dict.bench");
+  mush_free(sample, "dict.sample");
+  dict_free(&d);
+}
@@ -124,7 +124,7 @@ do { \
   if (!node->left && !node->right) { \
     /* Got a char */ \
     *b++ = node->c; \
-    if (!*p || ((long)(b - buf) >= (long)(sizeof(buf) - 1))) { \
+    if (!*p || ((long)(b - buf) >= (long)(BUFFER_LEN - 1))) { \
       *b++ = EOS; \
       return buf; \
     } \
@@ -134,29 +134,22 @@ do { \
   } \
 } while (0)
 
-/** Huffman uncompress a string.
+/** Huffman uncompress a string into a caller-supplied buffer.
  * Uncompression is a snap, too. Go bit by bit, using the
  * bits to traverse the binary tree (0=left, 1=right) until reaching
  * a leaf node, which is the uncompressed character.
  * Stop when the leaf node turns out to be EOS.
  *
- * To avoid generating memory problems, this function should be
- * used with something of the format
- * \verbatim
- * char tbuf1[BUFFER_LEN];
- * strcpy(tbuf1, text_uncompress(a->value));
- * \endverbatim
- * if you are using something of type char *buff, use the
- * safe_uncompress function instead.
+ * This only reads the tree built at startup, so it may be called from
+ * threads other than the main one.
  *
  * \param s a compressed string.
- * \return a pointer to a static buffer containing the uncompressed string.
+ * \param buf a buffer of at least BUFFER_LEN bytes.
+ * \return buf, containing the uncompressed string.
  */
 static char *
-huff_text_uncompress(const char *s)
+huff_text_uncompress_r(const char *s, char *buf)
 {
-
-  static char buf[BUFFER_LEN];
   const char *p;
   char *b;
   CNode *node;
@@ -181,6 +174,28 @@ huff_text_uncompress(const char *s)
   }
 }
 
+/** Huffman uncompress a string.
+ *
+ * To avoid generating memory problems, this function should be
+ * used with something of the format
+ * \verbatim
+ * char tbuf1[BUFFER_LEN];
+ * strcpy(tbuf1, text_uncompress(a->value));
+ * \endverbatim
+ * if you are using something of type char *buff, use the
+ * safe_uncompress function instead.
+ *
+ * \param s a compressed string.
+ * \return a pointer to a static buffer containing the uncompressed string.
+ */
+static char *
+huff_text_uncompress(const char *s)
+{
+  static char buf[BUFFER_LEN];
+
+  return huff_text_uncompress_r(s, buf);
+}
+
 static int
 fix_tree_depth(CNode *node, int height, int zeros)
 {
@@ -518,7 +533,8 @@ huff_init_compress(PENNFILE *f)
 struct compression_ops huffman_ops = {
   huff_init_compress,
   huff_text_compress,
-  huff_text_uncompress
+  huff_text_uncompress,
+  huff_text_uncompress_r
 };
 
 #ifdef STANDALONE
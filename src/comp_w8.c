@@ -268,26 +268,21 @@ word_text_compress(char const *s)
   return strdup(buf);
 } /* end of compress; */
 
-/** Word-uncompress a string.
- * To avoid generating memory problems, this function should be
- * used with something of the format
- * \verbatim
- * char tbuf1[BUFFER_LEN];
- * strcpy(tbuf1, text_uncompress(a->value));
- * \endverbatim
- * if you are using something of type char *buff, use the
- * safe_uncompress function instead.
+/** Word-uncompress a string into a caller-supplied buffer.
+ * Words are only ever added to the table, never changed, so this may be
+ * called from threads other than the main one for strings compressed
+ * before the thread was handed them.
  *
  * \param s a compressed string.
- * \return a pointer to a static buffer containing the uncompressed string.
+ * \param buf a buffer of at least BUFFER_LEN bytes.
+ * \return buf, containing the uncompressed string.
  */
 static char *
-word_text_uncompress(char const *s)
+word_text_uncompress_r(char const *s, char *buf)
 {
-
   const char *p;
+  char *b;
   int i;
-  static char buf[BUFFER_LEN];
 
   buf[0] = '\0';
   if (!s || !*s)
@@ -329,6 +324,27 @@ word_text_uncompress(char const *s)
 
 } /* end of uncompress; */
 
+/** Word-uncompress a string.
+ * To avoid generating memory problems, this function should be
+ * used with something of the format
+ * \verbatim
+ * char tbuf1[BUFFER_LEN];
+ * strcpy(tbuf1, text_uncompress(a->value));
+ * \endverbatim
+ * if you are using something of type char *buff, use the
+ * safe_uncompress function instead.
+ *
+ * \param s a compressed string.
+ * \return a pointer to a static buffer containing the uncompressed string.
+ */
+static char *
+word_text_uncompress(char const *s)
+{
+  static char buf[BUFFER_LEN];
+
+  return word_text_uncompress_r(s, buf);
+}
+
 /** Initialize the word compression.
  * This function clears the words table the first time through.
  * \param f (unused).
@@ -370,4 +386,5 @@ hash_fn(const char *s, int hashtab_mask)
 }
 
 struct compression_ops word_ops = {word_init_compress, word_text_compress,
-                                   word_text_uncompress};
+                                   word_text_uncompress,
+                                   word_text_uncompress_r};
@@ -3,13 +3,15 @@
  *
  * \brief Compression routine wrapper file for PennMUSH.
  *
- * This file does nothing but conditionally include the appropriate
- * attribute compression source code.
+ * This file does nothing but include the attribute compression source
+ * code and pick the method set by attr_compression.
  *
  */
 
 #include "copyrite.h"
 
+#include <errno.h>
+#include <stdio.h>
 #include <time.h>
 #include <string.h>
 #include <stdlib.h>
@@ -17,24 +19,29 @@
 
 #include "log.h"
 #include "mushtype.h"
+#include "attrib.h"
 #include "dbio.h"
 #include "conf.h"
 #include "externs.h"
+#include "hash_function.h"
 #include "mushdb.h"
 #include "mymalloc.h"
 #include "strutil.h"
 
 typedef bool (*init_fn)(PENNFILE *);
 typedef char *(*comp_fn)(char const *);
+typedef char *(*comp_r_fn)(char const *, char *);
 
 struct compression_ops {
   init_fn init;
   comp_fn comp;
   comp_fn decomp;
+  comp_r_fn decomp_r; /**< Uncompress into a buffer; must be thread-safe */
 };
 
 #include "comp_h.c"
 #include "comp_w8.c"
+#include "comp_dict.c"
 
 static bool
 dummy_init(PENNFILE *f __attribute__((__unused__)))
@@ -44,6 +51,13 @@ dummy_init(PENNFILE *f __attribute__((__unused__)))
 
 static char dummy_buff[BUFFER_LEN];
 
+static char *
+dummy_decompress_r(char const *s, char *buf)
+{
+  mush_strncpy(buf, s, BUFFER_LEN);
+  return buf;
+}
+
 static char *
 dummy_compress(char const *s)
 {
@@ -58,7 +72,8 @@ dummy_decompress(char const *s)
 }
 
 struct compression_ops nocompression_ops = {dummy_init, dummy_compress,
-                                            dummy_decompress};
+                                            dummy_decompress,
+                                            dummy_decompress_r};
 
 struct compression_ops *comp_ops = NULL;
 
@@ -72,6 +87,8 @@ init_compress(PENNFILE *f)
       comp_ops = &huffman_ops;
     else if (strcmp(options.attr_compression, "word") == 0)
       comp_ops = &word_ops;
+    else if (strcmp(options.attr_compression, "dictionary") == 0)
+      comp_ops = &dictionary_ops;
     else {
       /* Unknown option! */
       do_rawlog(LT_ERR, "Unknown compression option '%s'. Defaulting to none.",
@@ -96,6 +113,19 @@ text_uncompress(char const *s)
   return comp_ops->decomp(s);
 }
 
+/** Uncompress a string into a caller-supplied buffer.
+ * Unlike text_uncompress(), this is safe to call from threads other
+ * than the main one.
+ * \param s a compressed string.
+ * \param buf a buffer of at least BUFFER_LEN bytes.
+ * \return buf, containing the uncompressed string.
+ */
+char *
+text_uncompress_r(char const *s, char *buf)
+{
+  return comp_ops->decomp_r(s, buf);
+}
+
 __attribute_malloc__ char *
 safe_uncompress(char const *s)
 {
@@ -125,6 +125,7 @@ PENNCONF conftable[] = {
   {"default_home", cf_dbref, &options.default_home, 100000, 0, "db"},
   {"exits_connect_rooms", cf_bool, &options.exits_connect_rooms, 2, 0, "db"},
   {"zone_control_zmp_only", cf_bool, &options.zone_control, 2, 0, "db"},
+  {"lazy_attributes", cf_bool, &options.lazy_attributes, 2, 0, "db"},
   {"ancestor_room", cf_dbref, &options.ancestor_room, 100000, 0, "db"},
   {"ancestor_exit", cf_dbref, &options.ancestor_exit, 100000, 0, "db"},
   {"ancestor_thing", cf_dbref, &options.ancestor_thing, 100000, 0, "db"},
@@ -157,6 +158,8 @@ PENNCONF conftable[] = {
   {"sql_database", cf_str, options.sql_database, sizeof options.sql_database,
    CP_GODONLY, "net"},
   {"forking_dump", cf_bool, &options.forking_dump, 2, 0, "dump"},
+  {"snapshot_dump", cf_bool, &options.snapshot_dump, 2, 0, "dump"},
+  {"dump_threads", cf_int, &options.dump_threads, 16, 0, "dump"},
   {"dump_message", cf_str, options.dump_message, sizeof options.dump_message,
    CP_OPTIONAL, "dump"},
   {"dump_complete", cf_str, options.dump_complete, sizeof options.dump_complete,
@@ -234,6 +237,8 @@ PENNCONF conftable[] = {
    "limits"},
   {"queue_entry_cpu_time", cf_int, &options.queue_entry_cpu_time, 100000, 0,
    "limits"},
+  {"grep_threads", cf_int, &options.grep_threads, 16, 0, "limits"},
+  {"grep_cpu_time", cf_int, &options.grep_cpu_time, 3600000, 0, "limits"},
   {"use_quota", cf_bool, &options.use_quota, 2, 0, "limits"},
   {"max_channels", cf_int, &options.max_channels, 1000, 0, "chat"},
   {"max_player_chans", cf_int, &options.max_player_chans, 100, 0, "chat"},
@@ -251,6 +256,8 @@ PENNCONF conftable[] = {
   {"checkpt_log", cf_str, options.checkpt_log, sizeof options.checkpt_log, 0,
    "log"},
   {"trace_log", cf_str, options.trace_log, sizeof options.trace_log, 0, "log"},
+  {"capture_log", cf_str, options.capture_log, sizeof options.capture_log, 0,
+   "log"},
   {"connect_log", cf_str, options.connect_log, sizeof options.connect_log, 0,
    "log"},
 
@@ -315,9 +322,12 @@ PENNCONF conftable[] = {
   {"chunk_cache_memory", cf_int, &options.chunk_cache_memory, 1000000000, 0,
    "files"},
   {"chunk_migrate", cf_int, &options.chunk_migrate_amount, 100000, 0, "limits"},
+  {"chunk_dedup", cf_bool, &options.chunk_dedup, 2, 0, "limits"},
 
   {"attr_compression", cf_str, options.attr_compression,
    sizeof options.attr_compression, 0, NULL},
+  {"compression_dictionary", cf_str, options.compression_dictionary,
+   sizeof options.compression_dictionary, 0, "files"},
 
 #ifdef HAVE_SSL
   {"ssl_private_key_file", cf_str, options.ssl_private_key_file,
@@ -1238,6 +1248,7 @@ conf_default_set(void)
   strcpy(options.connect_log, "");
   strcpy(options.command_log, "");
   strcpy(options.trace_log, "");
+  strcpy(options.capture_log, "");
   strcpy(options.wizard_log, "");
   strcpy(options.checkpt_log, "");
   options.use_syslog = 0;
@@ -1283,6 +1294,7 @@ conf_default_set(void)
   options.count_all = 0;
   options.exits_connect_rooms = 0;
   options.zone_control = 1;
+  options.lazy_attributes = 0;
   options.link_to_object = 1;
   options.owner_queues = 0;
   options.wiz_noaenter = 0;
@@ -1291,6 +1303,8 @@ conf_default_set(void)
   options.player_name_spaces = 0;
   options.max_aliases = 3;
   options.forking_dump = 1;
+  options.snapshot_dump = 0;
+  options.dump_threads = 2;
   options.restrict_building = 0;
   options.free_objects = 1;
   options.flags_on_examine = 1;
@@ -1325,6 +1339,8 @@ conf_default_set(void)
   options.float_precision = 6;
   options.player_name_len = 15;
   options.queue_entry_cpu_time = 1500;
+  options.grep_threads = 2;
+  options.grep_cpu_time = 60000;
   options.ascii_names = 1;
   options.call_lim = 10000;
   options.use_chunk = 1;
@@ -1332,7 +1348,9 @@ conf_default_set(void)
   options.chunk_swap_initial = 2048;
   options.chunk_cache_memory = 1000000;
   options.chunk_migrate_amount = 50;
+  options.chunk_dedup = 1;
   strcpy(options.attr_compression, "none");
+  strcpy(options.compression_dictionary, "data/attrdict");
   options.read_remote_desc = 0;
 #ifdef HAVE_SSL
   strcpy(options.ssl_private_key_file, "");
@@ -1808,6 +1826,8 @@ show_compile_options(dbref player)
     notify(player, T(" Attributes are Huffman compressed in memory."));
   } else if (strcmp(options.attr_compression, "word") == 0) {
     notify(player, T(" Attributes are word compressed in memory."));
+  } else if (strcmp(options.attr_compression, "dictionary") == 0) {
+    notify(player, T(" Attributes are dictionary compressed in memory."));
   } else {
     notify(player, T(" Attributes are not compressed in memory."));
   }
@@ -50,13 +50,39 @@
 #include "strtree.h"
 #include "strutil.h"
 #include "mushsql.h"
+#include "tests.h"
 
 intmap *queue_map = NULL; /**< Intmap for looking up queue entries by pid */
 static uint32_t top_pid = 1;
 #define MAX_PID (1U << 15)
-
-static MQUE *qfirst = NULL, *qlast = NULL, *qwait = NULL;
+/** Bitmap of the pids in use. Bit 0 and the bits past MAX_PID are
+ * always set, so a search never hands them out. */
+static uint64_t pid_bits[MAX_PID / 64 + 1];
+
+/* Which queue an entry is on (MQUE.list) */
+#define QLIST_NONE 0      /**< Not queued: running, inplace or being freed */
+#define QLIST_COMMAND 1   /**< qfirst..qlast */
+#define QLIST_WAIT 2      /**< qwait..qwaitlast, sorted by wait_until */
+#define QLIST_SEMAPHORE 3 /**< qsemfirst..qsemlast */
+#define QLIST_COUNT 4
+
+static MQUE *qfirst = NULL, *qlast = NULL, *qwait = NULL, *qwaitlast = NULL;
 static MQUE *qsemfirst = NULL, *qsemlast = NULL;
+static uint64_t qseq = 0;         /**< Stamp for MQUE.seq */
+static int qcount[QLIST_COUNT];   /**< Number of entries on each queue */
+static int qindexed[QLIST_COUNT]; /**< Entries on each queue with an executor */
+
+/** The queue entries of one executor, oldest first. Lets \@halt, \@ps
+ * and lpids() find an object's entries without walking every queue.
+ */
+struct exec_queue {
+  dbref executor;                 /**< Whose entries these are */
+  MQUE *first;                    /**< First entry */
+  MQUE *last;                     /**< Last entry */
+  struct exec_queue *prev, *next; /**< All executors with queue entries */
+};
+static intmap *exec_map = NULL; /**< exec_queues by executor dbref */
+static struct exec_queue *exec_queues = NULL;
 
 static int add_to_generic(dbref player, int am, const char *name,
                           uint32_t flags);
@@ -70,12 +96,12 @@ void wait_que(dbref executor, int waittill, char *command, dbref enactor,
 int que_next(void);
 
 static void show_queue(dbref player, dbref victim, int q_type, int q_quiet,
-                       int q_all, MQUE *q_ptr, int *tot, int *self, int *del);
+                       int q_all, int list, int *tot, int *self, int *del);
 static void show_queue_single(dbref player, MQUE *q, int q_type);
 static void show_queue_env(dbref player, MQUE *q);
 static void do_raw_restart(dbref victim);
 static int waitable_attr(dbref thing, const char *atr);
-static void shutdown_a_queue(MQUE **head, MQUE **tail);
+static void shutdown_a_queue(int list);
 static int do_entry(MQUE *entry, int include_recurses);
 static MQUE *new_queue_entry(NEW_PE_INFO *pe_info);
 void init_queue(void);
@@ -91,6 +117,7 @@ double average32(const int32_t *arr, int count);
 /* From game.c, for report() */
 extern char report_cmd[BUFFER_LEN];
 extern dbref report_dbref;
+extern PTAB ptab_attrib; /* atr_tab.c */
 
 /** Attribute flags to be set or checked on attributes to be used
  * as semaphores.
@@ -104,6 +131,9 @@ void
 init_queue(void)
 {
   queue_map = im_new();
+  exec_map = im_new();
+  pid_bits[0] = 1;
+  pid_bits[MAX_PID / 64] = ~UINT64_C(1) << (MAX_PID % 64);
 }
 
 /** Returns true if the attribute on thing can be used as a semaphore.
@@ -234,6 +264,245 @@ queue_limit(dbref player)
     return nlimit > QUEUE_QUOTA;
 }
 
+/* Find the first clear bit at or after from in a pid bitmap, or 0 */
+static uint32_t
+pid_find_free(const uint64_t *bits, uint32_t from)
+{
+  uint32_t w = from / 64, pid;
+  uint64_t word = bits[w] | ((UINT64_C(1) << (from % 64)) - 1);
+
+  while (word == UINT64_MAX) {
+    if (++w > MAX_PID / 64)
+      return 0;
+    word = bits[w];
+  }
+  for (pid = w * 64; word & 1; word >>= 1)
+    pid++;
+  return pid;
+}
+
+static void
+pid_release(uint32_t pid)
+{
+  pid_bits[pid / 64] &= ~(UINT64_C(1) << (pid % 64));
+}
+
+static MQUE **
+queue_head(int list)
+{
+  switch (list) {
+  case QLIST_COMMAND:
+    return &qfirst;
+  case QLIST_WAIT:
+    return &qwait;
+  default:
+    return &qsemfirst;
+  }
+}
+
+static MQUE **
+queue_tail(int list)
+{
+  switch (list) {
+  case QLIST_COMMAND:
+    return &qlast;
+  case QLIST_WAIT:
+    return &qwaitlast;
+  default:
+    return &qsemlast;
+  }
+}
+
+/* Link entry into a queue after point, or at the front if point is NULL */
+static void
+queue_link_after(int list, MQUE *point, MQUE *entry)
+{
+  MQUE **head = queue_head(list), **tail = queue_tail(list);
+
+  entry->prev = point;
+  entry->next = point ? point->next : *head;
+  if (entry->next)
+    entry->next->prev = entry;
+  else
+    *tail = entry;
+  if (point)
+    point->next = entry;
+  else
+    *head = entry;
+  entry->list = list;
+  entry->seq = ++qseq;
+  qcount[list]++;
+  if (entry->exec_queue)
+    qindexed[list]++;
+}
+
+/** Add an entry to the end of the command or semaphore queue */
+static void
+queue_append(int list, MQUE *entry)
+{
+  queue_link_after(list, *queue_tail(list), entry);
+}
+
+/** Add an entry to the wait queue, after any that run at the same time.
+ * New waits are usually the latest, so look from the end.
+ */
+static void
+wait_queue_insert(MQUE *entry)
+{
+  MQUE *point;
+
+  for (point = qwaitlast; point && point->wait_until > entry->wait_until;
+       point = point->prev)
+    ;
+  queue_link_after(QLIST_WAIT, point, entry);
+}
+
+/** Take an entry off whichever queue it's on */
+static void
+queue_unlink(MQUE *entry)
+{
+  if (entry->list == QLIST_NONE)
+    return;
+  if (entry->prev)
+    entry->prev->next = entry->next;
+  else
+    *queue_head(entry->list) = entry->next;
+  if (entry->next)
+    entry->next->prev = entry->prev;
+  else
+    *queue_tail(entry->list) = entry->prev;
+  qcount[entry->list]--;
+  if (entry->exec_queue)
+    qindexed[entry->list]--;
+  entry->next = entry->prev = NULL;
+  entry->list = QLIST_NONE;
+}
+
+/** Index a queue entry by pid and executor */
+static void
+queue_index_add(MQUE *entry)
+{
+  struct exec_queue *eq;
+
+  im_insert(queue_map, entry->pid, entry);
+  if (!GoodObject(entry->executor))
+    return;
+  eq = im_find(exec_map, entry->executor);
+  if (!eq) {
+    eq = mush_malloc(sizeof *eq, "mque.exec_queue");
+    eq->executor = entry->executor;
+    eq->first = eq->last = NULL;
+    eq->prev = NULL;
+    eq->next = exec_queues;
+    if (exec_queues)
+      exec_queues->prev = eq;
+    exec_queues = eq;
+    im_insert(exec_map, eq->executor, eq);
+  }
+  entry->exec_prev = eq->last;
+  entry->exec_next = NULL;
+  if (eq->last)
+    eq->last->exec_next = entry;
+  else
+    eq->first = entry;
+  eq->last = entry;
+  entry->exec_queue = eq;
+  if (entry->list != QLIST_NONE)
+    qindexed[entry->list]++;
+}
+
+/** Drop a queue entry from its executor's index. The pid stays valid,
+ * so halted entries can still be looked at until they're freed.
+ */
+static void
+exec_queue_remove(MQUE *entry)
+{
+  struct exec_queue *eq = entry->exec_queue;
+
+  if (!eq)
+    return;
+  if (entry->exec_prev)
+    entry->exec_prev->exec_next = entry->exec_next;
+  else
+    eq->first = entry->exec_next;
+  if (entry->exec_next)
+    entry->exec_next->exec_prev = entry->exec_prev;
+  else
+    eq->last = entry->exec_prev;
+  entry->exec_next = entry->exec_prev = NULL;
+  entry->exec_queue = NULL;
+  if (entry->list != QLIST_NONE)
+    qindexed[entry->list]--;
+
+  if (!eq->first) {
+    if (eq->prev)
+      eq->prev->next = eq->next;
+    else
+      exec_queues = eq->next;
+    if (eq->next)
+      eq->next->prev = eq->prev;
+    im_delete(exec_map, eq->executor);
+    mush_free(eq, "mque.exec_queue");
+  }
+}
+
+/** Halt a queue entry that has to stay where it is for now */
+static void
+queue_entry_orphan(MQUE *entry)
+{
+  exec_queue_remove(entry);
+  entry->executor = NOTHING;
+}
+
+static int
+queue_order_cmp(const void *a, const void *b)
+{
+  const MQUE *qa = *(MQUE *const *) a, *qb = *(MQUE *const *) b;
+
+  if (qa->wait_until != qb->wait_until && qa->list == QLIST_WAIT)
+    return qa->wait_until < qb->wait_until ? -1 : 1;
+  return qa->seq < qb->seq ? -1 : qa->seq > qb->seq;
+}
+
+/** Collect one queue's entries for an object, in queue order.
+ * \param list the QLIST_* queue to look at.
+ * \param victim the executor, or the owner if by_owner is true.
+ * \param by_owner look for entries of everything victim owns.
+ * \param entries set to a mush_malloc'd array of the entries, or NULL.
+ * \return the number of entries.
+ */
+static int
+queue_entries_for(int list, dbref victim, bool by_owner, MQUE ***entries)
+{
+  struct exec_queue *eq, *single = NULL;
+  MQUE *tmp;
+  int n = 0, size = 0;
+
+  *entries = NULL;
+  if (!by_owner) {
+    single = im_find(exec_map, victim);
+    if (!single)
+      return 0;
+  }
+  for (eq = single ? single : exec_queues; eq; eq = single ? NULL : eq->next) {
+    if (by_owner && Owner(eq->executor) != victim)
+      continue;
+    for (tmp = eq->first; tmp; tmp = tmp->exec_next) {
+      if (tmp->list != list)
+        continue;
+      if (n == size) {
+        size = size ? size * 2 : 16;
+        *entries = mush_realloc(*entries, size * sizeof **entries,
+                                "mque.entries_for");
+      }
+      (*entries)[n++] = tmp;
+    }
+  }
+  if (n > 1)
+    qsort(*entries, n, sizeof **entries, queue_order_cmp);
+  return n;
+}
+
 /** Free a queue entry.
  * \param entry queue entry to free.
  */
@@ -272,7 +541,10 @@ free_qentry(MQUE *entry)
   }
 
   if (entry->pid) { /* INPLACE queue entries have no pid */
+    queue_unlink(entry);
+    exec_queue_remove(entry);
     im_delete(queue_map, entry->pid);
+    pid_release(entry->pid);
   }
 
   if (entry->regvals) { /* Nested pe_regs */
@@ -319,26 +591,48 @@ pay_queue(dbref player, const char *command)
 static uint32_t
 next_pid(void)
 {
-  uint32_t pid = top_pid;
+  uint32_t pid;
 
-  if (im_count(queue_map) >= (int) MAX_PID) {
+  if (top_pid > MAX_PID)
+    top_pid = 1;
+  pid = pid_find_free(pid_bits, top_pid);
+  if (!pid)
+    pid = pid_find_free(pid_bits, 1);
+  if (!pid) {
     do_rawlog(
       LT_ERR,
       "There are %ld queue entries! That's too many. Failing to add another.",
       (long) im_count(queue_map));
     return 0;
   }
+  pid_bits[pid / 64] |= UINT64_C(1) << (pid % 64);
+  top_pid = pid + 1;
+  return pid;
+}
 
-  while (1) {
-    if (pid > MAX_PID)
-      pid = 1;
-    if (im_exists(queue_map, pid))
-      pid++;
-    else {
-      top_pid = pid + 1;
-      return pid;
-    }
-  }
+TEST_GROUP(pid_find_free)
+{
+  static uint64_t bits[MAX_PID / 64 + 1];
+  uint32_t pid, found = 0;
+
+  bits[0] = 1;
+  bits[MAX_PID / 64] = ~UINT64_C(1) << (MAX_PID % 64);
+  TEST("pid_find_free.1", pid_find_free(bits, 1) == 1);
+  for (pid = 1; pid <= 70; pid++)
+    bits[pid / 64] |= UINT64_C(1) << (pid % 64);
+  TEST("pid_find_free.2", pid_find_free(bits, 5) == 71);
+  TEST("pid_find_free.3", pid_find_free(bits, 100) == 100);
+  TEST("pid_find_free.4", pid_find_free(bits, MAX_PID) == MAX_PID);
+  bits[MAX_PID / 64] = UINT64_MAX;
+  TEST("pid_find_free.5", pid_find_free(bits, MAX_PID) == 0);
+
+  /* Nearly full, with the only free pid at the far end */
+  memset(bits, 0xff, sizeof bits);
+  bits[(MAX_PID - 1) / 64] &= ~(UINT64_C(1) << ((MAX_PID - 1) % 64));
+  TEST("pid_find_free.6", pid_find_free(bits, 1) == MAX_PID - 1);
+  BENCHMARK("pid_find_free (one free pid)", 10000,
+            { found += pid_find_free(bits, 1) == MAX_PID - 1; });
+  TEST("pid_find_free.7", found == 10000);
 }
 
 static MQUE *
@@ -360,6 +654,12 @@ new_queue_entry(NEW_PE_INFO *pe_info)
 
   entry->inplace = NULL;
   entry->next = NULL;
+  entry->prev = NULL;
+  entry->exec_next = NULL;
+  entry->exec_prev = NULL;
+  entry->exec_queue = NULL;
+  entry->seq = 0;
+  entry->list = QLIST_NONE;
 
   entry->semaphore_obj = NOTHING;
   entry->semaphore_attr = NULL;
@@ -379,6 +679,95 @@ new_queue_entry(NEW_PE_INFO *pe_info)
  */
 #define EVENT_DELIM_CHAR '\x11'
 
+/* Events the event handler might have an attribute for. Every name an
+ * attribute on EVENT_HANDLER can be found by, including standard
+ * attribute aliases, sets one bit. An event whose bit is clear can't be
+ * handled and is skipped without looking for the attribute. The bits are
+ * recomputed at the next event after the event handler gains an
+ * attribute or an alias is added. Removed attributes leave their bits set,
+ * which only costs a lookup.
+ */
+#define EVENT_BITS 1024
+
+static uint64_t event_bits[EVENT_BITS / 64];
+static dbref event_bits_for = NOTHING; /**< Object the bits describe */
+
+static uint32_t
+event_name_hash(const char *name)
+{
+  uint32_t h = 2166136261U;
+
+  for (; *name; name++) {
+    h = (h ^ (unsigned char) UPCASE(*name)) * 16777619U;
+  }
+  return h & (EVENT_BITS - 1);
+}
+
+static void
+event_bit_set(const char *name)
+{
+  uint32_t h = event_name_hash(name);
+  event_bits[h / 64] |= UINT64_C(1) << (h % 64);
+}
+
+/** Forget which events the event handler has attributes for, after it
+ * or the attribute aliases change.
+ */
+void
+event_handlers_changed(void)
+{
+  event_bits_for = NOTHING;
+}
+
+/* Can the event handler have an attribute for this event? */
+static bool
+event_maybe_handled(const char *event)
+{
+  uint32_t h;
+
+  if (event_bits_for != EVENT_HANDLER) {
+    ATTR *a;
+    const char *alias;
+
+    memset(event_bits, 0, sizeof event_bits);
+    ATTR_FOR_EACH (EVENT_HANDLER, a) {
+      event_bit_set(AL_NAME(a));
+    }
+    for (a = ptab_firstentry_new(&ptab_attrib, &alias); a;
+         a = ptab_nextentry_new(&ptab_attrib, &alias)) {
+      if (strcmp(alias, AL_NAME(a)) != 0) {
+        event_bit_set(alias);
+      }
+    }
+    event_bits_for = EVENT_HANDLER;
+  }
+
+  h = event_name_hash(event);
+  return event_bits[h / 64] & (UINT64_C(1) << (h % 64));
+}
+
+TEST_GROUP(event_maybe_handled)
+{
+  dbref saved = options.event_handler;
+  int found = 0;
+
+  /* Use the master room as the event handler for a moment */
+  options.event_handler = 0;
+  TEST("event_maybe_handled.1", !event_maybe_handled("TEST`NOHANDLER"));
+  atr_add(0, "TEST`HANDLER", "think test", GOD, 0);
+  TEST("event_maybe_handled.2", event_maybe_handled("TEST`HANDLER"));
+  TEST("event_maybe_handled.3", event_maybe_handled("test`handler"));
+
+  BENCHMARK("unhandled event (atr_get_noparent)", 100000,
+            { found += atr_get_noparent(0, "TEST`NOHANDLER") != NULL; });
+  BENCHMARK("unhandled event (queue_event)", 100000,
+            { found += queue_event(SYSEVENT, "TEST`NOHANDLER", "%s", "x"); });
+  TEST("event_maybe_handled.4", found == 0);
+
+  atr_clr(0, "TEST`HANDLER", GOD);
+  options.event_handler = saved;
+}
+
 /** If EVENT_HANDLER config option is set to a valid dbref, try triggering
  * its handler attribute
  * \param enactor The enactor who caused it.
@@ -392,7 +781,8 @@ bool
 queue_event(dbref enactor, const char *event, const char *fmt, ...)
 {
   char myfmt[BUFFER_LEN];
-  char buff[BUFFER_LEN * 4];
+  char sbuff[BUFFER_LEN];
+  char *buff = NULL;
   char *s, *snext;
   ATTR *a;
   PE_REGS *pe_regs;
@@ -403,8 +793,8 @@ queue_event(dbref enactor, const char *event, const char *fmt, ...)
   int pid;
 
   /* Make sure we have an event to call, first. */
-  if (!GoodObject(EVENT_HANDLER) || IsGarbage(EVENT_HANDLER) ||
-      Halted(EVENT_HANDLER)) {
+  if (!GoodObject(EVENT_HANDLER) || !event_maybe_handled(event) ||
+      IsGarbage(EVENT_HANDLER) || Halted(EVENT_HANDLER)) {
     return 0;
   }
 
@@ -453,14 +843,25 @@ queue_event(dbref enactor, const char *event, const char *fmt, ...)
     argcount = MAX_STACK_ARGS;
 
   if (argcount > 0) {
-    /* Build the arguments. */
+    /* Build the arguments. Most events fit in one buffer; the rare ones
+     * that don't are formatted again into one that's big enough. */
     va_list args;
+    int len;
+
     va_start(args, fmt);
-    mush_vsnprintf(buff, sizeof buff, myfmt, args);
-    buff[(BUFFER_LEN * 4) - 1] = '\0';
+    len = mush_vsnprintf(sbuff, sizeof sbuff, myfmt, args);
     va_end(args);
+    if (len >= (int) sizeof sbuff) {
+      buff = mush_malloc(len + 1, "queue_event.args");
+      va_start(args, fmt);
+      mush_vsnprintf(buff, len + 1, myfmt, args);
+      va_end(args);
+    } else {
+      /* Possibly truncated, on systems that don't say how long it was */
+      buff = sbuff;
+      len = strlen(buff);
+    }
 
-    int len = strlen(buff);
     for (i = 0, s = buff; i < argcount && s; i++, s = snext) {
       snext = strchr(s, EVENT_DELIM_CHAR);
       if ((snext ? (snext - s) : (len - (s - buff))) > BUFFER_LEN) {
@@ -499,19 +900,17 @@ queue_event(dbref enactor, const char *event, const char *fmt, ...)
       pe_regs_setenv(pe_regs, i, wenv[i]);
     }
   }
+  if (buff && buff != sbuff) {
+    mush_free(buff, "queue_event.args");
+  }
 
   /* Hmm, should events queue ahead of anything else?
    * For now, yes, but leaving code here anyway.
    */
-  if (qlast) {
-    qlast->next = tmp;
-    qlast = tmp;
-  } else {
-    qlast = qfirst = tmp;
-  }
+  queue_index_add(tmp);
+  queue_append(QLIST_COMMAND, tmp);
 
   /* All good! */
-  im_insert(queue_map, tmp->pid, tmp);
 
   return 1;
 }
@@ -561,12 +960,8 @@ insert_que(MQUE *queue_entry, MQUE *parent_queue)
     (queue_entry->queue_type & (QUEUE_PLAYER | QUEUE_OBJECT | QUEUE_INPLACE))) {
   case QUEUE_PLAYER:
   case QUEUE_OBJECT:
-    if (qlast) {
-      qlast->next = queue_entry;
-      qlast = queue_entry;
-    } else {
-      qlast = qfirst = queue_entry;
-    }
+    queue_index_add(queue_entry);
+    queue_append(QLIST_COMMAND, queue_entry);
     break;
   case QUEUE_INPLACE:
     if (parent_queue->inplace) {
@@ -586,8 +981,6 @@ insert_que(MQUE *queue_entry, MQUE *parent_queue)
     free_qentry(queue_entry);
     return;
   }
-  if (queue_entry->pid)
-    im_insert(queue_map, queue_entry->pid, queue_entry);
 }
 
 /** Replacement for parse_que and inplace_queue_actionlist - queue an action
@@ -929,32 +1322,17 @@ wait_que(dbref executor, int waittill, char *command, dbref enactor, dbref sem,
       tmp->wait_until = 0; /* semaphore wait without a timeout */
   }
   tmp->semaphore_obj = sem;
+  queue_index_add(tmp);
   if (sem == NOTHING) {
     /* No semaphore, put on normal wait queue, sorted by time */
-    MQUE *point, *trail = NULL;
-
-    for (point = qwait; point && (point->wait_until <= tmp->wait_until);
-         point = point->next)
-      trail = point;
-
-    tmp->next = point;
-    if (trail != NULL)
-      trail->next = tmp;
-    else
-      qwait = tmp;
+    wait_queue_insert(tmp);
   } else {
 
     /* Put it on the end of the semaphore queue */
     tmp->semaphore_attr =
       mush_strdup(semattr ? semattr : "SEMAPHORE", "mque.semaphore_attr");
-    if (qsemlast != NULL) {
-      qsemlast->next = tmp;
-      qsemlast = tmp;
-    } else {
-      qsemfirst = qsemlast = tmp;
-    }
+    queue_append(QLIST_SEMAPHORE, tmp);
   }
-  im_insert(queue_map, tmp->pid, tmp);
 }
 
 void
@@ -998,7 +1376,7 @@ void
 queue_update(void)
 {
   static time_t last_mudtime = 0;
-  MQUE *trail = NULL, *point, *next;
+  MQUE *point, *next;
 
   if (mudtime == last_mudtime) {
     /* Only run once per second at most. */
@@ -1009,38 +1387,20 @@ queue_update(void)
   /* check regular @wait queue */
   while (qwait && qwait->wait_until <= mudtime) {
     point = qwait;
-    qwait = point->next;
-    point->next = NULL;
+    queue_unlink(point);
     point->wait_until = 0;
-    if (qlast) {
-      qlast->next = point;
-      qlast = point;
-    } else {
-      qlast = qfirst = point;
-    }
+    queue_append(QLIST_COMMAND, point);
   }
 
   /* check for semaphore Zwait timeouts */
-  for (point = qsemfirst, trail = NULL; point; point = next) {
-    if (point->wait_until == 0 || point->wait_until > mudtime) {
-      next = (trail = point)->next;
+  for (point = qsemfirst; point; point = next) {
+    next = point->next;
+    if (point->wait_until == 0 || point->wait_until > mudtime)
       continue; /* skip non-timed and those that haven't gone off yet */
-    }
-    if (trail != NULL)
-      trail->next = next = point->next;
-    else
-      qsemfirst = next = point->next;
-    if (point == qsemlast)
-      qsemlast = trail;
+    queue_unlink(point);
     add_to_sem(point->semaphore_obj, -1, point->semaphore_attr);
     point->semaphore_obj = NOTHING;
-    point->next = NULL;
-    if (qlast) {
-      qlast->next = point;
-      qlast = point;
-    } else {
-      qlast = qfirst = point;
-    }
+    queue_append(QLIST_COMMAND, point);
   }
 }
 
@@ -1064,8 +1424,7 @@ do_top(int ncom)
      * queued @kick or @ps get a sane queue image.
      */
     entry = qfirst;
-    if (!(qfirst = entry->next))
-      qlast = NULL;
+    queue_unlink(entry);
     do_entry(entry, 0);
     free_qentry(entry);
   }
@@ -1321,28 +1680,16 @@ drain_helper(dbref player __attribute__((__unused__)), dbref thing,
 int
 execute_one_semaphore(dbref thing, char const *aname, PE_REGS *pe_regs)
 {
-  MQUE **point;
   MQUE *entry;
 
   /* Go through the semaphore queue and do it */
-  point = &qsemfirst;
-  while (*point) {
-    entry = *point;
+  for (entry = qsemfirst; entry; entry = entry->next) {
     if (entry->semaphore_obj != thing ||
-        (aname && strcmp(entry->semaphore_attr, aname))) {
-      point = &(entry->next);
+        (aname && strcmp(entry->semaphore_attr, aname)))
       continue;
-    }
 
     /* Remove the queue entry from the semaphore list */
-    *point = entry->next;
-    entry->next = NULL;
-    if (qsemlast == entry) {
-      qsemlast = qsemfirst;
-      if (qsemlast)
-        while (qsemlast->next)
-          qsemlast = qsemlast->next;
-    }
+    queue_unlink(entry);
 
     /* Update bookkeeping */
     add_to_sem(entry->semaphore_obj, -1, entry->semaphore_attr);
@@ -1355,12 +1702,7 @@ execute_one_semaphore(dbref thing, char const *aname, PE_REGS *pe_regs)
     }
 
     /* And enqueue */
-    if (qlast) {
-      qlast->next = entry;
-      qlast = entry;
-    } else {
-      qlast = qfirst = entry;
-    }
+    queue_append(QLIST_COMMAND, entry);
     return 1;
   }
   return 0;
@@ -1380,31 +1722,20 @@ dequeue_semaphores(dbref thing, char const *aname, int count, int all,
                    int drain)
 {
 
-  MQUE **point;
-  MQUE *entry;
+  MQUE *entry, *next;
 
   if (all)
     count = INT_MAX;
 
   /* Go through the semaphore queue and do it */
-  point = &qsemfirst;
-  while (*point && count > 0) {
-    entry = *point;
+  for (entry = qsemfirst; entry && count > 0; entry = next) {
+    next = entry->next;
     if (entry->semaphore_obj != thing ||
-        (aname && strcmp(entry->semaphore_attr, aname))) {
-      point = &(entry->next);
+        (aname && strcmp(entry->semaphore_attr, aname)))
       continue;
-    }
 
     /* Remove the queue entry from the semaphore list */
-    *point = entry->next;
-    entry->next = NULL;
-    if (qsemlast == entry) {
-      qsemlast = qsemfirst;
-      if (qsemlast)
-        while (qsemlast->next)
-          qsemlast = qsemlast->next;
-    }
+    queue_unlink(entry);
 
     /* Update bookkeeping */
     count--;
@@ -1417,12 +1748,7 @@ dequeue_semaphores(dbref thing, char const *aname, int count, int all,
       add_to(entry->executor, -1);
       free_qentry(entry);
     } else {
-      if (qlast) {
-        qlast->next = entry;
-        qlast = entry;
-      } else {
-        qlast = qfirst = entry;
-      }
+      queue_append(QLIST_COMMAND, entry);
     }
   }
 
@@ -1635,8 +1961,7 @@ void
 do_waitpid(dbref player, const char *pidstr, const char *timestr, bool until)
 {
   uint32_t pid;
-  MQUE *q, *tmp, *last;
-  bool found;
+  MQUE *q;
 
   if (!is_strict_uinteger(pidstr)) {
     notify(player, T("That is not a valid pid!"));
@@ -1692,41 +2017,10 @@ do_waitpid(dbref player, const char *pidstr, const char *timestr, bool until)
       q->wait_until = 0;
   }
 
-  /* Now adjust it in the wait queue. Not a clever approach, but I
-     wrote it at 3 am and clever was not an option. */
-  found = false;
-  for (tmp = qwait, last = NULL; tmp; last = tmp, tmp = tmp->next) {
-    if (tmp == q) {
-      if (last)
-        last->next = q->next;
-      else
-        qwait = qwait->next;
-      found = true;
-      break;
-    }
-  }
-  if (found) {
-    found = false;
-    for (tmp = qwait, last = NULL; tmp; last = tmp, tmp = tmp->next) {
-      if (tmp->wait_until > q->wait_until) {
-        if (last) {
-          last->next = q;
-          q->next = tmp;
-        } else {
-          q->next = qwait;
-          qwait = q;
-        }
-        found = true;
-        break;
-      }
-    }
-    if (!found) {
-      if (last)
-        last->next = q;
-      else
-        qwait = q;
-      q->next = NULL;
-    }
+  /* Now move it to its new place in the wait queue. */
+  if (q->list == QLIST_WAIT) {
+    queue_unlink(q);
+    wait_queue_insert(q);
   }
 
   notify_format(player, T("Queue entry with pid %u updated."),
@@ -1887,13 +2181,32 @@ FUNCTION(fun_lpids)
       return;
     }
   }
-  if (qmask & LPIDS_WAIT) {
-    for (tmp = qwait; tmp; tmp = tmp->next) {
-      if (GoodObject(player) && GoodObject(tmp->executor) &&
-          ((qmask & LPIDS_INDEPENDENT) ? (tmp->executor != player)
-                                       : !Owns(tmp->executor, player))) {
+  if (GoodObject(player)) {
+    /* One object's or owner's pids: only look at their entries */
+    static const int lists[] = {QLIST_WAIT, QLIST_SEMAPHORE};
+    static const int masks[] = {LPIDS_WAIT, LPIDS_SEMAPHORE};
+    bool independent = qmask & LPIDS_INDEPENDENT;
+    MQUE **entries;
+    int l, n, i;
+
+    for (l = 0; l < 2; l++) {
+      if (!(qmask & masks[l]))
         continue;
+      n = queue_entries_for(lists[l], independent ? player : Owner(player),
+                            !independent, &entries);
+      for (i = 0; i < n; i++) {
+        if (!first)
+          safe_chr(' ', buff, bp);
+        safe_integer(entries[i]->pid, buff, bp);
+        first = false;
       }
+      if (entries)
+        mush_free(entries, "mque.entries_for");
+    }
+    return;
+  }
+  if (qmask & LPIDS_WAIT) {
+    for (tmp = qwait; tmp; tmp = tmp->next) {
       if (!first)
         safe_chr(' ', buff, bp);
       safe_integer(tmp->pid, buff, bp);
@@ -1902,10 +2215,6 @@ FUNCTION(fun_lpids)
   }
   if (qmask & LPIDS_SEMAPHORE) {
     for (tmp = qsemfirst; tmp; tmp = tmp->next) {
-      if (GoodObject(player) && GoodObject(tmp->executor) &&
-          ((qmask & LPIDS_INDEPENDENT) ? (tmp->executor != player)
-                                       : !Owns(tmp->executor, player)))
-        continue;
       if (GoodObject(thing) && (tmp->semaphore_obj != thing))
         continue;
       if (attrib && *attrib && strcasecmp(tmp->semaphore_attr, attrib))
@@ -1920,21 +2229,34 @@ FUNCTION(fun_lpids)
 
 static void
 show_queue(dbref player, dbref victim, int q_type, int q_quiet, int q_all,
-           MQUE *q_ptr, int *tot, int *self, int *del)
+           int list, int *tot, int *self, int *del)
 {
-  MQUE *tmp;
-  for (tmp = q_ptr; tmp; tmp = tmp->next) {
-    (*tot)++;
-    if (!GoodObject(tmp->executor))
-      (*del)++;
-    else if (q_all || (Owner(tmp->executor) == victim)) {
-      if ((LookQueue(player) || Owns(tmp->executor, player))) {
+  MQUE *tmp, **entries;
+  int n, i;
+
+  *tot += qcount[list];
+  *del += qcount[list] - qindexed[list];
+  if (q_all) {
+    for (tmp = *queue_head(list); tmp; tmp = tmp->next) {
+      if (GoodObject(tmp->executor) &&
+          (LookQueue(player) || Owns(tmp->executor, player))) {
         (*self)++;
         if (!q_quiet)
           show_queue_single(player, tmp, q_type);
       }
     }
+    return;
   }
+  n = queue_entries_for(list, victim, true, &entries);
+  for (i = 0; i < n; i++) {
+    if (LookQueue(player) || Owns(entries[i]->executor, player)) {
+      (*self)++;
+      if (!q_quiet)
+        show_queue_single(player, entries[i], q_type);
+    }
+  }
+  if (entries)
+    mush_free(entries, "mque.entries_for");
 }
 
 /* Show a single queue entry */
@@ -2090,13 +2412,14 @@ do_queue(dbref player, const char *what, enum queue_type flag)
     victim = Owner(victim);
     if (!quick)
       notify(player, T("Command Queue:"));
-    show_queue(player, victim, 0, quick, all, qfirst, &tpq, &pq, &dpq);
+    show_queue(player, victim, 0, quick, all, QLIST_COMMAND, &tpq, &pq, &dpq);
     if (!quick)
       notify(player, T("Wait Queue:"));
-    show_queue(player, victim, 1, quick, all, qwait, &twq, &wq, &dwq);
+    show_queue(player, victim, 1, quick, all, QLIST_WAIT, &twq, &wq, &dwq);
     if (!quick)
       notify(player, T("Semaphore Queue:"));
-    show_queue(player, victim, 2, quick, all, qsemfirst, &tsq, &sq, &dsq);
+    show_queue(player, victim, 2, quick, all, QLIST_SEMAPHORE, &tsq, &sq,
+               &dsq);
     if (!quick)
       notify(player, T("------------  Queue Done  ------------"));
     notify_format(player,
@@ -2162,9 +2485,11 @@ do_queue_single(dbref player, const char *pidstr, bool debug)
 void
 do_halt(dbref owner, const char *ncom, dbref victim)
 {
-  MQUE *tmp, *trail = NULL, *point, *next;
+  struct exec_queue *eq, *eqnext, *single = NULL;
+  MQUE *point, *next;
   int num = 0;
   dbref player;
+  bool by_owner;
   if (victim == NOTHING)
     player = owner;
   else
@@ -2172,45 +2497,40 @@ do_halt(dbref owner, const char *ncom, dbref victim)
   if (!Quiet(Owner(player)))
     notify_format(Owner(player), "%s: %s(#%d)", T("Halted"),
                   AName(player, AN_SYS, NULL), player);
-  for (tmp = qfirst; tmp; tmp = tmp->next) {
-    if (GoodObject(tmp->executor) &&
-        ((tmp->executor == player) || (Owner(tmp->executor) == player))) {
-      num--;
-      giveto(player, QUEUE_COST);
-      tmp->executor = NOTHING;
-    }
-  }
-  /* remove wait q stuff */
-  for (point = qwait; point; point = next) {
-    if (((point->executor == player) || (Owner(point->executor) == player))) {
-      num--;
-      giveto(player, QUEUE_COST);
-      if (trail)
-        trail->next = next = point->next;
-      else
-        qwait = next = point->next;
-      free_qentry(point);
-    } else {
-      next = (trail = point)->next;
-    }
-  }
-
-  /* clear semaphore queue */
 
-  for (point = qsemfirst, trail = NULL; point; point = next) {
-    if (((point->executor == player) || (Owner(point->executor) == player))) {
-      num--;
-      giveto(player, QUEUE_COST);
-      if (trail)
-        trail->next = next = point->next;
-      else
-        qsemfirst = next = point->next;
-      if (point == qsemlast)
-        qsemlast = trail;
-      add_to_sem(point->semaphore_obj, -1, point->semaphore_attr);
-      free_qentry(point);
-    } else
-      next = (trail = point)->next;
+  /* A player's halt takes in everything they own */
+  by_owner = IsPlayer(player);
+  if (!by_owner)
+    single = im_find(exec_map, player);
+  for (eq = single ? single : exec_queues; eq; eq = eqnext) {
+    eqnext = single ? NULL : eq->next;
+    if (by_owner && Owner(eq->executor) != player)
+      continue;
+    for (point = eq->first; point; point = next) {
+      next = point->exec_next;
+      switch (point->list) {
+      case QLIST_COMMAND:
+        /* Skipped when its turn comes up */
+        num--;
+        giveto(player, QUEUE_COST);
+        queue_entry_orphan(point);
+        break;
+      case QLIST_WAIT:
+        num--;
+        giveto(player, QUEUE_COST);
+        free_qentry(point);
+        break;
+      case QLIST_SEMAPHORE:
+        num--;
+        giveto(player, QUEUE_COST);
+        add_to_sem(point->semaphore_obj, -1, point->semaphore_attr);
+        free_qentry(point);
+        break;
+      default:
+        /* Running right now */
+        break;
+      }
+    }
   }
 
   add_to(player, num);
@@ -2308,21 +2628,8 @@ do_haltpid(dbref player, const char *arg1)
      belongs to, flag it as halted and just not execute it when its
      turn comes up (Or show it in @ps, etc.).  Exception is for
      semaphores, which otherwise might wait forever. */
-  q->executor = NOTHING;
-  if (q->semaphore_attr) {
-    MQUE *last = NULL, *tmp;
-    for (tmp = qsemfirst; tmp; last = tmp, tmp = tmp->next) {
-      if (tmp == q) {
-        if (last)
-          last->next = tmp->next;
-        else
-          qsemfirst = tmp->next;
-        if (qsemlast == tmp)
-          qsemlast = last;
-        break;
-      }
-    }
-
+  queue_entry_orphan(q);
+  if (q->list == QLIST_SEMAPHORE) {
     giveto(victim, QUEUE_COST);
     add_to_sem(q->semaphore_obj, -1, q->semaphore_attr);
     free_qentry(q);
@@ -2452,20 +2759,18 @@ do_restart_com(dbref player, const char *arg1)
 void
 shutdown_queues(void)
 {
-  shutdown_a_queue(&qfirst, &qlast);
-  shutdown_a_queue(&qsemfirst, &qsemlast);
-  shutdown_a_queue(&qwait, NULL);
+  shutdown_a_queue(QLIST_COMMAND);
+  shutdown_a_queue(QLIST_SEMAPHORE);
+  shutdown_a_queue(QLIST_WAIT);
 }
 
 static void
-shutdown_a_queue(MQUE **head, MQUE **tail)
+shutdown_a_queue(int list)
 {
   MQUE *entry;
   /* Drain out a queue */
-  while (*head) {
-    entry = *head;
-    if (!(*head = entry->next) && tail)
-      *tail = NULL;
+  while ((entry = *queue_head(list))) {
+    queue_unlink(entry);
     if (GoodObject(entry->executor) && !IsGarbage(entry->executor)) {
       giveto(entry->executor, QUEUE_COST);
       add_to(entry->executor, -1);
@@ -178,6 +178,7 @@ do_real_open(dbref player, const char *direction, const char *linkto,
     }
     current_state.exits++;
     local_data_create(new_exit);
+    warnings_changed(new_exit);
     queue_event(player, "OBJECT`CREATE", "%s", unparse_objid(new_exit));
     return new_exit;
   }
@@ -270,14 +271,16 @@ do_unlink(dbref player, const char *name)
       switch (Typeof(exit_l)) {
       case TYPE_EXIT:
         old_loc = Location(exit_l);
-        Location(exit_l) = NOTHING;
         delete_link_from(exit_l);
+        Location(exit_l) = NOTHING;
+        warnings_changed(exit_l);
         notify_format(player, T("Unlinked exit #%d (Used to lead to %s)."),
                       exit_l, unparse_object(player, old_loc, AN_UNPARSE));
         break;
       case TYPE_ROOM:
         Location(exit_l) = NOTHING;
         delete_link_from(exit_l);
+        warnings_changed(exit_l);
         notify(player, T("Dropto removed."));
         break;
       default:
@@ -514,6 +517,7 @@ do_dig(dbref player, const char *name, char **argv, int tport,
     }
     current_state.rooms++;
     local_data_create(room);
+    warnings_changed(room);
     if (tport) {
       /* We need to use the full command, because we need NO_TEL
        * and Z_TEL checking */
@@ -602,6 +606,7 @@ do_create(dbref player, const char *name, int cost, char *newdbref)
     notify_format(player, T("Created: Object %s."), unparse_dbref(thing));
     current_state.things++;
     local_data_create(thing);
+    warnings_changed(thing);
 
     queue_event(player, "OBJECT`CREATE", "%s", unparse_objid(thing));
 
@@ -627,8 +632,9 @@ clone_object(dbref player, dbref thing, const char *newname, bool preserve)
     set_name(clone, Name(thing));
   s_Pennies(clone, Pennies(thing));
   AttrCount(clone) = 0;
-  AttrCap(clone) = 0;
+  AttrLeaves(clone) = 0;
   List(clone) = NULL;
+  AttrIndex(clone) = NULL;
   Locks(clone) = NULL;
   clone_locks(player, thing, clone);
   Zone(clone) = Zone(thing);
@@ -660,6 +666,7 @@ clone_object(dbref player, dbref thing, const char *newname, bool preserve)
     add_link(clone, Home(thing));
   }
   atr_cpy(clone, thing);
+  warnings_changed(clone);
 
   queue_event(player, "OBJECT`CREATE", "%s,%s", unparse_objid(clone),
               unparse_objid(thing));
@@ -27,6 +27,10 @@
 #include <inttypes.h>
 #endif
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
 #include "ansi.h"
 #include "attrib.h"
 #include "conf.h"
@@ -40,6 +44,7 @@
 #include "htab.h"
 #include "lock.h"
 #include "log.h"
+#include "map_file.h"
 #include "memcheck.h"
 #include "mushdb.h"
 #include "mymalloc.h"
@@ -49,6 +54,7 @@
 #include "strutil.h"
 #include "mushsql.h"
 #include "charclass.h"
+#include "tests.h"
 
 #ifdef WIN32
 #pragma warning(disable : 4761) /* disable warning re conversion */
@@ -83,7 +89,10 @@ dbref db_size = DB_INITIAL_SIZE; /**< Current size of db array */
 
 static void db_grow(dbref newtop);
 
-static void db_write_obj_basic(PENNFILE *f, dbref i, struct object *o);
+static void db_write_obj_basic(PENNFILE *f, struct object *o);
+static void db_write_obj(PENNFILE *f, struct object *o, struct object *objs,
+                         dbref top);
+static void db_write_header(PENNFILE *f, int flag);
 int db_paranoid_write_object(PENNFILE *f, dbref i, int flag);
 int db_write_object(PENNFILE *f, dbref i);
 void putlocks(PENNFILE *f, lock_list *l);
@@ -96,6 +105,7 @@ static void init_objdata(void);
 static void db_write_flags(PENNFILE *f);
 static void db_write_attrs(PENNFILE *f);
 static dbref db_read_oldstyle(PENNFILE *f);
+static void attrs_forget(void);
 static void add_object_table(dbref);
 
 StrTree object_names; /**< String tree of object names */
@@ -128,6 +138,7 @@ init_names(void)
 const char *
 set_name(dbref obj, const char *newname)
 {
+  snapshot_preserve(obj);
   /* if pointer not null unalloc it */
   if (Name(obj))
     st_delete(Name(obj), &object_names);
@@ -191,8 +202,9 @@ db_grow(dbref newtop)
       o->warnings = 0;
       o->modification_time = o->creation_time = mudtime;
       o->attrcount = 0;
-      o->attrcap = 0;
+      o->attrleaves = 0;
       o->list = NULL;
+      o->attrindex = NULL;
       initialized++;
     }
   }
@@ -232,6 +244,8 @@ new_object(void)
   o->warnings = 0;
   o->modification_time = o->creation_time = mudtime;
   o->attrcount = 0;
+  o->attrleaves = 0;
+  o->attrindex = NULL;
   /* Flags are set by the functions that call this */
   o->powers = new_flag_bitmask("POWER");
   if (current_state.garbage) {
@@ -637,11 +651,10 @@ putlocks(PENNFILE *f, lock_list *l)
  * This function writes out the basic information associated with an
  * object - just about everything but the attributes.
  * \param f file pointer to write to.
- * \param i dbref of object to write.
  * \param o pointer to object to write.
  */
 static void
-db_write_obj_basic(PENNFILE *f, dbref i, struct object *o)
+db_write_obj_basic(PENNFILE *f, struct object *o)
 {
   db_write_labeled_string(f, "name", o->name);
   db_write_labeled_dbref(f, "location", o->location);
@@ -649,11 +662,11 @@ db_write_obj_basic(PENNFILE *f, dbref i, struct object *o)
   db_write_labeled_dbref(f, "exits", o->exits);
   db_write_labeled_dbref(f, "next", o->next);
   db_write_labeled_dbref(f, "parent", o->parent);
-  putlocks(f, Locks(i));
+  putlocks(f, o->locks);
   db_write_labeled_dbref(f, "owner", o->owner);
   db_write_labeled_dbref(f, "zone", o->zone);
-  db_write_labeled_int(f, "pennies", Pennies(i));
-  db_write_labeled_int(f, "type", Typeof(i));
+  db_write_labeled_int(f, "pennies", o->penn);
+  db_write_labeled_int(f, "type", o->type & ~TYPE_MARKED);
   db_write_labeled_string(f, "flags",
                           bits_to_string("FLAG", o->flags, GOD, NOTHING));
   db_write_labeled_string(f, "powers",
@@ -671,33 +684,44 @@ db_write_obj_basic(PENNFILE *f, dbref i, struct object *o)
 int
 db_write_object(PENNFILE *f, dbref i)
 {
-  struct object *o;
+  LoadAttrs(i);
+  db_write_obj(f, db + i, db, db_top);
+  return 0;
+}
+
+/* Write out an object from a copy of its fields. Attribute owners are
+ * looked up in objs, which has top objects, falling back on the db for
+ * objects created since it was copied. */
+static void
+db_write_obj(PENNFILE *f, struct object *o, struct object *objs, dbref top)
+{
   ALIST *list;
+  dbref owner;
   int count = 0;
 
-  o = db + i;
-  db_write_obj_basic(f, i, o);
+  db_write_obj_basic(f, o);
 
   /* write the attribute list */
 
   /* Don't trust AttrCount(thing) for number of attributes to write. */
-  ATTR_FOR_EACH (i, list) {
+  ATTR_FOR_EACH_LEAF (o->list, o->attrleaves, list) {
     if (AF_Nodump(list))
       continue;
     count++;
   }
   db_write_labeled_int(f, "attrcount", count);
 
-  ATTR_FOR_EACH (i, list) {
+  ATTR_FOR_EACH_LEAF (o->list, o->attrleaves, list) {
     if (AF_Nodump(list))
       continue;
+    owner = AL_CREATOR(list);
+    owner = (owner >= 0 && owner < top) ? objs[owner].owner : Owner(owner);
     db_write_labeled_string(f, " name", AL_NAME(list));
-    db_write_labeled_dbref(f, "  owner", Owner(AL_CREATOR(list)));
+    db_write_labeled_dbref(f, "  owner", owner);
     db_write_labeled_string(f, "  flags", atrflag_to_string(AL_FLAGS(list)));
     db_write_labeled_int(f, "  derefs", AL_DEREFS(list));
     db_write_labeled_string(f, "  value", atr_value(list));
   }
-  return 0;
 }
 
 /** Write out the object database to disk.
@@ -721,6 +745,28 @@ dbref
 db_write(PENNFILE *f, int flag)
 {
   dbref i;
+
+  db_write_header(f, flag);
+
+  for (i = 0; i < db_top; i++) {
+#ifdef WIN32SERVICES
+    /* Keep the service manager happy */
+    if (shutdown_flag && (i & 0xFF) == 0)
+      shutdown_checkpoint();
+#endif
+    if (IsGarbage(i))
+      continue;
+    penn_fprintf(f, "!%d\n", i);
+    db_write_object(f, i);
+  }
+  penn_fputs(EOD, f);
+  return db_top;
+}
+
+/* Write everything in a database before its objects. */
+static void
+db_write_header(PENNFILE *f, int flag)
+{
   int dbflag;
 
   /* print a header line to make a later conversion to 2.0 easier to do.
@@ -763,20 +809,6 @@ db_write(PENNFILE *f, int flag)
   db_write_attrs(f);
 
   penn_fprintf(f, "~%d\n", db_top);
-
-  for (i = 0; i < db_top; i++) {
-#ifdef WIN32SERVICES
-    /* Keep the service manager happy */
-    if (shutdown_flag && (i & 0xFF) == 0)
-      shutdown_checkpoint();
-#endif
-    if (IsGarbage(i))
-      continue;
-    penn_fprintf(f, "!%d\n", i);
-    db_write_object(f, i);
-  }
-  penn_fputs(EOD, f);
-  return db_top;
 }
 
 static void
@@ -795,6 +827,196 @@ db_write_attrs(PENNFILE *f)
   attr_write_all(f);
 }
 
+/* Snapshot dumps write the database a slice at a time from the main
+ * loop, as it was when the dump began. The fixed fields of every object
+ * are copied at the start; the strings, flagsets, locks and attributes
+ * they point to are shared with the live db until something is about to
+ * change them, when snapshot_preserve() writes the object out to memory
+ * first if the dump hasn't got to it yet.
+ */
+
+/** A snapshot dump in progress */
+static struct snapshot {
+  PENNFILE *f;         /**< File being written, or NULL if there's no dump */
+  struct object *objs; /**< The objects as of the start of the dump */
+  PENNFILE **saved;    /**< Objects written out early, before changing */
+  dbref top;           /**< db_top as of the start of the dump */
+  dbref next;          /**< The next object to write */
+  int preserved;       /**< How many objects were written out early */
+} snap = {NULL, NULL, NULL, 0, 0, 0};
+
+/* Write an object as it was at the start of the snapshot. */
+static void
+snapshot_write_object(PENNFILE *f, dbref i)
+{
+  penn_fprintf(f, "!%d\n", i);
+  db_write_obj(f, snap.objs + i, snap.objs, snap.top);
+}
+
+/** Start a snapshot dump.
+ * Writes the header of the database and notes the current state of
+ * every object. The objects are written by snapshot_write_some().
+ * \param f the file to write to. It's closed by the caller once the
+ * dump is done or has failed.
+ */
+void
+snapshot_begin(PENNFILE *f)
+{
+  attrs_load_all();
+  snap.top = db_top;
+  snap.next = 0;
+  snap.preserved = 0;
+  snap.objs = mush_malloc(sizeof(struct object) * db_top, "db.snapshot");
+  memcpy(snap.objs, db, sizeof(struct object) * db_top);
+  snap.saved = mush_calloc(db_top, sizeof(PENNFILE *), "db.snapshot");
+  snap.f = f;
+  db_write_header(f, 0);
+}
+
+/** Write some of the objects of a snapshot dump.
+ * \param count the most objects to write.
+ * \retval true the dump is finished.
+ * \retval false there are more objects to write.
+ */
+bool
+snapshot_write_some(int count)
+{
+  dbref i;
+
+  while (snap.next < snap.top && count-- > 0) {
+    i = snap.next++;
+    if (snap.saved[i]) {
+      penn_fputs(snap.saved[i]->handle.m.buf, snap.f);
+      penn_fclose(snap.saved[i]);
+      snap.saved[i] = NULL;
+    } else if ((snap.objs[i].type & TYPE_GARBAGE) != TYPE_GARBAGE) {
+      snapshot_write_object(snap.f, i);
+    }
+  }
+  if (snap.next < snap.top) {
+    return false;
+  }
+  penn_fputs(EOD, snap.f);
+  return true;
+}
+
+/** Stop a snapshot dump, finished or not.
+ * \return the number of objects that had to be written out early.
+ */
+int
+snapshot_end(void)
+{
+  dbref i;
+
+  if (!snap.f) {
+    return 0;
+  }
+  for (i = 0; i < snap.top; i++) {
+    if (snap.saved[i]) {
+      penn_fclose(snap.saved[i]);
+    }
+  }
+  mush_free(snap.saved, "db.snapshot");
+  mush_free(snap.objs, "db.snapshot");
+  snap.saved = NULL;
+  snap.objs = NULL;
+  snap.f = NULL;
+  return snap.preserved;
+}
+
+/** Is a snapshot dump being written? */
+bool
+snapshot_running(void)
+{
+  return snap.f != NULL;
+}
+
+/** Keep the state of an object for the snapshot dump being written.
+ * Call this before changing or freeing anything an object points to -
+ * its name, flags, powers, locks or attributes. Changes to its other
+ * fields don't need it.
+ * \param thing the object about to change.
+ */
+void
+snapshot_preserve(dbref thing)
+{
+  if (!snap.f || thing < snap.next || thing >= snap.top ||
+      snap.saved[thing] ||
+      (snap.objs[thing].type & TYPE_GARBAGE) == TYPE_GARBAGE) {
+    return;
+  }
+  snap.saved[thing] = penn_mopen();
+  snapshot_write_object(snap.saved[thing], thing);
+  snap.preserved++;
+}
+
+/* Check an attribute's name and owner for a paranoid dump, logging
+ * problems. name gets the name to write, with unprintable characters
+ * replaced, and owner the owner.
+ * \return true if the name or owner had to be fixed.
+ */
+static bool
+paranoid_check_attr(dbref i, ALIST *list, char *name, dbref *owner)
+{
+  bool fixed = 0, err = 0;
+  char *p;
+
+  /* smash unprintable characters in the name, replace with ! */
+  mush_strncpy(name, AL_NAME(list), ATTRIBUTE_NAME_LIMIT + 1);
+  for (p = name; *p; p++) {
+    if (!ascii_isprint(*p) || isspace(*p)) {
+      *p = '!';
+      err = 1;
+    }
+  }
+  if (err) {
+    fixed = 1;
+    /* If name already exists on this object, try adding a
+     * number to the end. Give up if we can't find one < 10000
+     */
+    if (atr_get_noparent(i, name)) {
+      int count = 0;
+      char newname[ATTRIBUTE_NAME_LIMIT + 1];
+      do {
+        snprintf(newname, sizeof newname, "%.1018s%d", name, count);
+        count++;
+      } while (count < 10000 && atr_get_noparent(i, newname));
+      strcpy(name, newname);
+    }
+    do_rawlog(LT_CHECK, " * Bad attribute name on #%d. Changing name to %s.\n",
+              i, name);
+  }
+  /* check the owner */
+  *owner = AL_CREATOR(list);
+  if (!GoodObject(*owner)) {
+    do_rawlog(LT_CHECK, " * Bad owner on attribute %s on #%d.\n", name, i);
+    *owner = GOD;
+    fixed = 1;
+  } else {
+    *owner = Owner(*owner);
+  }
+  return fixed;
+}
+
+/* Replace characters that don't belong in an attribute value with '!'.
+ * \return true if there were any.
+ */
+static bool
+paranoid_fix_text(char *text)
+{
+  bool err = 0;
+
+  /* get rid of unprintables and hard newlines */
+  for (; *text; text++) {
+    if (!char_isprint(*text) && !isspace(*text) && *text != TAG_START &&
+        *text != TAG_END && *text != ESC_CHAR && *text != BEEP_CHAR) {
+      *text = '!';
+      err = 1;
+    }
+  }
+  return err;
+}
+
 /** Write out an object, in paranoid fashion.
  * This function writes a single object out to a file in paranoid
  * mode, which warns about several potential types of corruption,
@@ -810,11 +1032,10 @@ db_paranoid_write_object(PENNFILE *f, dbref i, int flag)
   ALIST *list;
   char name[ATTRIBUTE_NAME_LIMIT + 1];
   char tbuf1[BUFFER_LEN];
-  char *p;
   int attrcount = 0;
 
   o = db + i;
-  db_write_obj_basic(f, i, o);
+  db_write_obj_basic(f, o);
 
   /* write the attribute list, scanning */
   ATTR_FOR_EACH (i, list) {
@@ -825,51 +1046,15 @@ db_paranoid_write_object(PENNFILE *f, dbref i, int flag)
 
   db_write_labeled_int(f, "attrcount", attrcount);
 
-  list = o->list;
-  for (int seen = 0; seen < AttrCount(i); seen++, list++) {
-    bool fixmemdb = 0, err = 0;
-    bool fixname = 0, fixtext = 0;
+  ATTR_FOR_EACH (i, list) {
+    bool fixmemdb, fixname, fixtext = 0;
     dbref owner;
 
     if (AF_Nodump(list))
       continue;
 
-    /* smash unprintable characters in the name, replace with ! */
-    mush_strncpy(name, AL_NAME(list), sizeof name);
-    for (p = name; *p; p++) {
-      if (!ascii_isprint(*p) || isspace(*p)) {
-        *p = '!';
-        err = 1;
-      }
-    }
-    if (err) {
-      fixname = fixmemdb = 1;
-      /* If name already exists on this object, try adding a
-       * number to the end. Give up if we can't find one < 10000
-       */
-      if (atr_get_noparent(i, name)) {
-        int count = 0;
-        char newname[ATTRIBUTE_NAME_LIMIT + 1];
-        do {
-          snprintf(newname, sizeof newname, "%.1018s%d", name, count);
-          count++;
-        } while (count < 10000 && atr_get_noparent(i, newname));
-        strcpy(name, newname);
-      }
-      do_rawlog(LT_CHECK,
-                " * Bad attribute name on #%d. Changing name to %s.\n", i,
-                name);
-      err = 0;
-    }
-    /* check the owner */
-    owner = AL_CREATOR(list);
-    if (!GoodObject(owner)) {
-      do_rawlog(LT_CHECK, " * Bad owner on attribute %s on #%d.\n", name, i);
-      owner = GOD;
-      fixmemdb = 1;
-    } else {
-      owner = Owner(owner);
-    }
+    fixmemdb = paranoid_check_attr(i, list, name, &owner);
+    fixname = strcmp(name, AL_NAME(list)) != 0;
 
     /* write that info out */
     db_write_labeled_string(f, " name", name);
@@ -879,15 +1064,7 @@ db_paranoid_write_object(PENNFILE *f, dbref i, int flag)
 
     /* now check the attribute */
     mush_strncpy(tbuf1, atr_value(list), sizeof tbuf1);
-    /* get rid of unprintables and hard newlines */
-    for (p = tbuf1; *p; p++) {
-      if (!char_isprint(*p) && !isspace(*p) && *p != TAG_START &&
-          *p != TAG_END && *p != ESC_CHAR && *p != BEEP_CHAR) {
-        *p = '!';
-        err = 1;
-      }
-    }
-    if (err) {
+    if (paranoid_fix_text(tbuf1)) {
       fixtext = fixmemdb = 1;
       do_rawlog(LT_CHECK, " * Bad text in attribute %s on #%d. Changed to:\n",
                 name, i);
@@ -905,7 +1082,7 @@ db_paranoid_write_object(PENNFILE *f, dbref i, int flag)
           return 0;
 
         chunk_delete(list->data);
-        list->data = chunk_create(t, strlen(t), 0);
+        list->data = chunk_create_shared(t, strlen(t), 0);
         free(t);
       }
       if (fixname) {
@@ -927,6 +1104,584 @@ db_paranoid_write_object(PENNFILE *f, dbref i, int flag)
   return 0;
 }
 
+/* Paranoid dumps check and quote attribute values, which is most of
+ * their work, on worker threads. The objects are cut into ranges. For
+ * each range, the dumping thread writes everything except the attribute
+ * values into a memory PENNFILE, noting where each value goes and
+ * copying its compressed text. A worker uncompresses and checks the
+ * values, assembles the range's text and takes its CRC-32. Ranges are
+ * written out in order. After the end of the dump comes a list of their
+ * lengths and CRCs, which db_check_sums() verifies on startup.
+ *
+ * Workers never touch the database or the memory checker. The text they
+ * assemble is allocated with plain malloc().
+ */
+
+#define DUMP_RANGE_OBJECTS 1024 /**< Most objects in a range */
+#define DUMP_RANGE_BYTES (256 * 1024) /**< Value bytes to end a range at */
+#define DUMP_MAX_THREADS 16 /**< Most worker threads */
+#define DUMP_SUMS "+CHECKSUMS\n" /**< Starts the list of range CRCs */
+
+/** One attribute value in a range */
+struct dump_value {
+  dbref thing;  /**< Object the attribute is on */
+  size_t name;  /**< Offset of the attribute's name in the range data */
+  size_t value; /**< Offset of the compressed value in the range data */
+  size_t at;    /**< Where the value goes in the skeleton */
+  char *fixed;  /**< The value, if the worker had to fix it */
+};
+
+/** A run of objects being dumped */
+struct dump_range {
+  struct dump_range *next;   /**< Next range in write order */
+  struct dump_range *qnext;  /**< Next range waiting for a worker */
+  dbref first;               /**< First object, or NOTHING for the header */
+  PENNFILE *skel;            /**< Everything but the attribute values */
+  struct dump_value *values; /**< The attribute values */
+  int nvalues;               /**< Number of values */
+  int maxvalues;             /**< Allocated size of values */
+  char *data;                /**< Attribute names and compressed values */
+  size_t used;               /**< Bytes of data in use */
+  size_t size;               /**< Allocated size of data */
+  char *text;                /**< The assembled range, from malloc() */
+  size_t len;                /**< Length of text */
+  size_t textsize;           /**< Allocated size of text */
+  uint32_t crc;              /**< CRC-32 of text */
+  bool done;                 /**< Has it been assembled? */
+};
+
+/** The length and CRC of one range of a dump */
+struct dump_sum {
+  dbref first;  /**< First object in the range, or NOTHING */
+  size_t len;   /**< Length of the range */
+  uint32_t crc; /**< CRC-32 of the range */
+};
+
+static struct dump_sum *db_sums = NULL; /**< Sums of the loaded database */
+static int db_nsums = 0;                /**< Number of db_sums, -1 if bad */
+
+/** Update a CRC-32 with more bytes. */
+static uint32_t
+dump_crc32(uint32_t crc, const char *buf, size_t len)
+{
+#ifdef HAVE_LIBZ
+  return crc32(crc, (const Bytef *) buf, len);
+#else
+  crc = ~crc;
+  while (len--) {
+    int k;
+    crc ^= (unsigned char) *buf++;
+    for (k = 0; k < 8; k++) {
+      crc = (crc >> 1) ^ (0xEDB88320U & -(crc & 1));
+    }
+  }
+  return ~crc;
+#endif
+}
+
+/* Make room for len bytes and a NUL in a range's data. Returns where
+ * they go. */
+static size_t
+dump_range_reserve(struct dump_range *r, size_t len)
+{
+  size_t at = r->used;
+
+  if (r->used + len + 1 > r->size) {
+    while (r->used + len + 1 > r->size) {
+      r->size *= 2;
+    }
+    r->data = mush_realloc(r->data, r->size, "dump.data");
+  }
+  r->data[r->used + len] = '\0';
+  r->used += len + 1;
+  return at;
+}
+
+static struct dump_range *
+dump_range_new(dbref first)
+{
+  struct dump_range *r;
+
+  r = mush_malloc_zero(sizeof *r, "dump.range");
+  r->first = first;
+  r->skel = penn_mopen();
+  r->maxvalues = 64;
+  r->values = mush_malloc(r->maxvalues * sizeof *r->values, "dump.values");
+  r->size = BUFFER_LEN;
+  r->data = mush_malloc(r->size, "dump.data");
+  return r;
+}
+
+static void
+dump_range_free(struct dump_range *r)
+{
+  int i;
+
+  for (i = 0; i < r->nvalues; i++) {
+    free(r->values[i].fixed);
+  }
+  free(r->text);
+  penn_fclose(r->skel);
+  mush_free(r->values, "dump.values");
+  mush_free(r->data, "dump.data");
+  mush_free(r, "dump.range");
+}
+
+/* Write the skeleton of one object into a range: everything
+ * db_paranoid_write_object() would, except the attribute values. */
+static void
+dump_range_add_object(struct dump_range *r, dbref i)
+{
+  PENNFILE *f = r->skel;
+  ALIST *list;
+  char name[ATTRIBUTE_NAME_LIMIT + 1];
+  int attrcount = 0;
+
+  penn_fprintf(f, "!%d\n", i);
+  db_write_obj_basic(f, db + i);
+
+  ATTR_FOR_EACH (i, list) {
+    if (AF_Nodump(list))
+      continue;
+    attrcount++;
+  }
+  db_write_labeled_int(f, "attrcount", attrcount);
+
+  ATTR_FOR_EACH (i, list) {
+    struct dump_value *v;
+    dbref owner;
+    uint32_t vlen = list->data ? chunk_len(list->data) : 0;
+
+    if (AF_Nodump(list))
+      continue;
+
+    (void) paranoid_check_attr(i, list, name, &owner);
+    db_write_labeled_string(f, " name", name);
+    db_write_labeled_dbref(f, "  owner", owner);
+    db_write_labeled_string(f, "  flags", atrflag_to_string(AL_FLAGS(list)));
+    db_write_labeled_int(f, "  derefs", AL_DEREFS(list));
+    db_write_label(f, "  value");
+
+    if (r->nvalues == r->maxvalues) {
+      r->maxvalues *= 2;
+      r->values =
+        mush_realloc(r->values, r->maxvalues * sizeof *r->values, "dump.values");
+    }
+    v = r->values + r->nvalues++;
+    v->thing = i;
+    v->name = dump_range_reserve(r, strlen(name));
+    strcpy(r->data + v->name, name);
+    v->value = dump_range_reserve(r, vlen);
+    if (vlen) {
+      chunk_fetch(list->data, r->data + v->value, vlen);
+    }
+    v->at = f->handle.m.len;
+    v->fixed = NULL;
+  }
+}
+
+static void
+dump_text_append(struct dump_range *r, const char *s, size_t len)
+{
+  if (r->len + len + 1 > r->textsize) {
+    while (r->len + len + 1 > r->textsize) {
+      r->textsize *= 2;
+    }
+    r->text = realloc(r->text, r->textsize);
+  }
+  memcpy(r->text + r->len, s, len);
+  r->len += len;
+  r->text[r->len] = '\0';
+}
+
+/** Check and quote the attribute values of a range, assembling its text.
+ * Called from worker threads, so it must not use static buffers.
+ */
+static void
+dump_assemble_range(struct dump_range *r)
+{
+  const char *skel = r->skel->handle.m.buf;
+  char value[BUFFER_LEN];
+  char quoted[BUFFER_LEN * 2 + 3];
+  size_t from = 0;
+  int i;
+
+  r->textsize = r->skel->handle.m.len + r->used + 64;
+  r->text = malloc(r->textsize);
+  r->len = 0;
+  for (i = 0; i < r->nvalues; i++) {
+    struct dump_value *v = r->values + i;
+    char *qp = quoted;
+    const char *p;
+
+    dump_text_append(r, skel + from, v->at - from);
+    from = v->at;
+
+    text_uncompress_r(r->data + v->value, value);
+    if (paranoid_fix_text(value)) {
+      v->fixed = strdup(value);
+    }
+    /* As putstring() */
+    *qp++ = '"';
+    for (p = value; *p; p++) {
+      if (*p == '\\' || *p == '"') {
+        *qp++ = '\\';
+      }
+      *qp++ = *p;
+    }
+    *qp++ = '"';
+    *qp++ = '\n';
+    dump_text_append(r, quoted, qp - quoted);
+  }
+  dump_text_append(r, skel + from, r->skel->handle.m.len - from);
+  r->crc = dump_crc32(0, r->text, r->len);
+}
+
+#ifdef HAVE_PTHREAD_H
+/* The workers of the running dump */
+static pthread_mutex_t dump_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dump_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t dump_assembled = PTHREAD_COND_INITIALIZER;
+static struct dump_range *dump_queue = NULL;
+static struct dump_range *dump_queue_tail = NULL;
+static bool dump_stopping = 0;
+static pthread_t dump_workers[DUMP_MAX_THREADS];
+
+static void *
+dump_worker(void *arg __attribute__((__unused__)))
+{
+  for (;;) {
+    struct dump_range *r;
+
+    pthread_mutex_lock(&dump_lock);
+    while (!dump_queue && !dump_stopping) {
+      pthread_cond_wait(&dump_wakeup, &dump_lock);
+    }
+    r = dump_queue;
+    if (!r) {
+      pthread_mutex_unlock(&dump_lock);
+      break;
+    }
+    dump_queue = r->qnext;
+    if (!dump_queue) {
+      dump_queue_tail = NULL;
+    }
+    pthread_mutex_unlock(&dump_lock);
+
+    dump_assemble_range(r);
+
+    pthread_mutex_lock(&dump_lock);
+    r->done = 1;
+    pthread_cond_broadcast(&dump_assembled);
+    pthread_mutex_unlock(&dump_lock);
+  }
+  return NULL;
+}
+#endif /* HAVE_PTHREAD_H */
+
+/* Start up to dump_threads workers. Returns how many started. */
+static int
+dump_start_workers(void)
+{
+  int n = 0;
+#ifdef HAVE_PTHREAD_H
+  int want = options.dump_threads;
+
+  if (want > DUMP_MAX_THREADS) {
+    want = DUMP_MAX_THREADS;
+  }
+  dump_stopping = 0;
+  while (n < want) {
+    if (pthread_create(&dump_workers[n], NULL, dump_worker, NULL) != 0) {
+      do_rawlog(LT_ERR, "Unable to start dump worker thread.");
+      break;
+    }
+    n++;
+  }
+#endif
+  return n;
+}
+
+static void
+dump_stop_workers(int n)
+{
+#ifdef HAVE_PTHREAD_H
+  int i;
+
+  pthread_mutex_lock(&dump_lock);
+  dump_stopping = 1;
+  pthread_cond_broadcast(&dump_wakeup);
+  pthread_mutex_unlock(&dump_lock);
+  for (i = 0; i < n; i++) {
+    pthread_join(dump_workers[i], NULL);
+  }
+#endif
+}
+
+/* Have a range assembled, by a worker if there are any. */
+static void
+dump_submit(struct dump_range *r, int nworkers)
+{
+#ifdef HAVE_PTHREAD_H
+  if (nworkers > 0) {
+    pthread_mutex_lock(&dump_lock);
+    r->qnext = NULL;
+    if (dump_queue_tail) {
+      dump_queue_tail->qnext = r;
+    } else {
+      dump_queue = r;
+    }
+    dump_queue_tail = r;
+    pthread_cond_signal(&dump_wakeup);
+    pthread_mutex_unlock(&dump_lock);
+    return;
+  }
+#endif
+  dump_assemble_range(r);
+  r->done = 1;
+}
+
+static void
+dump_wait(struct dump_range *r)
+{
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_lock(&dump_lock);
+  while (!r->done) {
+    pthread_cond_wait(&dump_assembled, &dump_lock);
+  }
+  pthread_mutex_unlock(&dump_lock);
+#endif
+}
+
+/* Write out an assembled range, logging any values that had to be
+ * fixed, and note its length and CRC. */
+static void
+dump_write_range(PENNFILE *f, struct dump_range *r, struct dump_sum *sum)
+{
+  int i;
+
+  for (i = 0; i < r->nvalues; i++) {
+    if (r->values[i].fixed) {
+      do_rawlog(LT_CHECK, " * Bad text in attribute %s on #%d. Changed to:\n",
+                r->data + r->values[i].name, r->values[i].thing);
+      do_rawlog(LT_CHECK, "%s\n", r->values[i].fixed);
+    }
+  }
+  penn_fputs(r->text, f);
+  sum->first = r->first;
+  sum->len = r->len;
+  sum->crc = r->crc;
+}
+
+/* The paranoid dump being written: its ranges not yet written out, the
+ * checksums of those that have been, and how many workers are running.
+ * Kept here rather than on the stack so they survive a longjmp. */
+static struct dump_range *dump_out_head = NULL;
+static struct dump_sum *dump_out_sums = NULL;
+static int dump_nworkers = 0;
+
+/* Write the ranges of a paranoid dump, starting with dump_out_head,
+ * followed by the end of dump marker and the checksums. */
+static void
+dump_write_ranges(PENNFILE *f)
+{
+  struct dump_range *tail = dump_out_head;
+  int nsums = 0, maxsums = 16;
+  int inflight = 1, maxinflight;
+  dbref i = 0;
+
+  dump_out_sums = mush_malloc(maxsums * sizeof *dump_out_sums, "dump.sums");
+  dump_assemble_range(dump_out_head);
+  dump_out_head->done = 1;
+  dump_nworkers = dump_start_workers();
+  maxinflight = dump_nworkers * 2 + 1;
+
+  while (dump_out_head) {
+    if (i < db_top && inflight < maxinflight) {
+      /* Cut another range */
+      struct dump_range *r = dump_range_new(i);
+      int n;
+
+      for (n = 0; n < DUMP_RANGE_OBJECTS && i < db_top &&
+                  r->used < DUMP_RANGE_BYTES;
+           i++) {
+#ifdef WIN32SERVICES
+        /* Keep the service manager happy */
+        if (shutdown_flag && (i & 0xFF) == 0)
+          shutdown_checkpoint();
+#endif
+        if (IsGarbage(i))
+          continue;
+        dump_range_add_object(r, i);
+        n++;
+        /* print out a message every so many objects */
+        if (i % globals.paranoid_checkpt == 0)
+          do_rawlog(LT_CHECK, "\t...wrote up to object #%d\n", i);
+      }
+      tail->next = r;
+      tail = r;
+      inflight++;
+      dump_submit(r, dump_nworkers);
+      continue;
+    }
+    dump_wait(dump_out_head);
+    if (nsums == maxsums) {
+      maxsums *= 2;
+      dump_out_sums = mush_realloc(
+        dump_out_sums, maxsums * sizeof *dump_out_sums, "dump.sums");
+    }
+    dump_write_range(f, dump_out_head, &dump_out_sums[nsums++]);
+    {
+      struct dump_range *next = dump_out_head->next;
+      dump_range_free(dump_out_head);
+      dump_out_head = next;
+    }
+    inflight--;
+  }
+  dump_stop_workers(dump_nworkers);
+  dump_nworkers = 0;
+
+  penn_fputs(EOD, f);
+  penn_fputs(DUMP_SUMS, f);
+  penn_fprintf(f, "%d\n", nsums);
+  for (i = 0; i < nsums; i++) {
+    penn_fprintf(f, "%d %lu %08lx\n", dump_out_sums[i].first,
+                 (unsigned long) dump_out_sums[i].len,
+                 (unsigned long) dump_out_sums[i].crc);
+  }
+  mush_free(dump_out_sums, "dump.sums");
+  dump_out_sums = NULL;
+}
+
+/* Write the objects of a paranoid dump, preceded by its header, and
+ * followed by the end of dump marker and the checksums. */
+static void
+db_paranoid_write_ranges(PENNFILE *f, struct dump_range *header)
+{
+  jmp_buf saved;
+
+  dump_out_head = header;
+  /* A failed write longjmps out; stop the workers and free the ranges
+   * before passing the error on to the dump's own handler. */
+  memcpy(saved, db_err, sizeof saved);
+  if (setjmp(db_err)) {
+    memcpy(db_err, saved, sizeof saved);
+    dump_stop_workers(dump_nworkers);
+    dump_nworkers = 0;
+    while (dump_out_head) {
+      struct dump_range *next = dump_out_head->next;
+      dump_range_free(dump_out_head);
+      dump_out_head = next;
+    }
+    if (dump_out_sums) {
+      mush_free(dump_out_sums, "dump.sums");
+      dump_out_sums = NULL;
+    }
+    longjmp(db_err, 1);
+  }
+  dump_write_ranges(f);
+  memcpy(db_err, saved, sizeof saved);
+}
+
+/** Read the range checksums that follow the end of a paranoid dump, if
+ * there are any.
+ * \param f file pointer to read from, just after the end of dump marker.
+ */
+static void
+db_read_sums(PENNFILE *f)
+{
+  char buff[BUFFER_LEN];
+  int c, n, i;
+
+  if (db_sums) {
+    mush_free(db_sums, "dump.sums");
+    db_sums = NULL;
+  }
+  db_nsums = 0;
+  c = penn_fgetc(f);
+  if (c != '+') {
+    if (c != EOF)
+      penn_ungetc(c, f);
+    return;
+  }
+  if (!penn_fgets(buff, sizeof buff, f) || strcmp(buff, DUMP_SUMS + 1) != 0 ||
+      !penn_fgets(buff, sizeof buff, f) || (n = parse_integer(buff)) < 1) {
+    do_rawlog(LT_ERR, "ERROR: Unreadable checksums after the end of dump.");
+    db_nsums = -1;
+    return;
+  }
+  db_sums = mush_malloc(n * sizeof *db_sums, "dump.sums");
+  for (i = 0; i < n; i++) {
+    unsigned long len, crc;
+
+    if (!penn_fgets(buff, sizeof buff, f) ||
+        sscanf(buff, "%d %lu %lx", &db_sums[i].first, &len, &crc) != 3) {
+      do_rawlog(LT_ERR, "ERROR: Unreadable checksums after the end of dump.");
+      db_nsums = -1;
+      return;
+    }
+    db_sums[i].len = len;
+    db_sums[i].crc = crc;
+  }
+  db_nsums = n;
+}
+
+/** Does the database that was just read have checksums to verify? */
+bool
+db_has_sums(void)
+{
+  return db_nsums != 0;
+}
+
+/** Verify a database file against the checksums read with it.
+ * \param f the database file, opened again from the start.
+ * \return the number of ranges that don't match; 0 if it's intact.
+ */
+int
+db_check_sums(PENNFILE *f)
+{
+  char buff[BUFFER_LEN];
+  int i, bad = 0;
+
+  if (db_nsums < 0) {
+    return 1;
+  }
+  for (i = 0; i < db_nsums; i++) {
+    size_t left = db_sums[i].len;
+    uint32_t crc = 0;
+
+    while (left > 0) {
+      size_t len;
+
+      if (!penn_fgets(buff, left + 1 < sizeof buff ? left + 1 : sizeof buff,
+                      f)) {
+        break;
+      }
+      len = strlen(buff);
+      if (len == 0) {
+        break;
+      }
+      crc = dump_crc32(crc, buff, len);
+      left -= len;
+    }
+    if (left > 0 || crc != db_sums[i].crc) {
+      if (db_sums[i].first == NOTHING)
+        do_rawlog(LT_ERR, "ERROR: Checksum mismatch in the database header.");
+      else
+        do_rawlog(LT_ERR,
+                  "ERROR: Checksum mismatch in objects from #%d onwards.",
+                  db_sums[i].first);
+      bad++;
+      if (left > 0) {
+        /* Can't tell where the later ranges are */
+        bad += db_nsums - i - 1;
+        break;
+      }
+    }
+  }
+  return bad;
+}
+
 /** Write out the object database to disk, in paranoid mode.
  * \verbatim
  * This function writes the databsae out to disk, in paranoid mode.
@@ -975,7 +1730,24 @@ db_paranoid_write(PENNFILE *f, int flag)
 
   do_rawlog(LT_CHECK, "PARANOID WRITE BEGINNING...\n");
 
-  penn_fprintf(f, "+V%u\n", dbflag * 256 + 2);
+  if (!flag) {
+    /* A normal paranoid dump only reads the db, so the objects can be
+     * written in ranges, with their attribute values checked by worker
+     * threads. */
+    struct dump_range *header = dump_range_new(NOTHING);
+
+    penn_fprintf(header->skel, "+V%d\n", dbflag * 256 + 2);
+    db_write_labeled_int(header->skel, "dbversion", NDBF_VERSION);
+    db_write_labeled_string(header->skel, "savedtime", show_time(mudtime, 1));
+    db_write_flags(header->skel);
+    penn_fprintf(header->skel, "~%d\n", db_top);
+    db_paranoid_write_ranges(f, header);
+    do_rawlog(LT_CHECK, "\t...finished at object #%d\n", db_top - 1);
+    do_rawlog(LT_CHECK, "END OF PARANOID WRITE.\n");
+    return db_top;
+  }
+
+  penn_fprintf(f, "+V%d\n", dbflag * 256 + 2);
   db_write_labeled_int(f, "dbversion", NDBF_VERSION);
   db_write_labeled_string(f, "savedtime", show_time(mudtime, 1));
   db_write_flags(f);
@@ -1200,6 +1972,9 @@ db_free(void)
 {
   if (db) {
     dbref i;
+
+    /* Attributes not read yet have nothing to free */
+    attrs_forget();
     for (i = 0; i < db_top; i++) {
       set_name(i, NULL);
       atr_free_all(i);
@@ -1373,6 +2148,246 @@ db_read_attrs(PENNFILE *f, dbref i, int count)
               found, count);
 }
 
+/* Lazily loaded attributes.
+ *
+ * With lazy_attributes on and an uncompressed input database, the
+ * loader maps the database into memory and, for each object, notes
+ * where its attribute list is instead of reading it. The list is read
+ * from the map the first time List() is used on the object, a slice
+ * at a time by attrs_load_some() from a timer, or all at once by
+ * attrs_load_all() before a dump or @dbck. The map is dropped when
+ * nothing is left to read. Skipping a list also notes whether it has a
+ * STARTUP or ALIAS attribute, so that do_restart() only has to read the
+ * objects that do.
+ */
+
+/** Objects whose attributes haven't been read from the database yet */
+int attrs_unloaded = 0;
+
+/** Where an object's attributes are in the input database */
+struct lazy_attrs {
+  size_t at; /**< Offset of the first attribute */
+  int count; /**< Number of attributes; 0 once they're read */
+  int has;   /**< LAZY_* attributes seen in the list */
+};
+
+static struct lazy_attrs *lazy_attrs = NULL; /**< Indexed by dbref */
+static dbref lazy_top = 0;                   /**< Allocated size of lazy_attrs */
+static dbref lazy_next = 0;          /**< Where attrs_load_some() resumes */
+static MAPPED_FILE *lazy_map = NULL; /**< The mapped input database */
+static const char *lazy_data = NULL; /**< Contents of the input database */
+static size_t lazy_len = 0;          /**< Length of lazy_data */
+
+/** Map an uncompressed database to read attributes from lazily.
+ * \param filename the file that db_read() will read.
+ * \retval true the file was mapped.
+ * \retval false it wasn't; attributes will be read as usual.
+ */
+bool
+attrs_map(const char *filename)
+{
+  lazy_map = map_file(filename, 0);
+  if (!lazy_map) {
+    return false;
+  }
+  lazy_data = lazy_map->data;
+  lazy_len = lazy_map->len;
+  return true;
+}
+
+/* Forget about attributes still to be read. */
+static void
+attrs_forget(void)
+{
+  if (lazy_attrs) {
+    mush_free(lazy_attrs, "db.lazyattrs");
+  }
+  lazy_attrs = NULL;
+  lazy_top = lazy_next = 0;
+  attrs_unloaded = 0;
+}
+
+/* Forget about attributes still to be read, and drop the map. */
+static void
+attrs_unmap(void)
+{
+  attrs_forget();
+  if (lazy_map) {
+    unmap_file(lazy_map);
+  }
+  lazy_map = NULL;
+  lazy_data = NULL;
+  lazy_len = 0;
+}
+
+/* Does an attribute's name line, at offset at, name the attribute
+ * name? */
+static bool
+lazy_is_named(const char *s, size_t at, size_t len, const char *name)
+{
+  size_t n = strlen(name);
+
+  return len - at > n + 6 && memcmp(s + at, "name \"", 6) == 0 &&
+         memcmp(s + at + 6, name, n) == 0 && s[at + 6 + n] == '"';
+}
+
+/* Find the end of a list of attributes: lines that start with a space,
+ * holding a label and a value, which may be a quoted string spanning
+ * lines. The LAZY_* attributes in the list are added to has. */
+static size_t
+lazy_skip_attrs(const char *s, size_t at, size_t len, int *has)
+{
+  while (at < len && s[at] == ' ') {
+    while (at < len && s[at] == ' ')
+      at++;
+    if (lazy_is_named(s, at, len, "STARTUP"))
+      *has |= LAZY_STARTUP;
+    else if (lazy_is_named(s, at, len, "ALIAS"))
+      *has |= LAZY_ALIAS;
+    while (at < len && s[at] != ' ' && s[at] != '\n')
+      at++;
+    if (at < len && s[at] == ' ')
+      at++;
+    if (at < len && s[at] == '"') {
+      for (at++; at < len && s[at] != '"'; at++) {
+        if (s[at] == '\\')
+          at++;
+      }
+    }
+    while (at < len && s[at] != '\n')
+      at++;
+    at++;
+  }
+  return at < len ? at : len;
+}
+
+/* Note that count attributes of an object start at offset at, with
+ * the LAZY_* attributes in has among them. */
+static void
+attrs_defer(dbref i, size_t at, int count, int has)
+{
+  if (i >= lazy_top) {
+    dbref top = lazy_top ? lazy_top : DB_INITIAL_SIZE;
+
+    while (top <= i)
+      top *= 2;
+    lazy_attrs =
+      mush_realloc(lazy_attrs, top * sizeof *lazy_attrs, "db.lazyattrs");
+    memset(lazy_attrs + lazy_top, 0, (top - lazy_top) * sizeof *lazy_attrs);
+    lazy_top = top;
+  }
+  if (!lazy_attrs[i].count)
+    attrs_unloaded++;
+  lazy_attrs[i].at = at;
+  lazy_attrs[i].count = count;
+  lazy_attrs[i].has = has;
+  db[i].attrcount = count;
+}
+
+/* Skip over an object's attributes, noting where they are. */
+static void
+db_defer_attrs(PENNFILE *f, dbref i, int count)
+{
+  long at = ftell(f->handle.f);
+  int has = 0;
+  size_t end = lazy_skip_attrs(lazy_data, at, lazy_len, &has);
+
+  fseek(f->handle.f, end, SEEK_SET);
+  attrs_defer(i, at, count, has);
+}
+
+/** Read an object's attributes if they haven't been yet.
+ * \param thing the object.
+ * \retval true they were read now.
+ * \retval false they already were.
+ */
+bool
+attrs_load(dbref thing)
+{
+  PENNFILE pf;
+  jmp_buf saved;
+  ATTR *a;
+  int count;
+
+  if (thing < 0 || thing >= lazy_top || !lazy_attrs[thing].count)
+    return false;
+
+  count = lazy_attrs[thing].count;
+  lazy_attrs[thing].count = 0;
+  attrs_unloaded--;
+  db[thing].attrcount = 0;
+
+  pf.type = PFT_MEMORY;
+  pf.handle.m.buf = (char *) lazy_data;
+  pf.handle.m.len = pf.handle.m.size = lazy_len;
+  pf.handle.m.pos = lazy_attrs[thing].at;
+
+  /* This may happen while a dump is writing, which has its own
+   * error handler. */
+  memcpy(saved, db_err, sizeof saved);
+  if (setjmp(db_err)) {
+    do_rawlog(LT_ERR, "ERROR: Unable to read the attributes of #%d.", thing);
+  } else {
+    db_read_attrs(&pf, thing, count);
+  }
+  memcpy(db_err, saved, sizeof saved);
+
+  /* As dbck() would have at startup */
+  ATTR_FOR_EACH (thing, a) {
+    if (!GoodObject(AL_CREATOR(a)))
+      AL_CREATOR(a) = GOD;
+  }
+
+  if (!attrs_unloaded)
+    attrs_unmap();
+  return true;
+}
+
+/** Have an object's attributes been read? */
+bool
+attrs_loaded(dbref thing)
+{
+  return !attrs_unloaded || thing < 0 || thing >= lazy_top ||
+         !lazy_attrs[thing].count;
+}
+
+/** Is an object known to lack some attributes without reading them?
+ * \param thing the object.
+ * \param which the LAZY_* attributes to look for.
+ * \retval true its attributes haven't been read, and none of them are
+ * any of which.
+ * \retval false they may be among its attributes.
+ */
+bool
+attrs_lack(dbref thing, int which)
+{
+  return !attrs_loaded(thing) && !(lazy_attrs[thing].has & which);
+}
+
+/** Read the attributes of some objects that haven't been yet.
+ * \param count how many objects to read.
+ * \return true if there are more left to read.
+ */
+bool
+attrs_load_some(int count)
+{
+  while (attrs_unloaded && count > 0 && lazy_next < lazy_top) {
+    if (attrs_load(lazy_next++))
+      count--;
+  }
+  return attrs_unloaded > 0;
+}
+
+/** Read the attributes of every object that haven't been yet. */
+void
+attrs_load_all(void)
+{
+  if (attrs_unloaded) {
+    do_rawlog(LT_CHECK, "Reading attributes of %d objects.", attrs_unloaded);
+    attrs_load_some(INT_MAX);
+  }
+}
+
 /** Read a non-labeled database from a file.
  * \param f the file to read from
  * \return number of objects in the database
@@ -1614,6 +2629,7 @@ db_read(PENNFILE *f)
   struct object *o;
   int minimum_flags = DBF_NEW_STRINGS | DBF_TYPE_GARBAGE | DBF_SPLIT_IMMORTAL |
                       DBF_NO_TEMPLE | DBF_SPIFFY_LOCKS;
+  bool lazy;
 
   log_mem_check();
 
@@ -1624,6 +2640,12 @@ db_read(PENNFILE *f)
   clear_players();
   db_free();
   globals.indb_flags = 1;
+  db_nsums = 0;
+
+  /* Attributes can only be skipped in a plain file */
+  lazy = lazy_data && f->type == PFT_FILE;
+  if (!lazy)
+    attrs_unmap();
 
   c = penn_fgetc(f);
   if (c != '+') {
@@ -1645,8 +2667,10 @@ db_read(PENNFILE *f)
     return -1;
   }
 
-  if (!(globals.indb_flags & DBF_LABELS))
+  if (!(globals.indb_flags & DBF_LABELS)) {
+    attrs_unmap();
     return db_read_oldstyle(f);
+  }
 
   if ((globals.indb_flags & DBF_NEW_VERSIONS)) {
     db_read_this_labeled_int(f, "dbversion", &i);
@@ -1840,7 +2864,10 @@ db_read(PENNFILE *f)
             break;
           case LBL_ATTRS: {
             int attrcount = parse_integer(value);
-            db_read_attrs(f, i, attrcount);
+            if (lazy && attrcount > 0)
+              db_defer_attrs(f, i, attrcount);
+            else
+              db_read_attrs(f, i, attrcount);
           } break;
           case LBL_ERROR:
           default:
@@ -1908,6 +2935,14 @@ db_read(PENNFILE *f)
            * ROOM. */
           set_flag_type_by_name("FLAG", "HAVEN", TYPE_PLAYER);
         }
+        /* A panic dump has other databases after the end of dump */
+        if (!(globals.indb_flags & DBF_PANIC))
+          db_read_sums(f);
+        if (attrs_unloaded)
+          do_rawlog(LT_ERR, "READING: attributes of %d objects deferred",
+                    attrs_unloaded);
+        else
+          attrs_unmap();
         do_rawlog(LT_ERR, "READING: done");
         sqlite3_exec(sqldb, "COMMIT TRANSACTION", NULL, NULL, NULL);
         loading_db = 0;
@@ -2822,6 +3857,47 @@ penn_fopen(const char *filename, const char *mode)
   return pf;
 }
 
+/** Open a PENNFILE that keeps what's written to it in memory, and reads
+ * it back from the start.
+ */
+PENNFILE *
+penn_mopen(void)
+{
+  PENNFILE *pf;
+
+  pf = mush_malloc(sizeof *pf, "pennfile");
+  pf->type = PFT_MEMORY;
+  pf->handle.m.size = BUFFER_LEN;
+  pf->handle.m.buf = mush_malloc(pf->handle.m.size, "pennfile.buffer");
+  pf->handle.m.buf[0] = '\0';
+  pf->handle.m.len = 0;
+  pf->handle.m.pos = 0;
+  return pf;
+}
+
+/* Make room for len more bytes, and the NUL, in a memory PENNFILE. */
+static void
+penn_mreserve(PENNFILE *pf, size_t len)
+{
+  if (pf->handle.m.len + len < pf->handle.m.size) {
+    return;
+  }
+  while (pf->handle.m.len + len >= pf->handle.m.size) {
+    pf->handle.m.size *= 2;
+  }
+  pf->handle.m.buf =
+    mush_realloc(pf->handle.m.buf, pf->handle.m.size, "pennfile.buffer");
+}
+
+static void
+penn_mwrite(PENNFILE *pf, const char *s, size_t len)
+{
+  penn_mreserve(pf, len);
+  memcpy(pf->handle.m.buf + pf->handle.m.len, s, len);
+  pf->handle.m.len += len;
+  pf->handle.m.buf[pf->handle.m.len] = '\0';
+}
+
 /* Close a db file, which may really be a pipe */
 void
 penn_fclose(PENNFILE *pf)
@@ -2840,6 +3916,9 @@ penn_fclose(PENNFILE *pf)
     gzclose(pf->handle.g);
 #endif
     break;
+  case PFT_MEMORY:
+    mush_free(pf->handle.m.buf, "pennfile.buffer");
+    break;
   }
   mush_free(pf, "pennfile");
 }
@@ -2861,6 +3940,10 @@ penn_fgetc(PENNFILE *f)
     return gzgetc(f->handle.g);
 #endif
     break;
+  case PFT_MEMORY:
+    if (f->handle.m.pos >= f->handle.m.len)
+      return EOF;
+    return (unsigned char) f->handle.m.buf[f->handle.m.pos++];
   }
   return 0;
 }
@@ -2881,6 +3964,17 @@ penn_fgets(char *buf, int len, PENNFILE *pf)
     return gzgets(pf->handle.g, buf, len);
 #endif
     break;
+  case PFT_MEMORY: {
+    char *p = buf;
+    if (len < 1 || pf->handle.m.pos >= pf->handle.m.len)
+      return NULL;
+    while (--len > 0 && pf->handle.m.pos < pf->handle.m.len) {
+      if ((*p++ = pf->handle.m.buf[pf->handle.m.pos++]) == '\n')
+        break;
+    }
+    *p = '\0';
+    return buf;
+  }
   }
   return NULL;
 }
@@ -2904,6 +3998,10 @@ penn_fputc(int c, PENNFILE *f)
     OUTPUT(gzputc(f->handle.g, c));
 #endif
     break;
+  case PFT_MEMORY: {
+    char ch = c;
+    penn_mwrite(f, &ch, 1);
+  } break;
   }
   return 0;
 }
@@ -2925,6 +4023,9 @@ penn_fputs(const char *s, PENNFILE *f)
     OUTPUT(gzputs(f->handle.g, s));
 #endif
     break;
+  case PFT_MEMORY:
+    penn_mwrite(f, s, strlen(s));
+    break;
   }
   return 0;
 }
@@ -2980,6 +4081,21 @@ penn_fprintf(PENNFILE *f, const char *fmt, ...)
 #endif
 #endif
     break;
+  case PFT_MEMORY: {
+    size_t room = f->handle.m.size - f->handle.m.len;
+    va_start(ap, fmt);
+    r = vsnprintf(f->handle.m.buf + f->handle.m.len, room, fmt, ap);
+    va_end(ap);
+    if (r < 0)
+      longjmp(db_err, 1);
+    if ((size_t) r >= room) {
+      penn_mreserve(f, r);
+      va_start(ap, fmt);
+      vsnprintf(f->handle.m.buf + f->handle.m.len, r + 1, fmt, ap);
+      va_end(ap);
+    }
+    f->handle.m.len += r;
+  } break;
   }
   return r;
 }
@@ -2997,6 +4113,10 @@ penn_ungetc(int c, PENNFILE *f)
     OUTPUT(gzungetc(c, f->handle.g));
 #endif
     break;
+  case PFT_MEMORY:
+    if (f->handle.m.pos > 0)
+      f->handle.m.pos--;
+    break;
   }
   return c;
 }
@@ -3013,6 +4133,232 @@ penn_feof(PENNFILE *pf)
     return gzeof(pf->handle.g);
 #endif
     break;
+  case PFT_MEMORY:
+    return pf->handle.m.pos >= pf->handle.m.len;
   }
   return 0;
 }
+
+/* Compare two dumps, ignoring attribute dereference counts, which
+ * go up as the values are read. */
+static bool
+dump_same_text(const char *a, const char *b, const char *bend)
+{
+  while (*a && b < bend) {
+    const char *aeol = strchr(a, '\n'), *beol = strchr(b, '\n');
+
+    if (!aeol || !beol)
+      return 0;
+    if (!(strncmp(a, "  derefs ", 9) == 0 && strncmp(b, "  derefs ", 9) == 0) &&
+        (aeol - a != beol - b || memcmp(a, b, aeol - a) != 0))
+      return 0;
+    a = aeol + 1;
+    b = beol + 1;
+  }
+  return !*a && b == bend;
+}
+
+TEST_GROUP(paranoid_dump)
+{
+  PENNFILE *debug, *ranges;
+  struct dump_sum *sums = db_sums;
+  int nsums = db_nsums;
+  int threads = options.dump_threads;
+  int checkpt = globals.paranoid_checkpt;
+  char *buf, *eod;
+
+  globals.paranoid_checkpt = db_top + 1;
+  debug = penn_mopen();
+  db_paranoid_write(debug, 1);
+  options.dump_threads = 4;
+  ranges = penn_mopen();
+  db_paranoid_write(ranges, 0);
+  buf = ranges->handle.m.buf;
+  eod = strstr(buf, EOD);
+  TEST("paranoid_dump.1", eod != NULL);
+  TEST("paranoid_dump.2",
+       eod && dump_same_text(debug->handle.m.buf, buf, eod + strlen(EOD)));
+  if (eod) {
+    db_sums = NULL;
+    ranges->handle.m.pos = eod - buf + strlen(EOD);
+    db_read_sums(ranges);
+    TEST("paranoid_dump.3", db_nsums > 1 && db_sums[0].first == NOTHING);
+    ranges->handle.m.pos = 0;
+    TEST("paranoid_dump.4", db_check_sums(ranges) == 0);
+    eod[-2] ^= 1;
+    ranges->handle.m.pos = 0;
+    TEST("paranoid_dump.5", db_check_sums(ranges) == 1);
+    if (db_sums)
+      mush_free(db_sums, "dump.sums");
+  }
+  penn_fclose(ranges);
+
+  /* A failed write stops the workers, and the next dump still works */
+  ranges = penn_fopen("/dev/full", "w");
+  if (ranges) {
+    jmp_buf saved;
+    volatile bool failed = 0;
+
+    setvbuf(ranges->handle.f, NULL, _IONBF, 0);
+    memcpy(saved, db_err, sizeof saved);
+    if (setjmp(db_err)) {
+      failed = 1;
+    } else {
+      db_paranoid_write(ranges, 0);
+    }
+    memcpy(db_err, saved, sizeof saved);
+    TEST("paranoid_dump.6", failed);
+    penn_fclose(ranges);
+    ranges = penn_mopen();
+    db_paranoid_write(ranges, 0);
+    eod = strstr(ranges->handle.m.buf, EOD);
+    TEST("paranoid_dump.7",
+         eod && dump_same_text(debug->handle.m.buf, ranges->handle.m.buf,
+                               eod + strlen(EOD)));
+    penn_fclose(ranges);
+  }
+  penn_fclose(debug);
+
+  BENCHMARK("paranoid dump (serial)", 20, {
+    PENNFILE *f = penn_mopen();
+    db_paranoid_write(f, 1);
+    penn_fclose(f);
+  });
+  BENCHMARK("paranoid dump (ranges)", 20, {
+    PENNFILE *f = penn_mopen();
+    db_paranoid_write(f, 0);
+    penn_fclose(f);
+  });
+
+  db_sums = sums;
+  db_nsums = nsums;
+  options.dump_threads = threads;
+  globals.paranoid_checkpt = checkpt;
+}
+
+TEST_GROUP(lazy_attrs)
+{
+  PENNFILE *f, pf;
+  struct object saved;
+  dbref thing = 0, top = db_top;
+  size_t end;
+  ATTR *a;
+  int n, has;
+  int startups = options.startups;
+
+  /* Borrow an object, without its attributes */
+  attrs_load_all();
+  saved = db[thing];
+  db[thing].list = NULL;
+  db[thing].attrcount = db[thing].attrleaves = 0;
+  db[thing].attrindex = NULL;
+
+  f = penn_mopen();
+  for (n = 0; n < 1000; n++) {
+    penn_fprintf(f,
+                 " name \"LAZY%d\"\n  owner #%d\n  flags \"\"\n  derefs 0\n"
+                 "  value \"Line %d \\\"quoted\\\"\nand \\\\ more\"\n",
+                 n, n ? GOD : -5, n);
+  }
+  end = f->handle.m.len;
+  penn_fputs("!1\n", f);
+  has = 0;
+  TEST("lazy_attrs.1",
+       lazy_skip_attrs(f->handle.m.buf, 0, f->handle.m.len, &has) == end &&
+         has == 0);
+
+  lazy_data = f->handle.m.buf;
+  lazy_len = f->handle.m.len;
+  attrs_defer(thing, 0, n, has);
+  TEST("lazy_attrs.2", AttrCount(thing) == n && attrs_unloaded == 1 &&
+                         !attrs_loaded(thing) &&
+                         attrs_lack(thing, LAZY_STARTUP | LAZY_ALIAS));
+
+  /* Startup passes over a player with neither, without reading it */
+  db[thing].type = TYPE_PLAYER;
+  db_top = thing + 1;
+  options.startups = 1;
+  do_restart();
+  options.startups = startups;
+  db_top = top;
+  db[thing].type = saved.type;
+  TEST("lazy_attrs.3", attrs_unloaded > 0 && !attrs_loaded(thing));
+  a = atr_get_noparent(thing, "LAZY7");
+  TEST("lazy_attrs.4",
+       a && strcmp(atr_value(a), "Line 7 \"quoted\"\nand \\ more") == 0);
+  TEST("lazy_attrs.5", AttrCount(thing) == n && attrs_unloaded == 0 &&
+                         attrs_loaded(thing) && !lazy_data);
+  a = atr_get_noparent(thing, "LAZY0");
+  TEST("lazy_attrs.6", a && AL_CREATOR(a) == GOD);
+  atr_free_all(thing);
+
+  {
+    const char *list = " name \"ALIASES\"\n  value \"\n name \"STARTUP\"\"\n"
+                       " name \"STARTUP\"\n  value \"\"\n";
+    has = 0;
+    lazy_skip_attrs(list, 0, strlen(list), &has);
+    TEST("lazy_attrs.7", has == LAZY_STARTUP);
+  }
+
+  /* What startup spends on each object's attributes */
+  BENCHMARK("1000 attributes at startup (read)", 20, {
+    pf = *f;
+    pf.handle.m.pos = 0;
+    db_read_attrs(&pf, thing, n);
+    atr_free_all(thing);
+  });
+  BENCHMARK("1000 attributes at startup (lazy)", 20, {
+    end = lazy_skip_attrs(f->handle.m.buf, 0, f->handle.m.len, &has);
+  });
+  penn_fclose(f);
+
+  db[thing].list = saved.list;
+  db[thing].attrcount = saved.attrcount;
+  db[thing].attrleaves = saved.attrleaves;
+  db[thing].attrindex = saved.attrindex;
+}
+
+TEST_GROUP(snapshot_dump)
+{
+  PENNFILE *before, *snapshot;
+  const char *buf;
+  int penn = Pennies(GOD);
+
+  before = penn_mopen();
+  db_write(before, 0);
+
+  /* Change an object after the dump has passed it, and one before */
+  snapshot = penn_mopen();
+  snapshot_begin(snapshot);
+  TEST("snapshot_dump.1", snapshot_running() && !snapshot_write_some(1));
+  atr_add(0, "SNAPSHOT", "after", GOD, 0);
+  atr_add(GOD, "SNAPSHOT", "before", GOD, 0);
+  set_flag_internal(GOD, "MONITOR");
+  Pennies(GOD) = penn + 1;
+  TEST("snapshot_dump.2", snapshot_write_some(INT_MAX));
+  TEST("snapshot_dump.3", snapshot_end() == 1 && !snapshot_running());
+  buf = snapshot->handle.m.buf;
+  TEST("snapshot_dump.4",
+       dump_same_text(before->handle.m.buf, buf, buf + snapshot->handle.m.len));
+  TEST("snapshot_dump.5", strstr(buf, "SNAPSHOT") == NULL);
+  penn_fclose(snapshot);
+  penn_fclose(before);
+
+  atr_clr(0, "SNAPSHOT", GOD);
+  atr_clr(GOD, "SNAPSHOT", GOD);
+  clear_flag_internal(GOD, "MONITOR");
+  Pennies(GOD) = penn;
+
+  /* How long the game stops for at the start of a dump */
+  BENCHMARK("dump pause (db_write)", 20, {
+    PENNFILE *f = penn_mopen();
+    db_write(f, 0);
+    penn_fclose(f);
+  });
+  BENCHMARK("dump pause (snapshot)", 20, {
+    PENNFILE *f = penn_mopen();
+    snapshot_begin(f);
+    snapshot_end();
+    penn_fclose(f);
+  });
+}
@@ -0,0 +1,642 @@
+/**
+ * \file dbgrep.c
+ *
+ * \brief Database-wide attribute searches for \@grep/all.
+ *
+ * Grepping every attribute in the database means uncompressing and
+ * matching all of them, which is too slow to do in one go on the main
+ * thread. Instead, each tick of the system queue copies the still
+ * compressed values of a batch of objects' attributes, and a small pool
+ * of worker threads uncompresses and matches them. Finished batches are
+ * reported to the searcher in database order on later ticks.
+ *
+ * Only one search runs at a time. Worker threads never touch the
+ * database or the memory checker: batches are allocated, filled and
+ * freed by the main thread, and the workers only fill in which items
+ * matched.
+ */
+
+#include "copyrite.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include "ansi.h"
+#include "attrib.h"
+#include "chunk.h"
+#include "conf.h"
+#include "dbdefs.h"
+#include "externs.h"
+#include "game.h"
+#include "log.h"
+#include "memcheck.h"
+#include "mushdb.h"
+#include "mymalloc.h"
+#include "parse.h"
+#include "strutil.h"
+#include "tests.h"
+
+#define DBGREP_BATCH_OBJECTS 256 /**< Most objects copied per batch */
+#define DBGREP_BATCH_BYTES (128 * 1024) /**< Batch data size to stop at */
+#define DBGREP_MAX_THREADS 16 /**< Most worker threads */
+#define DBGREP_TICK 20        /**< Milliseconds between ticks */
+#define DBGREP_TICK_CPU 10000 /**< Main thread usecs to spend per tick */
+#define DBGREP_PROGRESS 10000 /**< Milliseconds between progress reports */
+
+/** One attribute copied for matching */
+struct dbgrep_item {
+  dbref thing;    /**< Object the attribute is on */
+  uint32_t name;  /**< Offset of the attribute name in the batch data */
+  uint32_t value; /**< Offset of the compressed value in the batch data */
+  bool matched;   /**< Set by the matcher */
+};
+
+/** The attributes of a run of objects */
+struct dbgrep_batch {
+  struct dbgrep_batch *next;  /**< Next batch in report order */
+  struct dbgrep_batch *qnext; /**< Next batch waiting for a worker */
+  struct dbgrep_item *items;  /**< The attributes */
+  int nitems;                 /**< Number of items */
+  int maxitems;               /**< Allocated size of items */
+  char *data;                 /**< Names and compressed values */
+  size_t used;                /**< Bytes of data in use */
+  size_t size;                /**< Allocated size of data */
+  uint64_t cpu;               /**< Usecs of CPU time spent matching */
+  bool done;                  /**< Has it been matched? */
+};
+
+/** The running search */
+struct dbgrep {
+  dbref player;             /**< Who asked for it */
+  int flags;                /**< GREP_* flags */
+  char attrs[BUFFER_LEN];   /**< Attribute name pattern */
+  char findstr[BUFFER_LEN]; /**< What to look for, without markup */
+  size_t findlen;           /**< Length of findstr */
+  pcre2_code *re;           /**< Compiled regexp for GREP_REGEXP */
+  dbref next;               /**< Next object to copy */
+  int attribs;              /**< Attributes examined */
+  int matches;              /**< Attributes matched */
+  int objects;              /**< Objects with matches */
+  uint64_t started;         /**< When it started, in msecs */
+  uint64_t last_progress;   /**< When progress was last reported */
+  uint64_t cpu;             /**< Usecs of CPU time used so far */
+  bool stopping;            /**< Discard the rest of the results */
+  struct dbgrep_batch *head; /**< Oldest unreported batch */
+  struct dbgrep_batch *tail; /**< Newest batch */
+  int inflight;              /**< Number of unreported batches */
+};
+
+static struct dbgrep *search = NULL;
+
+static bool dbgrep_tick(void *data);
+static bool dbgrep_match_item(struct dbgrep const *s, char const *value,
+                              pcre2_match_data *md);
+static void dbgrep_match_batch(struct dbgrep const *s,
+                               struct dbgrep_batch *b);
+
+/** Usecs of CPU time used by the calling thread */
+static uint64_t
+dbgrep_thread_cpu(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
+#endif
+  return now_msecs() * 1000;
+}
+
+#ifdef HAVE_PTHREAD_H
+/* The worker pool, shared by every search */
+static pthread_mutex_t dbgrep_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dbgrep_wakeup = PTHREAD_COND_INITIALIZER;
+static struct dbgrep_batch *dbgrep_queue = NULL;
+static struct dbgrep_batch *dbgrep_queue_tail = NULL;
+static int dbgrep_nworkers = 0;
+
+static void *
+dbgrep_worker(void *arg __attribute__((__unused__)))
+{
+  for (;;) {
+    struct dbgrep_batch *b;
+    struct dbgrep const *s;
+
+    pthread_mutex_lock(&dbgrep_lock);
+    while (!dbgrep_queue) {
+      pthread_cond_wait(&dbgrep_wakeup, &dbgrep_lock);
+    }
+    b = dbgrep_queue;
+    dbgrep_queue = b->qnext;
+    if (!dbgrep_queue) {
+      dbgrep_queue_tail = NULL;
+    }
+    /* The search isn't freed until all its batches are done */
+    s = search;
+    pthread_mutex_unlock(&dbgrep_lock);
+
+    dbgrep_match_batch(s, b);
+
+    pthread_mutex_lock(&dbgrep_lock);
+    b->done = 1;
+    pthread_mutex_unlock(&dbgrep_lock);
+  }
+  return NULL;
+}
+
+/** Start up to grep_threads workers, if they aren't running yet.
+ * \return the number of workers available.
+ */
+static int
+dbgrep_start_workers(void)
+{
+  int want = options.grep_threads;
+
+  if (want > DBGREP_MAX_THREADS) {
+    want = DBGREP_MAX_THREADS;
+  }
+  while (dbgrep_nworkers < want) {
+    pthread_t tid;
+
+    if (pthread_create(&tid, NULL, dbgrep_worker, NULL) != 0) {
+      do_rawlog(LT_ERR, "Unable to start @grep/all worker thread.");
+      break;
+    }
+    pthread_detach(tid);
+    dbgrep_nworkers += 1;
+  }
+  return dbgrep_nworkers;
+}
+
+/** Hand a batch to the workers */
+static void
+dbgrep_submit(struct dbgrep_batch *b)
+{
+  pthread_mutex_lock(&dbgrep_lock);
+  b->qnext = NULL;
+  if (dbgrep_queue_tail) {
+    dbgrep_queue_tail->qnext = b;
+  } else {
+    dbgrep_queue = b;
+  }
+  dbgrep_queue_tail = b;
+  pthread_cond_signal(&dbgrep_wakeup);
+  pthread_mutex_unlock(&dbgrep_lock);
+}
+
+/** Has a batch been matched yet? */
+static bool
+dbgrep_is_done(struct dbgrep_batch *b)
+{
+  bool done;
+
+  pthread_mutex_lock(&dbgrep_lock);
+  done = b->done;
+  pthread_mutex_unlock(&dbgrep_lock);
+  return done;
+}
+#else
+static int
+dbgrep_start_workers(void)
+{
+  return 0;
+}
+
+static void
+dbgrep_submit(struct dbgrep_batch *b __attribute__((__unused__)))
+{
+}
+
+static bool
+dbgrep_is_done(struct dbgrep_batch *b)
+{
+  return b->done;
+}
+#endif /* HAVE_PTHREAD_H */
+
+/** Does an uncompressed attribute value match the search? Called from
+ * worker threads, so it must not use static buffers; quick_wild_new()
+ * strips markup with remove_markup_r() for that reason.
+ */
+static bool
+dbgrep_match_item(struct dbgrep const *s, char const *value,
+                  pcre2_match_data *md)
+{
+  char text[BUFFER_LEN];
+  char *tp = text;
+  char const *q;
+  int cs = !(s->flags & GREP_NOCASE);
+
+  if (s->flags & GREP_WILD) {
+    /* Like @grep/wild, the pattern has to match the whole value */
+    return quick_wild_new(s->findstr, value, cs);
+  }
+
+  /* Match against the text without any markup, as @grep does */
+  for (q = value; *q;) {
+    if (*q == ESC_CHAR) {
+      while (*q && *q++ != 'm')
+        ;
+    } else if (*q == TAG_START) {
+      while (*q && *q++ != TAG_END)
+        ;
+    } else {
+      *tp++ = *q++;
+    }
+  }
+  *tp = '\0';
+
+  if (s->flags & GREP_REGEXP) {
+    return pcre2_match(s->re, (const PCRE2_UCHAR *) text, tp - text, 0,
+                       re_match_flags, md, re_match_ctx) >= 0;
+  }
+  for (q = text; *q; q++) {
+    if (!(cs ? strncmp(q, s->findstr, s->findlen)
+             : strncasecmp(q, s->findstr, s->findlen))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/** Uncompress and match every item of a batch. */
+static void
+dbgrep_match_batch(struct dbgrep const *s, struct dbgrep_batch *b)
+{
+  char value[BUFFER_LEN];
+  pcre2_match_data *md = NULL;
+  uint64_t start = dbgrep_thread_cpu();
+  int i;
+
+  if (s->re) {
+    md = pcre2_match_data_create_from_pattern(s->re, NULL);
+  }
+  for (i = 0; i < b->nitems; i++) {
+    struct dbgrep_item *item = b->items + i;
+
+    text_uncompress_r(b->data + item->value, value);
+    item->matched = dbgrep_match_item(s, value, md);
+  }
+  if (md) {
+    pcre2_match_data_free(md);
+  }
+  b->cpu = dbgrep_thread_cpu() - start;
+}
+
+/** Helper function for dbgrep_snapshot(), passed to atr_iter_get().
+ * Copies the name and compressed value of an attribute into a batch.
+ */
+static int
+dbgrep_copy(dbref player __attribute__((__unused__)), dbref thing,
+            dbref parent __attribute__((__unused__)),
+            char const *pattern __attribute__((__unused__)), ATTR *atr,
+            void *args)
+{
+  struct dbgrep_batch *b = args;
+  struct dbgrep_item *item;
+  size_t nlen = strlen(AL_NAME(atr)) + 1;
+  uint32_t vlen = atr->data ? chunk_len(atr->data) : 0;
+
+  if (vlen >= BUFFER_LEN * 2) {
+    return 0;
+  }
+  if (b->nitems == b->maxitems) {
+    b->maxitems *= 2;
+    b->items = mush_realloc(b->items, b->maxitems * sizeof *b->items,
+                            "dbgrep.items");
+  }
+  if (b->used + nlen + vlen + 1 > b->size) {
+    while (b->used + nlen + vlen + 1 > b->size) {
+      b->size *= 2;
+    }
+    b->data = mush_realloc(b->data, b->size, "dbgrep.data");
+  }
+  item = b->items + b->nitems++;
+  item->thing = thing;
+  item->matched = 0;
+  item->name = b->used;
+  memcpy(b->data + b->used, AL_NAME(atr), nlen);
+  b->used += nlen;
+  item->value = b->used;
+  if (vlen) {
+    chunk_fetch(atr->data, b->data + b->used, vlen);
+  }
+  b->data[b->used + vlen] = '\0';
+  b->used += vlen + 1;
+  return 1;
+}
+
+/** Copy the attributes of the next run of objects into a new batch.
+ * \param s the search.
+ * \return the batch.
+ */
+static struct dbgrep_batch *
+dbgrep_snapshot(struct dbgrep *s)
+{
+  struct dbgrep_batch *b;
+  int n;
+
+  b = mush_malloc_zero(sizeof *b, "dbgrep.batch");
+  b->maxitems = 64;
+  b->items = mush_malloc(b->maxitems * sizeof *b->items, "dbgrep.items");
+  b->size = DBGREP_BATCH_BYTES;
+  b->data = mush_malloc(b->size, "dbgrep.data");
+
+  for (n = 0; n < DBGREP_BATCH_OBJECTS && s->next < db_top &&
+              b->used < DBGREP_BATCH_BYTES;
+       s->next++) {
+    if (IsGarbage(s->next) || !AttrCount(s->next)) {
+      continue;
+    }
+    atr_iter_get(s->player, s->next, s->attrs, AIG_NONE, dbgrep_copy, b);
+    n++;
+  }
+  s->attribs += b->nitems;
+  return b;
+}
+
+static void
+dbgrep_free_batch(struct dbgrep_batch *b)
+{
+  mush_free(b->items, "dbgrep.items");
+  mush_free(b->data, "dbgrep.data");
+  mush_free(b, "dbgrep.batch");
+}
+
+/** Tell the searcher about the matches in a finished batch, one line per
+ * object.
+ */
+static void
+dbgrep_report(struct dbgrep *s, struct dbgrep_batch *b)
+{
+  char buff[BUFFER_LEN];
+  char *bp = buff;
+  dbref thing = NOTHING;
+  int i;
+
+  for (i = 0; i <= b->nitems; i++) {
+    struct dbgrep_item *item = b->items + i;
+
+    if (i < b->nitems && !item->matched) {
+      continue;
+    }
+    if (thing != NOTHING && (i == b->nitems || item->thing != thing)) {
+      *bp = '\0';
+      /* It may have been destroyed since it was copied */
+      if (GoodObject(thing) && !IsGarbage(thing)) {
+        notify_format(s->player, "%s: %s",
+                      unparse_object(s->player, thing, AN_LOOK), buff);
+        s->objects++;
+      }
+      bp = buff;
+      thing = NOTHING;
+    }
+    if (i == b->nitems) {
+      break;
+    }
+    if (bp != buff) {
+      safe_chr(' ', buff, &bp);
+    }
+    safe_str(b->data + item->name, buff, &bp);
+    thing = item->thing;
+    s->matches++;
+  }
+}
+
+/** Report how far a search has got */
+static void
+dbgrep_progress(dbref player, struct dbgrep *s)
+{
+  notify_format(player,
+                T("@grep/all: %d%% of the database searched, %d matches so "
+                  "far, %.1f seconds of CPU time."),
+                db_top ? (int) ((int64_t) s->next * 100 / db_top) : 100,
+                s->matches, (double) s->cpu / 1000000.0);
+}
+
+static void
+dbgrep_free(struct dbgrep *s)
+{
+  if (s->re) {
+    pcre2_code_free(s->re);
+    DEL_CHECK("pcre");
+  }
+  mush_free(s, "dbgrep");
+}
+
+/** Run one step of the search: report finished batches, then copy
+ * some more for the workers.
+ */
+static bool
+dbgrep_tick(void *data __attribute__((__unused__)))
+{
+  struct dbgrep *s = search;
+  uint64_t start = dbgrep_thread_cpu();
+  int workers = dbgrep_start_workers();
+
+  if (!GoodObject(s->player) || IsGarbage(s->player)) {
+    s->stopping = 1;
+  }
+
+  /* Report finished batches, in order */
+  while (s->head && dbgrep_is_done(s->head)) {
+    struct dbgrep_batch *b = s->head;
+
+    s->head = b->next;
+    if (!s->head) {
+      s->tail = NULL;
+    }
+    s->inflight--;
+    s->cpu += b->cpu;
+    if (!s->stopping) {
+      dbgrep_report(s, b);
+    }
+    dbgrep_free_batch(b);
+  }
+
+  if (!s->stopping && options.grep_cpu_time > 0 &&
+      s->cpu > (uint64_t) options.grep_cpu_time * 1000) {
+    notify_format(s->player,
+                  T("@grep/all: CPU time limit reached after searching "
+                    "%d%% of the database."),
+                  db_top ? (int) ((int64_t) s->next * 100 / db_top) : 100);
+    s->stopping = 1;
+  }
+
+  /* Copy more, keeping each worker a couple of batches ahead */
+  while (!s->stopping && s->next < db_top &&
+         s->inflight < (workers ? workers * 2 : 1) &&
+         dbgrep_thread_cpu() - start < DBGREP_TICK_CPU) {
+    struct dbgrep_batch *b = dbgrep_snapshot(s);
+
+    if (s->tail) {
+      s->tail->next = b;
+    } else {
+      s->head = b;
+    }
+    s->tail = b;
+    s->inflight++;
+    if (workers) {
+      dbgrep_submit(b);
+    } else {
+      dbgrep_match_batch(s, b);
+      b->done = 1;
+    }
+  }
+  s->cpu += dbgrep_thread_cpu() - start;
+
+  if (s->inflight == 0 && (s->stopping || s->next >= db_top)) {
+    if (!s->stopping) {
+      notify_format(
+        s->player,
+        T("@grep/all: %d matches on %d objects, out of %d attributes. "
+          "%.1f seconds, %.1f seconds of CPU time."),
+        s->matches, s->objects, s->attribs,
+        (double) (now_msecs() - s->started) / 1000.0,
+        (double) s->cpu / 1000000.0);
+    }
+    search = NULL;
+    dbgrep_free(s);
+    return false;
+  }
+
+  if (!s->stopping && now_msecs() - s->last_progress >= DBGREP_PROGRESS) {
+    dbgrep_progress(s->player, s);
+    s->last_progress = now_msecs();
+  }
+  sq_register_in_msec(DBGREP_TICK, dbgrep_tick, NULL, NULL);
+  return false;
+}
+
+/** Start a search of every attribute in the database.
+ * \param player the enactor.
+ * \param attrs the attribute name pattern, or NULL for all top-level ones.
+ * \param lookfor what to look for.
+ * \param flags GREP_* flags.
+ */
+void
+do_grep_all(dbref player, const char *attrs, const char *lookfor, int flags)
+{
+  struct dbgrep *s;
+
+  if (!See_All(player)) {
+    notify(player, T("Permission denied."));
+    return;
+  }
+  if (search) {
+    if (search->stopping) {
+      notify(player, T("The last database grep is still stopping."));
+    } else {
+      notify_format(player, T("%s is already grepping the database."),
+                    AName(search->player, AN_SYS, NULL));
+    }
+    return;
+  }
+  if (!lookfor || !*lookfor) {
+    notify(player, T("What pattern do you want to grep for?"));
+    return;
+  }
+
+  s = mush_malloc_zero(sizeof *s, "dbgrep");
+  s->player = player;
+  s->flags = flags;
+  mush_strncpy(s->attrs, (attrs && *attrs) ? attrs : "*", sizeof s->attrs);
+  mush_strncpy(s->findstr, remove_markup(lookfor, NULL), sizeof s->findstr);
+  s->findlen = strlen(s->findstr);
+
+  if (flags & GREP_REGEXP) {
+    int errcode;
+    PCRE2_SIZE erroffset;
+    int reflags = re_compile_flags;
+
+    if (flags & GREP_NOCASE) {
+      reflags |= PCRE2_CASELESS;
+    }
+    s->re = pcre2_compile((const PCRE2_UCHAR *) s->findstr,
+                          PCRE2_ZERO_TERMINATED, reflags, &errcode,
+                          &erroffset, re_compile_ctx);
+    if (!s->re) {
+      char errstr[120];
+      pcre2_get_error_message(errcode, (PCRE2_UCHAR *) errstr, sizeof errstr);
+      notify_format(player, T("Invalid regexp: %s"), errstr);
+      mush_free(s, "dbgrep");
+      return;
+    }
+    ADD_CHECK("pcre");
+    pcre2_jit_compile(s->re, PCRE2_JIT_COMPLETE);
+  }
+
+  s->started = s->last_progress = now_msecs();
+  search = s;
+  notify_format(player, T("Grepping %d objects for '%s'. Matches will be "
+                          "reported as they are found."),
+                db_top, lookfor);
+  sq_register_in_msec(0, dbgrep_tick, NULL, NULL);
+}
+
+/** Report on the running database search.
+ * \param player the enactor.
+ */
+void
+do_grep_status(dbref player)
+{
+  if (!See_All(player)) {
+    notify(player, T("Permission denied."));
+  } else if (!search || search->stopping) {
+    notify(player, T("Nobody is grepping the database."));
+  } else {
+    notify_format(player, T("%s is grepping %s for '%s'."),
+                  AName(search->player, AN_SYS, NULL), search->attrs,
+                  search->findstr);
+    dbgrep_progress(player, search);
+  }
+}
+
+/** Stop the running database search. Batches already handed to the
+ * workers are thrown away as they finish.
+ * \param player the enactor.
+ */
+void
+do_grep_stop(dbref player)
+{
+  if (!search || search->stopping) {
+    notify(player, T("Nobody is grepping the database."));
+  } else if (search->player != player && !Wizard(player)) {
+    notify(player, T("Permission denied."));
+  } else {
+    search->stopping = 1;
+    if (search->player != player) {
+      notify_format(search->player, T("@grep/all: Stopped by %s."),
+                    AName(player, AN_SYS, NULL));
+    }
+    notify(player, T("Database grep stopped."));
+  }
+}
+
+TEST_GROUP(dbgrep_match_item)
+{
+  struct dbgrep s;
+  char ansi[BUFFER_LEN];
+
+  memset(&s, 0, sizeof s);
+  strcpy(s.findstr, "#123");
+  s.findlen = 4;
+  TEST("dbgrep_match_item.1", dbgrep_match_item(&s, "@tel me=#123", NULL));
+  TEST("dbgrep_match_item.2", !dbgrep_match_item(&s, "@tel me=#12", NULL));
+  snprintf(ansi, sizeof ansi, "#1%s23", ANSI_HILITE);
+  TEST("dbgrep_match_item.3", dbgrep_match_item(&s, ansi, NULL));
+  strcpy(s.findstr, "FOO");
+  s.findlen = 3;
+  TEST("dbgrep_match_item.4", !dbgrep_match_item(&s, "a foo b", NULL));
+  s.flags = GREP_NOCASE;
+  TEST("dbgrep_match_item.5", dbgrep_match_item(&s, "a foo b", NULL));
+  s.flags = GREP_WILD;
+  strcpy(s.findstr, "*#123*");
+  TEST("dbgrep_match_item.6", dbgrep_match_item(&s, "x #123 y", NULL));
+  TEST("dbgrep_match_item.7", !dbgrep_match_item(&s, "x #12 y", NULL));
+}
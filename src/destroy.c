@@ -602,6 +602,7 @@ free_object(dbref thing)
   const char *type;
   if (!GoodObject(thing))
     return;
+  snapshot_preserve(thing);
   local_data_free(thing);
   switch (Typeof(thing)) {
   case TYPE_THING:
@@ -917,6 +918,8 @@ static void
 clear_exit(dbref thing)
 {
   dbref loc;
+  /* Its return exits may be one-way now */
+  warnings_changed(thing);
   loc = Source(thing);
   if (GoodObject(loc)) {
     Exits(loc) = remove_first(Exits(loc), thing);
@@ -1122,6 +1125,7 @@ check_fields(void)
                   thing);
         report();
         Owner(thing) = GOD;
+        warnings_changed(thing);
       }
       next = Next(thing);
       if ((!GoodObject(next) || IsGarbage(next)) && (next != NOTHING)) {
@@ -1196,9 +1200,10 @@ check_fields(void)
         break;
       }
       /* Check attribute ownership. If the attribute is owned by
-       * an invalid dbref, change its ownership to God.
+       * an invalid dbref, change its ownership to God. Attributes
+       * that haven't been read yet get checked when they are.
        */
-      if (!IsGarbage(thing))
+      if (!IsGarbage(thing) && attrs_loaded(thing))
         atr_iter_get(GOD, thing, "**", AIG_NONE, attribute_owner_helper, NULL);
     }
   }
@@ -1206,13 +1211,14 @@ check_fields(void)
 
 static int
 attribute_owner_helper(dbref player __attribute__((__unused__)),
-                       dbref thing __attribute__((__unused__)),
-                       dbref parent __attribute__((__unused__)),
+                       dbref thing, dbref parent __attribute__((__unused__)),
                        char const *pattern __attribute__((__unused__)),
                        ATTR *atr, void *args __attribute__((__unused__)))
 {
-  if (!GoodObject(AL_CREATOR(atr)))
+  if (!GoodObject(AL_CREATOR(atr))) {
+    snapshot_preserve(thing);
     AL_CREATOR(atr) = GOD;
+  }
   return 0;
 }
 
@@ -1521,6 +1527,7 @@ do_dbck(dbref player)
   }
   notify(player, T("GAME: Performing database consistency check."));
   do_log(LT_WIZ, player, NOTHING, "DBCK done.");
+  attrs_load_all();
   dbck();
   notify(player, T("GAME: Database consistency check complete."));
 }
@@ -348,6 +348,9 @@ realloc_object_flag_bitmasks(FLAGSPACE *n)
   do_rawlog(LT_TRACE, T("Resizing object flag arrays."));
 #endif
 
+  /* Every object's flagset is about to be replaced */
+  snapshot_dump_finish();
+
   numbytes = FlagBytes(n);
 
   oldcache = n->cache;
@@ -1739,6 +1742,7 @@ twiddle_flag_internal(const char *ns, dbref thing, const char *flag, int negate)
     return;
   f = flag_hash_lookup(n, flag, Typeof(thing));
   if (f && (n->flag_table != type_table)) {
+    snapshot_preserve(thing);
     if (n->tab == &ptab_flag) {
       Flags(thing) = negate ? clear_flag_bitmask_ns(n, Flags(thing), f->bitpos)
                             : set_flag_bitmask_ns(n, Flags(thing), f->bitpos);
@@ -1747,6 +1751,7 @@ twiddle_flag_internal(const char *ns, dbref thing, const char *flag, int negate)
                         ? clear_flag_bitmask_ns(n, Powers(thing), f->bitpos)
                         : set_flag_bitmask_ns(n, Powers(thing), f->bitpos);
     }
+    warnings_changed(thing);
   }
 }
 
@@ -1804,10 +1809,12 @@ set_flag(dbref player, dbref thing, const char *flag, int negate, int hear,
 
   current = sees_flag("FLAG", player, thing, f->name);
 
+  snapshot_preserve(thing);
   if (negate)
     Flags(thing) = clear_flag_bitmask_ns(n, Flags(thing), f->bitpos);
   else
     Flags(thing) = set_flag_bitmask_ns(n, Flags(thing), f->bitpos);
+  warnings_changed(thing);
 
   if (negate) {
     /* log if necessary */
@@ -1971,6 +1978,7 @@ set_power(dbref player, dbref thing, const char *flag, int negate)
 
   current = sees_flag("POWER", player, thing, f->name);
 
+  snapshot_preserve(thing);
   if (negate)
     Powers(thing) = clear_flag_bitmask_ns(n, Powers(thing), f->bitpos);
   else
@@ -2897,6 +2905,7 @@ do_flag_delete(const char *ns, dbref player, const char *name)
     }
   } while (got_one);
   /* Reset the flag on all objects */
+  snapshot_dump_finish();
   for (i = 0; i < db_top; i++) {
     if (n->tab == &ptab_flag)
       Flags(i) = clear_flag_bitmask_ns(n, Flags(i), f->bitpos);
@@ -19,9 +19,14 @@
 #endif
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
 
+#ifdef HAVE_SSSE3
+#include <tmmintrin.h>
+#endif
+
 #include "ansi.h"
 #include "attrib.h"
 #include "case.h"
@@ -40,76 +45,229 @@
 #include "sort.h"
 #include "strutil.h"
 #include "charclass.h"
+#include "tests.h"
 
 char *crunch_code(char *code);
 char *crypt_code(char *code, char *text, int type);
 bool decode_base64(char *encoded, int len, bool printonly, char *buff,
                    char **bp);
 
-static bool
-encode_base64(const char *input, int len, char *buff, char **bp)
+/* Base64 encoding and decoding (RFC 4648, no line breaks).
+ *
+ * The SSSE3 versions handle 12 bytes of binary / 16 characters of base64
+ * at a time: bytes are shuffled so each 32-bit lane holds one 3-byte
+ * group, split into four 6-bit fields with multiplies, and mapped to
+ * and from the alphabet with range compares instead of table lookups.
+ * Anything they can't handle (the tail, padding, whitespace, bad
+ * characters) goes through the scalar code, which gives the same
+ * results. */
+
+static const char to_base64[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const signed char from_base64[256] = {
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+  52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+  -1, 0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14,
+  15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+  -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+  41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+
+/** Space needed to encode len bytes. */
+#define BASE64_ENCODED_LEN(len) ((((len) + 2) / 3) * 4)
+/** Space needed to decode len characters, with slack for the SIMD stores */
+#define BASE64_DECODED_LEN(len) ((((len) + 3) / 4) * 3 + 4)
+
+#ifdef HAVE_SSSE3
+/** Encode the first 12 of 16 readable bytes into 16 base64 characters. */
+static inline void
+base64_encode16(const unsigned char *in, char *out)
 {
-#ifdef WIN32
-  LPTSTR encoded;
-  DWORD encodedlen = 0;
-
-  if (!CryptBinaryToString((const BYTE *) input, len,
-                           CRYPT_STRING_BASE64 | CRYPT_STRING_NOCRLF, NULL,
-                           &encodedlen)) {
-    safe_str(T("#-1 ENCODING ERROR"), buff, bp);
-    return false;
-  }
-
-  encoded = mush_malloc(encodedlen, "string");
-  if (!CryptBinaryToString((const BYTE *) input, len,
-                           CRYPT_STRING_BASE64 | CRYPT_STRING_NOCRLF, encoded,
-                           &encodedlen)) {
-    mush_free(encoded, "string");
-    safe_str(T("#-1 ENCODING ERROR"), buff, bp);
-    return false;
-  }
+  __m128i v, hi, lo, res, less;
+
+  v = _mm_loadu_si128((const __m128i *) in);
+  /* Each lane gets bytes b1 b0 b2 b1 of one group */
+  v = _mm_shuffle_epi8(v, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7,
+                                        10, 9, 11, 10));
+  /* Pull the four 6-bit fields into the low bits of each byte */
+  hi = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)),
+                       _mm_set1_epi32(0x04000040));
+  lo = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)),
+                       _mm_set1_epi32(0x01000010));
+  v = _mm_or_si128(hi, lo);
+
+  /* 0-25 -> 'A', 26-51 -> 'a', 52-61 -> '0', 62 -> '+', 63 -> '/':
+   * pick the offset to add by range. */
+  res = _mm_subs_epu8(v, _mm_set1_epi8(51));
+  less = _mm_cmpgt_epi8(_mm_set1_epi8(26), v);
+  res = _mm_or_si128(res, _mm_and_si128(less, _mm_set1_epi8(13)));
+  res = _mm_shuffle_epi8(_mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52,
+                                       '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                       '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                       '/' - 63, 'A', 0, 0),
+                         res);
+  _mm_storeu_si128((__m128i *) out, _mm_add_epi8(res, v));
+}
 
-  safe_strl(encoded, encodedlen, buff, bp);
-  mush_free(encoded, "string");
+/** Decode 16 base64 characters into 12 bytes, writing 16.
+ * \return false if any of them isn't in the base64 alphabet.
+ */
+static inline bool
+base64_decode16(const char *in, unsigned char *out)
+{
+  __m128i v, upper, lower, digit, plus, slash, shift;
+
+  v = _mm_loadu_si128((const __m128i *) in);
+  /* Bytes over 127 are negative, so they fail every range */
+  upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                        _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+  lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a' - 1)),
+                        _mm_cmplt_epi8(v, _mm_set1_epi8('z' + 1)));
+  digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                        _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+  plus = _mm_cmpeq_epi8(v, _mm_set1_epi8('+'));
+  slash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+  if (_mm_movemask_epi8(_mm_or_si128(
+        _mm_or_si128(upper, lower),
+        _mm_or_si128(digit, _mm_or_si128(plus, slash)))) != 0xFFFF)
+    return 0;
+
+  shift = _mm_or_si128(
+    _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+                 _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+    _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                 _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(62 - '+')),
+                              _mm_and_si128(slash, _mm_set1_epi8(63 - '/')))));
+  v = _mm_add_epi8(v, shift);
+
+  /* Merge pairs of 6-bit fields into 12, then 24 bits per lane, and
+   * put the bytes back in big-endian order */
+  v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+  v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+  v = _mm_shuffle_epi8(
+    v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  _mm_storeu_si128((__m128i *) out, v);
+  return 1;
+}
+#endif
 
-  return true;
-#else
-  BIO *bio, *b64, *bmem;
-  char *membuf;
+/** Encode a block of bytes in base64.
+ * \param in the bytes to encode.
+ * \param len the number of bytes.
+ * \param out where to store the result. Must have room for
+ * BASE64_ENCODED_LEN(len) characters. It isn't nul-terminated.
+ * \return the length of the encoded string.
+ */
+static int
+base64_encode_block(const unsigned char *in, int len, char *out)
+{
+  char *o = out;
+  int i = 0;
 
-  b64 = BIO_new(BIO_f_base64());
-  if (!b64) {
-    safe_str(T("#-1 ALLOCATION ERROR"), buff, bp);
-    return false;
+#ifdef HAVE_SSSE3
+  for (; i + 16 <= len; i += 12, o += 16)
+    base64_encode16(in + i, o);
+#endif
+  for (; i + 3 <= len; i += 3) {
+    uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+    *o++ = to_base64[v >> 18];
+    *o++ = to_base64[(v >> 12) & 0x3F];
+    *o++ = to_base64[(v >> 6) & 0x3F];
+    *o++ = to_base64[v & 0x3F];
   }
-
-  BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
-
-  bmem = BIO_new(BIO_s_mem());
-  if (!bmem) {
-    safe_str(T("#-1 ALLOCATION ERROR"), buff, bp);
-    BIO_free(b64);
-    return false;
+  if (i < len) {
+    uint32_t v = in[i] << 16;
+    if (i + 1 < len)
+      v |= in[i + 1] << 8;
+    *o++ = to_base64[v >> 18];
+    *o++ = to_base64[(v >> 12) & 0x3F];
+    *o++ = (i + 1 < len) ? to_base64[(v >> 6) & 0x3F] : '=';
+    *o++ = '=';
   }
+  return o - out;
+}
 
-  bio = BIO_push(b64, bmem);
-
-  if (BIO_write(bio, input, len) < 0) {
-    safe_str(T("#-1 CONVERSION ERROR"), buff, bp);
-    BIO_free_all(bio);
-    return false;
-  }
+/** Decode a base64 string.
+ * Whitespace is ignored, decoding stops at the first '=', and missing
+ * padding at the end is fine.
+ * \param in the string to decode.
+ * \param len its length.
+ * \param out where to store the result. Must have room for
+ * BASE64_DECODED_LEN(len) bytes.
+ * \return the number of decoded bytes, or -1 if the string isn't valid
+ * base64.
+ */
+static int
+base64_decode_block(const char *in, int len, unsigned char *out)
+{
+  unsigned char *o = out;
+  uint32_t v = 0;
+  int i = 0, n = 0;
 
-  (void) BIO_flush(bio);
+  while (i < len) {
+    int c, d;
 
-  len = BIO_get_mem_data(bmem, &membuf);
+#ifdef HAVE_SSSE3
+    if (n == 0 && i + 16 <= len && base64_decode16(in + i, o)) {
+      i += 16;
+      o += 12;
+      continue;
+    }
+#endif
+    c = (unsigned char) in[i++];
+    d = from_base64[c];
+    if (d < 0) {
+      if (c == '=')
+        break;
+      if (isspace(c))
+        continue;
+      return -1;
+    }
+    v = (v << 6) | d;
+    if (++n == 4) {
+      *o++ = v >> 16;
+      *o++ = v >> 8;
+      *o++ = v;
+      n = 0;
+      v = 0;
+    }
+  }
 
-  safe_strl(membuf, len, buff, bp);
+  switch (n) {
+  case 1:
+    return -1;
+  case 2:
+    *o++ = v >> 4;
+    break;
+  case 3:
+    *o++ = v >> 10;
+    *o++ = v >> 2;
+    break;
+  }
+  return o - out;
+}
 
-  BIO_free_all(bio);
+static bool
+encode_base64(const char *input, int len, char *buff, char **bp)
+{
+  char encoded[BASE64_ENCODED_LEN(BUFFER_LEN)];
 
+  /* Anything past this wouldn't fit in buff anyway */
+  if (len > BUFFER_LEN / 4 * 3)
+    len = BUFFER_LEN / 4 * 3;
+  len = base64_encode_block((const unsigned char *) input, len, encoded);
+  safe_strl(encoded, len, buff, bp);
   return true;
-#endif
 }
 
 extern char valid_ansi_codes[UCHAR_MAX + 1];
@@ -117,44 +275,39 @@ extern char valid_ansi_codes[UCHAR_MAX + 1];
 bool
 decode_base64(char *encoded, int len, bool printonly, char *buff, char **bp)
 {
-#ifdef WIN32
-  BYTE *decoded;
-  DWORD dlen = 0;
-  char *sbp = *bp;
+  unsigned char sdecoded[BASE64_DECODED_LEN(BUFFER_LEN)];
+  unsigned char *decoded = sdecoded;
+  int dlen, n;
 
-  if (!CryptStringToBinary((LPCTSTR) encoded, len, CRYPT_STRING_BASE64, NULL,
-                           &dlen, NULL, NULL)) {
-    safe_str(T("#-1 DECODING ERROR"), buff, bp);
-    return false;
-  }
+  if (len > BUFFER_LEN)
+    decoded = mush_malloc(BASE64_DECODED_LEN(len), "string");
 
-  decoded = mush_malloc(dlen + 1, "string");
-  if (!CryptStringToBinary((LPCTSTR) encoded, len, CRYPT_STRING_BASE64, decoded,
-                           &dlen, NULL, NULL)) {
-    mush_free(decoded, "string");
-    safe_str(T("#-1 DECODING ERROR"), buff, bp);
+  dlen = base64_decode_block(encoded, len, decoded);
+  if (dlen < 0) {
+    if (decoded != sdecoded)
+      mush_free(decoded, "string");
+    safe_str(T("#-1 CONVERSION ERROR"), buff, bp);
     return false;
   }
-  decoded[dlen] = '\0';
 
-  for (DWORD n = 0; n < dlen; n++) {
+  for (n = 0; n < dlen; n++) {
     if (decoded[n] == TAG_START) {
-      DWORD end;
+      int end;
       n += 1;
       for (end = n; end < dlen; end++) {
         if (decoded[end] == TAG_END)
           break;
       }
       if (end == dlen || decoded[n] != MARKUP_COLOR) {
-        mush_free(decoded, "string");
-        *bp = sbp;
+        if (decoded != sdecoded)
+          mush_free(decoded, "string");
         safe_str(T("#-1 CONVERSION ERROR"), buff, bp);
         return false;
       }
       for (; n < end; n++) {
         if (!valid_ansi_codes[decoded[n]]) {
-          mush_free(decoded, "string");
-          *bp = sbp;
+          if (decoded != sdecoded)
+            mush_free(decoded, "string");
           safe_str(T("#-1 CONVERSION ERROR"), buff, bp);
           return false;
         }
@@ -164,80 +317,84 @@ decode_base64(char *encoded, int len, bool printonly, char *buff, char **bp)
       decoded[n] = '?';
   }
   safe_strl((const char *) decoded, dlen, buff, bp);
-  mush_free(decoded, "string");
+  if (decoded != sdecoded)
+    mush_free(decoded, "string");
   return true;
-#else
+}
+
+#ifndef WIN32
+/** The old OpenSSL BIO based encoder, kept to benchmark against */
+static int
+bio_encode_base64(const char *input, int len, char *out)
+{
   BIO *bio, *b64, *bmem;
-  char *sbp;
+  char *membuf;
 
   b64 = BIO_new(BIO_f_base64());
-  if (!b64) {
-    safe_str(T("#-1 ALLOCATION ERROR"), buff, bp);
-    return false;
-  }
   BIO_set_flags(b64, BIO_FLAGS_BASE64_NO_NL);
-
-  bmem = BIO_new_mem_buf(encoded, len);
-  if (!bmem) {
-    safe_str(T("#-1 ALLOCATION ERROR"), buff, bp);
-    BIO_free(b64);
-    return false;
-  }
-  /*  len = BIO_set_close(bmem, BIO_NOCLOSE); This makes valgrind report a
-   * memory leak. */
-
+  bmem = BIO_new(BIO_s_mem());
   bio = BIO_push(b64, bmem);
+  BIO_write(bio, input, len);
+  (void) BIO_flush(bio);
+  len = BIO_get_mem_data(bmem, &membuf);
+  memcpy(out, membuf, len);
+  BIO_free_all(bio);
+  return len;
+}
 
-  sbp = *bp;
-  while (true) {
-    char decoded[BUFFER_LEN];
-    int dlen;
-
-    dlen = BIO_read(bio, decoded, BUFFER_LEN);
-    if (dlen > 0) {
-      int n;
-      for (n = 0; n < dlen; n++) {
-        if (decoded[n] == TAG_START) {
-          int end;
-          n += 1;
-          for (end = n; end < dlen; end++) {
-            if (decoded[end] == TAG_END)
-              break;
-          }
-          if (end == dlen || decoded[n] != MARKUP_COLOR) {
-            BIO_free_all(bio);
-            *bp = sbp;
-            safe_str(T("#-1 CONVERSION ERROR"), buff, bp);
-            return false;
-          }
-          for (; n < end; n++) {
-            if (!valid_ansi_codes[decoded[n]]) {
-              BIO_free_all(bio);
-              *bp = sbp;
-              safe_str(T("#-1 CONVERSION ERROR"), buff, bp);
-              return false;
-            }
-          }
-          n = end;
-        } else if (printonly && !char_isprint(decoded[n]))
-          decoded[n] = '?';
-      }
-      safe_strl(decoded, dlen, buff, bp);
-    } else if (dlen == 0)
-      break;
-    else {
-      BIO_free_all(bio);
-      *bp = sbp;
-      safe_str(T("#-1 CONVERSION ERROR"), buff, bp);
-      return false;
-    }
+TEST_GROUP(base64)
+{
+  unsigned char data[BUFFER_LEN], decoded[BASE64_DECODED_LEN(BUFFER_LEN * 2)];
+  char encoded[BASE64_ENCODED_LEN(BUFFER_LEN) + 1];
+  char ref[BASE64_ENCODED_LEN(BUFFER_LEN) + 1];
+  char buff[BUFFER_LEN], *bp;
+  unsigned int seed = 1;
+  int n, len, elen;
+  bool ok = 1;
+
+  for (n = 0; n < BUFFER_LEN; n++) {
+    seed = seed * 1103515245 + 12345;
+    data[n] = seed >> 16;
   }
 
-  BIO_free_all(bio);
-
-  return true;
-#endif
+  /* Every length up to a few SIMD blocks, and a big one */
+  for (len = 0; len <= 100 && ok; len++) {
+    elen = base64_encode_block(data, len, encoded);
+    if (elen != EVP_EncodeBlock((unsigned char *) ref, data, len) ||
+        memcmp(encoded, ref, elen) != 0)
+      ok = 0;
+    if (base64_decode_block(encoded, elen, decoded) != len ||
+        memcmp(decoded, data, len) != 0)
+      ok = 0;
+  }
+  elen = base64_encode_block(data, BUFFER_LEN, encoded);
+  if (elen != EVP_EncodeBlock((unsigned char *) ref, data, BUFFER_LEN) ||
+      memcmp(encoded, ref, elen) != 0)
+    ok = 0;
+  if (base64_decode_block(encoded, elen, decoded) != BUFFER_LEN ||
+      memcmp(decoded, data, BUFFER_LEN) != 0)
+    ok = 0;
+  TEST("base64.1", ok);
+
+  TEST("base64.2", base64_decode_block("Zm9vYg", 6, decoded) == 4 &&
+                     memcmp(decoded, "foob", 4) == 0);
+  TEST("base64.3", base64_decode_block("Zm9v\r\nYmFy YmF6\tYmF6Zm9vYmFy==", 31,
+                                       decoded) == 18 &&
+                     memcmp(decoded, "foobarbazbazfoobar", 18) == 0);
+  TEST("base64.4", base64_decode_block("Zm9vYmFyYmF6YmF6Zm9v!mFy", 24,
+                                       decoded) == -1);
+  TEST("base64.5", base64_decode_block("Zm9vY", 5, decoded) == -1);
+  bp = buff;
+  TEST("base64.6", !decode_base64("Zm9v\xC3mFy", 8, 1, buff, &bp));
+
+  BENCHMARK("base64 encode (BIO)", 1000,
+            { bio_encode_base64((char *) data, BUFFER_LEN / 4 * 3, ref); });
+  BENCHMARK("base64 encode", 1000,
+            { base64_encode_block(data, BUFFER_LEN / 4 * 3, encoded); });
+  BENCHMARK("base64 decode", 1000,
+            { base64_decode_block(encoded, BUFFER_LEN, decoded); });
 }
+#endif
 
 /* Encode a string in base64 */
 FUNCTION(fun_encode64) { encode_base64(args[0], arglens[0], buff, bp); }
@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include "ansi.h"
 #include "attrib.h"
+#include "case.h"
 #include "conf.h"
 #include "dbdefs.h"
 #include "externs.h"
@@ -33,6 +34,8 @@
 #include "log.h"
 #include "charconv.h"
 #include "websock.h"
+#include "hash_function.h"
+#include "tests.h"
 
 static void func_hash_insert(const char *name, FUN *func);
 extern void local_functions(void);
@@ -40,81 +43,340 @@ static int apply_restrictions(uint32_t result, const char *restriction);
 static char *build_function_report(dbref player, FUN *fp);
 static FUN *user_func_hash_lookup(const char *name);
 static FUN *any_func_hash_lookup(const char *name);
+static void func_tables_changed(void);
 
 HASHTAB htab_function;      /**< Function hash table */
 HASHTAB htab_user_function; /**< User-defined function hash table */
 slab *function_slab;        /**< slab for 'struct fun' allocations */
 static bool functable = 0;
 
-/** Builds the tables used for giving spelling suggestions. */
+/* Spelling suggestions for misspelled function, flag and help topic
+ * names. Each category of words is kept in a BK-tree: every child of a
+ * node is filed under its edit distance from that node, so a search for
+ * words near a name only has to visit children whose distance from the
+ * node is close to the name's. The last few searches in each category
+ * are remembered, so softcode that keeps calling the same misspelled
+ * function doesn't repeat the search every time. */
+
+#define VOCAB_MAX_LEN 64   /**< Longest word to index or search for */
+#define VOCAB_MEMO_SIZE 64 /**< Searches remembered per category */
+
+/** A word in a vocabulary BK-tree. */
+struct vocab_node {
+  char *word;                  /**< The word, upper-cased */
+  int len;                     /**< Its length */
+  int dist;                    /**< Edit distance from its parent */
+  bool deleted;                /**< Removed from the vocabulary */
+  struct vocab_node *children; /**< First child */
+  struct vocab_node *next;     /**< Next sibling */
+};
+
+/** A remembered search. */
+struct vocab_memo {
+  uint32_t generation;          /**< Vocabulary generation; 0 if unused */
+  char name[VOCAB_MAX_LEN + 1]; /**< The name searched for */
+  const char *result;           /**< The best match, or NULL */
+};
+
+/** A category of words to make suggestions from. */
+struct vocab {
+  struct vocab_node *root;                 /**< The BK-tree */
+  int words;                               /**< Words that aren't deleted */
+  int deleted;                             /**< Deleted words in the tree */
+  uint32_t generation;                     /**< Bumped when words change */
+  struct vocab_memo memo[VOCAB_MEMO_SIZE]; /**< Recent searches */
+};
+
+static HASHTAB htab_vocab; /**< Vocabularies by category */
+
+/** Set up the tables used for giving spelling suggestions. */
 void
 init_private_vocab(void)
 {
-  sqlite3 *sqldb;
-  char *errmsg;
-
   if (functable) {
     return;
   }
+  hashinit(&htab_vocab, 16);
+  functable = 1;
+}
 
-  sqldb = get_shared_db();
-  if (sqlite3_exec(sqldb,
-                   "CREATE VIRTUAL TABLE suggest USING spellfix1;"
-                   "CREATE TABLE suggest_keys(id INTEGER NOT NULL PRIMARY KEY, "
-                   "cat TEXT NOT NULL UNIQUE);",
-                   NULL, NULL, &errmsg) != SQLITE_OK) {
-    do_rawlog(LT_ERR, "Unable to create spellfix1 table: %s", errmsg);
-    sqlite3_free(errmsg);
-  } else {
-    functable = 1;
+/** Copy a word, upper-casing ASCII letters.
+ * \param dst where to put the copy, at least VOCAB_MAX_LEN + 1 bytes.
+ * \param src the word.
+ * \return the length of the word, or -1 if it is empty or too long.
+ */
+static int
+vocab_word(char *dst, const char *src)
+{
+  int len;
+
+  for (len = 0; src[len]; len++) {
+    if (len == VOCAB_MAX_LEN) {
+      return -1;
+    }
+    /* Only ASCII, since words are UTF-8 */
+    if (src[len] >= 'a' && src[len] <= 'z') {
+      dst[len] = src[len] - 'a' + 'A';
+    } else {
+      dst[len] = src[len];
+    }
   }
+  dst[len] = '\0';
+  return len ? len : -1;
 }
 
-/** Add a word to the vocabulary list for a given category.
- *
- * \param name The word to add, in UTF-8.
- * \param category The category of the word, in UTF-8.
+/** The Levenshtein distance between two words. */
+static int
+vocab_distance(const char *a, int alen, const char *b, int blen)
+{
+  int row[VOCAB_MAX_LEN + 1];
+  int i, j;
+
+  for (j = 0; j <= blen; j++) {
+    row[j] = j;
+  }
+  for (i = 1; i <= alen; i++) {
+    int diag = row[0];
+    row[0] = i;
+    for (j = 1; j <= blen; j++) {
+      int best = diag + (a[i - 1] != b[j - 1]);
+      diag = row[j];
+      if (row[j] + 1 < best) {
+        best = row[j] + 1;
+      }
+      if (row[j - 1] + 1 < best) {
+        best = row[j - 1] + 1;
+      }
+      row[j] = best;
+    }
+  }
+  return row[blen];
+}
+
+/** Find the vocabulary for a category.
+ * \param category the category name.
+ * \param create if true, make an empty one if it doesn't exist.
+ * \return the vocabulary, or NULL.
  */
-void
-add_private_vocab(const char *name, const char *category)
+static struct vocab *
+get_vocab(const char *category, bool create)
 {
-  sqlite3 *sqldb;
-  sqlite3_stmt *inserter;
+  struct vocab *v;
 
   if (!functable) {
-    return;
+    if (!create) {
+      return NULL;
+    }
+    init_private_vocab();
+  }
+  v = hashfind(strupper(category), &htab_vocab);
+  if (!v && create) {
+    v = mush_calloc(1, sizeof *v, "vocab");
+    v->generation = 1;
+    hashadd(strupper(category), v, &htab_vocab);
+  }
+  return v;
+}
+
+static void
+vocab_free_tree(struct vocab_node *n)
+{
+  while (n) {
+    struct vocab_node *next = n->next;
+    vocab_free_tree(n->children);
+    mush_free(n->word, "vocab.word");
+    mush_free(n, "vocab.node");
+    n = next;
   }
+}
 
-  sqldb = get_shared_db();
+/** Add a word to a vocabulary's tree.
+ * \param v the vocabulary.
+ * \param word the word, upper-cased.
+ * \param len its length.
+ */
+static void
+vocab_insert(struct vocab *v, const char *word, int len)
+{
+  struct vocab_node *n = v->root, *child, *node;
+  int d = 0;
+
+  while (n) {
+    d = vocab_distance(word, len, n->word, n->len);
+    if (d == 0) {
+      if (n->deleted) {
+        n->deleted = 0;
+        v->deleted -= 1;
+        v->words += 1;
+        v->generation += 1;
+      }
+      return;
+    }
+    for (child = n->children; child && child->dist != d; child = child->next)
+      ;
+    if (!child) {
+      break;
+    }
+    n = child;
+  }
 
-  inserter = prepare_statement(
-    sqldb,
-    "INSERT INTO suggest_keys(cat) VALUES (upper(?)) ON CONFLICT DO NOTHING",
-    "suggest.addcat");
-  if (inserter) {
-    int status;
-    sqlite3_bind_text(inserter, 1, category, -1, SQLITE_STATIC);
-    do {
-      status = sqlite3_step(inserter);
-    } while (is_busy_status(status));
-    sqlite3_reset(inserter);
+  node = mush_calloc(1, sizeof *node, "vocab.node");
+  node->word = mush_strdup(word, "vocab.word");
+  node->len = len;
+  if (n) {
+    node->dist = d;
+    node->next = n->children;
+    n->children = node;
   } else {
-    return;
+    v->root = node;
+  }
+  v->words += 1;
+  v->generation += 1;
+}
+
+/** Find a word in a vocabulary's tree, deleted or not.
+ * \param v the vocabulary.
+ * \param word the word, upper-cased.
+ * \param len its length.
+ * \return its node, or NULL.
+ */
+static struct vocab_node *
+vocab_find(const struct vocab *v, const char *word, int len)
+{
+  struct vocab_node *n = v->root;
+
+  while (n) {
+    int d = vocab_distance(word, len, n->word, n->len);
+    if (d == 0) {
+      return n;
+    }
+    for (n = n->children; n && n->dist != d; n = n->next)
+      ;
   }
+  return NULL;
+}
 
-  inserter =
-    prepare_statement(sqldb,
-                      "INSERT INTO suggest(word, langid) SELECT lower(?), id "
-                      "FROM suggest_keys WHERE cat = upper(?)",
-                      "suggest.insert");
-  if (inserter) {
-    sqlite3_bind_text(inserter, 1, name, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(inserter, 2, category, -1, SQLITE_STATIC);
-    int status;
-    do {
-      status = sqlite3_step(inserter);
-    } while (is_busy_status(status));
-    sqlite3_reset(inserter);
+/** Add every word in a tree that isn't deleted to a vocabulary. */
+static void
+vocab_reinsert(struct vocab *v, const struct vocab_node *n)
+{
+  for (; n; n = n->next) {
+    if (!n->deleted) {
+      vocab_insert(v, n->word, n->len);
+    }
+    vocab_reinsert(v, n->children);
+  }
+}
+
+/** A name being searched for, set up for vocab_query_distance(). */
+struct vocab_query {
+  uint64_t peq[UCHAR_MAX + 1]; /**< Bit i is set for the name's ith byte */
+  uint64_t last;               /**< The bit for the name's last byte */
+  int len;                     /**< The length of the name */
+  int bestd;                   /**< Distance of the best match so far */
+  const char *best;            /**< The best match so far, or NULL */
+};
+
+/** The Levenshtein distance between a name being searched for and a word.
+ * This is Myers' bit-parallel algorithm, which handles a column of the
+ * usual table per step instead of a cell, since names are at most 64
+ * bytes long.
+ * \param q the name.
+ * \param word the word.
+ * \param wlen its length.
+ * \return the distance between them.
+ */
+static int
+vocab_query_distance(const struct vocab_query *q, const char *word, int wlen)
+{
+  uint64_t pv = ~UINT64_C(0), mv = 0;
+  int d = q->len, i;
+
+  for (i = 0; i < wlen; i++) {
+    uint64_t eq = q->peq[(unsigned char) word[i]];
+    uint64_t xv = eq | mv;
+    uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+    uint64_t ph = mv | ~(xh | pv);
+    uint64_t mh = pv & xh;
+    if (ph & q->last) {
+      d += 1;
+    } else if (mh & q->last) {
+      d -= 1;
+    }
+    ph = (ph << 1) | 1;
+    mh <<= 1;
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+  }
+  return d;
+}
+
+/** Search a tree for the closest word to a name.
+ * \param n the root of the tree.
+ * \param q the name, and the best match so far.
+ */
+static void
+vocab_search(const struct vocab_node *n, struct vocab_query *q)
+{
+  const struct vocab_node *c;
+  int d = q->len ? vocab_query_distance(q, n->word, n->len) : n->len;
+
+  /* Ties go to whichever comes first alphabetically */
+  if (!n->deleted &&
+      (d < q->bestd ||
+       (d == q->bestd && (!q->best || strcmp(n->word, q->best) < 0)))) {
+    q->bestd = d;
+    q->best = n->word;
+  }
+  for (c = n->children; c; c = c->next) {
+    if (c->dist >= d - q->bestd && c->dist <= d + q->bestd) {
+      vocab_search(c, q);
+    }
+  }
+}
+
+/** Find the closest word in a vocabulary to a name.
+ * Names up to 4 characters long can be one edit away from a suggestion,
+ * up to 8 two, and longer ones three.
+ * \param v the vocabulary.
+ * \param name the name, upper-cased.
+ * \param len its length, no more than VOCAB_MAX_LEN.
+ * \return the closest word, or NULL if there are none close enough.
+ */
+static const char *
+vocab_suggest(const struct vocab *v, const char *name, int len)
+{
+  struct vocab_query q;
+  int i;
+
+  if (!v->root) {
+    return NULL;
+  }
+  memset(q.peq, 0, sizeof q.peq);
+  for (i = 0; i < len; i++) {
+    q.peq[(unsigned char) name[i]] |= UINT64_C(1) << i;
+  }
+  q.last = len ? UINT64_C(1) << (len - 1) : 0;
+  q.len = len;
+  q.bestd = len <= 4 ? 1 : len <= 8 ? 2 : 3;
+  q.best = NULL;
+  vocab_search(v->root, &q);
+  return q.best;
+}
+
+/** Add a word to the vocabulary list for a given category.
+ *
+ * \param name The word to add, in UTF-8.
+ * \param category The category of the word, in UTF-8.
+ */
+void
+add_private_vocab(const char *name, const char *category)
+{
+  char word[VOCAB_MAX_LEN + 1];
+  int len = vocab_word(word, name);
+
+  if (len > 0) {
+    vocab_insert(get_vocab(category, 1), word, len);
   }
 }
 
@@ -126,27 +388,30 @@ add_private_vocab(const char *name, const char *category)
 void
 delete_private_vocab(const char *name, const char *category)
 {
-  sqlite3 *sqldb;
-  sqlite3_stmt *deleter;
+  struct vocab *v = get_vocab(category, 0);
+  struct vocab_node *n;
+  char word[VOCAB_MAX_LEN + 1];
+  int len = vocab_word(word, name);
 
-  if (!functable) {
+  if (!v || len < 0) {
+    return;
+  }
+  n = vocab_find(v, word, len);
+  if (!n || n->deleted) {
     return;
   }
-  sqldb = get_shared_db();
-
-  deleter =
-    prepare_statement(sqldb,
-                      "DELETE FROM suggest WHERE word = lower(?) AND langid = "
-                      "(SELECT id FROM suggest_keys WHERE cat = upper(?))",
-                      "suggest.delete");
-  if (deleter) {
-    int status;
-    sqlite3_bind_text(deleter, 1, name, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(deleter, 2, category, -1, SQLITE_STATIC);
-    do {
-      status = sqlite3_step(deleter);
-    } while (is_busy_status(status));
-    sqlite3_reset(deleter);
+  /* Deleted words stay in the tree to guide searches, until there are
+   * more of them than live ones. */
+  n->deleted = 1;
+  v->words -= 1;
+  v->deleted += 1;
+  v->generation += 1;
+  if (v->deleted > v->words) {
+    struct vocab_node *old = v->root;
+    v->root = NULL;
+    v->words = v->deleted = 0;
+    vocab_reinsert(v, old);
+    vocab_free_tree(old);
   }
 }
 
@@ -157,25 +422,13 @@ delete_private_vocab(const char *name, const char *category)
 void
 delete_private_vocab_cat(const char *category)
 {
-  sqlite3 *sqldb;
-  sqlite3_stmt *deleter;
+  struct vocab *v = get_vocab(category, 0);
 
-  if (!functable) {
-    return;
-  }
-  sqldb = get_shared_db();
-
-  deleter = prepare_statement(sqldb,
-                              "DELETE FROM suggest WHERE langid = (SELECT id "
-                              "FROM suggest_keys WHERE cat = upper(?))",
-                              "suggest.delete_all");
-  if (deleter) {
-    int status;
-    sqlite3_bind_text(deleter, 1, category, -1, SQLITE_STATIC);
-    do {
-      status = sqlite3_step(deleter);
-    } while (is_busy_status(status));
-    sqlite3_reset(deleter);
+  if (v) {
+    vocab_free_tree(v->root);
+    v->root = NULL;
+    v->words = v->deleted = 0;
+    v->generation += 1;
   }
 }
 
@@ -188,42 +441,30 @@ delete_private_vocab_cat(const char *category)
 char *
 suggest_name(const char *badname, const char *category)
 {
-  sqlite3 *sqldb;
-  sqlite3_stmt *finder;
-  int status;
-  int ulen;
-  const char *utf8;
-  char *suggestion = NULL;
+  struct vocab *v = get_vocab(category, 0);
+  struct vocab_memo *memo;
+  char *utf8;
+  char name[VOCAB_MAX_LEN + 1];
+  int ulen, len;
 
-  if (!functable) {
+  if (!v || !v->root) {
     return NULL;
   }
 
-  sqldb = get_shared_db();
-
-  finder = prepare_statement(
-    sqldb,
-    "SELECT upper(word) FROM suggest WHERE word MATCH ? AND top = 1 AND langid "
-    "= (SELECT id FROM suggest_keys WHERE cat = upper(?)) AND scope = 5",
-    "suggest.find1");
-  if (!finder) {
+  utf8 = latin1_to_utf8(badname, strlen(badname), &ulen, "string");
+  len = vocab_word(name, utf8);
+  mush_free(utf8, "string");
+  if (len < 0) {
     return NULL;
   }
 
-  utf8 = latin1_to_utf8(badname, strlen(badname), &ulen, "string");
-  sqlite3_bind_text(finder, 1, utf8, ulen, free_string);
-  sqlite3_bind_text(finder, 2, category, -1, SQLITE_STATIC);
-  do {
-    status = sqlite3_step(finder);
-    if (status == SQLITE_ROW) {
-      suggestion =
-        mush_strdup((const char *) sqlite3_column_text(finder, 0), "string");
-      break;
-    }
-  } while (is_busy_status(status));
-  sqlite3_reset(finder);
-
-  return suggestion;
+  memo = v->memo + city_hash(name, len, 0) % VOCAB_MEMO_SIZE;
+  if (memo->generation != v->generation || strcmp(memo->name, name) != 0) {
+    memo->generation = v->generation;
+    strcpy(memo->name, name);
+    memo->result = vocab_suggest(v, name, len);
+  }
+  return memo->result ? mush_strdup(memo->result, "string") : NULL;
 }
 
 /* -------------------------------------------------------------------------*
@@ -1023,6 +1264,107 @@ list_functions(const char *type)
  * Hashed function table stuff
  */
 
+/* Function calls in softcode are resolved through a cache keyed by the
+ * name exactly as it is written at the call site. A call inside an
+ * iter() loop then costs a hash and a memcmp() instead of uppercasing
+ * the name and doing up to three table lookups. Names that aren't
+ * functions are cached too. Anything that adds, removes, aliases,
+ * overrides or restores a function bumps func_generation, which makes
+ * every entry stale at once. Restrictions and @function/disable only
+ * change flags, which callers read from the FUN itself.
+ */
+#define FUNC_CACHE_SIZE 1024
+#define FUNC_CACHE_NAME 32
+
+struct func_cache_entry {
+  uint32_t generation;        /**< func_generation when filled in */
+  uint8_t len;                /**< Length of name */
+  bool builtin_only;          /**< Looked up with builtin_func_hash_lookup */
+  char name[FUNC_CACHE_NAME]; /**< Name as written, not uppercased */
+  FUN *fp;                    /**< The function, or NULL */
+};
+
+static struct func_cache_entry func_cache[FUNC_CACHE_SIZE];
+static uint32_t func_generation = 1;
+
+static void
+func_tables_changed(void)
+{
+  func_generation += 1;
+}
+
+/** Look up a function called from softcode.
+ * \param name the name as written in the code, not NUL-terminated.
+ * \param len length of name.
+ * \param builtin_only true to ignore @functions.
+ * \return pointer to function data, or NULL.
+ */
+FUN *
+func_call_lookup(const char *name, int len, bool builtin_only)
+{
+  struct func_cache_entry *e;
+  char ucname[BUFFER_LEN];
+  FUN *fp;
+
+  if (len >= FUNC_CACHE_NAME) {
+    /* Too long to be a function name anyone would use; don't cache it */
+    e = NULL;
+  } else {
+    e = &func_cache[(city_hash(name, len, builtin_only) & (FUNC_CACHE_SIZE - 1))];
+    if (e->generation == func_generation && e->len == len &&
+        e->builtin_only == builtin_only && memcmp(e->name, name, len) == 0) {
+      return e->fp;
+    }
+  }
+
+  if (len >= BUFFER_LEN) {
+    len = BUFFER_LEN - 1;
+  }
+  memcpy(ucname, name, len);
+  ucname[len] = '\0';
+  fp = builtin_only ? builtin_func_hash_lookup(ucname)
+                    : func_hash_lookup(ucname);
+  if (e) {
+    e->generation = func_generation;
+    e->len = len;
+    e->builtin_only = builtin_only;
+    memcpy(e->name, name, len);
+    e->fp = fp;
+  }
+  return fp;
+}
+
+TEST_GROUP(func_call_lookup)
+{
+  FUN *add = func_hash_lookup("ADD");
+  FUN *fp;
+  int found = 0;
+
+  TEST("func_call_lookup.1", add && func_call_lookup("add(1,2)", 3, 0) == add);
+  TEST("func_call_lookup.2", func_call_lookup("Add", 3, 1) == add);
+  TEST("func_call_lookup.3", func_call_lookup("add", 3, 0) == add);
+  TEST("func_call_lookup.4", func_call_lookup("TESTADDALIAS", 12, 0) == NULL);
+  /* New names are seen right away, even after a cached miss */
+  alias_function(NOTHING, "ADD", "TESTADDALIAS");
+  TEST("func_call_lookup.5", func_call_lookup("TESTADDALIAS", 12, 0) == add);
+  hashdelete("TESTADDALIAS", &htab_function);
+  delete_private_vocab("TESTADDALIAS", "FUNCTIONS");
+  func_tables_changed();
+  TEST("func_call_lookup.6", func_call_lookup("TESTADDALIAS", 12, 0) == NULL);
+
+  BENCHMARK("function lookup (func_hash_lookup)", 100000, {
+    char name[BUFFER_LEN], *np = name;
+    for (const char *sp = "add"; *sp; sp++)
+      safe_chr(UPCASE(*sp), name, &np);
+    *np = '\0';
+    fp = func_hash_lookup(name);
+    found += fp == add;
+  });
+  BENCHMARK("function lookup (func_call_lookup)", 100000,
+            { found += func_call_lookup("add", 3, 0) == add; });
+  TEST("func_call_lookup.7", found == 200000);
+}
+
 /** Look up a function by name.
  * \param name name of function to look up.
  * \return pointer to function data, or NULL.
@@ -1073,6 +1415,7 @@ func_hash_insert(const char *name, FUN *func)
 {
   add_private_vocab(name, "FUNCTIONS");
   hashadd(name, (void *) func, &htab_function);
+  func_tables_changed();
 }
 
 static void delete_function(void *);
@@ -1544,6 +1887,7 @@ cnf_add_function(const char *name, const char *opts)
     if (fp->flags & FN_BUILTIN) {
       /* Override built-in function */
       fp->flags |= FN_OVERRIDE;
+      func_tables_changed();
       fp = NULL;
     } else {
       if (fp->where.ufun->name) {
@@ -1561,6 +1905,7 @@ cnf_add_function(const char *name, const char *opts)
     fp->maxargs = MAX_STACK_ARGS;
     hashadd(ucname, fp, &htab_user_function);
     add_private_vocab(ucname, "FUNCTIONS");
+    func_tables_changed();
   }
 
   fp->where.ufun->thing = thing;
@@ -1728,6 +2073,7 @@ do_function(dbref player, const char *name, char **argv, int preserve)
       fp->flags |= FN_LOCALIZE;
     hashadd(ucname, fp, &htab_user_function);
     add_private_vocab(ucname, "FUNCTIONS");
+    func_tables_changed();
 
     /* now add it to the user function table */
     fp->where.ufun = mush_malloc(sizeof(USERFN_ENTRY), "userfn");
@@ -1786,6 +2132,7 @@ delete_function(void *data)
   mush_free(fp->where.ufun->name, "userfn.name");
   mush_free(fp->where.ufun, "userfn");
   slab_free(function_slab, fp);
+  func_tables_changed();
 }
 
 /** Restore an overridden built-in function.
@@ -1826,6 +2173,7 @@ do_function_restore(dbref player, const char *name)
   }
 
   fp->flags &= ~FN_OVERRIDE;
+  func_tables_changed();
   notify(player, T("Restored."));
 
   /* Delete any @function with the same name */
@@ -1863,6 +2211,7 @@ do_function_delete(dbref player, const char *name)
       /* Function alias */
       hashdelete(strupper(name), &htab_function);
       delete_private_vocab(fp->name, "FUNCTIONS");
+      func_tables_changed();
       notify(player, T("Function alias deleted."));
       return;
     } else if (fp->flags & FN_CLONE) {
@@ -1872,6 +2221,7 @@ do_function_delete(dbref player, const char *name)
       slab_free(function_slab, fp);
       hashdelete(safename, &htab_function);
       delete_private_vocab(safename, "FUNCTIONS");
+      func_tables_changed();
       notify(player, T("Function clone deleted."));
       return;
     }
@@ -1880,6 +2230,7 @@ do_function_delete(dbref player, const char *name)
       return;
     }
     fp->flags |= FN_OVERRIDE;
+    func_tables_changed();
     notify(player, T("Function deleted."));
     return;
   }
@@ -2022,3 +2373,96 @@ build_function_report(dbref player, FUN *fp)
   *bp = '\0';
   return buff;
 }
+
+TEST_GROUP(suggest_name)
+{
+  static const char *words[] = {"LENGTH", "LEN", "LN", "ITER", "ITEXT",
+                                "pemit", "NSPEMIT", NULL};
+  char *s;
+  int n;
+  struct vocab *v;
+
+  for (n = 0; words[n]; n++) {
+    add_private_vocab(words[n], "test.vocab");
+  }
+  s = suggest_name("lenn", "TEST.VOCAB");
+  TEST("suggest_name.1", s && strcmp(s, "LEN") == 0);
+  mush_free(s, "string");
+  s = suggest_name("LENGHT", "TEST.VOCAB");
+  TEST("suggest_name.2", s && strcmp(s, "LENGTH") == 0);
+  mush_free(s, "string");
+  s = suggest_name("ITR", "TEST.VOCAB");
+  TEST("suggest_name.3", s && strcmp(s, "ITER") == 0);
+  mush_free(s, "string");
+  TEST("suggest_name.4", suggest_name("XYZZYQ", "TEST.VOCAB") == NULL);
+  TEST("suggest_name.5", suggest_name("LEN", "NO.SUCH.VOCAB") == NULL);
+
+  /* Changes to the words aren't hidden by remembered searches */
+  delete_private_vocab("len", "TEST.VOCAB");
+  TEST("suggest_name.6", suggest_name("LENN", "TEST.VOCAB") == NULL);
+  add_private_vocab("LEN", "TEST.VOCAB");
+  s = suggest_name("LENN", "TEST.VOCAB");
+  TEST("suggest_name.7", s && strcmp(s, "LEN") == 0);
+  mush_free(s, "string");
+
+  /* Deleting most of the words rebuilds the tree without them */
+  for (n = 0; n < 5; n++) {
+    delete_private_vocab(words[n], "TEST.VOCAB");
+  }
+  v = get_vocab("TEST.VOCAB", 0);
+  TEST("suggest_name.8", v && v->words == 2 && v->deleted < v->words);
+  s = suggest_name("PEMITS", "TEST.VOCAB");
+  TEST("suggest_name.9", s && strcmp(s, "PEMIT") == 0);
+  mush_free(s, "string");
+  delete_private_vocab_cat("TEST.VOCAB");
+  TEST("suggest_name.10", suggest_name("PEMIT", "TEST.VOCAB") == NULL);
+
+  /* The fast distance agrees with the simple one */
+  {
+    char longword[VOCAB_MAX_LEN + 1];
+    const char *pairs[] = {longword, "ABC",    "KITTEN", "SITTING", "FLAW",
+                           "LAWN",   "ITER",   "ITEXT",  "ABCDEF",  "FEDCBA",
+                           "LENGTH", "LENGHT", "",       NULL};
+    struct vocab_query q;
+    int m, bad = 0;
+
+    memset(longword, 'A', VOCAB_MAX_LEN);
+    longword[VOCAB_MAX_LEN] = '\0';
+    longword[7] = 'B';
+    for (n = 0; *pairs[n]; n++) {
+      int len = strlen(pairs[n]);
+      memset(q.peq, 0, sizeof q.peq);
+      for (m = 0; m < len; m++) {
+        q.peq[(unsigned char) pairs[n][m]] |= UINT64_C(1) << m;
+      }
+      q.last = UINT64_C(1) << (len - 1);
+      q.len = len;
+      for (m = 0; pairs[m]; m++) {
+        int mlen = strlen(pairs[m]);
+        if (vocab_query_distance(&q, pairs[m], mlen) !=
+            vocab_distance(pairs[n], len, pairs[m], mlen)) {
+          bad += 1;
+        }
+      }
+    }
+    TEST("suggest_name.11", bad == 0);
+  }
+
+  v = get_vocab("FUNCTIONS", 0);
+  if (v && v->root) {
+    static const char *typos[] = {"LENN",   "ITR",     "SWTICH", "STRLNE",
+                                  "PEMITS", "LSEARCH", "XYZZY",  "ITEMIZ",
+                                  NULL};
+    BENCHMARK("suggest_name (remembered)", 10000, {
+      s = suggest_name("PEMITS", "FUNCTIONS");
+      if (s) {
+        mush_free(s, "string");
+      }
+    });
+    BENCHMARK("suggest_name (searched)", 1000, {
+      for (n = 0; typos[n]; n++) {
+        vocab_suggest(v, typos[n], strlen(typos[n]));
+      }
+    });
+  }
+}
@@ -12,6 +12,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <stdint.h>
 
 #ifdef HAVE_FENV_H
 #include <fenv.h>
@@ -31,6 +32,7 @@
 #include "parse.h"
 #include "sort.h"
 #include "strutil.h"
+#include "tests.h"
 
 #ifdef WIN32
 #pragma warning(disable : 4761) /* NJG: disable warning re conversion */
@@ -387,374 +389,431 @@ FUNCTION(fun_dist2d) { math_dist2d(args, nargs, buff, bp); }
 FUNCTION(fun_dist3d) { math_dist3d(args, nargs, buff, bp); }
 
 /* ------------------------------------------------------------------------
- * Dune's vector functions: VADD, VSUB, VMUL, VCROSS, VMAG, VUNIT, VDIM
- *  VCRAMER?
- * Vectors are space-separated numbers.
+ * Numeric lists: the vector functions and lmath() work on whole lists
+ * of numbers at a time, so they're parsed into arrays of NVALs up front,
+ * combined by the kernels below, and formatted back in one go.
  */
 
-/* ARGSUSED */
-FUNCTION(fun_vmax)
+/** Scratch space for parsed vectors. A list can't have more elements
+ * than a buffer has characters. Vector functions never evaluate code
+ * while using these, so sharing them is safe.
+ */
+static NVAL nval_a[BUFFER_LEN], nval_b[BUFFER_LEN], nval_r[BUFFER_LEN];
+
+/** Parse a delimited list of numbers into an array.
+ * Elements are split the same way split_token() does it, and each
+ * is converted the way parse_number() would, so a non-numeric element
+ * becomes 0, just like the old element-by-element code did.
+ * \param list the list to parse. It gets modified.
+ * \param sep the list separator.
+ * \param vals where to store the numbers.
+ * \return number of elements in the list.
+ */
+static int
+list2nvals(char *list, char sep, NVAL *vals)
 {
-  char *p1, *p2;
-  char *start;
-  char sep;
-  NVAL a, b;
-
-  /* return if a list is empty */
-  if (!args[0] || !args[1]) {
-    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
-    return;
-  }
-
-  if (!delim_check(buff, bp, nargs, args, 3, &sep))
-    return;
-  p1 = trim_space_sep(args[0], sep);
-  p2 = trim_space_sep(args[1], sep);
+  char *p;
+  int n = 0;
 
-  /* return if a list is empty */
-  if (!*p1 || !*p2) {
-    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
-    return;
-  }
+  p = trim_space_sep(list, sep);
+  if (!*p)
+    return 0;
+  while (p && n < BUFFER_LEN)
+    vals[n++] = parse_number(split_token(&p, sep));
+  return n;
+}
 
-  /* max the vectors */
-  start = *bp;
-  a = parse_number(split_token(&p1, sep));
-  b = parse_number(split_token(&p2, sep));
-  safe_number((a > b) ? a : b, buff, bp);
+/** Check and parse a math function argument in one step.
+ * \param str the argument.
+ * \param val where to store its value.
+ * \retval true str is_number() and val was set.
+ * \retval false str is not a number.
+ */
+static bool
+nval_arg(const char *str, NVAL *val)
+{
+  const char *s;
+  char *end;
 
-  while (p1 && p2) {
-    safe_chr(sep, buff, bp);
-    a = parse_number(split_token(&p1, sep));
-    b = parse_number(split_token(&p2, sep));
-    safe_number((a > b) ? a : b, buff, bp);
+  if (TINY_MATH) {
+    *val = parse_number(str);
+    return 1;
   }
-
-  /* make sure vectors were the same length */
-  if (p1 || p2) {
-    *bp = start;
-    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
-    return;
+  for (s = str; isspace(*s); s++)
+    ;
+  if (*s == '\0') {
+    *val = 0;
+    return NULL_EQ_ZERO;
   }
+  errno = 0;
+  *val = parse_nval(s, &end);
+  return errno != ERANGE && *end == '\0' && end > s;
 }
 
-/* ARGSUSED */
-FUNCTION(fun_vmin)
+/** Parse all the arguments of a math function.
+ * \param ptr the arguments.
+ * \param nptr the number of arguments.
+ * \param vals where to store their values.
+ * \retval true all the arguments are numbers.
+ * \retval false at least one isn't.
+ */
+static bool
+args2nvals(char **ptr, int nptr, NVAL *vals)
 {
-  char *p1, *p2;
-  char *start;
-  char sep;
-  NVAL a, b;
+  int n;
 
-  /* return if a list is empty */
-  if (!args[0] || !args[1]) {
-    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
-    return;
+  for (n = 0; n < nptr; n++)
+    if (!nval_arg(ptr[n], vals + n))
+      return 0;
+  return 1;
+}
+
+#define NVAL_ADD(x, y) ((x) + (y))
+#define NVAL_SUB(x, y) ((x) - (y))
+#define NVAL_MUL(x, y) ((x) * (y))
+#define NVAL_DIV(x, y) ((x) / (y))
+#define NVAL_MAX(x, y) (((x) > (y)) ? (x) : (y))
+#define NVAL_MIN(x, y) (((x) < (y)) ? (x) : (y))
+
+/* Elementwise kernels, r[i] = a[i] OP b[i]. The SSE2 versions do two
+ * elements at a time and give bit-for-bit the same results as the
+ * scalar ones; _mm_max_pd() and _mm_min_pd() even treat NaNs the same
+ * way as the ?: expressions. */
+#ifdef HAVE_SSE2
+#define NVAL_KERNEL(name, simd, scalar)                                        \
+  static void name(NVAL *RESTRICT r, const NVAL *a, const NVAL *b, int n)     \
+  {                                                                            \
+    int i;                                                                     \
+    for (i = 0; i + 1 < n; i += 2)                                             \
+      _mm_storeu_pd(r + i, simd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));    \
+    for (; i < n; i++)                                                         \
+      r[i] = scalar(a[i], b[i]);                                               \
+  }
+#else
+#define NVAL_KERNEL(name, simd, scalar)                                        \
+  static void name(NVAL *RESTRICT r, const NVAL *a, const NVAL *b, int n)     \
+  {                                                                            \
+    int i;                                                                     \
+    for (i = 0; i < n; i++)                                                    \
+      r[i] = scalar(a[i], b[i]);                                               \
   }
+#endif
 
-  if (!delim_check(buff, bp, nargs, args, 3, &sep))
-    return;
-  p1 = trim_space_sep(args[0], sep);
-  p2 = trim_space_sep(args[1], sep);
+NVAL_KERNEL(nvals_add, _mm_add_pd, NVAL_ADD)
+NVAL_KERNEL(nvals_sub, _mm_sub_pd, NVAL_SUB)
+NVAL_KERNEL(nvals_mul, _mm_mul_pd, NVAL_MUL)
+NVAL_KERNEL(nvals_div, _mm_div_pd, NVAL_DIV)
+NVAL_KERNEL(nvals_max, _mm_max_pd, NVAL_MAX)
+NVAL_KERNEL(nvals_min, _mm_min_pd, NVAL_MIN)
 
-  /* return if a list is empty */
-  if (!*p1 || !*p2)
-    return;
+/** Fill an array with copies of a number, to use a scalar with the
+ * elementwise kernels. */
+static void
+nvals_fill(NVAL *r, NVAL val, int n)
+{
+  int i;
 
-  /* max the vectors */
-  start = *bp;
-  a = parse_number(split_token(&p1, sep));
-  b = parse_number(split_token(&p2, sep));
-  safe_number((a < b) ? a : b, buff, bp);
+  for (i = 0; i < n; i++)
+    r[i] = val;
+}
 
-  while (p1 && p2) {
-    safe_chr(sep, buff, bp);
-    a = parse_number(split_token(&p1, sep));
-    b = parse_number(split_token(&p2, sep));
-    safe_number((a < b) ? a : b, buff, bp);
-  }
+/** Sum an array. This is done strictly left to right, so results are
+ * the same as adding up the elements one at a time as they're parsed. */
+static NVAL
+nvals_sum(const NVAL *a, int n)
+{
+  NVAL sum = 0;
+  int i;
 
-  /* make sure vectors were the same length */
-  if (p1 || p2) {
-    *bp = start;
-    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
-    return;
-  }
+  for (i = 0; i < n; i++)
+    sum += a[i];
+  return sum;
 }
 
-/* ARGSUSED */
-FUNCTION(fun_vadd)
+/** Store a number into a buffer, like safe_number().
+ * Integral values, by far the most common in vectors, are formatted
+ * straight into the buffer. The output is identical to
+ * safe_number()'s, including when the buffer fills up.
+ * \param n number to store.
+ * \param buff buffer to store into.
+ * \param bp pointer to pointer to insertion point in buff.
+ * \return number of characters that didn't fit.
+ */
+static int
+safe_nval(NVAL n, char *buff, char **bp)
+{
+  char digits[24];
+  char *p = digits + sizeof digits;
+  uint64_t u;
+  bool neg;
+
+  /* Only values small enough to be exact; this also rules out NaN */
+  if (!(fabs(n) < 1e15) || n != (NVAL) (int64_t) n)
+    return safe_number(n, buff, bp);
+  neg = signbit(n);
+  u = neg ? (uint64_t) -n : (uint64_t) n;
+  do {
+    *--p = '0' + (u % 10);
+    u /= 10;
+  } while (u);
+  if (neg) /* Including -0, which printf shows as "-0" */
+    *--p = '-';
+  return safe_strl(p, digits + sizeof digits - p, buff, bp);
+}
+
+/** Store a list of numbers into a buffer.
+ * \param vals the numbers.
+ * \param n how many numbers there are.
+ * \param sep the separator to put between them.
+ * \param buff buffer to store into.
+ * \param bp pointer to pointer to insertion point in buff.
+ */
+static void
+safe_nval_list(const NVAL *vals, int n, char sep, char *buff, char **bp)
 {
-  char *p1, *p2;
-  char *start;
-  char sep;
+  int i;
 
-  /* return if a list is empty */
-  if (!args[0] || !args[1]) {
-    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
-    return;
-  }
+  for (i = 0; i < n; i++) {
+    if (i > 0)
+      safe_chr(sep, buff, bp);
+    safe_nval(vals[i], buff, bp);
+  }
+}
+
+TEST_GROUP(safe_nval)
+{
+  /* Must match safe_number() exactly */
+  static const NVAL vals[] = {0.0,    -0.0,     1.0,      -1.0,    42.0,
+                              1e14,   -1e14,    1e15,     1e16,    0.5,
+                              -0.5,   1.0 / 3,  -1e-7,    2.0000001,
+                              1e300,  -1e300,   HUGE_VAL, -HUGE_VAL};
+  char b1[BUFFER_LEN], b2[BUFFER_LEN], *bp1, *bp2;
+  size_t n;
+  bool ok = 1;
+
+  for (n = 0; n < sizeof vals / sizeof vals[0]; n++) {
+    bp1 = b1;
+    bp2 = b2;
+    safe_nval(vals[n], b1, &bp1);
+    safe_number(vals[n], b2, &bp2);
+    if (bp1 - b1 != bp2 - b2 || memcmp(b1, b2, bp1 - b1) != 0)
+      ok = 0;
+  }
+  TEST("safe_nval.1", ok);
+  ok = 1;
+  for (n = 0; n < 100000; n++) {
+    NVAL v = (NVAL) (int64_t) (n * 7919) - 350000;
+    bp1 = b1;
+    bp2 = b2;
+    safe_nval(v, b1, &bp1);
+    safe_number(v, b2, &bp2);
+    if (bp1 - b1 != bp2 - b2 || memcmp(b1, b2, bp1 - b1) != 0)
+      ok = 0;
+  }
+  TEST("safe_nval.2", ok);
+  /* A nearly full buffer truncates the same way */
+  bp1 = b1 + BUFFER_LEN - 3;
+  bp2 = b2 + BUFFER_LEN - 3;
+  safe_nval(12345, b1, &bp1);
+  safe_number(12345, b2, &bp2);
+  TEST("safe_nval.3", bp1 == b1 + BUFFER_LEN - 1 && bp2 == b2 + BUFFER_LEN - 1 &&
+                        memcmp(b1 + BUFFER_LEN - 3, b2 + BUFFER_LEN - 3, 2) == 0);
 
-  if (!delim_check(buff, bp, nargs, args, 3, &sep))
-    return;
-  p1 = trim_space_sep(args[0], sep);
-  p2 = trim_space_sep(args[1], sep);
+  n = 0;
+  BENCHMARK("safe_number (integral)", 100000, {
+    bp2 = b2;
+    safe_number((NVAL) n++ - 50000, b2, &bp2);
+  });
+  n = 0;
+  BENCHMARK("safe_nval (integral)", 100000, {
+    bp1 = b1;
+    safe_nval((NVAL) n++ - 50000, b1, &bp1);
+  });
+}
+
+TEST_GROUP(list2nvals)
+{
+  char list[BUFFER_LEN];
+  NVAL v[4];
+
+  strcpy(list, "  1  -2.5 foo 3e2  ");
+  TEST("list2nvals.1", list2nvals(list, ' ', v) == 4 && v[0] == 1 &&
+                         v[1] == -2.5 && v[2] == 0 && v[3] == 300);
+  strcpy(list, "1,,2,");
+  TEST("list2nvals.2", list2nvals(list, ',', v) == 4 && v[1] == 0 && v[3] == 0);
+  strcpy(list, "   ");
+  TEST("list2nvals.3", list2nvals(list, ' ', v) == 0);
+}
+
+/** Parse the two vector arguments of a vector function.
+ * \param args the function arguments.
+ * \param nargs the number of arguments.
+ * \param sep the delimiter to use.
+ * \param na set to the length of the first vector.
+ * \param nb set to the length of the second vector.
+ * \retval true both vectors are present.
+ * \retval false one of the vectors is missing.
+ */
+static bool
+parse_vectors(char *args[], char sep, int *na, int *nb)
+{
+  if (!args[0] || !args[1])
+    return 0;
+  *na = list2nvals(args[0], sep, nval_a);
+  *nb = list2nvals(args[1], sep, nval_b);
+  return 1;
+}
 
-  /* return if a list is empty */
-  if (!*p1 || !*p2) {
-    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
-    return;
-  }
+/* ------------------------------------------------------------------------
+ * Dune's vector functions: VADD, VSUB, VMUL, VCROSS, VMAG, VUNIT, VDIM
+ *  VCRAMER?
+ * Vectors are space-separated numbers.
+ */
 
-  /* add the vectors */
-  start = *bp;
-  safe_number(parse_number(split_token(&p1, sep)) +
-                parse_number(split_token(&p2, sep)),
-              buff, bp);
-  while (p1 && p2) {
-    safe_chr(sep, buff, bp);
-    safe_number(parse_number(split_token(&p1, sep)) +
-                  parse_number(split_token(&p2, sep)),
-                buff, bp);
-  }
+/** Apply an elementwise kernel to two same-sized vectors. */
+static void
+vector_op(void (*kernel)(NVAL *RESTRICT, const NVAL *, const NVAL *, int),
+          char *args[], int nargs, char *buff, char **bp)
+{
+  char sep;
+  int na, nb;
 
-  /* make sure vectors were the same length */
-  if (p1 || p2) {
-    *bp = start;
+  if (!delim_check(buff, bp, nargs, args, 3, &sep))
+    return;
+  if (!parse_vectors(args, sep, &na, &nb) || !na || !nb || na != nb) {
     safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
     return;
   }
+  kernel(nval_r, nval_a, nval_b, na);
+  safe_nval_list(nval_r, na, sep, buff, bp);
 }
 
 /* ARGSUSED */
-FUNCTION(fun_vsub)
+FUNCTION(fun_vmax) { vector_op(nvals_max, args, nargs, buff, bp); }
+
+/* ARGSUSED */
+FUNCTION(fun_vmin)
 {
-  char *p1, *p2;
-  char *start;
   char sep;
 
-  /* return if a list is empty */
-  if (!args[0] || !args[1]) {
-    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
-    return;
-  }
-
   if (!delim_check(buff, bp, nargs, args, 3, &sep))
     return;
-  p1 = trim_space_sep(args[0], sep);
-  p2 = trim_space_sep(args[1], sep);
-
-  /* return if a list is empty */
-  if (!*p1 || !*p2) {
-    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
+  /* Unlike the others, vmin() of an empty list is empty */
+  if (args[0] && args[1] &&
+      (!*trim_space_sep(args[0], sep) || !*trim_space_sep(args[1], sep)))
     return;
-  }
+  vector_op(nvals_min, args, nargs, buff, bp);
+}
 
-  /* subtract the vectors */
-  start = *bp;
-  safe_number(parse_number(split_token(&p1, sep)) -
-                parse_number(split_token(&p2, sep)),
-              buff, bp);
-  while (p1 && p2) {
-    safe_chr(sep, buff, bp);
-    safe_number(parse_number(split_token(&p1, sep)) -
-                  parse_number(split_token(&p2, sep)),
-                buff, bp);
-  }
+/* ARGSUSED */
+FUNCTION(fun_vadd) { vector_op(nvals_add, args, nargs, buff, bp); }
 
-  /* make sure vectors were the same length */
-  if (p1 || p2) {
-    *bp = start;
-    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
-    return;
-  }
-}
+/* ARGSUSED */
+FUNCTION(fun_vsub) { vector_op(nvals_sub, args, nargs, buff, bp); }
 
 /* ARGSUSED */
 FUNCTION(fun_vmul)
 {
-  NVAL e1, e2;
-  char *p1, *p2;
-  char *start;
   char sep;
-
-  /* return if a list is empty */
-  if (!args[0] || !args[1]) {
-    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
-    return;
-  }
+  int na, nb;
 
   if (!delim_check(buff, bp, nargs, args, 3, &sep))
     return;
-  p1 = trim_space_sep(args[0], sep);
-  p2 = trim_space_sep(args[1], sep);
-
-  /* return if a list is empty */
-  if (!*p1 || !*p2) {
+  if (!parse_vectors(args, sep, &na, &nb) || !na || !nb) {
     safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
     return;
   }
 
-  /* multiply the vectors */
-  start = *bp;
-  e1 = parse_number(split_token(&p1, sep));
-  e2 = parse_number(split_token(&p2, sep));
-  if (!p1) {
+  if (na == 1) {
     /* scalar * vector */
-    safe_number(e1 * e2, buff, bp);
-    while (p2) {
-      safe_chr(sep, buff, bp);
-      safe_number(e1 * parse_number(split_token(&p2, sep)), buff, bp);
-    }
-  } else if (!p2) {
+    nvals_fill(nval_a, nval_a[0], nb);
+    na = nb;
+  } else if (nb == 1) {
     /* vector * scalar */
-    safe_number(e1 * e2, buff, bp);
-    while (p1) {
-      safe_chr(sep, buff, bp);
-      safe_number(parse_number(split_token(&p1, sep)) * e2, buff, bp);
-    }
-  } else {
-    /* vector * vector elementwise product */
-    safe_number(e1 * e2, buff, bp);
-    while (p1 && p2) {
-      safe_chr(sep, buff, bp);
-      safe_number(parse_number(split_token(&p1, sep)) *
-                    parse_number(split_token(&p2, sep)),
-                  buff, bp);
-    }
-    /* make sure vectors were the same length */
-    if (p1 || p2) {
-      *bp = start;
-      safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
-      return;
-    }
+    nvals_fill(nval_b, nval_b[0], na);
+    nb = na;
+  }
+  if (na != nb) {
+    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
+    return;
   }
+  nvals_mul(nval_r, nval_a, nval_b, na);
+  safe_nval_list(nval_r, na, sep, buff, bp);
 }
 
 /* ARGSUSED */
 FUNCTION(fun_vdot)
 {
-  NVAL product;
-  char *p1, *p2;
   char sep;
-
-  /* return if a list is empty */
-  if (!args[0] || !args[1]) {
-    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
-    return;
-  }
+  int na, nb;
 
   if (!delim_check(buff, bp, nargs, args, 3, &sep))
     return;
-  p1 = trim_space_sep(args[0], sep);
-  p2 = trim_space_sep(args[1], sep);
-
-  /* return if a list is empty */
-  if (!*p1 || !*p2) {
+  if (!parse_vectors(args, sep, &na, &nb) || !na || !nb || na != nb) {
     safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
     return;
   }
 
   /* multiply the vectors */
-  product = 0;
-  while (p1 && p2) {
-    product +=
-      parse_number(split_token(&p1, sep)) * parse_number(split_token(&p2, sep));
-  }
-  if (p1 || p2) {
-    safe_str(T("#-1 VECTORS MUST BE SAME DIMENSIONS"), buff, bp);
-    return;
-  }
-  safe_number(product, buff, bp);
+  nvals_mul(nval_r, nval_a, nval_b, na);
+  safe_nval(nvals_sum(nval_r, na), buff, bp);
+}
+
+/** Find the magnitude of a vector parsed into nval_a.
+ * \param n the length of the vector.
+ * \return the magnitude.
+ */
+static NVAL
+nvals_magnitude(int n)
+{
+  nvals_mul(nval_r, nval_a, nval_a, n);
+  return sqrt(nvals_sum(nval_r, n));
 }
 
 /* ARGSUSED */
 FUNCTION(fun_vmag)
 {
-  NVAL num, sum;
-  char *p1;
   char sep;
-
-  /* return if a list is empty */
-  if (!args[0]) {
-    safe_str(T("#-1 VECTOR MUST NOT BE EMPTY"), buff, bp);
-    return;
-  }
+  int n;
 
   if (!delim_check(buff, bp, nargs, args, 2, &sep))
     return;
-  p1 = trim_space_sep(args[0], sep);
 
   /* return if a list is empty */
-  if (!*p1) {
+  if (!args[0] || !(n = list2nvals(args[0], sep, nval_a))) {
     safe_str(T("#-1 VECTOR MUST NOT BE EMPTY"), buff, bp);
     return;
   }
 
-  /* sum the squares */
-  num = parse_number(split_token(&p1, sep));
-  sum = num * num;
-  while (p1) {
-    num = parse_number(split_token(&p1, sep));
-    sum += num * num;
-  }
-
-  safe_number(sqrt(sum), buff, bp);
+  safe_nval(nvals_magnitude(n), buff, bp);
 }
 
 /* ARGSUSED */
 FUNCTION(fun_vunit)
 {
-  NVAL num, sum;
-  char tbuf[BUFFER_LEN];
-  char *p1;
+  NVAL mag;
   char sep;
-
-  /* return if a list is empty */
-  if (!args[0]) {
-    safe_str(T("#-1 VECTOR MUST NOT BE EMPTY"), buff, bp);
-    return;
-  }
+  int n;
 
   if (!delim_check(buff, bp, nargs, args, 2, &sep))
     return;
-  p1 = trim_space_sep(args[0], sep);
 
   /* return if a list is empty */
-  if (!*p1) {
+  if (!args[0] || !(n = list2nvals(args[0], sep, nval_a))) {
     safe_str(T("#-1 VECTOR MUST NOT BE EMPTY"), buff, bp);
     return;
   }
 
-  /* copy the vector, since we have to walk it twice... */
-  strcpy(tbuf, p1);
-
-  /* find the magnitude */
-  num = parse_number(split_token(&p1, sep));
-  sum = num * num;
-  while (p1) {
-    num = parse_number(split_token(&p1, sep));
-    sum += num * num;
-  }
-  sum = sqrt(sum);
-
-  if (EQ(sum, 0)) {
+  mag = nvals_magnitude(n);
+  if (EQ(mag, 0)) {
     /* zero vector */
-    p1 = tbuf;
-    safe_chr('0', buff, bp);
-    while (split_token(&p1, sep), p1) {
-      safe_chr(sep, buff, bp);
-      safe_chr('0', buff, bp);
-    }
-    return;
-  }
-  /* now make the unit vector */
-  p1 = tbuf;
-  safe_number(parse_number(split_token(&p1, sep)) / sum, buff, bp);
-  while (p1) {
-    safe_chr(sep, buff, bp);
-    safe_number(parse_number(split_token(&p1, sep)) / sum, buff, bp);
+    nvals_fill(nval_r, 0, n);
+  } else {
+    /* now make the unit vector */
+    nvals_fill(nval_b, mag, n);
+    nvals_div(nval_r, nval_a, nval_b, n);
   }
+  safe_nval_list(nval_r, n, sep, buff, bp);
 }
 
 FUNCTION(fun_vcross)
@@ -1945,18 +2004,12 @@ FUNCTION(fun_baseconv)
 
 MATH_FUNC(math_add)
 {
-  NVAL result = 0;
-  int n;
-
-  for (n = 0; n < nptr; n++) {
-    if (!is_number(ptr[n])) {
-      safe_str(T(e_nums), buff, bp);
-      return;
-    }
-    result += parse_number(ptr[n]);
+  if (!args2nvals(ptr, nptr, nval_a)) {
+    safe_str(T(e_nums), buff, bp);
+    return;
   }
 
-  safe_number(result, buff, bp);
+  safe_nval(nvals_sum(nval_a, nptr), buff, bp);
 }
 
 MATH_FUNC(math_and)
@@ -1990,21 +2043,15 @@ MATH_FUNC(math_sub)
     return;
   }
 
-  if (!is_number(ptr[0])) {
+  if (!args2nvals(ptr, nptr, nval_a)) {
     safe_str(T(e_nums), buff, bp);
     return;
   }
 
-  result = parse_number(ptr[0]);
-
-  for (n = 1; n < nptr; n++) {
-    if (!is_number(ptr[n])) {
-      safe_str(T(e_nums), buff, bp);
-      return;
-    }
-    result -= parse_number(ptr[n]);
-  }
-  safe_number(result, buff, bp);
+  result = nval_a[0];
+  for (n = 1; n < nptr; n++)
+    result -= nval_a[n];
+  safe_nval(result, buff, bp);
 }
 
 MATH_FUNC(math_mul)
@@ -2018,20 +2065,15 @@ MATH_FUNC(math_mul)
     return;
   }
 
-  if (!is_number(ptr[0])) {
+  if (!args2nvals(ptr, nptr, nval_a)) {
     safe_str(T(e_nums), buff, bp);
     return;
   }
-  result = parse_number(ptr[0]);
 
-  for (n = 1; n < nptr; n++) {
-    if (!is_number(ptr[n])) {
-      safe_str(T(e_nums), buff, bp);
-      return;
-    }
-    result *= parse_number(ptr[n]);
-  }
-  safe_number(result, buff, bp);
+  result = nval_a[0];
+  for (n = 1; n < nptr; n++)
+    result *= nval_a[n];
+  safe_nval(result, buff, bp);
 }
 
 MATH_FUNC(math_min)
@@ -2044,22 +2086,15 @@ MATH_FUNC(math_min)
     return;
   }
 
-  if (!is_number(ptr[0])) {
+  if (!args2nvals(ptr, nptr, nval_a)) {
     safe_str(T(e_nums), buff, bp);
     return;
   }
-  result = parse_number(ptr[0]);
 
-  for (n = 1; n < nptr; n++) {
-    NVAL test;
-    if (!is_number(ptr[n])) {
-      safe_str(T(e_nums), buff, bp);
-      return;
-    }
-    test = parse_number(ptr[n]);
-    result = (result > test) ? test : result;
-  }
-  safe_number(result, buff, bp);
+  result = nval_a[0];
+  for (n = 1; n < nptr; n++)
+    result = (result > nval_a[n]) ? nval_a[n] : result;
+  safe_nval(result, buff, bp);
 }
 
 MATH_FUNC(math_max)
@@ -2072,44 +2107,30 @@ MATH_FUNC(math_max)
     return;
   }
 
-  if (!is_number(ptr[0])) {
+  if (!args2nvals(ptr, nptr, nval_a)) {
     safe_str(T(e_nums), buff, bp);
     return;
   }
-  result = parse_number(ptr[0]);
 
-  for (n = 1; n < nptr; n++) {
-    NVAL test;
-    if (!is_number(ptr[n])) {
-      safe_str(T(e_nums), buff, bp);
-      return;
-    }
-    test = parse_number(ptr[n]);
-    result = (result > test) ? result : test;
-  }
-  safe_number(result, buff, bp);
+  result = nval_a[0];
+  for (n = 1; n < nptr; n++)
+    result = (result > nval_a[n]) ? result : nval_a[n];
+  safe_nval(result, buff, bp);
 }
 
 MATH_FUNC(math_mean)
 {
-  NVAL result = 0, count = 0;
-  int n;
-
   if (nptr < 1) {
     safe_chr('0', buff, bp);
     return;
   }
 
-  for (n = 0; n < nptr; n++) {
-    if (!is_number(ptr[n])) {
-      safe_str(T(e_nums), buff, bp);
-      return;
-    }
-    result += parse_number(ptr[n]);
-    count++;
+  if (!args2nvals(ptr, nptr, nval_a)) {
+    safe_str(T(e_nums), buff, bp);
+    return;
   }
 
-  safe_number(result / count, buff, bp);
+  safe_nval(nvals_sum(nval_a, nptr) / nptr, buff, bp);
 }
 
 MATH_FUNC(math_div)
@@ -2216,19 +2237,17 @@ MATH_FUNC(math_fdiv)
     return;
   }
 
-  if (!is_number(ptr[0])) {
+  if (!nval_arg(ptr[0], &result)) {
     safe_str(T(e_nums), buff, bp);
     return;
   }
-  result = parse_number(ptr[0]);
 
   for (n = 1; n < nptr; n++) {
     NVAL temp;
-    if (!is_number(ptr[n])) {
+    if (!nval_arg(ptr[n], &temp)) {
       safe_str(T(e_nums), buff, bp);
       return;
     }
-    temp = parse_number(ptr[n]);
 
     if (EQ(temp, 0)) {
       safe_str(T("#-1 DIVISION BY ZERO"), buff, bp);
@@ -2237,7 +2256,7 @@ MATH_FUNC(math_fdiv)
 
     result /= temp;
   }
-  safe_number(result, buff, bp);
+  safe_nval(result, buff, bp);
 }
 
 MATH_FUNC(math_modulo)
@@ -2502,17 +2521,15 @@ lmathcomp(char **ptr, int nptr, char *buff, char **bp, int eqokay, int isgt)
     return;
   }
 
-  if (!is_number(ptr[0])) {
+  if (!nval_arg(ptr[0], &prev)) {
     safe_str(T(e_nums), buff, bp);
     return;
   }
-  prev = parse_number(ptr[0]);
   for (n = 1; n < nptr; n++, prev = next) {
-    if (!is_number(ptr[n])) {
+    if (!nval_arg(ptr[n], &next)) {
       safe_str(T(e_nums), buff, bp);
       return;
     }
-    next = parse_number(ptr[n]);
     /* Is eqok? */
     if (EQ(next, prev)) {
       if (eqokay)
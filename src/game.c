@@ -30,6 +30,7 @@ void Win32MUSH_setup(void);
 #endif
 #include <stdlib.h>
 #include <stdarg.h>
+#include <limits.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -298,6 +299,49 @@ do_shutdown(dbref player, enum shutdown_type flag)
 
 jmp_buf db_err;
 
+/* Write the mail and chat databases. Errors longjmp() to db_err. */
+static void
+dump_mail_and_chat(void)
+{
+  PENNFILE *f;
+  char realdumpfile[2048];
+  char realtmpfl[2304];
+  char tmpfl[2048];
+
+  snprintf(realdumpfile, sizeof realdumpfile, "%s%s", options.mail_db,
+           options.compresssuff);
+  strcpy(tmpfl, make_new_epoch_file(options.mail_db, epoch));
+  snprintf(realtmpfl, sizeof realtmpfl, "%s%s", tmpfl, options.compresssuff);
+  if (mdb_top >= 0) {
+    if ((f = db_open_write(tmpfl)) != NULL) {
+      dump_mail(f);
+      penn_fclose(f);
+      if (rename_file(realtmpfl, realdumpfile) < 0) {
+        penn_perror(realtmpfl);
+        longjmp(db_err, 1);
+      }
+    } else {
+      penn_perror(realtmpfl);
+      longjmp(db_err, 1);
+    }
+  }
+  snprintf(realdumpfile, sizeof realdumpfile, "%s%s", options.chatdb,
+           options.compresssuff);
+  strcpy(tmpfl, make_new_epoch_file(options.chatdb, epoch));
+  snprintf(realtmpfl, sizeof realtmpfl, "%s%s", tmpfl, options.compresssuff);
+  if ((f = db_open_write(tmpfl)) != NULL) {
+    save_chatdb(f);
+    penn_fclose(f);
+    if (rename_file(realtmpfl, realdumpfile) < 0) {
+      penn_perror(realtmpfl);
+      longjmp(db_err, 1);
+    }
+  } else {
+    penn_perror(realtmpfl);
+    longjmp(db_err, 1);
+  }
+}
+
 static bool
 dump_database_internal(void)
 {
@@ -334,6 +378,8 @@ dump_database_internal(void)
       }
 #endif
       break;
+      case PFT_MEMORY:
+        break;
       }
     } else {
       errmsg = strerror(errno);
@@ -402,38 +448,8 @@ dump_database_internal(void)
       penn_perror(realtmpfl);
       longjmp(db_err, 1);
     }
-    snprintf(realdumpfile, sizeof realdumpfile, "%s%s", options.mail_db,
-             options.compresssuff);
-    strcpy(tmpfl, make_new_epoch_file(options.mail_db, epoch));
-    snprintf(realtmpfl, sizeof realtmpfl, "%s%s", tmpfl, options.compresssuff);
-    if (mdb_top >= 0) {
-      if ((f = db_open_write(tmpfl)) != NULL) {
-        dump_mail(f);
-        penn_fclose(f);
-        if (rename_file(realtmpfl, realdumpfile) < 0) {
-          penn_perror(realtmpfl);
-          longjmp(db_err, 1);
-        }
-      } else {
-        penn_perror(realtmpfl);
-        longjmp(db_err, 1);
-      }
-    }
-    snprintf(realdumpfile, sizeof realdumpfile, "%s%s", options.chatdb,
-             options.compresssuff);
-    strcpy(tmpfl, make_new_epoch_file(options.chatdb, epoch));
-    snprintf(realtmpfl, sizeof realtmpfl, "%s%s", tmpfl, options.compresssuff);
-    if ((f = db_open_write(tmpfl)) != NULL) {
-      save_chatdb(f);
-      penn_fclose(f);
-      if (rename_file(realtmpfl, realdumpfile) < 0) {
-        penn_perror(realtmpfl);
-        longjmp(db_err, 1);
-      }
-    } else {
-      penn_perror(realtmpfl);
-      longjmp(db_err, 1);
-    }
+    f = NULL;
+    dump_mail_and_chat();
     time(&globals.last_dump_time);
   }
 
@@ -535,7 +551,11 @@ mush_panicf(const char *msg, ...)
 void
 dump_database(void)
 {
+  /* This one's more up to date */
+  snapshot_dump_abort();
+
   epoch++;
+  attrs_load_all();
 
   do_rawlog_lvl(LT_ERR, MLOG_INFO, "DUMPING: %s.#%d#", globals.dumpfile, epoch);
   if (dump_database_internal()) {
@@ -544,6 +564,153 @@ dump_database(void)
   }
 }
 
+/* Snapshot dumps: with snapshot_dump on, a forking dump is written a
+ * slice at a time by the main loop instead of by a child process, from
+ * a copy-on-write snapshot of the db taken when it starts (see db.c). */
+
+#define SNAPSHOT_SLICE 1000 /**< Objects written per slice */
+#define SNAPSHOT_TICK 10    /**< Milliseconds between slices */
+
+static PENNFILE *snapshot_file = NULL;    /**< The dump being written */
+static struct squeue *snapshot_sq = NULL; /**< The next slice */
+static char snapshot_tmpfl[2048];         /**< File it's written to */
+
+static bool snapshot_event(void *data);
+
+/* Report a failed snapshot dump, after a longjmp() to db_err. */
+static void
+snapshot_dump_failed(void)
+{
+  const char *errmsg = strerror(errno);
+
+  do_rawlog(LT_ERR, "ERROR! Database save failed: %s", errmsg);
+  queue_event(SYSEVENT, "DUMP`ERROR", "%s,%d,PERROR %s",
+              T("GAME: ERROR! Database save failed!"), 1, errmsg);
+  flag_broadcast("WIZARD ROYALTY", 0, T("GAME: ERROR! Database save failed!"));
+  snapshot_dump_abort();
+}
+
+/** Stop a snapshot dump in progress, and throw away what's been written.
+ */
+void
+snapshot_dump_abort(void)
+{
+  char realtmpfl[2304];
+
+  sq_cancel(snapshot_sq);
+  snapshot_sq = NULL;
+  snapshot_end();
+  if (snapshot_file) {
+    penn_fclose(snapshot_file);
+    snapshot_file = NULL;
+  }
+  if (*snapshot_tmpfl) {
+    snprintf(realtmpfl, sizeof realtmpfl, "%s%s", snapshot_tmpfl,
+             options.compresssuff);
+    unlink(realtmpfl);
+    *snapshot_tmpfl = '\0';
+  }
+}
+
+/* Write some of a snapshot dump, and the other databases once it's all
+ * written.
+ * \param count the most objects to write.
+ * \return true if the dump is over, one way or the other.
+ */
+static bool
+snapshot_dump_some(int count)
+{
+  PENNFILE *f;
+  jmp_buf saved;
+  char realdumpfile[2048];
+  char realtmpfl[2304];
+  int changed;
+
+  /* This may be called from anywhere, by snapshot_dump_finish() */
+  memcpy(saved, db_err, sizeof saved);
+  if (setjmp(db_err)) {
+    memcpy(db_err, saved, sizeof saved);
+    snapshot_dump_failed();
+    return true;
+  }
+  if (!snapshot_write_some(count)) {
+    memcpy(db_err, saved, sizeof saved);
+    return false;
+  }
+
+  changed = snapshot_end();
+  f = snapshot_file;
+  snapshot_file = NULL;
+  penn_fclose(f);
+  snprintf(realdumpfile, sizeof realdumpfile, "%s%s", globals.dumpfile,
+           options.compresssuff);
+  snprintf(realtmpfl, sizeof realtmpfl, "%s%s", snapshot_tmpfl,
+           options.compresssuff);
+  if (rename_file(realtmpfl, realdumpfile) < 0) {
+    penn_perror(realtmpfl);
+    longjmp(db_err, 1);
+  }
+  *snapshot_tmpfl = '\0';
+  dump_mail_and_chat();
+  memcpy(db_err, saved, sizeof saved);
+
+  time(&globals.last_dump_time);
+  do_rawlog_lvl(LT_CHECK, MLOG_INFO,
+                "CHECKPOINTING: %s.#%d# (done, %d objects changed meanwhile)",
+                globals.dumpfile, epoch, changed);
+  queue_event(SYSEVENT, "DUMP`COMPLETE", "%s,%d", DUMP_NOFORK_COMPLETE, 1);
+  if (DUMP_NOFORK_COMPLETE && *DUMP_NOFORK_COMPLETE)
+    flag_broadcast(0, 0, "%s", DUMP_NOFORK_COMPLETE);
+  return true;
+}
+
+static bool
+snapshot_event(void *data __attribute__((__unused__)))
+{
+  snapshot_sq = NULL;
+  if (!snapshot_dump_some(SNAPSHOT_SLICE))
+    snapshot_sq =
+      sq_register_in_msec(SNAPSHOT_TICK, snapshot_event, NULL, NULL);
+  return false;
+}
+
+/** Write the rest of a snapshot dump in progress right away.
+ * Used before changes to every object, or to the flag tables, that the
+ * snapshot can't keep track of.
+ */
+void
+snapshot_dump_finish(void)
+{
+  if (!snapshot_file)
+    return;
+  sq_cancel(snapshot_sq);
+  snapshot_sq = NULL;
+  snapshot_dump_some(INT_MAX);
+}
+
+/* Start a snapshot dump, the slices of which are written by timed events.
+ * \return true if it started.
+ */
+static bool
+snapshot_dump_start(void)
+{
+  mush_strncpy(snapshot_tmpfl, make_new_epoch_file(globals.dumpfile, epoch),
+               sizeof snapshot_tmpfl);
+  if (setjmp(db_err)) {
+    snapshot_dump_failed();
+    return false;
+  }
+  local_dump_database();
+  snapshot_file = db_open_write(snapshot_tmpfl);
+  if (!snapshot_file) {
+    penn_perror(snapshot_tmpfl);
+    longjmp(db_err, 1);
+  }
+  snapshot_begin(snapshot_file);
+  snapshot_sq = sq_register_in_msec(SNAPSHOT_TICK, snapshot_event, NULL, NULL);
+  return true;
+}
+
 /** Dump a database, possibly by forking the process.
  * This function calls dump_database_internal() to dump the MUSH
  * databases. If we're configured to do so, it forks first, so that
@@ -562,14 +729,24 @@ fork_and_dump(int forking)
   bool split = false;
 #endif
 
+  /* Get the last one out of the way */
+  snapshot_dump_finish();
+
   epoch++;
 
+  /* Don't leave the child to read attributes from the old database */
+  attrs_load_all();
+
 #ifdef LOG_CHUNK_STATS
   chunk_stats(NOTHING, 0);
   chunk_stats(NOTHING, 1);
 #endif
   do_rawlog_lvl(LT_CHECK, MLOG_INFO, "CHECKPOINTING: %s.#%d#", globals.dumpfile,
                 epoch);
+#ifndef ALWAYS_PARANOID
+  if (forking && SNAPSHOT_DUMP && !globals.paranoid_dump)
+    return snapshot_dump_start();
+#endif
   if (NO_FORK)
     nofork = 1;
   else
@@ -676,7 +853,9 @@ do_restart(void)
 
   sqlite3_exec(sqldb, "BEGIN TRANSACTION", NULL, NULL, NULL);
   for (thing = 0; thing < db_top; thing++) {
-    if (IsPlayer(thing)) {
+    /* Players whose attributes are still unread are only looked at
+     * if they have an alias to read. */
+    if (IsPlayer(thing) && !attrs_lack(thing, LAZY_ALIAS)) {
       if ((s = atr_get_noparent(thing, "ALIAS")) != NULL) {
         bp = buf;
         safe_str(atr_value(s), buf, &bp);
@@ -701,7 +880,8 @@ do_restart(void)
         set_name(thing, "XXXX");
       }
     }
-    if (STARTUPS && !IsGarbage(thing) && !(Halted(thing))) {
+    if (STARTUPS && !IsGarbage(thing) && !(Halted(thing)) &&
+        !attrs_lack(thing, LAZY_STARTUP)) {
       queue_attribute_base(thing, "STARTUP", thing, 1, NULL, QUEUE_PRIORITY);
       do_top(5);
     }
@@ -892,6 +1072,18 @@ init_game_dbs(void)
       return -1;
     }
 
+    /* Attributes can be read later from a map of a plain database */
+    if (options.lazy_attributes) {
+      if (*options.uncompressprog) {
+        do_rawlog(LT_ERR, "lazy_attributes needs an uncompressed database.");
+      } else {
+        char mapfile[BUFFER_LEN];
+        snprintf(mapfile, sizeof mapfile, "%s%s", infile,
+                 options.compresssuff);
+        attrs_map(mapfile);
+      }
+    }
+
     /* ok, read it in */
     do_rawlog(LT_ERR, "LOADING: %s", infile);
     dbline = 0;
@@ -916,6 +1108,25 @@ init_game_dbs(void)
       penn_fclose(f);
     }
 
+    /* A paranoid dump ends with checksums of its ranges */
+    if (db_has_sums()) {
+      int bad;
+
+      do_rawlog(LT_ERR, "CHECKING: %s", infile);
+      f = db_open(infile);
+      if (!f) {
+        return -1;
+      }
+      bad = db_check_sums(f);
+      penn_fclose(f);
+      if (bad) {
+        do_rawlog(LT_ERR, "ERROR LOADING %s: %d damaged range%s", infile, bad,
+                  bad == 1 ? "" : "s");
+        return -1;
+      }
+      do_rawlog(LT_ERR, "CHECKING: %s (done)", infile);
+    }
+
     /* complain about bad config options */
     if (!GoodObject(PLAYER_START) || (!IsRoom(PLAYER_START))) {
       do_rawlog(LT_ERR, "WARNING: Player_start (#%d) is NOT a room.",
@@ -1043,11 +1254,11 @@ do_readcache(dbref player)
   } while (0)
 
 /** Attempt to tell if the command is a @password or @newpassword, so
- * that the password isn't logged by Suspect or log_commands
+ * that the password isn't logged by Suspect, log_commands or capture_log
  * \param cmd The command to check
  * \return A sanitized version of the command suitable for logging.
  */
-static char *
+char *
 passwd_filter(const char *cmd)
 {
   static bool initialized = 0;
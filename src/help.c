@@ -46,20 +46,29 @@
 #include "charconv.h"
 #include "game.h"
 #include "mypcre.h"
+#include "tests.h"
 
 #define HELPDB_APP_ID 0x42010FF1
-#define HELPDB_VERSION 6
-#define HELPDB_VERSIONS "6"
+#define HELPDB_VERSION 7
+#define HELPDB_VERSIONS "7"
 
 #define LINE_SIZE 8192
 #define TOPIC_NAME_LEN 30
 
+enum { ENTRIES_PER_PAGE = 48, LONG_TOPIC = 25 };
+
 struct help_entry {
   char *name;
   char *body;
   int bodylen;
 };
 
+/** A topic name in a help file's in-memory index. */
+struct help_topic {
+  char *name;         /**< Topic name */
+  sqlite3_int64 id;   /**< rowid of the topic in the help database */
+};
+
 HASHTAB help_files; /**< Help filenames hash table */
 
 sqlite3 *help_db = NULL;
@@ -69,6 +78,9 @@ static int help_init = 0;
 static void do_new_spitfile(dbref, const char *, sqlite3_int64, help_file *);
 static const char *string_spitfile(help_file *help_dat, const char *arg1);
 
+static void help_load_topics(help_file *h);
+static void help_free_topics(help_file *h);
+static int help_find_topic(const help_file *h, const char *prefix);
 static bool help_entry_exists(const help_file *, const char *, sqlite3_int64 *);
 static struct help_entry *help_find_entry(const help_file *help_dat, const char *,
                                           sqlite3_int64);
@@ -81,10 +93,9 @@ static const char *normalize_entry(const help_file *help_dat, const char *arg1);
 
 static bool help_delete_entries(const help_file *h);
 static bool help_populate_entries(help_file *h);
-static bool help_build_index(help_file *h);
 
 static bool is_index_entry(const char *, int *);
-static char *entries_from_offset(const help_file *, int);
+static const char *entries_from_offset(help_file *, int);
 
 static bool needs_rebuild(help_file *h, sqlite3_int64 *pcurrmodts);
 static bool update_timestamp(const help_file *h, sqlite3_int64 currmodts);
@@ -303,7 +314,7 @@ COMMAND(cmd_helpcmd)
     if (*arg_left == '\0' || help_entry_exists(h, arg_left, &topicid)) {
       do_new_spitfile(executor, *arg_left == '\0' ? "" : NULL, topicid, h);
     } else if (is_index_entry(arg_left, &offset)) {
-      char *entries = entries_from_offset(h, offset);
+      const char *entries = entries_from_offset(h, offset);
       if (!entries) {
         notify_format(executor, T("No entry for '%s'."), strupper(arg_left));
         return;
@@ -317,7 +328,6 @@ COMMAND(cmd_helpcmd)
       if (SUPPORT_PUEBLO) {
         notify(executor, close_tag("SAMP"));
       }
-      sqlite3_free(entries);
       return;
     } else {
       char pattern[BUFFER_LEN], *pp, *sp;
@@ -475,10 +485,6 @@ init_help_files(void)
       "KEY(catid, name), FOREIGN KEY(catid) REFERENCES categories(id), FOREIGN "
       "KEY(bodyid) REFERENCES entries(id) ON DELETE CASCADE);"
       "CREATE INDEX topics_idx_bodyid ON topics(bodyid);"
-      "CREATE TABLE index_starts(catid INTEGER NOT NULL, pageno INTEGER NOT "
-      "NULL, topic TEXT NOT NULL COLLATE NOCASE, PRIMARY KEY(catid, pageno), "
-      "FOREIGN KEY(catid, topic) REFERENCES topics(catid, name) ON DELETE "
-      "CASCADE) WITHOUT ROWID;"
       "CREATE VIRTUAL TABLE helpfts USING fts5(body, content='entries', "
       "content_rowid='id', tokenize=\"porter unicode61 tokenchars '@+'\");"
       "CREATE TRIGGER entries_ai AFTER INSERT ON entries BEGIN INSERT INTO "
@@ -527,47 +533,160 @@ close_help_files(void)
   }
 }
 
+/** Fill in the spelling suggestions for a help file from the topics
+ * already in the help database.
+ */
+static void
+help_load_vocab(const help_file *h)
+{
+  sqlite3_stmt *topics;
+  int status;
+
+  delete_private_vocab_cat(h->command);
+  topics = prepare_statement_cache(help_db,
+                                   "SELECT name FROM topics WHERE catid = "
+                                   "(SELECT id FROM categories WHERE name = ?)",
+                                   "help.add.vocab", 0);
+  if (!topics) {
+    return;
+  }
+  sqlite3_bind_text(topics, 1, h->command, -1, SQLITE_STATIC);
+  do {
+    status = sqlite3_step(topics);
+    if (status == SQLITE_ROW) {
+      add_private_vocab((const char *) sqlite3_column_text(topics, 0),
+                        h->command);
+    }
+  } while (status == SQLITE_ROW || is_busy_status(status));
+  sqlite3_finalize(topics);
+}
+
+static void
+help_free_topics(help_file *h)
+{
+  int n;
+
+  for (n = 0; n < h->ntopics; n++) {
+    mush_free(h->topics[n].name, "help.topic.name");
+  }
+  if (h->topics) {
+    mush_free(h->topics, "help.topics");
+  }
+  for (n = 0; h->pages && n < h->npages; n++) {
+    if (h->pages[n]) {
+      sqlite3_free(h->pages[n]);
+    }
+  }
+  if (h->pages) {
+    mush_free(h->pages, "help.index.pages");
+  }
+  h->topics = NULL;
+  h->ntopics = 0;
+  h->pages = NULL;
+  h->npages = 0;
+}
+
+/** Load the sorted topic names of a help file into memory, replacing
+ * any earlier list and discarding rendered index pages. Topic lookups
+ * and 'help entries' are answered from this; only full-text searches
+ * and topic bodies go to the help database.
+ */
+static void
+help_load_topics(help_file *h)
+{
+  sqlite3_stmt *lister;
+  int status;
+  int size = 0;
+
+  help_free_topics(h);
+  lister = prepare_statement_cache(
+    help_db,
+    "SELECT name, rowid FROM topics WHERE catid = (SELECT id FROM "
+    "categories WHERE name = ?) ORDER BY name",
+    "help.load.topics", 0);
+  if (!lister) {
+    return;
+  }
+  sqlite3_bind_text(lister, 1, h->command, -1, SQLITE_STATIC);
+  do {
+    status = sqlite3_step(lister);
+    if (status == SQLITE_ROW) {
+      if (h->ntopics == size) {
+        size = size ? size * 2 : 256;
+        h->topics = mush_realloc(h->topics, size * sizeof *h->topics,
+                                 "help.topics");
+      }
+      h->topics[h->ntopics].name = mush_strdup(
+        (const char *) sqlite3_column_text(lister, 0), "help.topic.name");
+      h->topics[h->ntopics].id = sqlite3_column_int64(lister, 1);
+      h->ntopics += 1;
+    }
+  } while (status == SQLITE_ROW || is_busy_status(status));
+  sqlite3_finalize(lister);
+  h->npages = (h->ntopics + ENTRIES_PER_PAGE - 1) / ENTRIES_PER_PAGE;
+}
+
+/* Index of the first topic, in sorted order, that is not less than
+ * the first len bytes of prefix. Names are compared like the database's
+ * NOCASE collation so the order matches ORDER BY name. */
+static int
+help_topic_lower_bound(const help_file *h, const char *prefix, int len)
+{
+  int lo = 0, hi = h->ntopics;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (sqlite3_strnicmp(h->topics[mid].name, prefix, len) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/** Find the first topic that starts with a prefix.
+ * \param h the help file.
+ * \param prefix the start of the topic name.
+ * \return the index of the topic in h->topics, or -1.
+ */
+static int
+help_find_topic(const help_file *h, const char *prefix)
+{
+  int len = strlen(prefix);
+  int n = help_topic_lower_bound(h, prefix, len);
+
+  if (n < h->ntopics && sqlite3_strnicmp(h->topics[n].name, prefix, len) == 0) {
+    return n;
+  }
+  return -1;
+}
+
 static bool
 build_help_file(help_file *h)
 {
-  sqlite3 *sqldb = get_shared_db();
   sqlite3_int64 currmodts = 0;
 
   if (needs_rebuild(h, &currmodts)) {
-    sqlite3_stmt *add_cat;
-
-    sqlite3_exec(sqldb, "BEGIN TRANSACTION", NULL, NULL, NULL);
     sqlite3_exec(help_db, "BEGIN TRANSACTION", NULL, NULL, NULL);
 
     delete_private_vocab_cat(h->command);
 
-    add_cat = prepare_statement(
-      sqldb,
-      "INSERT INTO suggest_keys(cat) VALUES (upper(?)) ON CONFLICT DO NOTHING",
-      "suggest.addcat");
-    sqlite3_bind_text(add_cat, 1, h->command, -1, SQLITE_STATIC);
-    int status = sqlite3_step(add_cat);
-    sqlite3_reset(add_cat);
-    if (status != SQLITE_DONE) {
-      do_rawlog(LT_ERR, "Unable to add %s to suggestions: %s", h->command,
-                sqlite3_errmsg(sqldb));
-      sqlite3_exec(help_db, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
-      sqlite3_exec(sqldb, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
-      return 0;
-    }
-
     if (help_delete_entries(h) && help_populate_entries(h) &&
-        help_build_index(h) && update_timestamp(h, currmodts)) {
+        update_timestamp(h, currmodts)) {
       sqlite3_exec(help_db,
                    "INSERT INTO helpfts(helpfts) VALUES ('optimize');"
                    "COMMIT TRANSACTION",
                    NULL, NULL, NULL);
-      sqlite3_exec(sqldb, "COMMIT TRANSACTION", NULL, NULL, NULL);
+      h->modified = currmodts;
+      help_load_topics(h);
       return 1;
     } else {
       do_rawlog(LT_ERR, "Unable to rebuild help database for %s", h->command);
       sqlite3_exec(help_db, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
-      sqlite3_exec(sqldb, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+      /* Go back to the topics the old version had. The in-memory index
+       * was never touched. */
+      help_load_vocab(h);
       return 0;
     }
   } else {
@@ -588,7 +707,6 @@ add_help_file(const char *command_name, const char *filename, int admin)
 {
   help_file *h;
   sqlite3_stmt *add_cat;
-  int status;
 
   if (help_init == 0)
     init_help_files();
@@ -614,6 +732,11 @@ add_help_file(const char *command_name, const char *filename, int admin)
   h->command = strupper_a(command_name, "help_file.command");
   h->file = mush_strdup(filename, "help_file.filename");
   h->admin = admin;
+  h->modified = 0;
+  h->topics = NULL;
+  h->ntopics = 0;
+  h->pages = NULL;
+  h->npages = 0;
 
   add_cat = prepare_statement_cache(
     help_db, "INSERT INTO categories(name) VALUES (?) ON CONFLICT DO NOTHING",
@@ -623,47 +746,8 @@ add_help_file(const char *command_name, const char *filename, int admin)
   sqlite3_finalize(add_cat);
 
   if (!build_help_file(h)) {
-    sqlite3 *sqldb = get_shared_db();
-    sqlite3_stmt *topics, *add_suggest;
-
-    sqlite3_exec(sqldb, "BEGIN TRANSACTION", NULL, NULL, NULL);
-
-    topics =
-      prepare_statement_cache(help_db,
-                              "SELECT name FROM topics WHERE catid = (SELECT "
-                              "id FROM categories WHERE name = ?)",
-                              "help.add.vocab", 0);
-    sqlite3_bind_text(topics, 1, h->command, -1, SQLITE_STATIC);
-
-    add_suggest = prepare_statement(
-      sqldb,
-      "INSERT INTO suggest_keys(cat) VALUES (upper(?)) ON CONFLICT DO NOTHING",
-      "suggest.addcat");
-    sqlite3_bind_text(add_suggest, 1, h->command, -1, SQLITE_STATIC);
-    sqlite3_step(add_suggest);
-    sqlite3_reset(add_suggest);
-    add_suggest =
-      prepare_statement_cache(sqldb,
-                              "INSERT INTO suggest(word, langid) VALUES "
-                              "(lower(?1), (SELECT id FROM suggest_keys "
-                              "WHERE cat = upper(?2)))",
-                              "help.suggest.insert", 0);
-    sqlite3_bind_text(add_suggest, 2, h->command, -1, SQLITE_STATIC);
-
-    do {
-      status = sqlite3_step(topics);
-      if (status == SQLITE_ROW) {
-        const char *word = (const char *) sqlite3_column_text(topics, 0);
-        int wlen = sqlite3_column_bytes(topics, 0);
-
-        sqlite3_bind_text(add_suggest, 1, word, wlen, SQLITE_STATIC);
-        sqlite3_step(add_suggest);
-        sqlite3_reset(add_suggest);
-      }
-    } while (status == SQLITE_ROW || is_busy_status(status));
-    sqlite3_finalize(topics);
-    sqlite3_finalize(add_suggest);
-    sqlite3_exec(sqldb, "COMMIT TRANSACTION", NULL, NULL, NULL);
+    help_load_vocab(h);
+    help_load_topics(h);
   }
   (void) command_add(h->command, CMD_T_ANY | CMD_T_NOPARSE, NULL, 0,
                      "BRIEF QUERY SEARCH", cmd_helpcmd);
@@ -709,6 +793,11 @@ needs_rebuild(help_file *h, sqlite3_int64 *pcurrmodts)
     *pcurrmodts = currmodts;
   }
 
+  /* Unchanged since we last indexed or checked it */
+  if (h->modified && h->modified == currmodts) {
+    return 0;
+  }
+
   timestamp =
     prepare_statement_cache(help_db,
                             "SELECT filename, modified FROM files WHERE id = "
@@ -727,7 +816,11 @@ needs_rebuild(help_file *h, sqlite3_int64 *pcurrmodts)
 
   savedmodts = sqlite3_column_int64(timestamp, 1);
   sqlite3_finalize(timestamp);
-  return currmodts != savedmodts;
+  if (currmodts == savedmodts) {
+    h->modified = currmodts;
+    return 0;
+  }
+  return 1;
 
 cleanup:
   sqlite3_finalize(timestamp);
@@ -846,29 +939,12 @@ static bool
 help_entry_exists(const help_file *help_dat, const char *the_topic,
                   sqlite3_int64 *topicid)
 {
-  const char *name;
-  sqlite3_stmt *finder;
-  int status;
-  char *like;
-
-  finder = prepare_statement(
-    help_db,
-    "SELECT rowid FROM topics WHERE catid = (SELECT id FROM categories WHERE "
-    "name = ?1) AND name LIKE ?2 ESCAPE '$' ORDER BY name LIMIT 1",
-    "help.entry.exists");
+  int n = help_find_topic(help_dat, the_topic);
 
-  like = escape_like(the_topic, '$', NULL);
-  name = sqlite3_mprintf("%s%%", like);
-  free_string(like);
-
-  sqlite3_bind_text(finder, 1, help_dat->command, -1, SQLITE_STATIC);
-  sqlite3_bind_text(finder, 2, name, -1, sqlite3_free);
-  status = sqlite3_step(finder);
-  if (status == SQLITE_ROW && topicid) {
-    *topicid = sqlite3_column_int64(finder, 0);
+  if (n >= 0 && topicid) {
+    *topicid = help_dat->topics[n].id;
   }
-  sqlite3_reset(finder);
-  return status == SQLITE_ROW;
+  return n >= 0;
 }
 
 static struct help_entry *
@@ -882,31 +958,17 @@ help_find_entry(const help_file *help_dat, const char *the_topic,
     return NULL;
   }
 
-  if (topicid == -1) {
-    char *like;
-
-    finder = prepare_statement(help_db,
-                               "SELECT name, body FROM topics JOIN entries ON "
-                               "topics.bodyid = entries.id "
-                               "WHERE topics.catid = (SELECT id FROM "
-                               "categories WHERE name = ?1) AND name "
-                               "LIKE ?2 ESCAPE '$' ORDER BY name LIMIT 1",
-                               "help.find.entry.by_name");
-    like = escape_like(the_topic, '$', NULL);
-    const char *name = sqlite3_mprintf("%s%%", like);
-    free_string(like);
-
-    sqlite3_bind_text(finder, 1, help_dat->command, -1, SQLITE_STATIC);
-    sqlite3_bind_text(finder, 2, name, -1, sqlite3_free);
-  } else {
-    finder = prepare_statement(help_db,
-                               "SELECT name, body FROM topics JOIN entries ON "
-                               "topics.bodyid = entries.id "
-                               "WHERE topics.rowid = ?",
-                               "help.find.entry.by_id");
-    sqlite3_bind_int64(finder, 1, topicid);
+  if (topicid == -1 && !help_entry_exists(help_dat, the_topic, &topicid)) {
+    return NULL;
   }
 
+  finder = prepare_statement(help_db,
+                             "SELECT name, body FROM topics JOIN entries ON "
+                             "topics.bodyid = entries.id "
+                             "WHERE topics.rowid = ?",
+                             "help.find.entry.by_id");
+  sqlite3_bind_int64(finder, 1, topicid);
+
   status = sqlite3_step(finder);
   if (status == SQLITE_ROW) {
     const char *body;
@@ -937,9 +999,8 @@ help_free_entry(struct help_entry *h)
 static void
 write_topic(const help_file *h, const char *body)
 {
-  sqlite3 *sqldb = get_shared_db();
   int64_t entryid = 0;
-  sqlite3_stmt *query, *add_suggest;
+  sqlite3_stmt *query;
   int status;
 
   if (!top) {
@@ -969,13 +1030,6 @@ write_topic(const help_file *h, const char *body)
   sqlite3_bind_text(query, 1, h->command, -1, SQLITE_STATIC);
   sqlite3_bind_int64(query, 3, entryid);
 
-  add_suggest = prepare_statement(sqldb,
-                                  "INSERT INTO suggest(word, langid) VALUES "
-                                  "(lower(?1), (SELECT id FROM suggest_keys "
-                                  "WHERE cat = upper(?2)))",
-                                  "help.suggest.insert");
-  sqlite3_bind_text(add_suggest, 2, h->command, -1, SQLITE_STATIC);
-
   for (tlist *cur = top, *nextptr; cur; cur = nextptr) {
     int status;
     int primary = (cur->next == NULL);
@@ -990,9 +1044,7 @@ write_topic(const help_file *h, const char *body)
         "Unable to insert help topic %s: %s (Possible duplicate entry?)",
         cur->topic, sqlite3_errmsg(help_db));
     } else {
-      sqlite3_bind_text(add_suggest, 1, cur->topic, -1, SQLITE_STATIC);
-      sqlite3_step(add_suggest);
-      sqlite3_reset(add_suggest);
+      add_private_vocab(cur->topic, h->command);
     }
     sqlite3_reset(query);
 
@@ -1268,7 +1320,7 @@ string_spitfile(help_file *help_dat, const char *arg1)
   strcpy(the_topic, normalize_entry(help_dat, arg1));
 
   if (is_index_entry(the_topic, &offset)) {
-    char *entries = entries_from_offset(help_dat, offset);
+    const char *entries = entries_from_offset(help_dat, offset);
 
     if (!entries)
       return T("#-1 NO ENTRY");
@@ -1286,78 +1338,45 @@ string_spitfile(help_file *help_dat, const char *arg1)
   return buff;
 }
 
-static int
-get_help_nentries(const help_file *h)
-{
-  int count = 0;
-  sqlite3_stmt *total;
-  total = prepare_statement(help_db,
-                            "SELECT count(*) FROM topics WHERE catid = (SELECT "
-                            "id FROM categories WHERE name = ?)",
-                            "help.topics.count");
-  if (!total) {
-    return 0;
-  }
-  sqlite3_bind_text(total, 1, h->command, -1, SQLITE_STATIC);
-  int status = sqlite3_step(total);
-  if (status == SQLITE_ROW) {
-    count = sqlite3_column_int(total, 0);
-  }
-  sqlite3_reset(total);
-  return count;
-}
-
 /** Return a string with all help entries that match a pattern */
 static char **
 list_matching_entries(const char *pattern, help_file *help_dat, int *len)
 {
   char **buff;
-  sqlite3_stmt *lister;
-  int status;
   char *patcopy = mush_strdup(pattern, "string");
-  const char *like;
-  int likelen;
+  int prefixlen, n;
   int matches = 0;
 
   if (wildcard_count(patcopy, 1) >= 0) {
     /* Quick way out, use the other kind of matching */
-    char the_topic[LINE_SIZE + 2];
-    const struct help_entry *entry = NULL;
-    strcpy(the_topic, normalize_entry(help_dat, patcopy));
+    n = help_find_topic(help_dat, normalize_entry(help_dat, patcopy));
     mush_free(patcopy, "string");
-    entry = help_find_entry(help_dat, the_topic, -1);
-    if (!entry) {
+    if (n < 0) {
       *len = 0;
       return NULL;
     } else {
       *len = 1;
       buff = mush_calloc(1, sizeof(char *), "help.search");
-      buff[0] = mush_strdup(entry->name, "help.entry.name");
+      buff[0] = mush_strdup(help_dat->topics[n].name, "help.entry.name");
       return buff;
     }
   }
 
-  buff =
-    mush_calloc(get_help_nentries(help_dat), sizeof(char *), "help.search");
-
-  lister = prepare_statement(
-    help_db,
-    "SELECT name FROM topics WHERE catid = (SELECT id FROM categories WHERE "
-    "name = ?1) AND name LIKE ?2 ESCAPE '$' ORDER BY name",
-    "help.list.entries");
-  sqlite3_bind_text(lister, 1, help_dat->command, -1, SQLITE_STATIC);
-  like = glob_to_like(patcopy, '$', &likelen);
-  sqlite3_bind_text(lister, 2, like, likelen, free_string);
-  mush_free(patcopy, "string");
+  /* Only topics starting with the pattern's literal prefix can match */
+  prefixlen = strcspn(pattern, "*?\\");
+  n = help_topic_lower_bound(help_dat, pattern, prefixlen);
 
-  do {
-    status = sqlite3_step(lister);
-    if (status == SQLITE_ROW) {
-      buff[matches++] = mush_strdup(
-        (const char *) sqlite3_column_text(lister, 0), "help.entry.name");
+  buff = mush_calloc(help_dat->ntopics - n, sizeof(char *), "help.search");
+  for (; n < help_dat->ntopics; n++) {
+    const char *name = help_dat->topics[n].name;
+    if (sqlite3_strnicmp(name, pattern, prefixlen) != 0) {
+      break;
     }
-  } while (status == SQLITE_ROW || is_busy_status(status));
-  sqlite3_reset(lister);
+    if (quick_wild(pattern, name)) {
+      buff[matches++] = mush_strdup(name, "help.entry.name");
+    }
+  }
+  mush_free(patcopy, "string");
   *len = matches;
   return buff;
 }
@@ -1371,131 +1390,44 @@ free_entry_list(char **entries, int len)
   mush_free(entries, "help.search");
 }
 
-enum { ENTRIES_PER_PAGE = 48, LONG_TOPIC = 25 };
-
-static bool
-help_build_index(help_file *h)
-{
-  sqlite3_stmt *lister, *adder;
-  int status;
-  int page = 1;
-  int count = ENTRIES_PER_PAGE - 1;
-
-  lister = prepare_statement_cache(
-    help_db,
-    "SELECT name FROM topics WHERE catid = (SELECT id FROM "
-    "categories WHERE name = ?) ORDER BY name",
-    "help.entries.build.index", 0);
-  if (!lister) {
-    return 0;
-  }
-  adder = prepare_statement_cache(
-    help_db,
-    "INSERT INTO index_starts(catid, pageno, topic) VALUES ((SELECT id FROM "
-    "categories WHERE name = ?1),?2,?3)",
-    "help.entries.insert", 0);
-  if (!adder) {
-    sqlite3_finalize(lister);
-    return 0;
-  }
-
-  sqlite3_bind_text(lister, 1, h->command, -1, SQLITE_STATIC);
-  sqlite3_bind_text(adder, 1, h->command, -1, SQLITE_STATIC);
-
-  do {
-    status = sqlite3_step(lister);
-    if (status == SQLITE_ROW) {
-      if (++count == ENTRIES_PER_PAGE) {
-        const char *t = (const char *) sqlite3_column_text(lister, 0);
-        sqlite3_bind_int(adder, 2, page);
-        sqlite3_bind_text(adder, 3, t, -1, SQLITE_TRANSIENT);
-        status = sqlite3_step(adder);
-        if (status != SQLITE_DONE) {
-          do_rawlog(LT_ERR, "While building entries database for %s: %s",
-                    h->command, sqlite3_errmsg(help_db));
-          break;
-        }
-        sqlite3_reset(adder);
-        page += 1;
-        count = 0;
-      }
-      status = SQLITE_ROW;
-    }
-  } while (status == SQLITE_ROW);
-  sqlite3_finalize(lister);
-  sqlite3_finalize(adder);
-  return status == SQLITE_DONE;
-}
-
 /* Generate a page of the index of the help file (The old pre-generated 'help
- * entries' tables), 1-indexed.
+ * entries' tables), 1-indexed. Pages are rendered on first use and kept
+ * until the help file is reindexed.
  */
-static char *
-entries_from_offset(const help_file *h, int off)
+static const char *
+entries_from_offset(help_file *h, int off)
 {
-
-  sqlite3_stmt *indexer;
   sqlite3_str *res;
   int fmtwidths[3];
-  int col = 0, pages = 0, status;
+  int col = 0, n, start, end;
   int ncols = 3, colspace = 0;
 
-  indexer = prepare_statement(help_db,
-                              "SELECT count(*) FROM index_starts WHERE catid = "
-                              "(SELECT id FROM categories WHERE name = ?)",
-                              "help.entries.count");
-  sqlite3_bind_text(indexer, 1, h->command, -1, SQLITE_STATIC);
-
-  status = sqlite3_step(indexer);
-  if (status == SQLITE_ROW) {
-    pages = sqlite3_column_int(indexer, 0);
-  }
-  sqlite3_reset(indexer);
-
-  if (pages == 0 || off > pages) {
+  if (off < 1 || off > h->npages) {
     return NULL;
   }
-
-  /* Window functions would be useful here */
-  indexer = prepare_statement(
-    help_db,
-    "WITH cat(id) AS (SELECT id FROM categories WHERE name = ?1) "
-    "SELECT t.name"
-    "     , lead(length(t.name), 1, 0) OVER (ORDER BY t.name)"
-    "     , lead(length(t.name), 2, 0) OVER (ORDER BY t.name)"
-    "FROM topics AS t "
-    "JOIN cat ON t.catid = cat.id "
-    "JOIN index_starts AS i ON cat.id = i.catid "
-    "WHERE t.name >= i.topic AND i.pageno = ?2 "
-    "ORDER BY t.name "
-    "LIMIT ?3",
-    "help.entries.page");
-
-  if (!indexer) {
-    return NULL;
+  if (!h->pages) {
+    h->pages = mush_calloc(h->npages, sizeof(char *), "help.index.pages");
+  }
+  if (h->pages[off - 1]) {
+    return h->pages[off - 1];
   }
 
-  sqlite3_bind_text(indexer, 1, h->command, -1, SQLITE_STATIC);
-  sqlite3_bind_int(indexer, 2, off);
-  sqlite3_bind_int(indexer, 3, ENTRIES_PER_PAGE);
+  start = (off - 1) * ENTRIES_PER_PAGE;
+  end = start + ENTRIES_PER_PAGE;
+  if (end > h->ntopics) {
+    end = h->ntopics;
+  }
 
   res = sqlite3_str_new(help_db);
 
-  while (1) {
-    const char *entry;
-
-    status = sqlite3_step(indexer);
-    if (status != SQLITE_ROW) {
-      break;
-    }
-
-    entry = (const char *) sqlite3_column_text(indexer, 0);
+  for (n = start; n < end; n++) {
+    const char *entry = h->topics[n].name;
 
     if (col == 0) {
       int len0, len1, len2;
-      len0 = sqlite3_column_bytes(indexer, 0);
-      len1 = sqlite3_column_int(indexer, 1);
-      len2 = sqlite3_column_int(indexer, 2);
+      len0 = strlen(entry);
+      len1 = n + 1 < h->ntopics ? (int) strlen(h->topics[n + 1].name) : 0;
+      len2 = n + 2 < h->ntopics ? (int) strlen(h->topics[n + 2].name) : 0;
       colspace = 0;
       if (len0 > LONG_TOPIC) {
         if (len1 > LONG_TOPIC) {
@@ -1530,19 +1462,19 @@ entries_from_offset(const help_file *h, int off)
       col = 0;
     }
   }
-  sqlite3_reset(indexer);
 
-  /* There are 'pages' pages in total */
-  if (off < pages) {
-    if (pages == (off + 1)) {
-      sqlite3_str_appendf(res, "\nFor more, see ENTRIES-%d", pages);
-    } else if (pages > (off + 1)) {
-      sqlite3_str_appendf(res, "\nFor more, see ENTRIES-%d through %d", off + 1,
-                          pages);
+  /* There are 'npages' pages in total */
+  if (off < h->npages) {
+    if (h->npages == (off + 1)) {
+      sqlite3_str_appendf(res, "\nFor more, see ENTRIES-%d", h->npages);
+    } else {
+      sqlite3_str_appendf(res, "\nFor more, see ENTRIES-%d through %d",
+                          off + 1, h->npages);
     }
   }
 
-  return sqlite3_str_finish(res);
+  h->pages[off - 1] = sqlite3_str_finish(res);
+  return h->pages[off - 1];
 }
 
 extern const unsigned char *tables;
@@ -1937,3 +1869,70 @@ COMMAND(cmd_suggest)
     }
   }
 }
+
+TEST_GROUP(help_topics)
+{
+  help_file fake, *h;
+  char name[TOPIC_NAME_LEN + 1];
+  char **entries;
+  const char *page;
+  int n, len = 0;
+
+  /* A made up file: ENTRY000 through ENTRY099 */
+  memset(&fake, 0, sizeof fake);
+  fake.command = "TEST.HELP";
+  fake.ntopics = 100;
+  fake.topics = mush_calloc(fake.ntopics, sizeof *fake.topics, "help.topics");
+  for (n = 0; n < fake.ntopics; n++) {
+    snprintf(name, sizeof name, "ENTRY%03d", n);
+    fake.topics[n].name = mush_strdup(name, "help.topic.name");
+    fake.topics[n].id = n;
+  }
+  fake.npages = (fake.ntopics + ENTRIES_PER_PAGE - 1) / ENTRIES_PER_PAGE;
+
+  TEST("help_topics.1", help_find_topic(&fake, "entry05") == 50);
+  TEST("help_topics.2", help_find_topic(&fake, "ENTRY1") == -1);
+  TEST("help_topics.3", help_find_topic(&fake, "E") == 0);
+  entries = list_matching_entries("entry0?5", &fake, &len);
+  TEST("help_topics.4", len == 10 && strcmp(entries[0], "ENTRY005") == 0 &&
+                          strcmp(entries[9], "ENTRY095") == 0);
+  free_entry_list(entries, len);
+  entries = list_matching_entries("*9", &fake, &len);
+  TEST("help_topics.5", len == 10);
+  free_entry_list(entries, len);
+  page = entries_from_offset(&fake, 2);
+  TEST("help_topics.6", page && strncmp(page, " ENTRY048 ", 10) == 0 &&
+                          strstr(page, "see ENTRIES-3\n") == NULL &&
+                          strstr(page, "For more, see ENTRIES-3"));
+  TEST("help_topics.7", entries_from_offset(&fake, 2) == page);
+  TEST("help_topics.8", entries_from_offset(&fake, 4) == NULL);
+  help_free_topics(&fake);
+
+  /* Compare against asking the database each time, for the real help */
+  h = hashfind("HELP", &help_files);
+  if (help_db && h && h->ntopics > 0) {
+    sqlite3_stmt *finder;
+    int found = 0;
+
+    finder = prepare_statement_cache(
+      help_db,
+      "SELECT rowid FROM topics WHERE catid = (SELECT id FROM categories "
+      "WHERE name = ?1) AND name LIKE ?2 || '%' ORDER BY name LIMIT 1",
+      "help.test.exists", 0);
+    sqlite3_bind_text(finder, 1, h->command, -1, SQLITE_STATIC);
+    BENCHMARK("help topic lookup (sqlite)", 1, {
+      for (n = 0; n < h->ntopics; n++) {
+        sqlite3_bind_text(finder, 2, h->topics[n].name, -1, SQLITE_STATIC);
+        found += sqlite3_step(finder) == SQLITE_ROW;
+        sqlite3_reset(finder);
+      }
+    });
+    sqlite3_finalize(finder);
+    BENCHMARK("help topic lookup (index)", 1, {
+      for (n = 0; n < h->ntopics; n++) {
+        found += help_entry_exists(h, h->topics[n].name, NULL);
+      }
+    });
+    TEST("help_topics.9", found == h->ntopics * 2);
+  }
+}
@@ -439,6 +439,7 @@ add_lock(dbref player, dbref thing, lock_type type, boolexp key, privbits flags)
     return 0;
   }
 
+  snapshot_preserve(thing);
   ll = getlockstruct_noparent(thing, type);
 
   if (ll) {
@@ -483,6 +484,7 @@ add_lock(dbref player, dbref thing, lock_type type, boolexp key, privbits flags)
       *t = ll;
     }
   }
+  warnings_changed(thing);
   return 1;
 }
 
@@ -512,6 +514,7 @@ add_lock_raw(dbref player, dbref thing, lock_type type, boolexp key,
     return 0;
   }
 
+  snapshot_preserve(thing);
   ll = next_free_lock(Locks(thing));
   if (!ll) {
     /* Oh, this sucks */
@@ -569,9 +572,11 @@ delete_lock(dbref player, dbref thing, lock_type type)
   }
   if (*llp != NULL) {
     if (can_write_lock(player, thing, *llp)) {
+      snapshot_preserve(thing);
       ll = *llp;
       *llp = ll->next;
       free_one_lock_list(ll);
+      warnings_changed(thing);
       return 1;
     } else
       return 0;
@@ -940,6 +945,7 @@ do_lset(dbref player, char *what, char *flags)
     return;
   }
 
+  snapshot_preserve(thing);
   if (unset)
     L_FLAGS(l) &= ~flag;
   else
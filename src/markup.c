@@ -628,6 +628,20 @@ char *
 remove_markup(const char *orig, size_t *s_len)
 {
   static char buff[BUFFER_LEN];
+
+  return remove_markup_r(orig, buff, s_len);
+}
+
+/** Strip all ANSI and HTML markup from a string into a buffer.
+ * Like remove_markup(), but safe to call from other threads.
+ * \param orig string to strip.
+ * \param buff BUFFER_LEN buffer to store the stripped string in.
+ * \param s_len address to store length of stripped string, if provided.
+ * \return buff, or NULL if orig is NULL.
+ */
+char *
+remove_markup_r(const char *orig, char *buff, size_t *s_len)
+{
   char *bp = buff;
   const char *q;
   size_t len = 0;
@@ -25,8 +25,10 @@
 #include "strutil.h"
 #include "externs.h"
 #include "mymalloc.h"
+#include "tests.h"
 
 #define PASSWORD_HASH "sha512"
+#define DIGEST_MAX_LEN 64 /**< Longest supported digest, SHA-512 */
 
 bool decode_base64(char *encoded, int len, bool printonly, char *buff,
                    char **bp);
@@ -34,6 +36,11 @@ bool check_mux_password(const char *saved, const char *password);
 char *mush_crypt_sha0(const char *key);
 int safe_hash_byname(const char *algo, const char *plaintext, int len,
                      char *buff, char **bp, bool inplace_err);
+static struct digest_ctx *digest_begin(const char *algo);
+static void digest_update(struct digest_ctx *d, const void *data,
+                          size_t len);
+static unsigned int digest_finish(struct digest_ctx *d, uint8_t *hash);
+static int safe_digest_finish(struct digest_ctx *d, char *buff, char **bp);
 char *password_hash(const char *key, const char *algo);
 bool password_comp(const char *saved, const char *pass);
 
@@ -97,6 +104,126 @@ lookup_bcrypt_algo(const char *name)
 }
 #endif
 
+/** An incremental message digest. Start one with digest_begin(), feed
+ * it as many pieces of data as needed with digest_update(), and get the
+ * result with digest_finish() or safe_digest_finish(). Used to hash a
+ * salt and a password without first copying both into one buffer.
+ * Attribute values reach digest() as already evaluated arguments, so
+ * nothing else needs it.
+ */
+struct digest_ctx {
+#ifdef WIN32
+  BCRYPT_ALG_HANDLE balgo; /**< Algorithm provider */
+  BCRYPT_HASH_HANDLE hfun; /**< Hash object */
+  DWORD hashlen;           /**< Length of the digest */
+#else
+  EVP_MD_CTX *ctx; /**< OpenSSL digest context */
+#endif
+};
+
+/** Start computing a digest.
+ * \param algo the name of the hash algorithm (sha1, md5, etc.)
+ * \return a new digest context, or NULL if the algorithm isn't supported.
+ */
+static struct digest_ctx *
+digest_begin(const char *algo)
+{
+  struct digest_ctx *d;
+#ifdef WIN32
+  const wchar_t *dgst;
+  ULONG cbhash = 0;
+
+  dgst = lookup_bcrypt_algo(algo);
+  if (!dgst)
+    return NULL;
+  d = mush_malloc(sizeof *d, "digest.ctx");
+  if (BCryptOpenAlgorithmProvider(&d->balgo, dgst, NULL, 0) !=
+      STATUS_SUCCESS) {
+    mush_free(d, "digest.ctx");
+    return NULL;
+  }
+  if (BCryptCreateHash(d->balgo, &d->hfun, NULL, 0, NULL, 0, 0) !=
+      STATUS_SUCCESS) {
+    BCryptCloseAlgorithmProvider(d->balgo, 0);
+    mush_free(d, "digest.ctx");
+    return NULL;
+  }
+  if (BCryptGetProperty(d->balgo, BCRYPT_HASH_LENGTH, (PBYTE) &d->hashlen,
+                        sizeof(d->hashlen), &cbhash, 0) != STATUS_SUCCESS ||
+      d->hashlen > DIGEST_MAX_LEN) {
+    BCryptDestroyHash(d->hfun);
+    BCryptCloseAlgorithmProvider(d->balgo, 0);
+    mush_free(d, "digest.ctx");
+    return NULL;
+  }
+#else
+  const EVP_MD *md;
+
+  md = EVP_get_digestbyname(algo);
+  if (!md)
+    return NULL;
+  d = mush_malloc(sizeof *d, "digest.ctx");
+  d->ctx = EVP_MD_CTX_create();
+  EVP_DigestInit(d->ctx, md);
+#endif
+  return d;
+}
+
+/** Add data to a digest.
+ * \param d the digest context.
+ * \param data the data to hash.
+ * \param len the length of the data.
+ */
+static void
+digest_update(struct digest_ctx *d, const void *data, size_t len)
+{
+#ifdef WIN32
+  BCryptHashData(d->hfun, (PUCHAR) data, (ULONG) len, 0);
+#else
+  EVP_DigestUpdate(d->ctx, data, len);
+#endif
+}
+
+/** Finish a digest and free its context.
+ * \param d the digest context.
+ * \param hash where to store the raw digest, at least DIGEST_MAX_LEN bytes.
+ * \return the length of the digest.
+ */
+static unsigned int
+digest_finish(struct digest_ctx *d, uint8_t *hash)
+{
+  unsigned int rlen;
+#ifdef WIN32
+  rlen = d->hashlen;
+  BCryptFinishHash(d->hfun, hash, rlen, 0);
+  BCryptDestroyHash(d->hfun);
+  BCryptCloseAlgorithmProvider(d->balgo, 0);
+#else
+  rlen = EVP_MAX_MD_SIZE;
+  EVP_DigestFinal(d->ctx, hash, &rlen);
+  EVP_MD_CTX_destroy(d->ctx);
+#endif
+  mush_free(d, "digest.ctx");
+  return rlen;
+}
+
+/** Finish a digest, free its context, and store the digest base-16
+ * encoded in a buffer.
+ * \param d the digest context.
+ * \param buff where to store it.
+ * \param bp pointer into buff to store at.
+ * \return 1 on failure, 0 on success.
+ */
+static int
+safe_digest_finish(struct digest_ctx *d, char *buff, char **bp)
+{
+  uint8_t hash[DIGEST_MAX_LEN];
+  unsigned int rlen;
+
+  rlen = digest_finish(d, hash);
+  return safe_hexstr(hash, rlen, buff, bp);
+}
+
 /** Hash a string and store it base-16 encoded in a buffer.
  * \param algo the name of the hash algorithm (sha1, md5, etc.)
  * \param plaintext the text to hash.
@@ -110,17 +237,10 @@ int
 safe_hash_byname(const char *algo, const char *plaintext, int len, char *buff,
                  char **bp, bool inplace_err)
 {
-#ifdef WIN32
-  const wchar_t *dgst;
-  BCRYPT_ALG_HANDLE balgo;
-  BCRYPT_HASH_HANDLE hfun;
-  PUCHAR hash;
-  DWORD hashlen = 0;
-  ULONG cbhash = 0;
-  int r;
+  struct digest_ctx *d;
 
-  dgst = lookup_bcrypt_algo(algo);
-  if (!dgst) {
+  d = digest_begin(algo);
+  if (!d) {
     if (inplace_err)
       safe_str(T("#-1 UNSUPPORTED DIGEST TYPE"), buff, bp);
     else
@@ -128,67 +248,53 @@ safe_hash_byname(const char *algo, const char *plaintext, int len, char *buff,
                 algo);
     return 1;
   }
+  digest_update(d, plaintext, len);
+  return safe_digest_finish(d, buff, bp);
+}
 
-  if (BCryptOpenAlgorithmProvider(&balgo, dgst, NULL, 0) != STATUS_SUCCESS) {
-    if (inplace_err)
-      safe_str(T("#-1 UNSUPPORTED DIGEST TYPE"), buff, bp);
-    else
-      do_rawlog(LT_ERR, "safe_hash_byname: Unknown password hash function: %s",
-                algo);
-    return 1;
-  }
-  if (BCryptCreateHash(balgo, &hfun, NULL, 0, NULL, 0, 0) != STATUS_SUCCESS) {
-    if (inplace_err)
-      safe_str(T("#-1 UNSUPPORTED DIGEST TYPE"), buff, bp);
-    else
-      do_rawlog(LT_ERR, "safe_hash_byname: Unknown password hash function: %s",
-                algo);
-    BCryptCloseAlgorithmProvider(balgo, 0);
-    return 1;
-  }
-  if (BCryptGetProperty(balgo, BCRYPT_HASH_LENGTH, (PBYTE) &hashlen,
-                        sizeof(hashlen), &cbhash, 0) != STATUS_SUCCESS) {
-    if (inplace_err)
-      safe_str(T("#-1 UNSUPPORTED DIGEST TYPE"), buff, bp);
-    else
-      do_rawlog(LT_ERR, "safe_hash_byname: Unknown password hash function: %s",
-                algo);
-    BCryptDestroyHash(hfun);
-    BCryptCloseAlgorithmProvider(balgo, 0);
-    return 1;
-  }
-  BCryptHashData(hfun, (PUCHAR) plaintext, (ULONG) len, 0);
-  hash = mush_malloc(hashlen + 1, "string");
-  BCryptFinishHash(hfun, hash, hashlen, 0);
-  hash[hashlen] = '\0';
-  BCryptDestroyHash(hfun);
-  BCryptCloseAlgorithmProvider(balgo, 0);
-  r = safe_hexstr(hash, hashlen, buff, bp);
-  mush_free(hash, "string");
-  return r;
-#else
-  EVP_MD_CTX *ctx;
-  const EVP_MD *md;
-  uint8_t hash[EVP_MAX_MD_SIZE];
-  unsigned int rlen = EVP_MAX_MD_SIZE;
+TEST_GROUP(digest_update)
+{
+  char b1[BUFFER_LEN], b2[BUFFER_LEN], *bp1 = b1, *bp2 = b2;
+  struct digest_ctx *d;
+
+  d = digest_begin("sha1");
+  digest_update(d, "foo", 3);
+  digest_update(d, "", 0);
+  digest_update(d, "bar", 3);
+  safe_digest_finish(d, b1, &bp1);
+  *bp1 = '\0';
+  safe_hash_byname("sha1", "foobar", 6, b2, &bp2, 1);
+  *bp2 = '\0';
+  TEST("digest_update.1", strcmp(b1, b2) == 0);
+  TEST("digest_update.2",
+       strcmp(b1, "8843d7f92416211de9ebb963ff4ce28125932878") == 0);
+  TEST("digest_update.3", digest_begin("nosuchdigest") == NULL);
+}
 
-  md = EVP_get_digestbyname(algo);
-  if (!md) {
-    if (inplace_err)
-      safe_str(T("#-1 UNSUPPORTED DIGEST TYPE"), buff, bp);
-    else
-      do_rawlog(LT_ERR, "safe_hash_byname: Unknown password hash function: %s",
-                algo);
+/** Hash a password with a two-character salt in front of it, and store
+ * it base-16 encoded in a buffer.
+ * \param algo the name of the hash algorithm.
+ * \param salt the two salt characters.
+ * \param pass the plaintext password.
+ * \param buff where to store it.
+ * \param bp pointer into buff to store at.
+ * \return 1 on failure, 0 on success.
+ */
+static int
+safe_salted_hash(const char *algo, const char *salt, const char *pass,
+                 char *buff, char **bp)
+{
+  struct digest_ctx *d;
+
+  d = digest_begin(algo);
+  if (!d) {
+    do_rawlog(LT_ERR, "safe_hash_byname: Unknown password hash function: %s",
+              algo);
     return 1;
   }
-  ctx = EVP_MD_CTX_create();
-  EVP_DigestInit(ctx, md);
-  EVP_DigestUpdate(ctx, plaintext, len);
-  EVP_DigestFinal(ctx, hash, &rlen);
-  EVP_MD_CTX_destroy(ctx);
-
-  return safe_hexstr(hash, rlen, buff, bp);
-#endif
+  digest_update(d, salt, 2);
+  digest_update(d, pass, strlen(pass));
+  return safe_digest_finish(d, buff, bp);
 }
 
 bool
@@ -233,52 +339,14 @@ check_mux_password(const char *saved, const char *password)
   decode_base64(start, strlen(start), 0, decoded, &dp);
   *dp = '\0';
   /* Double-hash the password */
-#ifdef WIN32
-  {
-    BCRYPT_ALG_HANDLE balgo;
-    BCRYPT_HASH_HANDLE hfun;
-    ULONG hashlen = 0, cbhash = 0;
-
-    const wchar_t *dgst = lookup_bcrypt_algo(algo);
-    if (!dgst) {
-      return 0;
-    }
-    if (BCryptOpenAlgorithmProvider(&balgo, dgst, NULL, 0) != STATUS_SUCCESS) {
-      return 0;
-    }
-    if (BCryptCreateHash(balgo, &hfun, NULL, 0, NULL, 0, 0) != STATUS_SUCCESS) {
-      BCryptCloseAlgorithmProvider(balgo, 0);
-      return 0;
-    }
-    if (BCryptGetProperty(balgo, BCRYPT_HASH_LENGTH, (PBYTE) &hashlen,
-                          sizeof(DWORD), &cbhash, 0) != STATUS_SUCCESS) {
-      BCryptDestroyHash(hfun);
-      BCryptCloseAlgorithmProvider(balgo, 0);
-      return 0;
-    }
-    BCryptHashData(hfun, (PUCHAR) start, (ULONG) strlen(start), 0);
-    BCryptHashData(hfun, (PUCHAR) password, (ULONG) strlen(password), 0);
-    BCryptFinishHash(hfun, (PUCHAR) hash, hashlen, 0);
-    hash[hashlen] = '\0';
-    rlen = hashlen;
-    BCryptDestroyHash(hfun);
-    BCryptCloseAlgorithmProvider(balgo, 0);
-  }
-#else
   {
-    EVP_MD_CTX *ctx;
-    const EVP_MD *md;
-    md = EVP_get_digestbyname(algo);
-    if (!md)
+    struct digest_ctx *d = digest_begin(algo);
+    if (!d)
       return 0;
-    ctx = EVP_MD_CTX_create();
-    EVP_DigestInit(ctx, md);
-    EVP_DigestUpdate(ctx, start, strlen(start));
-    EVP_DigestUpdate(ctx, password, strlen(password));
-    EVP_DigestFinal(ctx, hash, &rlen);
-    EVP_MD_CTX_destroy(ctx);
+    digest_update(d, start, strlen(start));
+    digest_update(d, password, strlen(password));
+    rlen = digest_finish(d, hash);
   }
-#endif
 
   /* Decode the stored password */
   dp = decoded;
@@ -316,28 +384,22 @@ password_hash(const char *key, const char *algo)
   static char buff[BUFFER_LEN];
   static const char *salts =
     "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
-  char s1, s2;
+  char salt[2];
   char *bp;
-  int len;
-  char hbuff[BUFFER_LEN + 2];
 
   if (!algo) {
     algo = PASSWORD_HASH;
   }
 
-  len = strlen(key);
-
-  s1 = salts[get_random_u32(0, 61)];
-  s2 = salts[get_random_u32(0, 61)];
+  salt[0] = salts[get_random_u32(0, 61)];
+  salt[1] = salts[get_random_u32(0, 61)];
 
   bp = buff;
   safe_strl("2:", 2, buff, &bp);
   safe_str(algo, buff, &bp);
   safe_chr(':', buff, &bp);
-  safe_chr(s1, buff, &bp);
-  safe_chr(s2, buff, &bp);
-  snprintf(hbuff, sizeof hbuff, "%c%c%s", s1, s2, key);
-  safe_hash_byname(algo, hbuff, len + 2, buff, &bp, 0);
+  safe_strl(salt, 2, buff, &bp);
+  safe_salted_hash(algo, salt, key, buff, &bp);
   safe_chr(':', buff, &bp);
   safe_time_t(time(NULL), buff, &bp);
   *bp = '\0';
@@ -403,11 +465,8 @@ password_comp(const char *saved, const char *pass)
     r = safe_hash_byname(algo, pass, len, buff, &bp, 0);
   } else if (strcmp(version, "2") == 0) {
     /* Salted password */
-    char hbuff[BUFFER_LEN + 2];
-    safe_chr(shash[0], buff, &bp);
-    safe_chr(shash[1], buff, &bp);
-    snprintf(hbuff, sizeof hbuff, "%c%c%s", shash[0], shash[1], pass);
-    r = safe_hash_byname(algo, hbuff, len + 2, buff, &bp, 0);
+    safe_strl(shash, 2, buff, &bp);
+    r = safe_salted_hash(algo, shash, pass, buff, &bp);
   } else {
     /* Unknown password format version */
     retval = 0;
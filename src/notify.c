@@ -1918,6 +1918,7 @@ queue_newwrite_channel(DESC *d, const char *b, int n, char ch)
   int space;
 
   char *utf8 = NULL;
+  char utf8buf[BUFFER_LEN * 2 + 1];
 
   if (d->conn_flags & CONN_NOWRITE)
     return 0;
@@ -1929,11 +1930,18 @@ queue_newwrite_channel(DESC *d, const char *b, int n, char ch)
   }
 
   if (d->conn_flags & CONN_UTF8) {
-    int utf8bytes = 0;
-    utf8 = latin1_to_utf8_tn(b, n, &utf8bytes, d->conn_flags & CONN_TELNET,
-                             "string");
-    b = utf8;
-    n = utf8bytes;
+    /* Most output fits in a stack buffer; only allocate for huge writes. */
+    if (n * 2 + 1 <= (int) sizeof utf8buf) {
+      n = latin1_to_utf8_tn_r(b, n, utf8buf, sizeof utf8buf,
+                              d->conn_flags & CONN_TELNET);
+      b = utf8buf;
+    } else {
+      int utf8bytes = 0;
+      utf8 = latin1_to_utf8_tn(b, n, &utf8bytes, d->conn_flags & CONN_TELNET,
+                               "string");
+      b = utf8;
+      n = utf8bytes;
+    }
   }
 
   /*
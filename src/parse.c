@@ -512,11 +512,10 @@ bool
 is_strict_number(char const *str)
 {
   char *end;
-  int throwaway __attribute__((__unused__));
   if (!str)
     return 0;
   errno = 0;
-  throwaway = strtod(str, &end);
+  (void) parse_nval(str, &end);
   if (errno == ERANGE || *end != '\0')
     return 0;
   return end > str;
@@ -757,6 +756,142 @@ parse_int64(const char *s, char **end, int base)
 #endif
 }
 
+/** Powers of ten that a double represents exactly. */
+static const double nval_pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                    1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                    1e18, 1e19, 1e20, 1e21, 1e22};
+
+/** Convert a string containing a floating-point number into an NVAL.
+ * This is a drop-in replacement for strtod(). Plain decimal numbers, which
+ * is nearly everything softcode passes around, are converted directly:
+ * when the significant digits fit in 53 bits and the power of ten is
+ * exact, a single multiplication or division is correctly rounded and
+ * gives exactly what strtod() would. Anything else (long or huge numbers,
+ * hex, inf, nan) is handed to strtod().
+ * \param s The string to convert
+ * \param end pointer to store the end of the parsed part of the string in
+ * if not NULL.
+ * \return the number. On overflow or underflow errno is set to ERANGE.
+ */
+NVAL
+parse_nval(const char *s, char **end)
+{
+  const char *p = s;
+  uint64_t mant = 0;
+  int digits = 0, scale = 0;
+  bool neg = 0, any = 0;
+  NVAL val;
+
+  while (isspace(*p))
+    p++;
+  if (*p == '-' || *p == '+')
+    neg = (*p++ == '-');
+  if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+    return strtod(s, end);
+  for (; isdigit(*p); p++) {
+    any = 1;
+    if (mant == 0 && *p == '0')
+      continue;
+    if (++digits > 19)
+      return strtod(s, end);
+    mant = mant * 10 + (*p - '0');
+  }
+  if (*p == '.') {
+    for (p++; isdigit(*p); p++) {
+      any = 1;
+      scale--;
+      if (mant == 0 && *p == '0')
+        continue;
+      if (++digits > 19)
+        return strtod(s, end);
+      mant = mant * 10 + (*p - '0');
+    }
+  }
+  if (!any)
+    return strtod(s, end);
+  if (*p == 'e' || *p == 'E') {
+    const char *q = p + 1;
+    bool eneg = 0;
+    int exp = 0;
+
+    if (*q == '-' || *q == '+')
+      eneg = (*q++ == '-');
+    if (isdigit(*q)) {
+      for (; isdigit(*q); q++)
+        if (exp < 10000)
+          exp = exp * 10 + (*q - '0');
+      scale += eneg ? -exp : exp;
+      p = q;
+    }
+  }
+
+  if (mant == 0)
+    val = 0;
+  else if (mant > (UINT64_C(1) << 53) || scale < -22 || scale > 22)
+    return strtod(s, end);
+  else if (scale < 0)
+    val = (NVAL) mant / nval_pow10[-scale];
+  else
+    val = (NVAL) mant * nval_pow10[scale];
+
+  if (end)
+    *end = (char *) p;
+  return neg ? -val : val;
+}
+
+TEST_GROUP(parse_nval)
+{
+  static const char *strs[] = {
+    "0",     "-0",     "+0",       "12",      "-12.5",   "  12.05", ".5",
+    "5.",    ".",      "-",        "",        "1e5",     "1e",      "1e+",
+    "1.e5",  "2E-3",   "0x1A",     "inf",     "-nan",    "12foo",   "1e400",
+    "1e-400", "0.1",   "0.3",      "123456789012345678",
+    "1234567890123456789012",      "9007199254740993",
+    "0.000000000000000000000000001", "3.14159265358979", "1e22", "1e23",
+    "000123.4500",                 "-0.0e5"};
+  char buf[64];
+  char *e1, *e2;
+  NVAL v1, v2;
+  size_t n;
+  unsigned int seed = 1;
+  int prec;
+  bool ok = 1;
+
+  for (n = 0; n < sizeof strs / sizeof strs[0]; n++) {
+    v1 = parse_nval(strs[n], &e1);
+    v2 = strtod(strs[n], &e2);
+    if (e1 != e2 || memcmp(&v1, &v2, sizeof v1) != 0)
+      ok = 0;
+  }
+  TEST("parse_nval.1", ok);
+
+  /* Compare against strtod() on whatever unparse_number() and %g make of
+   * a spread of pseudo-random numbers */
+  ok = 1;
+  for (n = 0; n < 20000; n++) {
+    NVAL x;
+    seed = seed * 1103515245 + 12345;
+    x = (NVAL) (seed >> 8) / (1 << (seed % 24)) - 5000;
+    for (prec = 0; prec < 18; prec += 3) {
+      snprintf(buf, sizeof buf, "%.*g", prec + 1, x);
+      v1 = parse_nval(buf, &e1);
+      v2 = strtod(buf, &e2);
+      if (e1 != e2 || memcmp(&v1, &v2, sizeof v1) != 0)
+        ok = 0;
+      snprintf(buf, sizeof buf, "%.*f", prec, x);
+      v1 = parse_nval(buf, &e1);
+      v2 = strtod(buf, &e2);
+      if (e1 != e2 || memcmp(&v1, &v2, sizeof v1) != 0)
+        ok = 0;
+    }
+  }
+  TEST("parse_nval.2", ok);
+
+  BENCHMARK("strtod", 100000, { strtod("-1234.5678", NULL); });
+  BENCHMARK("parse_nval", 100000, { parse_nval("-1234.5678", NULL); });
+}
+
 /** Convert a string containing an unsigned integer into an int.
  * Does not do any format checking. Invalid strings will return 0.
  * Use this instead of strtoul() when storing to an int to avoid problems
@@ -1995,6 +2130,163 @@ pe_info_from(NEW_PE_INFO *old_pe_info, int flags, PE_REGS *pe_regs)
   return pe_info;
 }
 
+/* Function arguments are evaluated into buffers carved off a stack of
+ * chunks rather than each getting its own zeroed allocation. A function
+ * call gives back everything it took before process_expression() moves
+ * on, and nested calls finish before the calls around them, so a mark
+ * taken before the arguments are evaluated is all that's needed to
+ * release them. A few emptied chunks are kept around for the next call,
+ * since a switch() with many cases needs several.
+ */
+enum { PE_STACK_CHUNK = 16 * (BUFFER_LEN + SSE_OFFSET), PE_STACK_SPARES = 8 };
+
+struct pe_stack_chunk {
+  struct pe_stack_chunk *prev; /**< The chunk below this one */
+  size_t size;                 /**< Usable bytes in data */
+  size_t used;                 /**< Bytes handed out */
+  char data[] __attribute__((__aligned__(16)));
+};
+
+/** A position in the argument stack to release back to. */
+struct pe_stack_mark {
+  struct pe_stack_chunk *chunk;
+  size_t used;
+};
+
+static struct pe_stack_chunk *pe_stack = NULL;
+static struct pe_stack_chunk *pe_stack_spare = NULL; /**< Unused chunks */
+static int pe_stack_nspare = 0;
+static uint64_t pe_stack_allocs = 0; /**< Buffers handed out, for tests */
+static uint64_t pe_stack_chunks = 0; /**< Chunks malloced, for tests */
+
+static struct pe_stack_mark
+pe_stack_save(void)
+{
+  struct pe_stack_mark mark = {pe_stack, pe_stack ? pe_stack->used : 0};
+  return mark;
+}
+
+/* Allocate uninitialized memory from the argument stack. */
+static void *
+pe_stack_alloc(size_t bytes)
+{
+  struct pe_stack_chunk *c = pe_stack;
+  void *p;
+
+  bytes = (bytes + 15) & ~(size_t) 15;
+  if (!c || c->size - c->used < bytes) {
+    size_t size = bytes > PE_STACK_CHUNK ? bytes : PE_STACK_CHUNK;
+    if (pe_stack_spare && pe_stack_spare->size >= size) {
+      c = pe_stack_spare;
+      pe_stack_spare = c->prev;
+      pe_stack_nspare--;
+    } else {
+      c = mush_malloc(sizeof *c + size, "process_expression.stack");
+      if (!c)
+        mush_panic("Unable to allocate memory in pe_stack_alloc");
+      c->size = size;
+      pe_stack_chunks++;
+    }
+    c->used = 0;
+    c->prev = pe_stack;
+    pe_stack = c;
+  }
+  p = c->data + c->used;
+  c->used += bytes;
+  pe_stack_allocs++;
+  return p;
+}
+
+/* Free everything allocated from the argument stack since mark. */
+static void
+pe_stack_release(struct pe_stack_mark mark)
+{
+  while (pe_stack != mark.chunk) {
+    struct pe_stack_chunk *c = pe_stack;
+    pe_stack = c->prev;
+    if (c->size == PE_STACK_CHUNK && pe_stack_nspare < PE_STACK_SPARES) {
+      c->prev = pe_stack_spare;
+      pe_stack_spare = c;
+      pe_stack_nspare++;
+    } else {
+      mush_free(c, "process_expression.stack");
+    }
+  }
+  if (pe_stack)
+    pe_stack->used = mark.used;
+}
+
+TEST_GROUP(pe_stack)
+{
+  /* Typical softcode: a long switch(), a loop, and a few nested calls */
+  static const char *code[] = {
+    "switch(17,1,a,2,b,3,c,4,d,5,e,6,f,7,g,8,h,9,i,10,j,11,k,12,l,13,m,14,n,"
+    "15,o,16,p,17,q,18,r,19,s,20,t,none)",
+    "words(iter(lnum(100),add(##,1)))",
+    "ucstr(mid(strcat(foo,bar,baz),2,5))",
+    "if(gt(strlen(repeat(ab,20)),10),yes,no)",
+    NULL};
+  static const char *want[] = {"q", "100", "OBARB", "yes"};
+  struct pe_stack_mark mark;
+  char buff[BUFFER_LEN], *bp;
+  char *a, *b;
+  const char *sp;
+  uint64_t allocs, chunks;
+  int n, ok = 1;
+
+  mark = pe_stack_save();
+  a = pe_stack_alloc(10);
+  b = pe_stack_alloc(BUFFER_LEN);
+  TEST("pe_stack.1", b == a + 16);
+  pe_stack_release(mark);
+  TEST("pe_stack.2", pe_stack == mark.chunk && pe_stack_alloc(10) == a);
+  b = pe_stack_alloc(PE_STACK_CHUNK * 2);
+  TEST("pe_stack.3", pe_stack->size >= PE_STACK_CHUNK * 2 &&
+                       b == pe_stack->data);
+  pe_stack_release(mark);
+
+  for (n = 0; code[n]; n++) {
+    bp = buff;
+    sp = code[n];
+    process_expression(buff, &bp, &sp, GOD, GOD, GOD, PE_DEFAULT, PT_DEFAULT,
+                       NULL);
+    *bp = '\0';
+    if (strcmp(buff, want[n]) != 0) {
+      do_rawlog(LT_TRACE, "pe_stack: %s gave '%s'", code[n], buff);
+      ok = 0;
+    }
+  }
+  TEST("pe_stack.4", ok);
+  TEST("pe_stack.5", pe_stack == mark.chunk);
+
+  allocs = pe_stack_allocs;
+  chunks = pe_stack_chunks;
+  for (n = 0; code[n]; n++) {
+    BENCHMARK(code[n], 1000, {
+      bp = buff;
+      sp = code[n];
+      process_expression(buff, &bp, &sp, GOD, GOD, GOD, PE_DEFAULT,
+                         PT_DEFAULT, NULL);
+    });
+  }
+  do_rawlog(LT_TRACE,
+            "BENCHMARK argument buffers for %d evaluations: %" PRIu64
+            " from the stack, %" PRIu64 " chunks malloced.",
+            n * 1000, pe_stack_allocs - allocs, pe_stack_chunks - chunks);
+
+  /* What each of those buffers used to cost */
+  BENCHMARK("argument buffer (mush_malloc_zero)", 10000, {
+    a = mush_malloc_zero(BUFFER_LEN + SSE_OFFSET,
+                         "process_expression.function_argument");
+    mush_free(a, "process_expression.function_argument");
+  });
+  BENCHMARK("argument buffer (pe_stack_alloc)", 10000, {
+    mark = pe_stack_save();
+    a = pe_stack_alloc(BUFFER_LEN + SSE_OFFSET);
+    pe_stack_release(mark);
+  });
+}
+
 /** Function and other substitution evaluation.
  * This is the PennMUSH function/expression parser. Big stuff.
  *
@@ -2756,7 +3048,8 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
         }
         break;
       } else {
-        char *onearg;
+        struct pe_stack_mark mark = pe_stack_save();
+        char *onearg = NULL;
         char *sargs[10];
         char **fargs;
         int sarglens[10];
@@ -2778,16 +3071,19 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
         }
         args_alloced = 10;
         eflags &= ~PE_FUNCTION_CHECK;
-        /* Get the function name */
-        for (sp = startpos, tp = name; sp < *bp; sp++)
-          safe_chr(UPCASE(*sp), name, &tp);
-        *tp = '\0';
-        fp = (eflags & PE_BUILTINONLY) ? builtin_func_hash_lookup(name)
-                                       : func_hash_lookup(name);
+        fp = func_call_lookup(startpos, *bp - startpos,
+                              (eflags & PE_BUILTINONLY) != 0);
         eflags &= ~PE_BUILTINONLY; /* Only applies to the outermost call */
+        /* name is scratch space for skipping over arguments, except when
+         * it's needed for an error message. */
+        tp = name;
         if (!fp) {
           if (eflags & PE_FUNCTION_MANDATORY) {
             char *suggestion;
+            /* Get the function name */
+            for (sp = startpos; sp < *bp; sp++)
+              safe_chr(UPCASE(*sp), name, &tp);
+            *tp = '\0';
             *bp = startpos;
             safe_str(T("#-1 FUNCTION ("), buff, bp);
             safe_str(name, buff, bp);
@@ -2870,8 +3166,10 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
             ~(PE_COMPRESS_SPACES | PE_EVALUATE | PE_FUNCTION_CHECK);
         temp_tflags = PT_COMMA | PT_PAREN;
         nfargs = 0;
-        onearg = mush_malloc(BUFFER_LEN,
-                             "process_expression.single_function_argument");
+        /* Markup is stripped on the way from onearg to the argument;
+         * other arguments are evaluated in place. */
+        if (fp->flags & FN_STRIPANSI)
+          onearg = pe_stack_alloc(BUFFER_LEN);
         do {
           char *argp;
           char *lca_safe_func_name = NULL;
@@ -2895,26 +3193,24 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
           if (nfargs >= args_alloced) {
             char **nargs;
             int *narglens;
-            nargs = mush_calloc(nfargs + 10, sizeof(char *),
-                                "process_expression.function_arglist");
-            narglens = mush_calloc(nfargs + 10, sizeof(int),
-                                   "process_expression.function_arglens");
+            /* The old lists are left on the stack until the call is done */
+            args_alloced *= 2;
+            nargs = pe_stack_alloc(args_alloced * sizeof(char *));
+            narglens = pe_stack_alloc(args_alloced * sizeof(int));
             for (j = 0; j < nfargs; j++) {
               nargs[j] = fargs[j];
               narglens[j] = arglens[j];
             }
-            if (fargs != sargs)
-              mush_free(fargs, "process_expression.function_arglist");
-            if (arglens != sarglens)
-              mush_free(arglens, "process_expression.function_arglens");
+            for (; j < args_alloced; j++) {
+              nargs[j] = NULL;
+              narglens[j] = 0;
+            }
             fargs = nargs;
             arglens = narglens;
-            args_alloced += 10;
           }
-          fargs[nfargs] = mush_malloc_zero(
-            BUFFER_LEN + SSE_OFFSET, "process_expression.function_argument");
-          argp = onearg;
-          if (process_expression(onearg, &argp, str, executor, caller, enactor,
+          fargs[nfargs] = pe_stack_alloc(BUFFER_LEN + SSE_OFFSET);
+          argp = onearg ? onearg : fargs[nfargs];
+          if (process_expression(argp, &argp, str, executor, caller, enactor,
                                  temp_eflags, temp_tflags, pe_info)) {
             retval = 1;
             nfargs++;
@@ -2930,11 +3226,8 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
             goto free_func_args;
           }
           *argp = '\0';
-          if (fp->flags & FN_STRIPANSI) {
+          if (onearg)
             strcpy(fargs[nfargs], remove_markup(onearg, NULL));
-          } else {
-            strcpy(fargs[nfargs], onearg);
-          }
           arglens[nfargs] = strlen(fargs[nfargs]);
           /* Part of r1628's deprecation of unescaped commas as the final arg of
            * a function,
@@ -2972,7 +3265,6 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
            * Special case: zero args is recognized as one null arg.
            */
           if ((fp->minargs == 0) && (nfargs == 1) && !*fargs[0]) {
-            mush_free(fargs[0], "process_expression.function_argument");
             fargs[0] = NULL;
             arglens[0] = 0;
             nfargs = 0;
@@ -3077,15 +3369,7 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
         }
       /* Free up the space allocated for the args */
       free_func_args:
-        for (j = 0; j < nfargs; j++)
-          if (fargs[j])
-            mush_free(fargs[j], "process_expression.function_argument");
-        if (fargs != sargs)
-          mush_free(fargs, "process_expression.function_arglist");
-        if (arglens != sarglens)
-          mush_free(arglens, "process_expression.function_arglens");
-        if (onearg)
-          mush_free(onearg, "process_expression.single_function_argument");
+        pe_stack_release(mark);
       }
       break;
     /* Space compression */
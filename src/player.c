@@ -590,6 +590,7 @@ make_player(const char *name, const char *password, const char *host,
   current_state.players++;
 
   local_data_create(player);
+  warnings_changed(player);
 
   return player;
 }
@@ -305,6 +305,7 @@ chown_object(dbref player, dbref thing, dbref newowner, int preserve)
   } else {
     Owner(thing) = Owner(newowner);
   }
+  warnings_changed(thing);
   /* Don't allow circular zones */
   Zone(thing) = NOTHING;
   if (GoodObject(Zone(newowner))) {
@@ -335,6 +336,7 @@ chown_object(dbref player, dbref thing, dbref newowner, int preserve)
     clear_flag_internal(thing, "ROYALTY");
     clear_flag_internal(thing, "TRUST");
     set_flag_internal(thing, "HALT");
+    snapshot_preserve(thing);
     destroy_flag_bitmask("POWER", Powers(thing));
     Powers(thing) = new_flag_bitmask("POWER");
     do_halt(thing, "", thing);
@@ -472,6 +474,7 @@ do_chzone(dbref player, char const *name, char const *newobj, bool noisy,
     clear_flag_internal(thing, "WIZARD");
     clear_flag_internal(thing, "ROYALTY");
     clear_flag_internal(thing, "TRUST");
+    snapshot_preserve(thing);
     destroy_flag_bitmask("POWER", Powers(thing));
     Powers(thing) = new_flag_bitmask("POWER");
   } else {
@@ -514,6 +517,8 @@ af_helper(dbref player, dbref thing, dbref parent __attribute__((__unused__)),
     return 0;
   }
 
+  snapshot_preserve(thing);
+
   /* Clear flags first, then set flags */
   if (af->clrf) {
     AL_FLAGS(atr) &= ~af->clrf;
@@ -549,6 +554,7 @@ copy_attrib_flags(dbref player, dbref target, ATTR *atr, int flags)
     flags |= AF_ROOT;
   else
     flags &= ~AF_ROOT;
+  snapshot_preserve(target);
   AL_FLAGS(atr) = flags;
 }
 
@@ -1486,6 +1492,7 @@ do_parent(dbref player, const char *name, const char *parent_name, NEW_PE_INFO *
   }
   /* everything is okay, do the change */
   Parent(thing) = parent;
+  warnings_changed(thing);
   if (!AreQuiet(player, thing))
     notify(player, T("Parent changed."));
 }
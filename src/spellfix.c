@@ -3108,6 +3108,40 @@ static int spellfix1Register(sqlite3 *db){
   return rc;
 }
 
+/* Penn addition: look up the ASCII transliteration of a single unicode
+** character in translit[], so that C code can share the table without
+** a round trip through spellfix1_translit(). Up to 4 bytes are written
+** to zOut. Returns the number of bytes written, or 0 if the character
+** has no mapping.
+*/
+int spellfix_translit_char(int c, unsigned char *zOut){
+  int xTop, xBtm, x, n;
+  const Transliteration *tbl = spellfixFindTranslit(c, &xTop);
+  xBtm = 0;
+  while( xTop>=xBtm ){
+    x = (xTop + xBtm)/2;
+    if( tbl[x].cFrom==c ){
+      n = 0;
+      zOut[n++] = tbl[x].cTo0;
+      if( tbl[x].cTo1 ){
+        zOut[n++] = tbl[x].cTo1;
+        if( tbl[x].cTo2 ){
+          zOut[n++] = tbl[x].cTo2;
+          if( tbl[x].cTo3 ){
+            zOut[n++] = tbl[x].cTo3;
+          }
+        }
+      }
+      return n;
+    }else if( tbl[x].cFrom>c ){
+      xTop = x-1;
+    }else{
+      xBtm = x+1;
+    }
+  }
+  return 0;
+}
+
 #endif /* SQLITE_OMIT_VIRTUALTABLE */
 
 /*
@@ -5,12 +5,47 @@
 
 #include <stdio.h>
 #include <string.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+#ifdef WIN32
+#include <windows.h>
+#endif
 
 #include "sqlite3.h"
 #include "tests.h"
 
 #include "tests.inc"
 
+/** Current time in microseconds, for benchmarks. */
+uint64_t
+bench_usecs(void)
+{
+#ifdef WIN32
+  LARGE_INTEGER li, frequency;
+  QueryPerformanceCounter(&li);
+  QueryPerformanceFrequency(&frequency);
+  return li.QuadPart * 1000000.0 / frequency.QuadPart;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (1000000ULL * tv.tv_sec) + tv.tv_usec;
+#endif
+}
+
+/** Log the result of a benchmark.
+ * \param name the name of the benchmark.
+ * \param iterations how many times the benchmarked code ran.
+ * \param usecs the total time taken, in microseconds.
+ */
+void
+log_benchmark(const char *name, int iterations, uint64_t usecs)
+{
+  do_rawlog(LT_TRACE, "BENCHMARK %s: %d iterations in %.3fms, %.3fus each.",
+            name, iterations, usecs / 1000.0, (double) usecs / iterations);
+}
+
 /** Run the hardcode tests.
  * \return true if all tests passed, false if tests failed.
  */
@@ -43,6 +43,9 @@
 #include "sig.h"
 #include "strutil.h"
 
+/** Objects to read lazily loaded attributes of each second */
+#define ATTRS_LOAD_SLICE 1000
+
 bool inactivity_check(void);
 static void migrate_stuff(int amount);
 static struct squeue *sq_register(uint64_t w, sq_func f, void *d,
@@ -178,14 +181,27 @@ dbck_event(void *data __attribute__((__unused__)))
   return true;
 }
 
+static bool
+attrs_event(void *data __attribute__((__unused__)))
+{
+  if (attrs_load_some(ATTRS_LOAD_SLICE))
+    sq_register_in(1, attrs_event, NULL, NULL);
+  return false;
+}
+
 static bool
 warning_event(void *data __attribute__((__unused__)))
 {
   if (options.warn_interval <= 0)
     return false; /* in case warn_interval is set to 0 with @config */
-  options.warn_counter = options.warn_interval + mudtime;
-  run_topology();
-  sq_register_in(options.warn_interval, warning_event, NULL, "DB`WCHECK");
+  if (run_topology_changes()) {
+    /* Check the rest soon, a slice at a time */
+    options.warn_counter = mudtime + 1;
+    sq_register_in(1, warning_event, NULL, "DB`WCHECK");
+  } else {
+    options.warn_counter = options.warn_interval + mudtime;
+    sq_register_in(options.warn_interval, warning_event, NULL, "DB`WCHECK");
+  }
   return true;
 }
 
@@ -251,6 +267,8 @@ init_sys_events(void)
 {
   time(&mudtime);
   sq_register_loop(60, idle_event, NULL, "PLAYER`INACTIVITY");
+  if (attrs_unloaded)
+    sq_register_in(1, attrs_event, NULL, NULL);
   if (DBCK_INTERVAL > 0) {
     sq_register_in(DBCK_INTERVAL, dbck_event, NULL, "DB`DBCK");
     options.dbck_counter = mudtime + DBCK_INTERVAL;
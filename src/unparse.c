@@ -8,6 +8,7 @@
 
 #include "copyrite.h"
 
+#include <math.h>
 #include <string.h>
 #ifdef HAVE_INTTYPES_H
 #include <inttypes.h>
@@ -26,6 +27,7 @@
 #include "parse.h"
 #include "pueblo.h"
 #include "strutil.h"
+#include "tests.h"
 
 /** Format an object's name (and dbref and flags).
  * This is a wrapper for real_unparse() that conditionally applies
@@ -243,18 +245,18 @@ unparse_uinteger(uintmax_t num)
   return str;
 }
 
-/** Give a string representation of a number.
- * \param num value to stringify
- * \return address of static buffer containing stringified value.
+/** Format a number the way unparse_number() always has: printf's "%.*f"
+ * with trailing zeros and a trailing decimal point removed.
+ * \param num value to stringify.
+ * \param prec number of decimal places.
+ * \param str buffer of at least 1000 characters to write into.
  */
-char *
-unparse_number(NVAL num)
+static void
+unparse_number_printf(NVAL num, int prec, char *str)
 {
-  /* 100 is NOT large enough for even the huge floats */
-  static char str[1000]; /* Should be large enough for even the HUGE floats */
   char *p;
-  snprintf(str, 1000, "%.*f", FLOAT_PRECISION, num);
 
+  snprintf(str, 1000, "%.*f", prec, num);
   if ((p = strchr(str, '.'))) {
     p += strlen(p);
     while (p[-1] == '0')
@@ -263,9 +265,170 @@ unparse_number(NVAL num)
       p--;
     *p = '\0';
   }
+}
+
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 uint128_nval;
+
+/** Format a number like unparse_number_printf(), without printf.
+ * A double below 2^53 is exactly f / 2^k for integers f and k,
+ * so its integer part and its decimal places can be worked out exactly
+ * with 128-bit integers, rounding half to even on the exact value just
+ * like glibc's printf does.
+ * \param num value to stringify.
+ * \param prec number of decimal places.
+ * \param str buffer to write into.
+ * \retval true num was formatted.
+ * \retval false num is out of range, use unparse_number_printf().
+ */
+static bool
+unparse_number_fast(NVAL num, int prec, char *str)
+{
+  static const uint64_t pow10[] = {1ULL,
+                                   10ULL,
+                                   100ULL,
+                                   1000ULL,
+                                   10000ULL,
+                                   100000ULL,
+                                   1000000ULL,
+                                   10000000ULL,
+                                   100000000ULL,
+                                   1000000000ULL,
+                                   10000000000ULL,
+                                   100000000000ULL,
+                                   1000000000000ULL,
+                                   10000000000000ULL,
+                                   100000000000000ULL};
+  char digits[24], *p;
+  uint64_t bits, f, ip = 0, frac = 0;
+  uint128_nval prod, rem, half;
+  int e, k = 0, n;
+
+  if (prec < 0 || prec > 14)
+    return 0;
+  memcpy(&bits, &num, sizeof bits);
+  e = (bits >> 52) & 0x7FF;
+  f = bits & ((UINT64_C(1) << 52) - 1);
+  if (e == 0x7FF || (e == 0 && f != 0))
+    return 0; /* inf, nan, or too tiny to bother with */
+  if (e != 0) {
+    /* |num| is f / 2^k */
+    f |= UINT64_C(1) << 52;
+    k = 1075 - e;
+    if (k < 0 || k > 120)
+      return 0;
+    if (k < 64) {
+      ip = f >> k;
+      f &= (UINT64_C(1) << k) - 1;
+    }
+  }
+
+  /* Round f / 2^k to prec decimal places */
+  if (k > 0) {
+    prod = (uint128_nval) f * pow10[prec];
+    frac = (uint64_t) (prod >> k);
+    rem = prod & ((((uint128_nval) 1) << k) - 1);
+    half = ((uint128_nval) 1) << (k - 1);
+    if (rem > half || (rem == half && ((prec ? frac : ip) & 1)))
+      frac++;
+    if (frac == pow10[prec]) {
+      ip++;
+      frac = 0;
+    }
+  }
+
+  if (signbit(num))
+    *str++ = '-';
+  p = digits + sizeof digits;
+  do {
+    *--p = '0' + (ip % 10);
+    ip /= 10;
+  } while (ip);
+  n = digits + sizeof digits - p;
+  memcpy(str, p, n);
+  str += n;
+
+  if (frac) {
+    while (frac % 10 == 0) {
+      frac /= 10;
+      prec--;
+    }
+    *str++ = '.';
+    for (p = str + prec; p > str; frac /= 10)
+      *--p = '0' + (frac % 10);
+    str += prec;
+  }
+  *str = '\0';
+  return 1;
+}
+#endif
+
+/** Give a string representation of a number.
+ * \param num value to stringify
+ * \return address of static buffer containing stringified value.
+ */
+char *
+unparse_number(NVAL num)
+{
+  /* 100 is NOT large enough for even the huge floats */
+  static char str[1000]; /* Should be large enough for even the HUGE floats */
+
+#ifdef __SIZEOF_INT128__
+  if (unparse_number_fast(num, FLOAT_PRECISION, str))
+    return str;
+#endif
+  unparse_number_printf(num, FLOAT_PRECISION, str);
   return str;
 }
 
+#ifdef __SIZEOF_INT128__
+TEST_GROUP(unparse_number)
+{
+  static const NVAL vals[] = {0.0,     -0.0,    0.5,      1.5,     2.5,
+                              -2.5,    0.125,   0.0625,   1e-7,    -1e-7,
+                              5e-7,    4.9e-7,  0.1,      0.3,     1.0 / 3,
+                              2.0 / 3, 1e14,    1e15,     -1e15,   1e16,
+                              1e300,   1e-300,  HUGE_VAL, -HUGE_VAL};
+  char fast[1000], ref[1000];
+  unsigned int seed = 1;
+  size_t n;
+  int prec;
+  bool ok = 1;
+
+  for (n = 0; n < sizeof vals / sizeof vals[0]; n++)
+    for (prec = 0; prec <= 14; prec++) {
+      unparse_number_printf(vals[n], prec, ref);
+      if (unparse_number_fast(vals[n], prec, fast) && strcmp(fast, ref) != 0)
+        ok = 0;
+    }
+  TEST("unparse_number.1", ok);
+
+  /* Pseudo-random numbers of all sizes, plus ones exactly halfway between
+   * two outputs, which is where rounding goes wrong */
+  ok = 1;
+  for (n = 0; n < 20000; n++) {
+    NVAL x;
+    seed = seed * 1103515245 + 12345;
+    x = (NVAL) (seed >> 4) / (1 << (seed % 30)) - 1000;
+    for (prec = 0; prec <= 14; prec++) {
+      unparse_number_printf(x, prec, ref);
+      if (unparse_number_fast(x, prec, fast) && strcmp(fast, ref) != 0)
+        ok = 0;
+    }
+    x = ((NVAL) (seed % 100000) + 0.5) / 1000;
+    unparse_number_printf(x, 3, ref);
+    if (!unparse_number_fast(x, 3, fast) || strcmp(fast, ref) != 0)
+      ok = 0;
+  }
+  TEST("unparse_number.2", ok);
+
+  BENCHMARK("unparse_number (printf)", 100000,
+            { unparse_number_printf(-1234.5678, 6, ref); });
+  BENCHMARK("unparse_number", 100000,
+            { unparse_number_fast(-1234.5678, 6, fast); });
+}
+#endif
+
 /** Return the name of an object, applying NAMEACCENT if set.
  * \param thing dbref of object.
  * \return address of static buffer containing object name, with accents
@@ -20,8 +20,11 @@
 #include "lock.h"
 #include "match.h"
 #include "mushdb.h"
+#include "mymalloc.h"
 #include "notify.h"
+#include "sort.h"
 #include "strutil.h"
+#include "tests.h"
 #include "warn_tab.h"
 
 /* We might check for both locked and unlocked warnings if we can't
@@ -242,6 +245,7 @@ do_warnings(dbref player, const char *name, const char *warns)
   w = parse_warnings(player, warns);
   if (w != old) {
     Warnings(thing) = w;
+    warnings_changed(thing);
     if (Warnings(thing))
       notify_format(player, T("@warnings set to: %s"),
                     unparse_warnings(Warnings(thing)));
@@ -381,6 +385,223 @@ check_topology_on(dbref player, dbref i)
   return;
 }
 
+/* The periodic check only looks at objects that changed since they
+ * were last checked. Changing an object's attributes, locks, flags,
+ * links, parent or owner queues it; each run checks a slice of the
+ * queue. Objects whose owner isn't connected wait until the owner
+ * connects. Every object is also on a list of its owner's objects, so
+ * @wcheck/me doesn't have to look through the whole database.
+ *
+ * Nothing is tracked until the first check needs it; that queues every
+ * object once.
+ */
+
+/** How many queued objects one periodic run checks */
+#define WCHECK_SLICE 500
+
+enum wcheck_state {
+  WCHECK_CHECKED, /**< Not changed since it was last checked */
+  WCHECK_QUEUED,  /**< On wcheck_queue */
+  WCHECK_WAITING  /**< Changed, waiting for its owner to connect */
+};
+
+/** Incremental warning state of one object */
+struct wcheck_obj {
+  dbref owner;  /**< Owner whose list the object is on, or NOTHING */
+  dbref prev;   /**< Previous object on that list */
+  dbref next;   /**< Next object on that list */
+  dbref owned;  /**< First object on this object's own list */
+  enum wcheck_state state;
+};
+
+static struct wcheck_obj *wcheck_objs = NULL;
+static int wcheck_size = 0;
+static dbref *wcheck_queue = NULL;
+static int wcheck_queued = 0, wcheck_queue_size = 0;
+
+static void
+wcheck_grow(void)
+{
+  int n = wcheck_size ? wcheck_size : 64;
+
+  while (n < db_top) {
+    n *= 2;
+  }
+  wcheck_objs =
+    mush_realloc(wcheck_objs, n * sizeof *wcheck_objs, "wcheck.objects");
+  for (; wcheck_size < n; wcheck_size++) {
+    struct wcheck_obj *w = &wcheck_objs[wcheck_size];
+    w->owner = w->prev = w->next = w->owned = NOTHING;
+    w->state = WCHECK_CHECKED;
+  }
+}
+
+/* Put thing on its current owner's list, if it isn't already. */
+static void
+wcheck_list(dbref thing)
+{
+  struct wcheck_obj *w = &wcheck_objs[thing];
+  dbref owner = Owner(thing);
+
+  if (w->owner == owner || !GoodObject(owner)) {
+    return;
+  }
+  if (w->owner != NOTHING) {
+    if (w->prev != NOTHING) {
+      wcheck_objs[w->prev].next = w->next;
+    } else {
+      wcheck_objs[w->owner].owned = w->next;
+    }
+    if (w->next != NOTHING) {
+      wcheck_objs[w->next].prev = w->prev;
+    }
+  }
+  w->owner = owner;
+  w->prev = NOTHING;
+  w->next = wcheck_objs[owner].owned;
+  if (w->next != NOTHING) {
+    wcheck_objs[w->next].prev = thing;
+  }
+  wcheck_objs[owner].owned = thing;
+}
+
+static void
+wcheck_enqueue(dbref thing)
+{
+  if (wcheck_objs[thing].state == WCHECK_QUEUED) {
+    return;
+  }
+  if (wcheck_queued == wcheck_queue_size) {
+    wcheck_queue_size = wcheck_queue_size ? wcheck_queue_size * 2 : 64;
+    wcheck_queue = mush_realloc(wcheck_queue,
+                                wcheck_queue_size * sizeof *wcheck_queue,
+                                "wcheck.queue");
+  }
+  wcheck_queue[wcheck_queued++] = thing;
+  wcheck_objs[thing].state = WCHECK_QUEUED;
+}
+
+/* Start tracking, with every object queued. */
+static void
+wcheck_start(void)
+{
+  dbref i;
+
+  if (wcheck_objs) {
+    return;
+  }
+  wcheck_grow();
+  /* Backwards, so the owner lists come out in dbref order */
+  for (i = db_top - 1; i >= 0; i--) {
+    if (!IsGarbage(i)) {
+      wcheck_list(i);
+      wcheck_enqueue(i);
+    }
+  }
+}
+
+/** Note that an object changed in a way that can change its warnings.
+ * Changing an exit can also change the warnings of the exits that lead
+ * back along it, so they're queued as well; call this before and after
+ * relinking an exit.
+ * \param thing the object that changed.
+ */
+void
+warnings_changed(dbref thing)
+{
+  dbref src, dst, j;
+
+  if (!wcheck_objs || !GoodObject(thing)) {
+    return;
+  }
+  if (thing >= wcheck_size) {
+    wcheck_grow();
+  }
+  wcheck_list(thing);
+  wcheck_enqueue(thing);
+
+  if (!IsExit(thing)) {
+    return;
+  }
+  src = Source(thing);
+  dst = Destination(thing);
+  if (GoodObject(src) && GoodObject(dst) && IsRoom(dst)) {
+    for (j = Exits(dst); GoodObject(j); j = Next(j)) {
+      if (Location(j) == src && j < wcheck_size) {
+        wcheck_enqueue(j);
+      }
+    }
+  }
+}
+
+/** Queue the changed objects of a player who just connected.
+ * \param player the player.
+ */
+void
+warnings_connected(dbref player)
+{
+  dbref i;
+
+  if (!wcheck_objs || !GoodObject(player) || player >= wcheck_size) {
+    return;
+  }
+  for (i = wcheck_objs[player].owned; i != NOTHING; i = wcheck_objs[i].next) {
+    if (wcheck_objs[i].state == WCHECK_WAITING) {
+      wcheck_enqueue(i);
+    }
+  }
+}
+
+/** Check a slice of the objects that changed since they were last
+ * checked, warning their owners.
+ * \retval 1 there are more objects to check.
+ * \retval 0 everything has been checked.
+ */
+bool
+run_topology_changes(void)
+{
+  int n;
+
+  wcheck_start();
+  for (n = 0; n < WCHECK_SLICE && wcheck_queued > 0; n++) {
+    dbref i = wcheck_queue[--wcheck_queued];
+
+    if (!GoodObject(i) || IsGarbage(i)) {
+      wcheck_objs[i].state = WCHECK_CHECKED;
+    } else if (!Connected(Owner(i)) || NoWarn(Owner(i))) {
+      wcheck_objs[i].state = WCHECK_WAITING;
+    } else {
+      wcheck_objs[i].state = WCHECK_CHECKED;
+      check_topology_on(Owner(i), i);
+    }
+  }
+  return wcheck_queued > 0;
+}
+
+TEST_GROUP(warnings_changed)
+{
+  dbref i;
+  int found = 0;
+
+  /* Nobody is connected while the tests run, so changed objects end up
+   * waiting for their owners. */
+  while (run_topology_changes())
+    ;
+  TEST("warnings_changed.1", wcheck_queued == 0);
+  warnings_changed(0);
+  warnings_changed(0);
+  TEST("warnings_changed.2",
+       wcheck_queued == 1 && wcheck_objs[0].state == WCHECK_QUEUED);
+  TEST("warnings_changed.3", !run_topology_changes());
+  TEST("warnings_changed.4", wcheck_objs[0].state == WCHECK_WAITING);
+  warnings_connected(Owner(0));
+  TEST("warnings_changed.5", wcheck_objs[0].state == WCHECK_QUEUED);
+  (void) run_topology_changes();
+  for (i = wcheck_objs[Owner(0)].owned; i != NOTHING; i = wcheck_objs[i].next)
+    found += (i == 0);
+  TEST("warnings_changed.6", found == 1);
+}
+
 /** Loop through all objects and check their topology.  */
 void
 run_topology(void)
@@ -417,13 +638,29 @@ do_wcheck_all(dbref player)
 void
 do_wcheck_me(dbref player)
 {
-  int ndone;
+  dbref i;
+  dbref *owned;
+  int n = 0, count = 0;
+
   if (!Connected(player))
     return;
-  for (ndone = 0; ndone < db_top; ndone++) {
-    if ((Owner(ndone) == player) && !IsGarbage(ndone))
-      check_topology_on(player, ndone);
+  wcheck_start();
+  if (player < wcheck_size) {
+    for (i = wcheck_objs[player].owned; i != NOTHING; i = wcheck_objs[i].next)
+      count++;
+  }
+  /* Check them in dbref order, as they appear in the database */
+  owned = mush_calloc(count + 1, sizeof(dbref), "wcheck.owned");
+  if (player < wcheck_size) {
+    for (i = wcheck_objs[player].owned; i != NOTHING; i = wcheck_objs[i].next)
+      owned[n++] = i;
+  }
+  qsort(owned, n, sizeof(dbref), int_comp);
+  for (i = 0; i < n; i++) {
+    if ((Owner(owned[i]) == player) && !IsGarbage(owned[i]))
+      check_topology_on(player, owned[i]);
   }
+  mush_free(owned, "wcheck.owned");
   notify(player, T("@wcheck complete."));
   return;
 }
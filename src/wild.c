@@ -247,8 +247,8 @@ wild_match_test(const char *restrict pat, const char *restrict str, bool cs,
     matches[i * 2 + 1] = 0;
   }
 
-  pat = mush_strncpy(pbuff, remove_markup(pat, NULL), sizeof pbuff);
-  str = mush_strncpy(tbuff, remove_markup(str, NULL), sizeof tbuff);
+  pat = remove_markup_r(pat, pbuff, NULL);
+  str = remove_markup_r(str, tbuff, NULL);
   slen = strlen(str);
 
   if (!cs) {
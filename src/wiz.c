@@ -1569,6 +1569,7 @@ delete_link_from(dbref obj)
   sqlite3 *sqldb;
   sqlite3_stmt *deleter;
 
+  warnings_changed(obj);
   sqldb = get_shared_db();
   deleter = prepare_statement(sqldb, "DELETE FROM linked WHERE from_obj = ?",
                               "linked.delete_one");
@@ -1589,6 +1590,7 @@ add_link(dbref from, dbref to)
   sqlite3 *sqldb;
   sqlite3_stmt *adder;
 
+  warnings_changed(from);
   if (!GoodObject(from) || !GoodObject(to)) {
     return;
   }
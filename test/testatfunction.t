@@ -0,0 +1,26 @@
+run tests:
+# Function calls are cached by name; changes to @functions must show up
+test('atfunction.1', $god, '@create Funcs', 'Created');
+test('atfunction.2', $god, '&FN_TWICE Funcs=[mul(%0,2)]', 'Set');
+test('atfunction.3', $god, 'think twice(4)', '^twice\(4\)$');
+test('atfunction.4', $god, '@function twice=Funcs,FN_TWICE', 'Function added');
+test('atfunction.5', $god, 'think twice(4)', '^8$');
+test('atfunction.6', $god, '@function/delete twice', 'Function deleted');
+test('atfunction.7', $god, 'think twice(4)', '^twice\(4\)$');
+# Overriding and restoring a builtin
+test('atfunction.8', $god, 'think strlen(abc)', '^3$');
+test('atfunction.9', $god, '@function/delete strlen', 'Function deleted');
+test('atfunction.10', $god, 'think strlen(abc)', '^strlen\(abc\)$');
+test('atfunction.11', $god, '@function strlen=Funcs,FN_TWICE', 'Function added');
+test('atfunction.12', $god, 'think strlen(5)', '^10$');
+test('atfunction.13', $god, '@function/restore strlen', 'Restored');
+test('atfunction.14', $god, 'think strlen(abc)', '^3$');
+# Aliases
+test('atfunction.15', $god, '@function/alias strlen=slen', 'Alias added');
+test('atfunction.16', $god, 'think slen(abcd)', '^4$');
+test('atfunction.17', $god, '@function/delete slen', 'alias deleted');
+test('atfunction.18', $god, 'think slen(abcd)', '^slen\(abcd\)$');
+test('atfunction.19', $god, '@function/disable strlen', 'Disabled');
+test('atfunction.20', $god, 'think strlen(abc)', 'FUNCTION DISABLED');
+test('atfunction.21', $god, '@function/enable strlen', 'Enabled');
+test('atfunction.22', $god, 'think strlen(abc)', '^3$');
@@ -79,6 +79,18 @@ test('atree.matching.18', $god, 'think lattr(me)',
 test('atree.matching.19', $god, 'think lattr(me/**)',
      ['\bFOO\b', '\bFOO`BAR\b', '\bFOO`BAR`BAZ\b']);
 test("atree.matching.20", $god, 'think flags(me/foo)', '`');
+# Patterns with a literal prefix only look at part of the attribute list
+test("atree.matching.21", $god, '&foobar me=1', 'Set');
+test("atree.matching.22", $god, '&fop me=1', 'Set');
+test("atree.matching.23", $god, '&fo me=1', 'Set');
+test('atree.matching.24', $god, 'think nattr(me/fo*)', '^7$');
+test('atree.matching.25', $god, 'think lattr(me/foo`ba*)',
+     '^FOO`BAR FOO`BAR`BAZ FOO`BAZ$');
+test('atree.matching.26', $god, 'think lattr(me/foo`bar`)', '^FOO`BAR`BAZ$');
+test('atree.matching.27', $god, 'think lattr(me/fo?)', '^FOO FOP$');
+test('atree.matching.28', $god, 'think lattrp(me/foo`b?z)', '^FOO`BAZ$');
+test('atree.matching.29', $god, '@wipe me/fo*', 'wiped');
+test('atree.matching.30', $god, 'think nattr(me/f*)', '^0$');
 
 # Permissions checks
 # Need a mortal for this...
@@ -0,0 +1,52 @@
+run tests:
+# Enough attributes to need several leaves in the attribute list
+test('attrlist.1', $god, '@create Attrlist', 'Created');
+test('attrlist.2', $god, '@set me=quiet', '.');
+# Added in reverse order, so every insert is at the front
+test('attrlist.3', $god,
+     'think [null(iter(lnum(300,1),attrib_set(Attrlist/A[rjust(%i0,3,0)],%i0)))][nattr(Attrlist)]',
+     '^300$');
+test('attrlist.4', $god,
+     'think [comp(lattr(Attrlist),sort(lattr(Attrlist)))] [first(lattr(Attrlist))] [last(lattr(Attrlist))]',
+     '^0 A001 A300$');
+test('attrlist.5', $god,
+     'think [get(Attrlist/A001)] [get(Attrlist/A150)] [get(Attrlist/A300)]',
+     '^1 150 300$');
+test('attrlist.6', $god, 'think lattr(Attrlist/A29*)',
+     '^A290 A291 A292 A293 A294 A295 A296 A297 A298 A299$');
+test('attrlist.7', $god, 'think nattr(Attrlist/A1*)', '^100$');
+test('attrlist.8', $god, '@wipe Attrlist/A1*', 'wiped');
+test('attrlist.9', $god,
+     'think [nattr(Attrlist)] [get(Attrlist/A099)] [get(Attrlist/A200)] [nattr(Attrlist/A1*)]',
+     '^200 99 200 0$');
+# Attribute trees spanning leaves
+test('attrlist.10', $god, '&T Attrlist=x', '^$');
+test('attrlist.11', $god,
+     'think [null(iter(lnum(200),attrib_set(Attrlist/T`[rjust(%i0,3,0)],%i0)))][nattr(Attrlist/T`*)]',
+     '^200$');
+test('attrlist.12', $god,
+     'think [get(Attrlist/T`000)] [get(Attrlist/T`199)] [hasflag(Attrlist/T,`)]',
+     '^0 199 1$');
+test('attrlist.13', $god, '@wipe Attrlist/T', 'wiped');
+test('attrlist.14', $god, 'think [nattr(Attrlist/T**)] [nattr(Attrlist)]',
+     '^0 200$');
+# Empty it, then fill it back up in order
+test('attrlist.15', $god, '@wipe Attrlist', 'wiped');
+test('attrlist.16', $god,
+     'think [nattr(Attrlist)] [null(iter(lnum(1,300),attrib_set(Attrlist/B[rjust(%i0,3,0)],%i0)))][nattr(Attrlist/B*)]',
+     '^0 300$');
+test('attrlist.17', $god,
+     'think [comp(lattr(Attrlist),sort(lattr(Attrlist)))] [get(Attrlist/B129)] [get(Attrlist/B257)]',
+     '^0 129 257$');
+# Lookups after attributes move around within and between leaves
+test('attrlist.18', $god, '@wipe Attrlist/B1*', 'wiped');
+test('attrlist.19', $god,
+     'think [hasattr(Attrlist,B100)] [hasattr(Attrlist,B099)] [get(Attrlist/B150)]|[get(Attrlist/B200)] [get(Attrlist/B300)]',
+     '^0 1 \\|200 300$');
+test('attrlist.20', $god,
+     'think [null(iter(lnum(100,199),attrib_set(Attrlist/B%i0,x%i0)))][get(Attrlist/B100)] [get(Attrlist/B199)] [get(Attrlist/B099)] [nattr(Attrlist)]',
+     '^x100 x199 99 300$');
+test('attrlist.21', $god,
+     'think [null(iter(lnum(1,280),attrib_set(Attrlist/B[rjust(%i0,3,0)])))][nattr(Attrlist)] [get(Attrlist/B281)] [hasattr(Attrlist,B001)]',
+     '^20 281 0$');
+test('attrlist.22', $god, '@set me=!quiet', '.');
@@ -0,0 +1,21 @@
+run tests:
+# Identical attribute values share storage, and changing one copy
+# leaves the others alone
+test('chunks.1', $god, '@set me=quiet', '.');
+test('chunks.2', $god, '@create Chunks1', 'Created');
+test('chunks.3', $god, '@create Chunks2', 'Created');
+test('chunks.4', $god,
+     'think [attrib_set(Chunks1/SAME,a shared value)][attrib_set(Chunks2/SAME,a shared value)][attrib_set(Chunks2/OTHER,a shared value)][get(Chunks1/SAME)]',
+     '^a shared value$');
+test('chunks.5', $god, '&SAME Chunks1=changed', '^$');
+test('chunks.6', $god,
+     'think [get(Chunks1/SAME)]/[get(Chunks2/SAME)]/[get(Chunks2/OTHER)]',
+     '^changed/a shared value/a shared value$');
+test('chunks.7', $god, '@wipe Chunks2/SAME', 'wiped');
+test('chunks.8', $god, 'think [get(Chunks2/OTHER)]', '^a shared value$');
+test('chunks.9', $god, '&SAME Chunks2=changed', '^$');
+test('chunks.10', $god, 'think [get(Chunks1/SAME)]/[get(Chunks2/SAME)]',
+     '^changed/changed$');
+test('chunks.11', $god, '@stats/chunks',
+     'Shared:\s+\d+ values\s+\(\s*\d+ references,\s+\d+ bytes saved\)');
+test('chunks.12', $god, '@set me=!quiet', '.');
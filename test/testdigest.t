@@ -15,3 +15,7 @@ test('digest.10', $mortal, 'think digest(whirlpool, foo)', 'b1b2ee48991281a439da
 
 test('base64.1', $mortal, 'think encode64(test string)', 'dGVzdCBzdHJpbmc=');
 test("base64.2", $mortal, "think decode64(encode64(this is another fine mess you've gotten us into))", "this is another fine mess you've gotten us into");
+test('base64.3', $mortal, 'think decode64(Zm9vYg)', '^foob$');
+test('base64.4', $mortal, 'think decode64(Zm9v YmFy)', '^foobar$');
+test('base64.5', $mortal, 'think decode64(Zm9v!YmFy)', '^#-1 CONVERSION ERROR$');
+test('base64.6', $mortal, 'think strlen(decode64(encode64(repeat(abcdefghijklmnopqrstuvwxyz,200))))', '^5200$');
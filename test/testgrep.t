@@ -35,3 +35,17 @@ test('grep.23', $mortal, 'think regrepi(me,*,d)', 'SECOND THIRD');
 test('grep.24', $mortal, 'think regrepi(me,*,d$)', 'SECOND THIRD');
 test('grep.25', $mortal, 'think regrepi(me,*,first)', 'FIRST');
 test('grep.26', $mortal, 'think regrepi(me,*,FIRST)', 'FIRST');
+
+# Database-wide grep
+$mortal->command("&GREPALL me=a xyzzy b");
+test('grep.27', $mortal, '@grep/all *=xyzzy', 'Permission denied');
+test('grep.28', $god, '@grep/all *=xyzzy', 'Grepping');
+sleep 1;
+test('grep.29', $god, undef, ['\(#\d+\w*\): GREPALL\s', '1 matches on 1 objects']);
+test('grep.30', $god, '@grep/all/regexp GREP*=x[y]+zzy', 'Grepping');
+sleep 1;
+test('grep.31', $god, undef, ['GREPALL', '1 matches']);
+test('grep.32', $god, '@grep/all/nocase NOPE=XYZZY', 'Grepping');
+sleep 1;
+test('grep.33', $god, undef, ['!GREPALL', '0 matches']);
+test('grep.34', $god, '@grep/status', 'Nobody is grepping');
@@ -0,0 +1,12 @@
+run tests:
+# Topic lookups and 'help entries' pages come from the in-memory index
+test('help.1', $god, 'think textentries(help,@pemit)', '^@pemit$');
+test('help.2', $god, 'think words(textentries(help,@pe*))', '^[1-9]');
+test('help.3', $god, 'think first(textentries(help,*))', '^\S');
+test('help.4', $god, 'think textfile(help,@pemi)', 'pemit');
+test('help.5', $god, 'think textfile(help,xyzzyplugh)', '^#-1 NO ENTRY');
+test('help.6', $god, 'think textfile(help,entries)', 'For more, see ENTRIES-2');
+test('help.7', $god, 'think textfile(help,entries-2)', '^ \S');
+test('help.8', $god, 'think textfile(help,entries-99999)', '^#-1 NO ENTRY');
+test('help.9', $god, 'help @pemi', '@pemit');
+test('help.10', $god, 'help entries', 'ENTRIES');
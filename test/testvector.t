@@ -0,0 +1,31 @@
+run tests:
+test('vadd.1', $god, 'think vadd(1 2 3,4 5 6)', '^5 7 9$');
+test('vadd.2', $god, 'think vadd(1.5|-2|0.25,0.5|2|0.75,|)', '^2\|0\|1$');
+test('vadd.3', $god, 'think vadd(1 2 3,4 5)', '^#-1 VECTORS MUST BE SAME DIMENSIONS$');
+test('vadd.4', $god, 'think vadd(0.1 0.2,0.2 0.1)', '^0.3 0.3$');
+test('vadd.5', $god, 'think vadd(  1   2  ,3 4)', '^4 6$');
+test('vadd.6', $god, 'think vadd(1e3 -0,foo 0)', '^1000 0$');
+test('vsub.1', $god, 'think vsub(5 7 9,4 5 6)', '^1 2 3$');
+test('vsub.2', $god, 'think vsub(0,0.0000001)', '^-0$');
+test('vsub.3', $god, 'think vsub(1 2,1 2 3)', '^#-1 VECTORS MUST BE SAME DIMENSIONS$');
+test('vmul.1', $god, 'think vmul(1 2 3,2)', '^2 4 6$');
+test('vmul.2', $god, 'think vmul(3,1 2 3)', '^3 6 9$');
+test('vmul.3', $god, 'think vmul(1 2 3,4 5 6)', '^4 10 18$');
+test('vmul.4', $god, 'think vmul(1 2 3,4 5)', '^#-1 VECTORS MUST BE SAME DIMENSIONS$');
+test('vmax.1', $god, 'think vmax(1 5 3,4 2 6)', '^4 5 6$');
+test('vmin.1', $god, 'think vmin(1 5 3,4 2 6)', '^1 2 3$');
+test('vdot.1', $god, 'think vdot(1 2 3,4 5 6)', '^32$');
+test('vdot.2', $god, 'think vdot(1 2 3,4 5)', '^#-1 VECTORS MUST BE SAME DIMENSIONS$');
+test('vmag.1', $god, 'think vmag(3 4)', '^5$');
+test('vmag.2', $god, 'think vmag(1 1 1)', '^1.732051$');
+test('vmag.3', $god, 'think vmag()', '^#-1 VECTOR MUST NOT BE EMPTY$');
+test('vunit.1', $god, 'think vunit(3 4)', '^0.6 0.8$');
+test('vunit.2', $god, 'think vunit(0 0 0)', '^0 0 0$');
+test('vcross.1', $god, 'think vcross(1 0 0,0 1 0)', '^0 0 1$');
+test('lmath.1', $god, 'think lmath(add,1 2 3.5)', '^6.5$');
+test('lmath.2', $god, 'think lmath(sub,10|2|3,|)', '^5$');
+test('lmath.3', $god, 'think lmath(max,1 9 -3)', '^9$');
+test('lmath.4', $god, 'think lmath(lt,1 2 3)', '^1$');
+test('lmath.5', $god, 'think lmath(gte,3 3 1)', '^1$');
+test('lmath.6', $god, 'think lmath(add,1 foo)', '^#-1 ARGUMENTS MUST BE NUMBERS$');
+test('lmath.7', $god, 'think lmath(mul,1.5 2 -4)', '^-12$');
@@ -0,0 +1,14 @@
+run tests:
+# @wcheck/me finds the player's objects through the per-owner index,
+# which has to follow creation, changes and destruction.
+test('wcheck.1', $god, '@warnings me=normal', 'set to');
+test('wcheck.2', $god, '@create WcThing', 'Created');
+test('wcheck.3', $god, 'drop WcThing', 'You drop');
+test('wcheck.4', $god, '@wcheck/me', '(?s)thing-desc.*WcThing.*@wcheck complete');
+test('wcheck.5', $god, '@desc WcThing=A thing.', 'Set');
+test('wcheck.6', $god, '@wcheck/me', '(?s)^(?!.*WcThing).*@wcheck complete');
+test('wcheck.7', $god, '@create WcOther', 'Created');
+test('wcheck.8', $god, 'drop WcOther', 'You drop');
+test('wcheck.9', $god, '@wcheck/me', '(?s)WcOther.*@wcheck complete');
+test('wcheck.10', $god, '@nuke WcOther', '.');
+test('wcheck.11', $god, '@wcheck/me', '(?s)^(?!.*WcOther).*@wcheck complete');
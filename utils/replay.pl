@@ -0,0 +1,314 @@
+#!/usr/bin/env perl
+
+# Script for replaying a capture_log input trace against a running game
+# and measuring how quickly it answers.
+# Run with --help for details, or look at the end.
+
+use strict;
+use warnings;
+use Getopt::Long;
+use IO::Socket::INET;
+use IO::Select;
+use POSIX qw/sysconf _SC_CLK_TCK/;
+use Time::HiRes qw/time sleep/;
+use Pod::Text::Termcap;
+
+our $host = "localhost";
+our $port = 4201;
+our $password = "";
+our $speed = 1;
+our $pid = 0;
+our $pidfile = "";
+our $drain = 10;
+our $help = 0;
+
+GetOptions("host=s" => \$host,
+	   "port|p=i" => \$port,
+	   "password|w=s" => \$password,
+	   "speed|s=f" => \$speed,
+	   "pid=i" => \$pid,
+	   "pidfile=s" => \$pidfile,
+	   "drain=f" => \$drain,
+	   "help|h" => \$help);
+
+if ($help) {
+  # Display pretty documentation.
+  my $parser = Pod::Text::Termcap->new;
+  $parser->output_fh(*STDERR);
+  $parser->parse_file(*DATA);
+  exit 0;
+}
+
+die "--speed must be positive.\n" unless $speed > 0;
+die "--password is required to log players in.\n" if $password eq "";
+
+if ($pidfile ne "") {
+  open my $pfh, "<", $pidfile or die "Unable to open $pidfile: $!\n";
+  $pid = <$pfh>;
+  close $pfh;
+  chomp $pid;
+  die "No pid in $pidfile\n" unless $pid =~ /^\d+$/;
+}
+
+# Marks the end of the output of each command, so we know when the game
+# has answered it.
+our $marker = "--REPLAY-$$-DONE--";
+
+# Lines that the game answers without an output suffix, or that would
+# clobber ours. Sending OUTPUTPREFIX/OUTPUTSUFFIX is skipped entirely;
+# the others are sent but not timed.
+our $skip_re = qr/^(?:OUTPUTPREFIX|OUTPUTSUFFIX)/;
+our $untimed_re =
+  qr/^(?:IDLE|QUIT$|LOGOUT$|SCREENWIDTH|SCREENHEIGHT|PROMPT_NEWLINES|SOCKSET|PUEBLOCLIENT )/;
+
+# Returns (user, system) CPU seconds and current and peak RSS in KiB
+# of the game process, or an empty list if it can't be read.
+sub server_usage {
+  return () unless $pid;
+  open my $sfh, "<", "/proc/$pid/stat" or return ();
+  my $stat = <$sfh>;
+  close $sfh;
+  # The command name may contain spaces; skip past it.
+  $stat =~ s/^.*\)\s+//;
+  my @f = split ' ', $stat;
+  my $ticks = sysconf(_SC_CLK_TCK) || 100;
+  my ($rss, $hwm) = (0, 0);
+  if (open my $mfh, "<", "/proc/$pid/status") {
+    while (<$mfh>) {
+      $rss = $1 if /^VmRSS:\s+(\d+)/;
+      $hwm = $1 if /^VmHWM:\s+(\d+)/;
+    }
+    close $mfh;
+  }
+  return ($f[11] / $ticks, $f[12] / $ticks, $rss, $hwm);
+}
+
+sub percentile {
+  my ($sorted, $p) = @_;
+  return 0 unless @$sorted;
+  my $rank = int($p / 100 * @$sorted + 0.999999) - 1;
+  $rank = 0 if $rank < 0;
+  return $sorted->[$rank];
+}
+
+our @events;
+
+while (<>) {
+  chomp;
+  s/\r$//;
+  next if /^#/ || /^\s*$/;
+  my ($ms, $ev, $fd, $data) = /^(\d+) ([CLID]) (\d+)(?: (.*))?$/;
+  unless (defined $ms) {
+    warn "Skipping malformed trace line $.\n";
+    next;
+  }
+  push @events, [$ms, $ev, $fd, $data];
+}
+
+die "Empty trace.\n" unless @events;
+
+our %session_of;    # Trace descriptor => live session
+our %session_by_sock;    # Socket => session
+our $select = IO::Select->new;
+our @latencies;
+our ($sent, $timed, $failed) = (0, 0, 0);
+
+sub close_session {
+  my $s = shift;
+  return unless $s->{sock};
+  $select->remove($s->{sock});
+  delete $session_by_sock{ $s->{sock} };
+  close $s->{sock};
+  $s->{sock} = undef;
+}
+
+sub send_line {
+  my ($s, $line) = @_;
+  my $sock = $s->{sock};
+  my $buf = "$line\r\n";
+  # The game drains its input quickly; a short blocking write is fine.
+  $sock->blocking(1);
+  my $ok = defined $sock->syswrite($buf);
+  $sock->blocking(0);
+  close_session($s) unless $ok;
+  return $ok;
+}
+
+sub read_session {
+  my $s = shift;
+  my $got = $s->{sock}->sysread(my $chunk, 65536);
+  if (!$got) {
+    close_session($s) unless defined $got && $!{EAGAIN};
+    return;
+  }
+  $s->{buf} .= $chunk;
+  while ($s->{buf} =~ s/^([^\n]*)\n//) {
+    my $line = $1;
+    $line =~ s/\r$//;
+    next unless $line eq $marker;
+    my $start = shift @{ $s->{pending} };
+    push @latencies, time - $start if defined $start;
+  }
+}
+
+sub dispatch {
+  my $e = shift;
+  my ($ms, $ev, $fd, $data) = @$e;
+  if ($ev eq "C") {
+    close_session($session_of{$fd}) if $session_of{$fd};
+    my $sock = IO::Socket::INET->new(PeerAddr => $host, PeerPort => $port,
+				     Proto => "tcp");
+    unless ($sock) {
+      $failed++;
+      delete $session_of{$fd};
+      return;
+    }
+    $sock->blocking(0);
+    my $s = { sock => $sock, pending => [], buf => "" };
+    $session_of{$fd} = $s;
+    $session_by_sock{$sock} = $s;
+    $select->add($sock);
+    send_line($s, "OUTPUTSUFFIX $marker");
+    return;
+  }
+  my $s = $session_of{$fd};
+  return unless $s && $s->{sock};
+  if ($ev eq "L") {
+    send_line($s, "connect $data $password");
+  } elsif ($ev eq "I") {
+    return if $data =~ $skip_re;
+    my $now = time;
+    return unless send_line($s, $data);
+    $sent++;
+    unless ($data =~ $untimed_re) {
+      push @{ $s->{pending} }, $now;
+      $timed++;
+    }
+  } elsif ($ev eq "D") {
+    close_session($s);
+    delete $session_of{$fd};
+  }
+}
+
+our @before = server_usage;
+our $origin = $events[0][0];
+our $start = time;
+our $i = 0;
+
+while ($i < @events) {
+  my $due = $start + ($events[$i][0] - $origin) / 1000 / $speed;
+  my $wait = $due - time;
+  if ($wait <= 0) {
+    dispatch($events[$i++]);
+    next;
+  }
+  $wait = 0.05 if $wait > 0.05;
+  foreach my $sock ($select->can_read($wait)) {
+    read_session($session_by_sock{$sock}) if $session_by_sock{$sock};
+  }
+}
+
+# Wait for the game to answer whatever is still outstanding.
+our $deadline = time + $drain;
+while (time < $deadline && grep { @{ $_->{pending} } } values %session_by_sock) {
+  foreach my $sock ($select->can_read(0.05)) {
+    read_session($session_by_sock{$sock}) if $session_by_sock{$sock};
+  }
+}
+our $elapsed = time - $start;
+our @after = server_usage;
+close_session($_) foreach values %session_by_sock;
+
+my @sorted = sort { $a <=> $b } @latencies;
+printf "Replayed %d events from %d sessions in %.2fs at %gx speed.\n",
+  scalar @events, scalar(grep { $_->[1] eq "C" } @events), $elapsed, $speed;
+printf "Sent %d lines, %d timed: %d answered, %d unanswered.\n",
+  $sent, $timed, scalar @latencies, $timed - @latencies;
+printf "Failed to connect %d times.\n", $failed if $failed;
+printf "Throughput: %.1f commands/sec\n", @latencies / $elapsed if $elapsed > 0;
+printf "Latency (ms): p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+  map { percentile(\@sorted, $_) * 1000 } 50, 90, 99, 100;
+if (@before && @after) {
+  printf "Server CPU: %.2fs user, %.2fs system (%.0f%% of one core)\n",
+    $after[0] - $before[0], $after[1] - $before[1],
+    100 * ($after[0] + $after[1] - $before[0] - $before[1]) / $elapsed;
+  printf "Server RSS: %d KiB -> %d KiB, peak %d KiB\n",
+    $before[2], $after[2], $after[3];
+} elsif ($pid) {
+  warn "Unable to read /proc/$pid; no server usage reported.\n";
+}
+
+__DATA__
+
+=head1 Usage
+
+ replay.pl [ARGS ...] --password FOO TRACE ...
+
+=head1 Description
+
+replay is a tool for load testing a B<PennMUSH> game with the
+traffic of real players. The game records a trace when the
+B<capture_log> option in F<mush.cnf> names a file: each connection,
+login, line of input from a connected player, and disconnection,
+with millisecond timestamps. Addresses aren't recorded, and neither
+is anything typed at the login screen, so the trace holds no
+passwords.
+
+replay plays the trace back against a running game, opening one
+connection per recorded connection and sending each line at the
+recorded time. Logins are replayed as C<connect #dbref password> using
+the B<--password> given, so run it against a copy of the database the
+trace was captured on with every password set to the same thing:
+
+ % utils/pwutil.pl --set all --password replay -o data/indb data/outdb
+
+Each connection sets an C<OUTPUTSUFFIX>, and the time from sending a
+command to seeing its suffix is that command's latency. When the trace
+has been played and the game has caught up (or B<--drain> seconds
+pass), replay reports latency percentiles, throughput, and, given
+B<--pid> or B<--pidfile>, the CPU time and memory the game used while
+the trace ran. Server usage is read from F</proc>, so it's only
+available on Linux.
+
+Lines that the game doesn't answer with a suffix, like C<IDLE> and
+C<LOGOUT>, are sent but not timed. Commands still waiting for a suffix
+when their connection closes or the drain period ends are counted as
+unanswered.
+
+=head2 Options
+
+=over
+
+=item B<--host> and B<--port>
+
+Where the game is listening. Defaults to I<localhost> port I<4201>.
+
+=item B<--speed>
+
+How fast to replay the trace. I<2> sends it at twice the recorded
+rate, I<0.5> at half. Defaults to I<1>.
+
+=item B<--pid> and B<--pidfile>
+
+The game's process id, or the file it's written to (F<netmush.pid>
+when started by F<restart>).
+
+=item B<--drain>
+
+Seconds to wait for outstanding answers after the last event.
+Defaults to I<10>.
+
+=back
+
+=head1 Examples
+
+=over
+
+=item *
+
+To replay a trace at 4 times its recorded speed:
+
+ % utils/replay.pl --port 4299 --password replay --speed 4 \
+     --pidfile game/netmush.pid game/log/capture.log
+
+=back